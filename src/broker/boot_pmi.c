@@ -21,6 +21,9 @@
 #include "src/common/libutil/cleanup.h"
 #include "src/common/libutil/ipaddr.h"
 #include "src/common/libutil/errno_safe.h"
+#include "src/common/libutil/monotime.h"
+#include "src/common/libidset/idset.h"
+#include "ccan/str/str.h"
 #include "src/common/libpmi/pmi.h"
 #include "src/common/libpmi/pmi_strerror.h"
 #include "src/common/libpmi/clique.h"
@@ -33,6 +36,16 @@
 
 #define DEFAULT_FANOUT 2
 
+/* PMI values are limited to 1024 bytes in the simple PMI wire protocol
+ * and in PMI-2, so longer values are split into chunks of this size.
+ */
+#define PMI_CHUNK_SIZE 1000
+
+enum {
+    BOOT_HOSTLIST_TREE,     // gather hostlist up the TBON topology
+    BOOT_HOSTLIST_ALL,      // every rank reads every business card
+};
+
 
 /*  If the broker is launched via flux-shell, then the shell may opt
  *  to set a "flux.instance-level" parameter in the PMI kvs to tell
@@ -178,12 +191,461 @@ static int set_hostlist_attr (attr_t *attrs, struct hostlist *hl)
     return rc;
 }
 
+/* Set broker.boot-hostlist attribute and return the hostlist method.
+ * The default may be overridden on the command line.
+ */
+static int get_hostlist_method (attr_t *attrs)
+{
+    const char *val;
+    int method = BOOT_HOSTLIST_TREE;
+
+    if (attr_get (attrs, "broker.boot-hostlist", &val, NULL) == 0) {
+        if (streq (val, "all"))
+            method = BOOT_HOSTLIST_ALL;
+        else if (!streq (val, "tree")) {
+            log_msg ("broker.boot-hostlist must be tree or all");
+            errno = EINVAL;
+            return -1;
+        }
+        (void)attr_delete (attrs, "broker.boot-hostlist", true);
+    }
+    if (attr_add (attrs,
+                  "broker.boot-hostlist",
+                  method == BOOT_HOSTLIST_ALL ? "all" : "tree",
+                  FLUX_ATTRFLAG_IMMUTABLE) < 0)
+        return -1;
+    return method;
+}
+
+/* Record the duration of a bootstrap phase, in seconds, as an attribute.
+ */
+static int set_boot_time_attr (attr_t *attrs,
+                               const char *phase,
+                               struct timespec *t)
+{
+    char name[64];
+    char val[32];
+
+    snprintf (name, sizeof (name), "broker.boot-time.%s", phase);
+    snprintf (val, sizeof (val), "%.3f", monotime_since (*t) / 1000.);
+    if (attr_add (attrs, name, val, FLUX_ATTRFLAG_IMMUTABLE) < 0) {
+        log_err ("setattr %s", name);
+        return -1;
+    }
+    monotime (t);
+    return 0;
+}
+
+/* Put 'value' under 'key', splitting it into 'key', 'key.1', 'key.2', ...
+ * if it is too long for a single PMI value.  The first chunk is prefixed
+ * with the chunk count and a colon, e.g. "2:".
+ */
+static int kvs_put_chunked (struct pmi_handle *pmi,
+                            const char *kvsname,
+                            const char *key,
+                            const char *value)
+{
+    size_t len = strlen (value);
+    int nchunks = len > 0 ? (len + PMI_CHUNK_SIZE - 1) / PMI_CHUNK_SIZE : 1;
+    char ckey[64];
+    char val[1024];
+    int result;
+    int i;
+
+    for (i = 0; i < nchunks; i++) {
+        const char *chunk = value + i * PMI_CHUNK_SIZE;
+        int chunklen = MIN (len - i * PMI_CHUNK_SIZE, PMI_CHUNK_SIZE);
+
+        if (i == 0) {
+            if (snprintf (ckey, sizeof (ckey), "%s", key) >= sizeof (ckey))
+                goto overflow;
+            snprintf (val, sizeof (val), "%d:%.*s", nchunks, chunklen, chunk);
+        }
+        else {
+            if (snprintf (ckey, sizeof (ckey), "%s.%d", key, i)
+                >= sizeof (ckey))
+                goto overflow;
+            snprintf (val, sizeof (val), "%.*s", chunklen, chunk);
+        }
+        result = broker_pmi_kvs_put (pmi, kvsname, ckey, val);
+        if (result != PMI_SUCCESS) {
+            log_msg ("broker_pmi_kvs_put %s: %s", ckey, pmi_strerror (result));
+            return -1;
+        }
+    }
+    return 0;
+overflow:
+    log_msg ("pmi key string overflow");
+    return -1;
+}
+
+/* Get a value stored with kvs_put_chunked().  Caller must free.
+ */
+static char *kvs_get_chunked (struct pmi_handle *pmi,
+                              const char *kvsname,
+                              const char *key,
+                              int from_rank)
+{
+    char ckey[64];
+    char val[1024];
+    char *endptr;
+    char *buf = NULL;
+    size_t len;
+    int nchunks;
+    int result;
+    int i;
+
+    result = broker_pmi_kvs_get (pmi, kvsname, key, val, sizeof (val),
+                                 from_rank);
+    if (result != PMI_SUCCESS) {
+        log_msg ("broker_pmi_kvs_get %s: %s", key, pmi_strerror (result));
+        return NULL;
+    }
+    errno = 0;
+    nchunks = strtol (val, &endptr, 10);
+    if (errno != 0 || *endptr != ':' || nchunks < 1) {
+        log_msg ("error decoding pmi value %s", key);
+        return NULL;
+    }
+    if (!(buf = malloc (nchunks * sizeof (val)))) {
+        log_err ("error allocating buffer for pmi value %s", key);
+        return NULL;
+    }
+    strcpy (buf, endptr + 1);
+    len = strlen (buf);
+    for (i = 1; i < nchunks; i++) {
+        if (snprintf (ckey, sizeof (ckey), "%s.%d", key, i) >= sizeof (ckey)) {
+            log_msg ("pmi key string overflow");
+            goto error;
+        }
+        result = broker_pmi_kvs_get (pmi, kvsname, ckey, val, sizeof (val),
+                                     from_rank);
+        if (result != PMI_SUCCESS) {
+            log_msg ("broker_pmi_kvs_get %s: %s", ckey, pmi_strerror (result));
+            goto error;
+        }
+        strcpy (buf + len, val);
+        len += strlen (val);
+    }
+    return buf;
+error:
+    free (buf);
+    return NULL;
+}
+
+/* A set of (rank, hostname) pairs for a TBON subtree.
+ */
+struct boot_host {
+    unsigned int rank;
+    char *hostname;
+};
+
+struct subtree {
+    struct boot_host *hosts;
+    int count;
+    int size;
+};
+
+static void subtree_clear (struct subtree *st)
+{
+    int i;
+
+    for (i = 0; i < st->count; i++)
+        free (st->hosts[i].hostname);
+    free (st->hosts);
+    memset (st, 0, sizeof (*st));
+}
+
+static int subtree_append (struct subtree *st,
+                           unsigned int rank,
+                           const char *hostname)
+{
+    struct boot_host *host;
+
+    if (st->count == st->size) {
+        int size = st->size ? st->size * 2 : 16;
+        struct boot_host *hosts;
+
+        if (!(hosts = realloc (st->hosts, size * sizeof (hosts[0]))))
+            return -1;
+        st->hosts = hosts;
+        st->size = size;
+    }
+    host = &st->hosts[st->count];
+    if (!(host->hostname = strdup (hostname)))
+        return -1;
+    host->rank = rank;
+    st->count++;
+    return 0;
+}
+
+static int by_rank (const void *a, const void *b)
+{
+    const struct boot_host *h1 = a;
+    const struct boot_host *h2 = b;
+
+    return h1->rank < h2->rank ? -1 : h1->rank > h2->rank ? 1 : 0;
+}
+
+/* Return subtree hosts as an RFC 29 hostlist in rank order.
+ */
+static struct hostlist *subtree_hostlist (struct subtree *st)
+{
+    struct hostlist *hl;
+    int i;
+
+    qsort (st->hosts, st->count, sizeof (st->hosts[0]), by_rank);
+    if (!(hl = hostlist_create ()))
+        return NULL;
+    for (i = 0; i < st->count; i++) {
+        if (hostlist_append (hl, st->hosts[i].hostname) < 0) {
+            hostlist_destroy (hl);
+            return NULL;
+        }
+    }
+    return hl;
+}
+
+/* Encode subtree as a JSON object with an RFC 22 idset of ranks and
+ * an RFC 29 hostlist of hostnames, both in rank order.  Caller must free.
+ */
+static char *subtree_encode (struct subtree *st)
+{
+    struct hostlist *hl;
+    struct idset *ids = NULL;
+    char *ranks = NULL;
+    char *hosts = NULL;
+    char *s = NULL;
+    json_t *o;
+    int i;
+
+    if (!(hl = subtree_hostlist (st))
+        || !(ids = idset_create (0, IDSET_FLAG_AUTOGROW)))
+        goto done;
+    for (i = 0; i < st->count; i++) {
+        if (idset_set (ids, st->hosts[i].rank) < 0)
+            goto done;
+    }
+    if (!(ranks = idset_encode (ids, IDSET_FLAG_RANGE))
+        || !(hosts = hostlist_encode (hl)))
+        goto done;
+    if ((o = json_pack ("{s:s s:s}", "ranks", ranks, "hosts", hosts))) {
+        s = json_dumps (o, JSON_COMPACT);
+        json_decref (o);
+    }
+done:
+    hostlist_destroy (hl);
+    idset_destroy (ids);
+    free (ranks);
+    free (hosts);
+    return s;
+}
+
+/* Decode subtree encoded with subtree_encode() and append it to 'st'.
+ */
+static int subtree_decode (struct subtree *st, const char *s)
+{
+    json_t *o;
+    const char *ranks;
+    const char *hosts;
+    struct idset *ids = NULL;
+    struct hostlist *hl = NULL;
+    unsigned int id;
+    const char *host;
+    int rc = -1;
+
+    if (!(o = json_loads (s, 0, NULL))
+        || json_unpack (o, "{s:s s:s}", "ranks", &ranks, "hosts", &hosts) < 0
+        || !(ids = idset_decode (ranks))
+        || !(hl = hostlist_decode (hosts))
+        || idset_count (ids) != hostlist_count (hl))
+        goto done;
+    id = idset_first (ids);
+    host = hostlist_first (hl);
+    while (id != IDSET_INVALID_ID && host) {
+        if (subtree_append (st, id, host) < 0)
+            goto done;
+        id = idset_next (ids, id);
+        host = hostlist_next (hl);
+    }
+    rc = 0;
+done:
+    json_decref (o);
+    idset_destroy (ids);
+    hostlist_destroy (hl);
+    return rc;
+}
+
+/* Fetch the business card of all ranks and build hostlist.
+ * The hostlist is built independently (and in parallel) on all ranks,
+ * so the total number of PMI gets grows as the square of the size.
+ * End with a barrier.
+ */
+static struct hostlist *gather_hostlist_all (struct pmi_handle *pmi,
+                                             struct pmi_params *pmi_params)
+{
+    struct hostlist *hl;
+    char key[64];
+    char val[1024];
+    json_t *o;
+    int result;
+    int i;
+
+    if (!(hl = hostlist_create ())) {
+        log_err ("hostlist_create");
+        return NULL;
+    }
+    for (i = 0; i < pmi_params->size; i++) {
+        const char *peer_hostname;
+
+        if (snprintf (key, sizeof (key), "%d", i) >= sizeof (key)) {
+            log_msg ("pmi key string overflow");
+            goto error;
+        }
+        result = broker_pmi_kvs_get (pmi, pmi_params->kvsname,
+                                     key, val, sizeof (val), i);
+
+        if (result != PMI_SUCCESS) {
+            log_msg ("broker_pmi_kvs_get %s: %s", key, pmi_strerror (result));
+            goto error;
+        }
+        if (!(o = json_loads (val, 0, NULL))
+            || json_unpack (o, "{s:s}", "hostname", &peer_hostname) < 0) {
+            log_msg ("error decoding rank %d pmi business card", i);
+            json_decref (o);
+            goto error;
+        }
+        if (hostlist_append (hl, peer_hostname) < 0) {
+            log_err ("hostlist_append");
+            json_decref (o);
+            goto error;
+        }
+        json_decref (o);
+    }
+    result = broker_pmi_barrier (pmi);
+    if (result != PMI_SUCCESS) {
+        log_msg ("broker_pmi_barrier: %s", pmi_strerror (result));
+        goto error;
+    }
+    return hl;
+error:
+    hostlist_destroy (hl);
+    return NULL;
+}
+
+/* Gather the hostlist up the TBON, then distribute it from rank 0.
+ * In round r, brokers at level (maxlevel - r) fetch the subtree of each
+ * child, add their own hostname, and put the result, so each broker only
+ * fetches its children's keys.  After maxlevel + 1 rounds, rank 0 has the
+ * complete hostlist, which it puts for all other ranks to fetch.
+ */
+static struct hostlist *gather_hostlist_tree (struct pmi_handle *pmi,
+                                              struct pmi_params *pmi_params,
+                                              struct topology *topo,
+                                              const char *hostname,
+                                              int *child_ranks,
+                                              int child_count)
+{
+    int level = topology_get_level (topo);
+    int maxlevel = topology_get_maxlevel (topo);
+    struct subtree st = { 0 };
+    struct hostlist *hl = NULL;
+    char key[64];
+    char *s = NULL;
+    int result;
+    int round;
+    int i;
+
+    for (round = 0; round <= maxlevel; round++) {
+        if (round == maxlevel - level) {
+            if (subtree_append (&st, pmi_params->rank, hostname) < 0) {
+                log_err ("error adding hostname to subtree");
+                goto error;
+            }
+            for (i = 0; i < child_count; i++) {
+                snprintf (key,
+                          sizeof (key),
+                          "flux.subtree.%d",
+                          child_ranks[i]);
+                if (!(s = kvs_get_chunked (pmi,
+                                           pmi_params->kvsname,
+                                           key,
+                                           child_ranks[i]))
+                    || subtree_decode (&st, s) < 0) {
+                    log_msg ("error fetching rank %d subtree hostlist",
+                             child_ranks[i]);
+                    goto error;
+                }
+                free (s);
+                s = NULL;
+            }
+            if (pmi_params->rank == 0) {
+                if (!(hl = subtree_hostlist (&st))
+                    || !(s = hostlist_encode (hl))) {
+                    log_err ("error encoding hostlist");
+                    goto error;
+                }
+                snprintf (key, sizeof (key), "flux.hostlist");
+            }
+            else {
+                if (!(s = subtree_encode (&st))) {
+                    log_err ("error encoding subtree hostlist");
+                    goto error;
+                }
+                snprintf (key,
+                          sizeof (key),
+                          "flux.subtree.%d",
+                          pmi_params->rank);
+            }
+            if (kvs_put_chunked (pmi, pmi_params->kvsname, key, s) < 0)
+                goto error;
+            free (s);
+            s = NULL;
+            result = broker_pmi_kvs_commit (pmi, pmi_params->kvsname);
+            if (result != PMI_SUCCESS) {
+                log_msg ("broker_pmi_kvs_commit: %s", pmi_strerror (result));
+                goto error;
+            }
+        }
+        result = broker_pmi_barrier (pmi);
+        if (result != PMI_SUCCESS) {
+            log_msg ("broker_pmi_barrier: %s", pmi_strerror (result));
+            goto error;
+        }
+    }
+    if (pmi_params->rank > 0) {
+        if (!(s = kvs_get_chunked (pmi,
+                                   pmi_params->kvsname,
+                                   "flux.hostlist",
+                                   0))
+            || !(hl = hostlist_decode (s))) {
+            log_msg ("error fetching hostlist from rank 0");
+            goto error;
+        }
+    }
+    if (hostlist_count (hl) != pmi_params->size) {
+        log_msg ("hostlist has %d hosts, expected %d",
+                 hostlist_count (hl),
+                 pmi_params->size);
+        goto error;
+    }
+    free (s);
+    subtree_clear (&st);
+    return hl;
+error:
+    free (s);
+    subtree_clear (&st);
+    hostlist_destroy (hl);
+    return NULL;
+}
+
 int boot_pmi (struct overlay *overlay, attr_t *attrs)
 {
     uint32_t fanout;
     char key[64];
     char val[1024];
     char hostname[MAXHOSTNAMELEN + 1];
+    const char *fakehost;
     char *bizcard = NULL;
     struct hostlist *hl = NULL;
     json_t *o;
@@ -194,8 +656,12 @@ int boot_pmi (struct overlay *overlay, attr_t *attrs)
     int *child_ranks = NULL;
     int result;
     const char *uri;
+    int method;
+    struct timespec t;
     int i;
 
+    monotime (&t);
+
     /* Fetch the tbon.fanout attribute and supply a default value if unset.
      */
     if (attr_get_uint32 (attrs, "tbon.fanout", &fanout) < 0)
@@ -207,6 +673,8 @@ int boot_pmi (struct overlay *overlay, attr_t *attrs)
                          fanout,
                          FLUX_ATTRFLAG_IMMUTABLE) < 0)
         return -1;
+    if ((method = get_hostlist_method (attrs)) < 0)
+        return -1;
 
 
     memset (&pmi_params, 0, sizeof (pmi_params));
@@ -241,18 +709,22 @@ int boot_pmi (struct overlay *overlay, attr_t *attrs)
         log_err ("gethostname");
         goto error;
     }
-    if (!(hl = hostlist_create ())) {
-        log_err ("hostlist_create");
+    if ((fakehost = getenv ("FLUX_FAKE_HOSTNAME"))) // for testing
+        snprintf (hostname, sizeof (hostname), "%s", fakehost);
+    if (set_boot_time_attr (attrs, "init", &t) < 0)
         goto error;
-    }
 
     /* A size=1 instance has no peers, so skip the PMI exchange.
      */
     if (pmi_params.size == 1) {
-        if (hostlist_append (hl, hostname) < 0) {
+        if (!(hl = hostlist_create ())
+            || hostlist_append (hl, hostname) < 0) {
             log_err ("hostlist_append");
             goto error;
         }
+        if (set_boot_time_attr (attrs, "exchange", &t) < 0
+            || set_boot_time_attr (attrs, "hostlist", &t) < 0)
+            goto error;
         goto done;
     }
 
@@ -391,46 +863,26 @@ int boot_pmi (struct overlay *overlay, attr_t *attrs)
         }
         json_decref (o);
     }
+    if (set_boot_time_attr (attrs, "exchange", &t) < 0)
+        goto error;
 
-    /* Fetch the business card of all ranks and build hostlist.
-     * The hostlist is built indepenedently (and in parallel) on all ranks.
+    /* Build the hostlist.  Both methods end with a barrier, so that all
+     * clients are "allowed" before connects commence.
      */
-    for (i = 0; i < pmi_params.size; i++) {
-        const char *peer_hostname;
-
-        if (snprintf (key, sizeof (key), "%d", i) >= sizeof (key)) {
-            log_msg ("pmi key string overflow");
-            goto error;
-        }
-        result = broker_pmi_kvs_get (pmi, pmi_params.kvsname,
-                                     key, val, sizeof (val), i);
-
-        if (result != PMI_SUCCESS) {
-            log_msg ("broker_pmi_kvs_get %s: %s", key, pmi_strerror (result));
-            goto error;
-        }
-        if (!(o = json_loads (val, 0, NULL))
-            || json_unpack (o, "{s:s}", "hostname", &peer_hostname) < 0) {
-            log_msg ("error decoding rank %d pmi business card", i);
-            json_decref (o);
-            goto error;
-        }
-        if (hostlist_append (hl, peer_hostname) < 0) {
-            log_err ("hostlist_append");
-            json_decref (o);
-            goto error;
-        }
-        json_decref (o);
+    if (method == BOOT_HOSTLIST_ALL)
+        hl = gather_hostlist_all (pmi, &pmi_params);
+    else {
+        hl = gather_hostlist_tree (pmi,
+                                   &pmi_params,
+                                   topo,
+                                   hostname,
+                                   child_ranks,
+                                   child_count);
     }
-
-    /* One more barrier before allowing connects to commence.
-     * Need to ensure that all clients are "allowed".
-     */
-    result = broker_pmi_barrier (pmi);
-    if (result != PMI_SUCCESS) {
-        log_msg ("broker_pmi_barrier: %s", pmi_strerror (result));
+    if (!hl)
+        goto error;
+    if (set_boot_time_attr (attrs, "hostlist", &t) < 0)
         goto error;
-    }
 
 done:
     result = broker_pmi_finalize (pmi);
@@ -438,6 +890,8 @@ done:
         log_msg ("broker_pmi_finalize: %s", pmi_strerror (result));
         goto error;
     }
+    if (set_boot_time_attr (attrs, "finalize", &t) < 0)
+        goto error;
     if (set_hostlist_attr (attrs, hl) < 0) {
         log_err ("failed to set hostlist attribute to PMI-derived value");
         goto error;
@@ -14,7 +14,9 @@
 #include "config.h"
 #endif
 #include <inttypes.h>
+#include <limits.h>
 #include <assert.h>
+#include <lz4.h>
 #include <flux/core.h>
 
 #include "src/common/libczmqcontainers/czmq_containers.h"
@@ -24,6 +26,7 @@
 #include "src/common/libutil/iterators.h"
 #include "src/common/libutil/log.h"
 #include "src/common/libcontent/content.h"
+#include "src/common/libcontent/content-batch.h"
 
 #include "attr.h"
 #include "content-cache.h"
@@ -38,6 +41,13 @@ static const char *default_hash = "sha1";
 
 static const uint32_t default_cache_purge_target_size = 1024*1024*16;
 static const uint32_t default_cache_purge_old_entry = 10; // seconds
+static const uint32_t default_cache_purge_max_size = 0; // unlimited
+static const uint32_t default_cache_compress_target_size = 0; // disabled
+
+/* Blobs smaller than this are evicted rather than compressed, since
+ * there is little to be gained for the CPU cost.
+ */
+static const int compress_min_size = 256;
 
 /* Raise the max blob size value to 1GB so that large KVS values
  * (including KVS directories) can be supported while the KVS transitions
@@ -48,6 +58,19 @@ static const uint32_t default_blob_size_limit = 1048576*1024;
 
 static const uint32_t default_flush_batch_limit = 256;
 
+/* Cache misses and dirty entries are sent upstream (or to the backing
+ * store on rank 0) immediately while fewer than 'batch_inflight_limit'
+ * RPCs of that type are outstanding.  Beyond that they are queued, and
+ * sent in load-batch/store-batch RPCs as responses arrive.  A batch holds
+ * at most 'batch_max_count' entries, and store batches are closed once
+ * they exceed 'batch_max_size' bytes.  If the peer does not support
+ * batches, there is nothing to gain by queueing, so RPCs are not limited
+ * (stores on rank 0 are still bounded by 'flush_batch_limit').
+ */
+static const int batch_inflight_limit = 4;
+static const int batch_max_count = 256;
+static const int batch_max_size = 1048576*4;
+
 /* Hash digests are used as zhashx keys.  The digest size needs to be
  * available to zhashx comparator so make this global.
  */
@@ -58,17 +81,53 @@ struct msgstack {
     struct msgstack *next;
 };
 
+/* A content.load-batch or content.store-batch request.  It is answered
+ * once all of its slots have completed.
+ */
+struct batch_slot {
+    int errnum;
+    const flux_msg_t *data_msg;     // load: blob
+    uint8_t hash[BLOBREF_MAX_DIGEST_SIZE]; // store: hash
+};
+
+struct batch_request {
+    const flux_msg_t *msg;
+    bool load;
+    int pending;
+    int count;
+    struct batch_slot slots[];
+};
+
+struct batchwait {
+    struct batch_request *br;
+    int index;
+    struct batchwait *next;
+};
+
+/* Entries carried by an outgoing load-batch or store-batch RPC.
+ */
+struct batch_rpc {
+    int count;
+    struct cache_entry *entries[];
+};
+
 struct cache_entry {
-    void *data;
-    int len;
+    const flux_msg_t *data_msg;     // payload holds the blob (shared)
+    int len;                        // uncompressed blob size
+    void *zdata;                    // LZ4 compressed blob (if compressed)
+    int zlen;
     void *hash;                     // key storage is contiguous with struct
     uint8_t valid:1;                // entry contains valid data
     uint8_t dirty:1;                // entry needs to be stored upstream
                                     //   or to backing store (rank 0)
     uint8_t load_pending:1;
     uint8_t store_pending:1;
+    uint8_t compressed:1;           // blob is held in zdata, not data_msg
+    uint8_t flush_queued:1;         // entry is on the flush list
     struct msgstack *load_requests;
     struct msgstack *store_requests;
+    struct batchwait *load_batches;
+    struct batchwait *store_batches;
     double lastused;
 
     struct list_node list;
@@ -87,7 +146,14 @@ struct content_cache {
     struct msgstack *flush_requests;
 
     struct list_head lru;           // LRU is for valid, clean entries only
+    struct list_head lru_compressed;// clean entries demoted from lru
     struct list_head flush;         // dirties queued due to batch limit
+    struct list_head load_queue;    // misses waiting for a load RPC
+    struct list_head store_queue;   // dirties waiting for a store RPC
+    int load_inflight;
+    int store_inflight;
+    int batch_plug;                 // defer sending queued RPCs if > 0
+    uint8_t nobatch:1;              // peer lacks load-batch/store-batch
 
     uint32_t blob_size_limit;
     uint32_t flush_batch_limit;
@@ -95,14 +161,20 @@ struct content_cache {
 
     uint32_t purge_target_size;
     uint32_t purge_old_entry;
+    uint32_t purge_max_size;
+    uint32_t compress_target_size;
 
-    uint64_t acct_size;             // total size of all cache entries
+    uint64_t acct_size;             // total size of uncompressed entries
     uint32_t acct_valid;            // count of valid cache entries
     uint32_t acct_dirty;            // count of dirty cache entries
+    uint64_t acct_compressed_size;  // total size of compressed entries
+    uint32_t acct_compressed;       // count of compressed cache entries
 };
 
 static void flush_respond (struct content_cache *cache);
-static int cache_flush (struct content_cache *cache);
+static void cache_flush (struct content_cache *cache);
+static void cache_enforce_max_size (struct content_cache *cache,
+                                    struct cache_entry *keep);
 
 static int msgstack_push (struct msgstack **msp, const flux_msg_t *msg)
 {
@@ -154,6 +226,43 @@ static void request_list_respond_raw (struct msgstack **l,
     }
 }
 
+/* Respond to 'request' with the payload of 'payload_msg', which is
+ * shared with the response rather than copied.
+ */
+static int respond_shared (flux_t *h,
+                           const flux_msg_t *request,
+                           const flux_msg_t *payload_msg)
+{
+    flux_msg_t *msg;
+    int rc = -1;
+
+    if (flux_msg_is_noresponse (request))
+        return 0;
+    if (!(msg = flux_response_derive (request, 0))
+        || flux_msg_share_payload (msg, payload_msg) < 0
+        || flux_send (h, msg, 0) < 0)
+        goto done;
+    rc = 0;
+done:
+    flux_msg_destroy (msg);
+    return rc;
+}
+
+/* Same as above only share the payload of 'payload_msg'
+ */
+static void request_list_respond_shared (struct msgstack **l,
+                                         flux_t *h,
+                                         const flux_msg_t *payload_msg,
+                                         const char *type)
+{
+    const flux_msg_t *msg;
+    while ((msg = msgstack_pop (l))) {
+        if (respond_shared (h, msg, payload_msg) < 0)
+            flux_log_error (h, "%s (%s):", __FUNCTION__, type);
+        flux_msg_decref (msg);
+    }
+}
+
 /* Same as above only send errnum, errmsg response
  */
 static void request_list_respond_error (struct msgstack **l,
@@ -170,6 +279,129 @@ static void request_list_respond_error (struct msgstack **l,
     }
 }
 
+static void batch_request_destroy (struct batch_request *br)
+{
+    if (br) {
+        int saved_errno = errno;
+        int i;
+        for (i = 0; i < br->count; i++)
+            flux_msg_decref (br->slots[i].data_msg);
+        flux_msg_decref (br->msg);
+        free (br);
+        errno = saved_errno;
+    }
+}
+
+/* Create a batch request with 'count' slots.  The request holds a
+ * reference on itself that is dropped by batch_request_decref() once
+ * all slots have been handed out.
+ */
+static struct batch_request *batch_request_create (const flux_msg_t *msg,
+                                                   bool load,
+                                                   int count)
+{
+    struct batch_request *br;
+
+    if (!(br = calloc (1, sizeof (*br) + count * sizeof (br->slots[0]))))
+        return NULL;
+    br->msg = flux_msg_incref (msg);
+    br->load = load;
+    br->count = count;
+    br->pending = count + 1;
+    return br;
+}
+
+static void batch_request_respond (flux_t *h, struct batch_request *br)
+{
+    struct content_batch *b;
+    const void *buf;
+    int len;
+    int i;
+
+    if (!(b = content_batch_create ()))
+        goto error;
+    for (i = 0; i < br->count; i++) {
+        struct batch_slot *slot = &br->slots[i];
+        const void *data = NULL;
+        int size = 0;
+
+        if (slot->errnum == 0) {
+            if (!br->load) {
+                data = slot->hash;
+                size = content_hash_size;
+            }
+            else if (flux_msg_has_payload (slot->data_msg)
+                     && flux_msg_get_payload (slot->data_msg,
+                                              &data,
+                                              &size) < 0)
+                goto error;
+        }
+        if (content_batch_append (b, slot->errnum, data, size) < 0)
+            goto error;
+    }
+    buf = content_batch_data (b, &len);
+    if (flux_respond_raw (h, br->msg, buf, len) < 0)
+        flux_log_error (h, "%s", br->load ? "load-batch" : "store-batch");
+    content_batch_destroy (b);
+    return;
+error:
+    if (flux_respond_error (h, br->msg, errno, NULL) < 0)
+        flux_log_error (h, "%s", br->load ? "load-batch" : "store-batch");
+    content_batch_destroy (b);
+}
+
+static void batch_request_decref (flux_t *h, struct batch_request *br)
+{
+    if (--br->pending == 0) {
+        batch_request_respond (h, br);
+        batch_request_destroy (br);
+    }
+}
+
+/* Complete slot 'index' of 'br' with 'errnum', or on success,
+ * with a reference on 'data_msg' (load) or the hash (store).
+ */
+static void batch_request_complete (flux_t *h,
+                                    struct batch_request *br,
+                                    int index,
+                                    int errnum,
+                                    const flux_msg_t *data_msg)
+{
+    br->slots[index].errnum = errnum;
+    if (errnum == 0 && data_msg)
+        br->slots[index].data_msg = flux_msg_incref (data_msg);
+    batch_request_decref (h, br);
+}
+
+static int batchwait_push (struct batchwait **l,
+                           struct batch_request *br,
+                           int index)
+{
+    struct batchwait *bw;
+    if (!(bw = malloc (sizeof (*bw))))
+        return -1;
+    bw->br = br;
+    bw->index = index;
+    bw->next = *l;
+    *l = bw;
+    return 0;
+}
+
+/* Complete all batch requests waiting on an entry.
+ */
+static void batchwait_complete (struct batchwait **l,
+                                flux_t *h,
+                                int errnum,
+                                const flux_msg_t *data_msg)
+{
+    struct batchwait *bw;
+    while ((bw = *l)) {
+        *l = bw->next;
+        batch_request_complete (h, bw->br, bw->index, errnum, data_msg);
+        free (bw);
+    }
+}
+
 /* Destroy a cache entry
  */
 static void cache_entry_destroy (struct cache_entry *e)
@@ -178,7 +410,10 @@ static void cache_entry_destroy (struct cache_entry *e)
         int saved_errno = errno;
         assert (e->load_requests == NULL);
         assert (e->store_requests == NULL);
-        free (e->data);
+        assert (e->load_batches == NULL);
+        assert (e->store_batches == NULL);
+        flux_msg_decref (e->data_msg);
+        free (e->zdata);
         free (e);
         errno = saved_errno;
     }
@@ -222,28 +457,46 @@ static struct cache_entry *cache_entry_create (const void *hash)
     return e;
 }
 
-/* Make an invalid cache entry valid, filling in its data.
+/* Make an invalid cache entry valid, filling in its data from the
+ * payload of 'msg' if non-NULL.  The payload is shared, not copied.
+ * Otherwise, 'data' of length 'len' is copied.
  * Set dirty flag if 'dirty' is true.
  * Perform accounting.
  * Respond to any pending load requests.
+ * Evict other clean entries if the cache now exceeds its hard size limit.
  * If entry is already valid, do not fill, do not set dirty; there will be
  * no load requests.
  * Returns 0 on success, -1 on failure with errno set.
  */
 static int cache_entry_fill (struct content_cache *cache,
                              struct cache_entry *e,
+                             const flux_msg_t *msg,
                              const void *data,
                              int len,
                              bool dirty)
 {
     if (!e->valid) {
-        assert (!e->data);
+        flux_msg_t *data_msg;
+
+        assert (!e->data_msg);
         assert (e->len == 0);
-        if (len > 0) {
-            if (!(e->data = malloc (len)))
+        if (msg) {
+            len = 0;
+            if (flux_msg_has_payload (msg)
+                && flux_msg_get_payload (msg, NULL, &len) < 0)
                 return -1;
-            memcpy (e->data, data, len);
         }
+        /* Hold the payload in a bare message so that the rest of 'msg'
+         * (e.g. routes) is not retained by the cache.
+         */
+        if (!(data_msg = flux_msg_create (FLUX_MSGTYPE_RESPONSE)))
+            return -1;
+        if ((msg && flux_msg_share_payload (data_msg, msg) < 0)
+            || (!msg && flux_msg_set_payload (data_msg, data, len) < 0)) {
+            flux_msg_destroy (data_msg);
+            return -1;
+        }
+        e->data_msg = data_msg;
         e->len = len;
         e->valid = 1;
         cache->acct_valid++;
@@ -256,11 +509,12 @@ static int cache_entry_fill (struct content_cache *cache,
             list_add (&cache->lru, &e->list);
             e->lastused = flux_reactor_now (cache->reactor);
         }
-        request_list_respond_raw (&e->load_requests,
-                                  cache->h,
-                                  e->data,
-                                  e->len,
-                                  "load");
+        request_list_respond_shared (&e->load_requests,
+                                     cache->h,
+                                     e->data_msg,
+                                     "load");
+        batchwait_complete (&e->load_batches, cache->h, 0, e->data_msg);
+        cache_enforce_max_size (cache, e);
     }
     return 0;
 }
@@ -281,6 +535,7 @@ static void cache_entry_dirty_clear (struct content_cache *cache,
                                   e->hash,
                                   content_hash_size,
                                   "store");
+        batchwait_complete (&e->store_batches, cache->h, 0, NULL);
     }
 }
 
@@ -309,7 +564,7 @@ static struct cache_entry *cache_entry_insert (struct content_cache *cache,
 }
 
 /* Look up a cache entry.
- * Move to front of LRU because it was looked up.
+ * Move to front of LRU (or compressed LRU) because it was looked up.
  * Returns entry on success, NULL on failure.
  * N.B. errno is not set
  */
@@ -325,8 +580,11 @@ static struct cache_entry *cache_entry_lookup (struct content_cache *cache,
         return NULL;
 
     if (e->valid && !e->dirty) {
-        list_del_from (&cache->lru, &e->list);
-        list_add (&cache->lru, &e->list);
+        list_del (&e->list);
+        if (e->compressed)
+            list_add (&cache->lru_compressed, &e->list);
+        else
+            list_add (&cache->lru, &e->list);
         e->lastused = flux_reactor_now (cache->reactor);
     }
 
@@ -340,15 +598,142 @@ static void cache_entry_remove (struct content_cache *cache,
 {
     assert (e->load_requests == NULL);
     assert (e->store_requests == NULL);
+    assert (e->load_batches == NULL);
+    assert (e->store_batches == NULL);
     assert (!e->dirty);
     list_del (&e->list);
     if (e->valid) {
-        cache->acct_size -= e->len;
+        if (e->compressed) {
+            cache->acct_compressed_size -= e->zlen;
+            cache->acct_compressed--;
+        }
+        else
+            cache->acct_size -= e->len;
         cache->acct_valid--;
     }
     zhashx_delete (cache->entries, e->hash);
 }
 
+/* Demote a valid, clean entry to the compressed tier.
+ * The uncompressed blob is released and the entry is moved to the
+ * compressed LRU.  Small or incompressible blobs are not demoted.
+ * Returns 0 on success, -1 on failure with errno set.
+ */
+static int cache_entry_compress (struct content_cache *cache,
+                                 struct cache_entry *e)
+{
+    const void *data;
+    int len;
+    int bound;
+    char *zdata;
+    int zlen;
+
+    assert (e->valid);
+    assert (!e->dirty);
+    assert (!e->compressed);
+    if (e->len < compress_min_size) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (flux_msg_get_payload (e->data_msg, &data, &len) < 0)
+        return -1;
+    bound = LZ4_compressBound (len);
+    if (!(zdata = malloc (bound)))
+        return -1;
+    zlen = LZ4_compress_default (data, zdata, len, bound);
+    if (zlen <= 0 || zlen >= len) {
+        free (zdata);
+        errno = EINVAL;
+        return -1;
+    }
+    if (zlen < bound) {
+        char *p;
+        if ((p = realloc (zdata, zlen)))
+            zdata = p;
+    }
+    flux_msg_decref (e->data_msg);
+    e->data_msg = NULL;
+    e->zdata = zdata;
+    e->zlen = zlen;
+    e->compressed = 1;
+    cache->acct_size -= e->len;
+    cache->acct_compressed_size += zlen;
+    cache->acct_compressed++;
+
+    list_del (&e->list);
+    list_add (&cache->lru_compressed, &e->list);
+    return 0;
+}
+
+/* Promote a compressed entry back to the uncompressed tier.
+ * Returns 0 on success, -1 on failure with errno set.
+ */
+static int cache_entry_decompress (struct content_cache *cache,
+                                   struct cache_entry *e)
+{
+    flux_msg_t *data_msg = NULL;
+    char *data;
+
+    assert (e->compressed);
+    if (!(data = malloc (e->len)))
+        return -1;
+    if (LZ4_decompress_safe (e->zdata, data, e->zlen, e->len) != e->len) {
+        errno = EPROTO;
+        goto error;
+    }
+    if (!(data_msg = flux_msg_create (FLUX_MSGTYPE_RESPONSE))
+        || flux_msg_set_payload (data_msg, data, e->len) < 0)
+        goto error;
+    free (data);
+    cache->acct_compressed_size -= e->zlen;
+    cache->acct_compressed--;
+    cache->acct_size += e->len;
+    free (e->zdata);
+    e->zdata = NULL;
+    e->zlen = 0;
+    e->compressed = 0;
+    e->data_msg = data_msg;
+
+    list_del (&e->list);
+    list_add (&cache->lru, &e->list);
+    e->lastused = flux_reactor_now (cache->reactor);
+    return 0;
+error:
+    ERRNO_SAFE_WRAP (free, data);
+    flux_msg_destroy (data_msg);
+    return -1;
+}
+
+/* Hard limit on the memory footprint of the cache, enforced as entries
+ * are added, rather than waiting for the periodic purge.  Evict clean
+ * entries regardless of age, starting with the oldest compressed ones.
+ * Dirty entries cannot be evicted, so the limit may be exceeded until
+ * they are stored.  Entry 'keep', if non-NULL, is not evicted.
+ */
+static void cache_enforce_max_size (struct content_cache *cache,
+                                    struct cache_entry *keep)
+{
+    struct cache_entry *e = NULL;
+    struct cache_entry *next;
+
+    if (cache->purge_max_size == 0)
+        return;
+    list_for_each_rev_safe (&cache->lru_compressed, e, next, list) {
+        if (cache->acct_size + cache->acct_compressed_size
+            <= cache->purge_max_size)
+            return;
+        if (e != keep)
+            cache_entry_remove (cache, e);
+    }
+    list_for_each_rev_safe (&cache->lru, e, next, list) {
+        if (cache->acct_size + cache->acct_compressed_size
+            <= cache->purge_max_size)
+            return;
+        if (e != keep)
+            cache_entry_remove (cache, e);
+    }
+}
+
 /* Load operation
  *
  * If a cache entry is already present and valid, response is immediate.
@@ -358,57 +743,249 @@ static void cache_entry_remove (struct content_cache *cache,
  * Once the response is received, identical responses are sent to all
  * parked requests, and cache entry is made valid or removed if there was
  * an error such as ENOENT.
+ *
+ * When several load RPCs are already outstanding, misses are queued and
+ * sent together in a load-batch RPC.  A content.load-batch request from
+ * a downstream peer is handled like a series of content.load requests,
+ * with one response sent once all of its entries are resolved.
  */
 
+/* Respond to all requests waiting on an invalid entry with an error,
+ * then remove the entry.
+ */
+static void cache_entry_load_error (struct content_cache *cache,
+                                    struct cache_entry *e,
+                                    int errnum)
+{
+    e->load_pending = 0;
+    request_list_respond_error (&e->load_requests,
+                                cache->h,
+                                errnum,
+                                NULL,
+                                "load");
+    batchwait_complete (&e->load_batches, cache->h, errnum, NULL);
+    cache_entry_remove (cache, e);
+}
+
+static void cache_load_drain (struct content_cache *cache);
+
 static void cache_load_continuation (flux_future_t *f, void *arg)
 {
     struct content_cache *cache = arg;
     struct cache_entry *e = flux_future_aux_get (f, "entry");
-    const void *data = NULL;
-    int len = 0;
+    const flux_msg_t *msg;
+    const void *data;
+    int len;
 
+    /* N.B. the response message is retained, so the blob is not copied */
+    cache->load_inflight--;
     e->load_pending = 0;
-    if (content_load_get (f, &data, &len) < 0) {
+    if (content_load_get (f, &data, &len) < 0
+        || flux_future_get (f, (const void **)&msg) < 0) {
         if (errno == ENOSYS && cache->rank == 0)
             errno = ENOENT;
         if (errno != ENOENT)
             flux_log_error (cache->h, "content load");
         goto error;
     }
-    if (cache_entry_fill (cache, e, data, len, false) < 0) {
+    if (cache_entry_fill (cache, e, msg, NULL, 0, false) < 0) {
         flux_log_error (cache->h, "content load");
         goto error;
     }
     flux_future_destroy (f);
+    cache_load_drain (cache);
     return;
 error:
-    request_list_respond_error (&e->load_requests,
-                                cache->h,
-                                errno,
-                                NULL,
-                                "load");
-    cache_entry_remove (cache, e);
+    cache_entry_load_error (cache, e, errno);
     flux_future_destroy (f);
+    cache_load_drain (cache);
 }
 
-static int cache_load (struct content_cache *cache, struct cache_entry *e)
+static void cache_load_batch_continuation (flux_future_t *f, void *arg)
 {
-    flux_future_t *f;
+    struct content_cache *cache = arg;
+    struct batch_rpc *rpc = flux_future_aux_get (f, "entries");
+    const void *buf;
+    int len;
+    int cursor = 0;
+    int i;
+
+    cache->load_inflight--;
+    if (content_batch_get (f, &buf, &len) < 0) {
+        int errnum = errno;
+        /* The upstream broker or backing store does not support batches.
+         * Requeue the entries to be loaded one at a time.
+         */
+        if (errnum == ENOSYS
+            && !cache->nobatch
+            && (cache->rank > 0 || cache->backing)) {
+            flux_log (cache->h, LOG_DEBUG, "content load-batch: %s",
+                      "unsupported, falling back to content load");
+            cache->nobatch = 1;
+            for (i = 0; i < rpc->count; i++)
+                list_add_tail (&cache->load_queue, &rpc->entries[i]->list);
+            goto done;
+        }
+        if (errnum == ENOSYS && cache->rank == 0)
+            errnum = ENOENT;
+        if (errnum != ENOENT)
+            flux_log_error (cache->h, "content load-batch");
+        for (i = 0; i < rpc->count; i++)
+            cache_entry_load_error (cache, rpc->entries[i], errnum);
+        goto done;
+    }
+    for (i = 0; i < rpc->count; i++) {
+        struct cache_entry *e = rpc->entries[i];
+        const void *data;
+        int size;
+        int errnum;
+
+        if (content_batch_next (buf, len, &cursor, &errnum, &data, &size) <= 0)
+            errnum = EPROTO;
+        else if (errnum == 0) {
+            e->load_pending = 0;
+            if (cache_entry_fill (cache, e, NULL, data, size, false) < 0)
+                errnum = errno;
+        }
+        if (errnum != 0) {
+            if (errnum != ENOENT) {
+                errno = errnum;
+                flux_log_error (cache->h, "content load-batch");
+            }
+            cache_entry_load_error (cache, e, errnum);
+        }
+    }
+done:
+    flux_future_destroy (f);
+    cache_load_drain (cache);
+}
+
+/* Send the entry at the head of the load queue in a content.load RPC,
+ * or up to 'batch_max_count' entries in a content.load-batch RPC.
+ * On failure, the entries are failed and removed.
+ */
+static void cache_load_send (struct content_cache *cache)
+{
+    struct batch_rpc *rpc = NULL;
+    struct content_batch *b = NULL;
+    flux_future_t *f = NULL;
+    struct cache_entry *e;
     int flags = CONTENT_FLAG_UPSTREAM;
+    int count = 0;
+    int errnum;
+    int i;
 
-    if (e->load_pending)
-        return 0;
     if (cache->rank == 0)
         flags = CONTENT_FLAG_CACHE_BYPASS;
-    if (!(f = content_load_byhash (cache->h, e->hash, content_hash_size, flags))
-        || flux_future_aux_set (f, "entry", e, NULL) < 0
-        || flux_future_then (f, -1., cache_load_continuation, cache) < 0) {
-        flux_log_error (cache->h, "content load");
-        flux_future_destroy (f);
-        return -1;
+    e = list_top (&cache->load_queue, struct cache_entry, list);
+    if (cache->nobatch || !list_next (&cache->load_queue, e, list)) {
+        list_del_init (&e->list);
+        if (!(f = content_load_byhash (cache->h,
+                                       e->hash,
+                                       content_hash_size,
+                                       flags))
+            || flux_future_aux_set (f, "entry", e, NULL) < 0
+            || flux_future_then (f, -1., cache_load_continuation, cache) < 0)
+            goto error_single;
+        cache->load_inflight++;
+        return;
     }
+    if (!(rpc = calloc (1, sizeof (*rpc)
+                           + batch_max_count * sizeof (rpc->entries[0])))
+        || !(b = content_batch_create ()))
+        goto error;
+    while (count < batch_max_count
+           && (e = list_pop (&cache->load_queue, struct cache_entry, list))) {
+        list_node_init (&e->list);
+        rpc->entries[count++] = e;
+        if (content_batch_append (b, 0, e->hash, content_hash_size) < 0)
+            goto error;
+    }
+    rpc->count = count;
+    if (!(f = content_load_batch (cache->h, b, flags))
+        || flux_future_then (f, -1., cache_load_batch_continuation, cache) < 0
+        || flux_future_aux_set (f, "entries", rpc, free) < 0)
+        goto error;
+    cache->load_inflight++;
+    content_batch_destroy (b);
+    return;
+error_single:
+    flux_log_error (cache->h, "content load");
+    cache_entry_load_error (cache, e, errno);
+    flux_future_destroy (f);
+    return;
+error:
+    errnum = errno;
+    flux_log_error (cache->h, "content load-batch");
+    flux_future_destroy (f);
+    if (rpc) {
+        for (i = 0; i < count; i++)
+            cache_entry_load_error (cache, rpc->entries[i], errnum);
+        free (rpc);
+    }
+    else {
+        /* ensure progress by failing at least the head of the queue */
+        e = list_pop (&cache->load_queue, struct cache_entry, list);
+        list_node_init (&e->list);
+        cache_entry_load_error (cache, e, errnum);
+    }
+    content_batch_destroy (b);
+}
+
+static int batch_inflight_max (struct content_cache *cache)
+{
+    return cache->nobatch ? INT_MAX : batch_inflight_limit;
+}
+
+/* Send queued misses, subject to 'batch_inflight_limit'.
+ */
+static void cache_load_drain (struct content_cache *cache)
+{
+    while (cache->batch_plug == 0
+           && cache->load_inflight < batch_inflight_max (cache)
+           && !list_empty (&cache->load_queue))
+        cache_load_send (cache);
+}
+
+/* Queue a load RPC for an invalid entry, if one isn't already pending.
+ */
+static void cache_load (struct content_cache *cache, struct cache_entry *e)
+{
+    if (e->load_pending)
+        return;
+    list_add_tail (&cache->load_queue, &e->list);
     e->load_pending = 1;
-    return 0;
+    cache_load_drain (cache);
+}
+
+/* Look up an entry to be loaded, promoting it from the compressed tier
+ * if necessary.  On a miss, an invalid entry is inserted.
+ * Returns entry on success, NULL on failure with errno set.
+ */
+static struct cache_entry *cache_entry_lookup_load (struct content_cache *cache,
+                                                    const void *hash,
+                                                    int hash_size)
+{
+    struct cache_entry *e;
+
+    if ((e = cache_entry_lookup (cache, hash, hash_size))
+        && e->compressed
+        && cache_entry_decompress (cache, e) < 0) {
+        flux_log_error (cache->h, "content load: decompress");
+        cache_entry_remove (cache, e);
+        e = NULL;
+    }
+    if (!e) {
+        if (cache->rank == 0 && !cache->backing) {
+            errno = ENOENT;
+            return NULL;
+        }
+        if (!(e = cache_entry_insert (cache, hash, hash_size))) {
+            flux_log_error (cache->h, "content load");
+            return NULL;
+        }
+    }
+    return e;
 }
 
 void content_load_request (flux_t *h, flux_msg_handler_t *mh,
@@ -417,8 +994,6 @@ void content_load_request (flux_t *h, flux_msg_handler_t *mh,
     struct content_cache *cache = arg;
     const void *hash;
     int hash_size;
-    void *data = NULL;
-    int len = 0;
     struct cache_entry *e;
 
     if (flux_request_decode_raw (msg, NULL, &hash, &hash_size) < 0)
@@ -427,35 +1002,89 @@ void content_load_request (flux_t *h, flux_msg_handler_t *mh,
         errno = EPROTO;
         goto error;
     }
-    if (!(e = cache_entry_lookup (cache, hash, hash_size))) {
-        if (cache->rank == 0 && !cache->backing) {
-            errno = ENOENT;
-            goto error;
-        }
-        if (!(e = cache_entry_insert (cache, hash, hash_size))) {
-            flux_log_error (h, "content load");
-            goto error;
-        }
-    }
+    if (!(e = cache_entry_lookup_load (cache, hash, hash_size)))
+        goto error;
     if (!e->valid) {
-        if (cache_load (cache, e) < 0)
-            goto error;
         if (msgstack_push (&e->load_requests, msg) < 0) {
             flux_log_error (h, "content load");
             goto error;
         }
+        cache_load (cache, e);
         return; /* RPC continuation will respond to msg */
     }
-    data = e->data;
-    len = e->len;
-    if (flux_respond_raw (h, msg, data, len) < 0)
-        flux_log_error (h, "content load: flux_respond_raw");
+    if (respond_shared (h, msg, e->data_msg) < 0)
+        flux_log_error (h, "content load: respond");
     return;
 error:
     if (flux_respond_error (h, msg, errno, NULL) < 0)
         flux_log_error (h, "content load: flux_respond_error");
 }
 
+/* Count the records in a batch.
+ * Returns count on success, -1 with errno set to EPROTO if malformed.
+ */
+static int batch_count (const void *buf, int len)
+{
+    int cursor = 0;
+    int count = 0;
+    int rc;
+
+    while ((rc = content_batch_next (buf, len, &cursor, NULL, NULL, NULL)) > 0)
+        count++;
+    return rc < 0 ? -1 : count;
+}
+
+static void content_load_batch_request (flux_t *h, flux_msg_handler_t *mh,
+                                        const flux_msg_t *msg, void *arg)
+{
+    struct content_cache *cache = arg;
+    struct batch_request *br;
+    const void *buf;
+    int len;
+    int count;
+    int cursor = 0;
+    int i;
+
+    if (flux_request_decode_raw (msg, NULL, &buf, &len) < 0
+        || (count = batch_count (buf, len)) < 0
+        || !(br = batch_request_create (msg, true, count)))
+        goto error;
+    cache->batch_plug++;
+    for (i = 0; i < count; i++) {
+        const void *hash;
+        int hash_size;
+        struct cache_entry *e;
+
+        (void)content_batch_next (buf, len, &cursor, NULL, &hash, &hash_size);
+        if (hash_size != content_hash_size) {
+            batch_request_complete (h, br, i, EPROTO, NULL);
+            continue;
+        }
+        if (!(e = cache_entry_lookup_load (cache, hash, hash_size))) {
+            batch_request_complete (h, br, i, errno, NULL);
+            continue;
+        }
+        if (!e->valid) {
+            if (batchwait_push (&e->load_batches, br, i) < 0) {
+                batch_request_complete (h, br, i, errno, NULL);
+                if (!e->load_pending && !e->load_requests)
+                    cache_entry_remove (cache, e);
+                continue;
+            }
+            cache_load (cache, e);
+            continue;
+        }
+        batch_request_complete (h, br, i, 0, e->data_msg);
+    }
+    cache->batch_plug--;
+    cache_load_drain (cache);
+    batch_request_decref (h, br);
+    return;
+error:
+    if (flux_respond_error (h, msg, errno, NULL) < 0)
+        flux_log_error (h, "content load-batch: flux_respond_error");
+}
+
 /* Store operation
  *
  * If a cache entry is already valid and not dirty, response is immediate.
@@ -484,9 +1113,28 @@ static void cache_resume_flush (struct content_cache *cache)
     if (cache->acct_dirty == 0 || (cache->rank == 0 && !cache->backing))
         flush_respond (cache);
     else
-        (void)cache_flush (cache); /* resume flushing, subject to limits */
+        cache_flush (cache); /* resume flushing, subject to limits */
 }
 
+/* Fail a pending store of a dirty entry.  The entry remains dirty.
+ */
+static void cache_entry_store_error (struct content_cache *cache,
+                                     struct cache_entry *e,
+                                     int errnum)
+{
+    e->store_pending = 0;
+    assert (cache->flush_batch_count > 0);
+    cache->flush_batch_count--;
+    request_list_respond_error (&e->store_requests,
+                                cache->h,
+                                errnum,
+                                NULL,
+                                "store");
+    batchwait_complete (&e->store_batches, cache->h, errnum, NULL);
+}
+
+static void cache_store_drain (struct content_cache *cache);
+
 static void cache_store_continuation (flux_future_t *f, void *arg)
 {
     struct content_cache *cache = arg;
@@ -494,9 +1142,7 @@ static void cache_store_continuation (flux_future_t *f, void *arg)
     const void *hash;
     int hash_size;
 
-    e->store_pending = 0;
-    assert (cache->flush_batch_count > 0);
-    cache->flush_batch_count--;
+    cache->store_inflight--;
     if (content_store_get_hash (f, &hash, &hash_size) < 0) {
         if (cache->rank == 0 && errno == ENOSYS)
             flux_log (cache->h, LOG_DEBUG, "content store: %s",
@@ -510,94 +1156,277 @@ static void cache_store_continuation (flux_future_t *f, void *arg)
         errno = EIO;
         goto error;
     }
+    e->store_pending = 0;
+    assert (cache->flush_batch_count > 0);
+    cache->flush_batch_count--;
     cache_entry_dirty_clear (cache, e);
     flux_future_destroy (f);
     cache_resume_flush (cache);
+    cache_store_drain (cache);
     return;
 error:
-    request_list_respond_error (&e->store_requests,
-                                cache->h,
-                                errno,
-                                NULL,
-                                "store");
+    cache_entry_store_error (cache, e, errno);
     flux_future_destroy (f);
     cache_resume_flush (cache);
+    cache_store_drain (cache);
 }
 
-static int cache_store (struct content_cache *cache, struct cache_entry *e)
+static void cache_store_batch_continuation (flux_future_t *f, void *arg)
 {
-    flux_future_t *f;
-    int flags = CONTENT_FLAG_UPSTREAM;
+    struct content_cache *cache = arg;
+    struct batch_rpc *rpc = flux_future_aux_get (f, "entries");
+    const void *buf;
+    int len;
+    int cursor = 0;
+    int i;
+
+    cache->store_inflight--;
+    if (content_batch_get (f, &buf, &len) < 0) {
+        int errnum = errno;
+        /* The upstream broker or backing store does not support batches.
+         * Requeue the entries to be stored one at a time.
+         */
+        if (errnum == ENOSYS
+            && !cache->nobatch
+            && (cache->rank > 0 || cache->backing)) {
+            flux_log (cache->h, LOG_DEBUG, "content store-batch: %s",
+                      "unsupported, falling back to content store");
+            cache->nobatch = 1;
+            for (i = 0; i < rpc->count; i++)
+                list_add_tail (&cache->store_queue, &rpc->entries[i]->list);
+            goto done;
+        }
+        if (cache->rank == 0 && errnum == ENOSYS)
+            flux_log (cache->h, LOG_DEBUG, "content store-batch: %s",
+                      "backing store service unavailable");
+        else
+            flux_log_error (cache->h, "content store-batch");
+        for (i = 0; i < rpc->count; i++)
+            cache_entry_store_error (cache, rpc->entries[i], errnum);
+        goto done;
+    }
+    for (i = 0; i < rpc->count; i++) {
+        struct cache_entry *e = rpc->entries[i];
+        const void *hash;
+        int hash_size;
+        int errnum;
+
+        if (content_batch_next (buf,
+                                len,
+                                &cursor,
+                                &errnum,
+                                &hash,
+                                &hash_size) <= 0)
+            errnum = EPROTO;
+        else if (errnum == 0
+                 && (hash_size != content_hash_size
+                     || memcmp (hash, e->hash, content_hash_size) != 0))
+            errnum = EIO;
+        if (errnum != 0) {
+            errno = errnum;
+            flux_log_error (cache->h, "content store-batch");
+            cache_entry_store_error (cache, e, errnum);
+            continue;
+        }
+        e->store_pending = 0;
+        assert (cache->flush_batch_count > 0);
+        cache->flush_batch_count--;
+        cache_entry_dirty_clear (cache, e);
+    }
+done:
+    flux_future_destroy (f);
+    cache_resume_flush (cache);
+    cache_store_drain (cache);
+}
 
-    assert (e->valid);
+/* Send the entry at the head of the store queue in a content.store RPC,
+ * or several entries in a content.store-batch RPC.
+ * On failure, the stores are failed and the entries remain dirty.
+ */
+static void cache_store_send (struct content_cache *cache)
+{
+    struct batch_rpc *rpc = NULL;
+    struct content_batch *b = NULL;
+    flux_future_t *f = NULL;
+    struct cache_entry *e;
+    int flags = CONTENT_FLAG_UPSTREAM;
+    int count = 0;
+    int errnum;
+    int i;
 
-    if (e->store_pending)
-        return 0;
-    if (cache->rank == 0) {
-        if (cache->flush_batch_count >= cache->flush_batch_limit) {
-            list_add_tail (&cache->flush, &e->list);
-            return 0;
-        }
+    if (cache->rank == 0)
         flags = CONTENT_FLAG_CACHE_BYPASS;
+    e = list_top (&cache->store_queue, struct cache_entry, list);
+    if (cache->nobatch || !list_next (&cache->store_queue, e, list)) {
+        list_del_init (&e->list);
+        if (!(f = content_store_msg (cache->h, e->data_msg, flags))
+            || flux_future_aux_set (f, "entry", e, NULL) < 0
+            || flux_future_then (f, -1., cache_store_continuation, cache) < 0)
+            goto error_single;
+        cache->store_inflight++;
+        return;
     }
-    if (!(f = content_store (cache->h, e->data, e->len, flags))
-        || flux_future_aux_set (f, "entry", e, NULL) < 0
-        || flux_future_then (f, -1., cache_store_continuation, cache) < 0) {
-        flux_log_error (cache->h, "content store");
-        flux_future_destroy (f);
-        return -1;
+    if (!(rpc = calloc (1, sizeof (*rpc)
+                           + batch_max_count * sizeof (rpc->entries[0])))
+        || !(b = content_batch_create ()))
+        goto error;
+    while (count < batch_max_count
+           && content_batch_size (b) < batch_max_size
+           && (e = list_pop (&cache->store_queue, struct cache_entry, list))) {
+        const void *data = NULL;
+        int len = 0;
+
+        list_node_init (&e->list);
+        rpc->entries[count++] = e;
+        if ((flux_msg_has_payload (e->data_msg)
+             && flux_msg_get_payload (e->data_msg, &data, &len) < 0)
+            || content_batch_append (b, 0, data, len) < 0)
+            goto error;
     }
+    rpc->count = count;
+    if (!(f = content_store_batch (cache->h, b, flags))
+        || flux_future_then (f, -1., cache_store_batch_continuation, cache) < 0
+        || flux_future_aux_set (f, "entries", rpc, free) < 0)
+        goto error;
+    cache->store_inflight++;
+    content_batch_destroy (b);
+    return;
+error_single:
+    flux_log_error (cache->h, "content store");
+    cache_entry_store_error (cache, e, errno);
+    flux_future_destroy (f);
+    return;
+error:
+    errnum = errno;
+    flux_log_error (cache->h, "content store-batch");
+    flux_future_destroy (f);
+    if (rpc) {
+        for (i = 0; i < count; i++)
+            cache_entry_store_error (cache, rpc->entries[i], errnum);
+        free (rpc);
+    }
+    else {
+        /* ensure progress by failing at least the head of the queue */
+        e = list_pop (&cache->store_queue, struct cache_entry, list);
+        list_node_init (&e->list);
+        cache_entry_store_error (cache, e, errnum);
+    }
+    content_batch_destroy (b);
+}
+
+/* Send queued stores, subject to 'batch_inflight_limit'.
+ */
+static void cache_store_drain (struct content_cache *cache)
+{
+    while (cache->batch_plug == 0
+           && cache->store_inflight < batch_inflight_max (cache)
+           && !list_empty (&cache->store_queue))
+        cache_store_send (cache);
+}
+
+/* Put a dirty entry on the flush list, if it's not already there.
+ */
+static void cache_flush_enqueue (struct content_cache *cache,
+                                 struct cache_entry *e)
+{
+    if (!e->flush_queued) {
+        list_add_tail (&cache->flush, &e->list);
+        e->flush_queued = 1;
+    }
+}
+
+/* Queue a store RPC for a dirty entry, if one isn't already pending.
+ * On rank 0, the entry is put on the flush list instead if
+ * 'flush_batch_limit' stores are already in progress.
+ */
+static void cache_store (struct content_cache *cache, struct cache_entry *e)
+{
+    assert (e->valid);
+
+    if (e->store_pending || e->flush_queued)
+        return;
+    if (cache->rank == 0
+        && cache->flush_batch_count >= cache->flush_batch_limit) {
+        cache_flush_enqueue (cache, e);
+        return;
+    }
+    list_add_tail (&cache->store_queue, &e->list);
     e->store_pending = 1;
     cache->flush_batch_count++;
-    return 0;
+    cache_store_drain (cache);
 }
 
-static void content_store_request (flux_t *h, flux_msg_handler_t *mh,
-                                   const flux_msg_t *msg, void *arg)
+/* Fill a cache entry with a blob that is being stored, received in
+ * 'msg' (shared) or as 'data' (copied).  The blob's hash is stored in
+ * 'hash', with size 'hash_len'.
+ * Returns the entry on success, NULL on failure with errno set.
+ */
+static struct cache_entry *cache_store_fill (struct content_cache *cache,
+                                             const flux_msg_t *msg,
+                                             const void *data,
+                                             int len,
+                                             void *hash,
+                                             int hash_len)
 {
-    struct content_cache *cache = arg;
-    const void *data;
-    int len;
-    struct cache_entry *e = NULL;
-    uint8_t hash[BLOBREF_MAX_DIGEST_SIZE];
+    struct cache_entry *e;
     int hash_size;
 
-    if (flux_request_decode_raw (msg, NULL, &data, &len) < 0)
-        goto error;
     if (len > cache->blob_size_limit) {
         errno = EFBIG;
-        goto error;
+        return NULL;
     }
     if ((hash_size = blobref_hash_raw (cache->hash_name,
                                        data,
                                        len,
                                        hash,
-                                       sizeof (hash))) < 0)
-        goto error;
+                                       hash_len)) < 0)
+        return NULL;
     if (!(e = cache_entry_lookup (cache, hash, hash_size))) {
         if (!(e = cache_entry_insert (cache, hash, hash_size)))
-            goto error;
+            return NULL;
     }
-    if (cache_entry_fill (cache, e, data, len, true) < 0)
+    if (cache_entry_fill (cache, e, msg, data, len, true) < 0)
+        return NULL;
+    return e;
+}
+
+/* Start storing a dirty entry on rank 0.  If there is no backing store,
+ * save it to the flush list in the event a backing module is loaded later.
+ * Note that dirty entries are not removed during purge or dropcache,
+ * so this does not alter behavior.
+ */
+static void cache_store_rank0 (struct content_cache *cache,
+                               struct cache_entry *e)
+{
+    if (cache->backing)
+        cache_store (cache, e);
+    else
+        cache_flush_enqueue (cache, e);
+}
+
+static void content_store_request (flux_t *h, flux_msg_handler_t *mh,
+                                   const flux_msg_t *msg, void *arg)
+{
+    struct content_cache *cache = arg;
+    const void *data;
+    int len;
+    struct cache_entry *e = NULL;
+    uint8_t hash[BLOBREF_MAX_DIGEST_SIZE];
+
+    if (flux_request_decode_raw (msg, NULL, &data, &len) < 0)
+        goto error;
+    if (!(e = cache_store_fill (cache, msg, data, len, hash, sizeof (hash))))
         goto error;
     if (e->dirty) {
-        if (cache->rank > 0 || cache->backing) {
-            if (cache_store (cache, e) < 0)
+        if (cache->rank > 0) {  /* write-through */
+            if (msgstack_push (&e->store_requests, msg) < 0)
                 goto error;
-            if (cache->rank > 0) {  /* write-through */
-                if (msgstack_push (&e->store_requests, msg) < 0)
-                    goto error;
-                return;
-            }
+            cache_store (cache, e);
+            return;
         }
-        /* On rank 0, save to flush list in event backing module
-         * loaded later.  Note that dirty entries are not removed
-         * during purge or dropcache, so this does not alter
-         * behavior */
-        if (cache->rank == 0 && !cache->backing)
-            list_add_tail (&cache->flush, &e->list);
+        cache_store_rank0 (cache, e);
     }
-    if (flux_respond_raw (h, msg, hash, hash_size) < 0)
+    if (flux_respond_raw (h, msg, hash, content_hash_size) < 0)
         flux_log_error (h, "content store: flux_respond_raw");
     return;
 error:
@@ -605,6 +1434,60 @@ error:
         flux_log_error (h, "content store: flux_respond_error");
 }
 
+static void content_store_batch_request (flux_t *h, flux_msg_handler_t *mh,
+                                         const flux_msg_t *msg, void *arg)
+{
+    struct content_cache *cache = arg;
+    struct batch_request *br;
+    const void *buf;
+    int len;
+    int count;
+    int cursor = 0;
+    int i;
+
+    if (flux_request_decode_raw (msg, NULL, &buf, &len) < 0
+        || (count = batch_count (buf, len)) < 0
+        || !(br = batch_request_create (msg, false, count)))
+        goto error;
+    cache->batch_plug++;
+    for (i = 0; i < count; i++) {
+        struct batch_slot *slot = &br->slots[i];
+        const void *data;
+        int size;
+        struct cache_entry *e;
+
+        (void)content_batch_next (buf, len, &cursor, NULL, &data, &size);
+        if (!(e = cache_store_fill (cache,
+                                    NULL,
+                                    data,
+                                    size,
+                                    slot->hash,
+                                    sizeof (slot->hash)))) {
+            batch_request_complete (h, br, i, errno, NULL);
+            continue;
+        }
+        if (e->dirty) {
+            if (cache->rank > 0) {  /* write-through */
+                if (batchwait_push (&e->store_batches, br, i) < 0) {
+                    batch_request_complete (h, br, i, errno, NULL);
+                    continue;
+                }
+                cache_store (cache, e);
+                continue;
+            }
+            cache_store_rank0 (cache, e);
+        }
+        batch_request_complete (h, br, i, 0, NULL);
+    }
+    cache->batch_plug--;
+    cache_store_drain (cache);
+    batch_request_decref (h, br);
+    return;
+error:
+    if (flux_respond_error (h, msg, errno, NULL) < 0)
+        flux_log_error (h, "content store-batch: flux_respond_error");
+}
+
 static void checkpoint_get_continuation (flux_future_t *f, void *arg)
 {
     struct content_cache *cache = arg;
@@ -730,29 +1613,20 @@ error:
  * dropping from the rank 0 cache.
  */
 
-static int cache_flush (struct content_cache *cache)
+static void cache_flush (struct content_cache *cache)
 {
     struct cache_entry *e;
-    int last_errno = 0;
-    int rc = 0;
 
+    cache->batch_plug++;
     while (cache->flush_batch_count < cache->flush_batch_limit) {
-        if (!(e = list_top (&cache->flush, struct cache_entry, list)))
+        if (!(e = list_pop (&cache->flush, struct cache_entry, list)))
             break;
-        if (cache_store (cache, e) < 0) { // incr flush_batch_count
-            last_errno = errno;           //   and continuation will decr
-            rc = -1;
-            /* A few errors we will consider "unrecoverable", so break
-             * out */
-            if (errno == ENOSYS
-                || errno == ENOMEM)
-                break;
-        }
-        (void)list_pop (&cache->flush, struct cache_entry, list);
-    }
-    if (rc < 0)
-        errno = last_errno;
-    return rc;
+        list_node_init (&e->list);
+        e->flush_queued = 0;
+        cache_store (cache, e); // incr flush_batch_count
+    }                           //   and continuation will decr
+    cache->batch_plug--;
+    cache_store_drain (cache);
 }
 
 static void content_register_backing_request (flux_t *h,
@@ -791,10 +1665,11 @@ static void content_register_backing_request (flux_t *h,
         goto error;
     }
     cache->backing = 1;
+    cache->nobatch = 0;
     flux_log (h, LOG_DEBUG, "content backing store: enabled %s", name);
     if (flux_respond (h, msg, NULL) < 0)
         flux_log_error (h, "error responding to register-backing request");
-    (void)cache_flush (cache);
+    cache_flush (cache);
     return;
 error:
     if (flux_respond_error (h, msg, errno, errstr) < 0)
@@ -854,6 +1729,9 @@ static void content_dropcache_request (flux_t *h, flux_msg_handler_t *mh,
     list_for_each_safe (&cache->lru, e, next, list) {
         cache_entry_remove (cache, e);
     }
+    list_for_each_safe (&cache->lru_compressed, e, next, list) {
+        cache_entry_remove (cache, e);
+    }
 
     flux_log (h, LOG_DEBUG, "content dropcache %d/%d",
               orig_size - (int)zhashx_size (cache->entries), orig_size);
@@ -869,11 +1747,13 @@ static void content_stats_request (flux_t *h, flux_msg_handler_t *mh,
 {
     struct content_cache *cache = arg;
 
-    if (flux_respond_pack (h, msg, "{s:i s:i s:i s:I s:i}",
+    if (flux_respond_pack (h, msg, "{s:i s:i s:i s:I s:i s:I s:i}",
                            "count", zhashx_size (cache->entries),
                            "valid", cache->acct_valid,
                            "dirty", cache->acct_dirty,
                            "size", cache->acct_size,
+                           "compressed", cache->acct_compressed,
+                           "compressed-size", cache->acct_compressed_size,
                            "flush-batch-count", cache->flush_batch_count) < 0)
         flux_log_error (h, "content stats");
 }
@@ -917,10 +1797,9 @@ static void content_flush_request (flux_t *h, flux_msg_handler_t *mh,
         goto error;
     }
     if (cache->acct_dirty > 0) {
-        if (cache_flush (cache) < 0)
-            goto error;
         if (msgstack_push (&cache->flush_requests, msg) < 0)
             goto error;
+        cache_flush (cache);
         return;
     }
     if (flux_respond (h, msg, NULL) < 0)
@@ -931,7 +1810,9 @@ error:
         flux_log_error (h, "error responding to content flush");
 }
 
-/* Heartbeat drives periodic cache purge
+/* Heartbeat drives periodic cache purge.
+ * Old entries are demoted to the compressed tier if it is enabled,
+ * then the compressed tier is trimmed to its target size.
  */
 
 static void cache_purge (struct content_cache *cache)
@@ -946,6 +1827,13 @@ static void cache_purge (struct content_cache *cache)
             break;
         assert (e->valid);
         assert (!e->dirty);
+        if (cache->compress_target_size == 0
+            || cache_entry_compress (cache, e) < 0)
+            cache_entry_remove (cache, e);
+    }
+    list_for_each_rev_safe (&cache->lru_compressed, e, next, list) {
+        if (cache->acct_compressed_size <= cache->compress_target_size)
+            break;
         cache_entry_remove (cache, e);
     }
 }
@@ -960,6 +1848,10 @@ static void update_stats (struct content_cache *cache)
         cache->acct_dirty);
     flux_stats_gauge_set (cache->h, "content-cache.size",
         cache->acct_size);
+    flux_stats_gauge_set (cache->h, "content-cache.compressed",
+        cache->acct_compressed);
+    flux_stats_gauge_set (cache->h, "content-cache.compressed-size",
+        cache->acct_compressed_size);
     flux_stats_gauge_set (cache->h, "content-cache.flush-batch-count",
         cache->flush_batch_count);
 }
@@ -992,6 +1884,18 @@ static const struct flux_msg_handler_spec htab[] = {
         content_store_request,
         0
     },
+    {
+        FLUX_MSGTYPE_REQUEST,
+        "content.load-batch",
+        content_load_batch_request,
+        0
+    },
+    {
+        FLUX_MSGTYPE_REQUEST,
+        "content.store-batch",
+        content_store_batch_request,
+        0
+    },
     {
         FLUX_MSGTYPE_REQUEST,
         "content.checkpoint-get",
@@ -1091,6 +1995,12 @@ static int register_attrs (struct content_cache *cache, attr_t *attr)
     if (attr_add_active_uint32 (attr, "content.purge-old-entry",
                 &cache->purge_old_entry, 0) < 0)
         return -1;
+    if (attr_add_active_uint32 (attr, "content.purge-max-size",
+                &cache->purge_max_size, 0) < 0)
+        return -1;
+    if (attr_add_active_uint32 (attr, "content.compress-target-size",
+                &cache->compress_target_size, 0) < 0)
+        return -1;
     /* Misc
      */
     if (attr_add_active_uint32 (attr, "content.flush-batch-limit",
@@ -1140,13 +2050,18 @@ struct content_cache *content_cache_create (flux_t *h, attr_t *attrs)
     cache->flush_batch_limit = default_flush_batch_limit;
     cache->purge_target_size = default_cache_purge_target_size;
     cache->purge_old_entry = default_cache_purge_old_entry;
+    cache->purge_max_size = default_cache_purge_max_size;
+    cache->compress_target_size = default_cache_compress_target_size;
     cache->hash_name = default_hash;
     if ((content_hash_size = blobref_validate_hashtype (default_hash)) < 0)
         goto error;
     cache->h = h;
     cache->reactor = flux_get_reactor (h);
     list_head_init (&cache->lru);
+    list_head_init (&cache->lru_compressed);
     list_head_init (&cache->flush);
+    list_head_init (&cache->load_queue);
+    list_head_init (&cache->store_queue);
 
     if (register_attrs (cache, attrs) < 0)
         goto error;
@@ -28,6 +28,7 @@
 #include "src/common/libutil/log.h"
 #include "src/common/libutil/iterators.h"
 #include "src/common/libutil/digest.h"
+#include "src/common/librouter/subtrie.h"
 
 #include "module.h"
 #include "modservice.h"
@@ -78,6 +79,7 @@ struct broker_module {
 
 struct modhash {
     zhash_t *zh_byuuid;
+    struct subtrie *subs;    /* topic => subscribed modules */
     uint32_t rank;
     flux_t *broker_h;
     attr_t *attrs;
@@ -403,8 +405,10 @@ static void module_destroy (module_t *p)
     flux_msg_destroy (p->insmod);
     if (p->subs) {
         char *s;
-        while ((s = zlist_pop (p->subs)))
+        while ((s = zlist_pop (p->subs))) {
+            (void)subtrie_remove (p->modhash->subs, s, p);
             free (s);
+        }
         zlist_destroy (&p->subs);
     }
     zlist_destroy (&p->rmmod);
@@ -656,6 +660,10 @@ modhash_t *modhash_create (void)
         modhash_destroy (mh);
         return NULL;
     }
+    if (!(mh->subs = subtrie_create ())) {
+        modhash_destroy (mh);
+        return NULL;
+    }
     return mh;
 }
 
@@ -676,6 +684,7 @@ void modhash_destroy (modhash_t *mh)
             }
             zhash_destroy (&mh->zh_byuuid);
         }
+        subtrie_destroy (mh->subs);
         free (mh);
     }
     errno = saved_errno;
@@ -790,6 +799,11 @@ int module_subscribe (modhash_t *mh, const char *uuid, const char *topic)
         errno = ENOMEM;
         goto done;
     }
+    if (subtrie_insert (mh->subs, topic, p) < 0) {
+        zlist_remove (p->subs, cpy);
+        free (cpy);
+        goto done;
+    }
     rc = 0;
 done:
     return rc;
@@ -809,6 +823,7 @@ int module_unsubscribe (modhash_t *mh, const char *uuid, const char *topic)
     while (s) {
         if (!strcmp (topic, s)) {
             zlist_remove (p->subs, s);
+            (void)subtrie_remove (mh->subs, s, p);
             free (s);
             break;
         }
@@ -819,37 +834,20 @@ done:
     return rc;
 }
 
-static bool match_sub (module_t *p, const char *topic)
+/* subtrie_match_f footprint */
+static int event_sendmsg (void *item, void *arg)
 {
-    char *s = zlist_first (p->subs);
-
-    while (s) {
-        if (!strncmp (topic, s, strlen (s)))
-            return true;
-        s = zlist_next (p->subs);
-    }
-    return false;
+    return module_sendmsg (item, arg);
 }
 
 int module_event_mcast (modhash_t *mh, const flux_msg_t *msg)
 {
     const char *topic;
-    module_t *p;
-    int rc = -1;
 
-    if (flux_msg_get_topic (msg, &topic) < 0)
-        goto done;
-    p = zhash_first (mh->zh_byuuid);
-    while (p) {
-        if (match_sub (p, topic)) {
-            if (module_sendmsg (p, msg) < 0)
-                goto done;
-        }
-        p = zhash_next (mh->zh_byuuid);
-    }
-    rc = 0;
-done:
-    return rc;
+    if (flux_msg_get_topic (msg, &topic) < 0
+        || subtrie_match (mh->subs, topic, event_sendmsg, (void *)msg) < 0)
+        return -1;
+    return 0;
 }
 
 module_t *module_first (modhash_t *mh)
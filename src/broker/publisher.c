@@ -18,6 +18,7 @@
 
 #include "src/common/libczmqcontainers/czmq_containers.h"
 #include "src/common/libccan/ccan/base64/base64.h"
+#include "src/common/librouter/subtrie.h"
 
 #include "module.h"
 #include "publisher.h"
@@ -152,30 +153,12 @@ error_restore_seq:
 
 static int broker_subscribe (struct broker *ctx, const char *topic)
 {
-    char *cpy;
-
-    if (!(cpy = strdup (topic)))
-        return -1;
-    if (zlist_append (ctx->subscriptions, cpy) < 0)
-        goto nomem;
-    zlist_freefn (ctx->subscriptions, cpy, free, true);
-    return 0;
-nomem:
-    free (cpy);
-    errno = ENOMEM;
-    return -1;
+    return subtrie_insert (ctx->subscriptions, topic, ctx);
 }
 
 static void broker_unsubscribe (struct broker *ctx, const char *topic)
 {
-    char *s = zlist_first (ctx->subscriptions);
-    while (s) {
-        if (!strcmp (s, topic)) {
-            zlist_remove (ctx->subscriptions, s);
-            break;
-        }
-        s = zlist_next (ctx->subscriptions);
-    }
+    (void)subtrie_remove (ctx->subscriptions, topic, ctx);
 }
 
 
@@ -249,6 +249,31 @@ static void dump_dir (struct archive *ar,
     }
 }
 
+static void dump_dirref (struct archive *ar,
+                         flux_t *h,
+                         const char *path,
+                         json_t *treeobj);
+
+static void dump_hdir (struct archive *ar,
+                       flux_t *h,
+                       const char *path,
+                       json_t *treeobj)
+{
+    json_t *shard;
+    int i;
+
+    for (i = 0; i < TREEOBJ_HDIR_FANOUT; i++) {
+        if (!(shard = treeobj_get_shard (treeobj, i)))
+            continue;
+        if (treeobj_is_dirref (shard))
+            dump_dirref (ar, h, path, shard); // recurse
+        else if (treeobj_is_hdir (shard))
+            dump_hdir (ar, h, path, shard); // recurse
+        else
+            dump_dir (ar, h, path, shard);
+    }
+}
+
 static void dump_dirref (struct archive *ar,
                          flux_t *h,
                          const char *path,
@@ -271,9 +296,12 @@ static void dump_dirref (struct archive *ar,
     }
     if (!(treeobj_deref = treeobj_decodeb (buf, buflen)))
         log_err_exit ("%s: could not decode directory", path);
-    if (!treeobj_is_dir (treeobj_deref))
+    if (treeobj_is_hdir (treeobj_deref))
+        dump_hdir (ar, h, path, treeobj_deref); // recurse
+    else if (treeobj_is_dir (treeobj_deref))
+        dump_dir (ar, h, path, treeobj_deref); // recurse
+    else
         log_msg_exit ("%s: dirref references non-directory", path);
-    dump_dir (ar, h, path, treeobj_deref); // recurse
     json_decref (treeobj_deref);
     flux_future_destroy (f);
 }
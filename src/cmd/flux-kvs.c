@@ -100,6 +100,9 @@ static struct optparse_option get_opts[] =  {
     { .name = "count", .key = 'c', .has_arg = 1, .arginfo = "COUNT",
       .usage = "Display at most COUNT changes",
     },
+    { .name = "prefetch", .key = 'p', .has_arg = 0,
+      .usage = "Prefetch the contents of directories fetched for lookup",
+    },
     OPTPARSE_TABLE_END
 };
 
@@ -281,7 +284,7 @@ static struct optparse_subcommand subcommands[] = {
       NULL,
     },
     { "get",
-      "[-N ns] [-r|-t] [-a treeobj] [-l] [-W] [-w] [-u] [-A] [-f] "
+      "[-N ns] [-r|-t] [-a treeobj] [-l] [-W] [-w] [-u] [-A] [-f] [-p] "
         "[-c COUNT] key [key...]",
       "Get value stored under key",
       cmd_get,
@@ -455,12 +458,16 @@ int cmd_namespace_create (optparse_t *p, int argc, char **argv)
     uint32_t owner = FLUX_USERID_UNKNOWN;
     const char *str;
     const char *rootref;
+    const char *link;
 
     optindex = optparse_option_index (p);
     if ((optindex - argc) == 0) {
         optparse_print_usage (p);
         exit (1);
     }
+    link = optparse_get_str (p, "link", NULL);
+    if (link && argc - optindex > 1)
+        log_msg_exit ("--link may only be used with a single namespace");
 
     if ((str = optparse_get_str (p, "owner", NULL))) {
         char *endptr;
@@ -477,7 +484,14 @@ int cmd_namespace_create (optparse_t *p, int argc, char **argv)
     for (i = optindex; i < argc; i++) {
         const char *name = argv[i];
         int flags = 0;
-        if (rootref)
+        if (link)
+            f = flux_kvs_namespace_create_link (h,
+                                                name,
+                                                rootref,
+                                                owner,
+                                                flags,
+                                                link);
+        else if (rootref)
             f = flux_kvs_namespace_create_with (h, name, rootref, owner, flags);
         else
             f = flux_kvs_namespace_create (h, name, owner, flags);
@@ -573,12 +587,15 @@ static struct optparse_option namespace_create_opts[] =  {
     { .name = "rootref", .key = 'r', .has_arg = 1,
       .usage = "Initialize namespace with specific root reference",
     },
+    { .name = "link", .key = 'l', .has_arg = 1, .arginfo = "KEY",
+      .usage = "Link namespace from KEY in the primary namespace",
+    },
     OPTPARSE_TABLE_END
 };
 
 static struct optparse_subcommand namespace_subcommands[] = {
     { "create",
-      "[-o owner] [-r rootref] name [name...]",
+      "[-o owner] [-r rootref] [-l key] name [name...]",
       "Create a KVS namespace",
       cmd_namespace_create,
       0,
@@ -748,6 +765,8 @@ void cmd_get_one (flux_t *h, const char *key, struct lookup_ctx *ctx)
     }
     if (optparse_hasopt (ctx->p, "waitcreate"))
         flags |= FLUX_KVS_WAITCREATE;
+    if (optparse_hasopt (ctx->p, "prefetch"))
+        flags |= FLUX_KVS_PREFETCH;
     if (optparse_hasopt (ctx->p, "at")) {
         const char *reference = optparse_get_str (ctx->p, "at", NULL);
         if (!(f = flux_kvs_lookupat (h, flags, key, reference)))
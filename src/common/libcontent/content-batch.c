@@ -0,0 +1,215 @@
+/************************************************************\
+ * Copyright 2024 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <arpa/inet.h>
+#include <flux/core.h>
+
+#include "content.h"
+#include "content-batch.h"
+
+#define RECORD_HDR_SIZE 8
+
+struct content_batch {
+    char *buf;
+    int size;
+    int alloc;
+    int count;
+};
+
+struct content_batch *content_batch_create (void)
+{
+    return calloc (1, sizeof (struct content_batch));
+}
+
+void content_batch_destroy (struct content_batch *b)
+{
+    if (b) {
+        int saved_errno = errno;
+        free (b->buf);
+        free (b);
+        errno = saved_errno;
+    }
+}
+
+static int batch_reserve (struct content_batch *b, int len)
+{
+    int need;
+    int alloc;
+    char *buf;
+
+    if (len > INT_MAX - b->size) {
+        errno = EOVERFLOW;
+        return -1;
+    }
+    need = b->size + len;
+    if (need <= b->alloc)
+        return 0;
+    alloc = b->alloc > 0 ? b->alloc : 4096;
+    while (alloc < need)
+        alloc = alloc <= INT_MAX / 2 ? alloc * 2 : INT_MAX;
+    if (!(buf = realloc (b->buf, alloc)))
+        return -1;
+    b->buf = buf;
+    b->alloc = alloc;
+    return 0;
+}
+
+int content_batch_append (struct content_batch *b,
+                          int errnum,
+                          const void *data,
+                          int len)
+{
+    uint32_t hdr[2];
+
+    if (!b
+        || len < 0
+        || len > INT_MAX - RECORD_HDR_SIZE
+        || errnum < 0
+        || (len > 0 && !data)) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (batch_reserve (b, RECORD_HDR_SIZE + len) < 0)
+        return -1;
+    hdr[0] = htonl (errnum);
+    hdr[1] = htonl (len);
+    memcpy (b->buf + b->size, hdr, RECORD_HDR_SIZE);
+    if (len > 0)
+        memcpy (b->buf + b->size + RECORD_HDR_SIZE, data, len);
+    b->size += RECORD_HDR_SIZE + len;
+    b->count++;
+    return 0;
+}
+
+int content_batch_count (struct content_batch *b)
+{
+    return b ? b->count : 0;
+}
+
+int content_batch_size (struct content_batch *b)
+{
+    return b ? b->size : 0;
+}
+
+const void *content_batch_data (struct content_batch *b, int *len)
+{
+    if (!b) {
+        errno = EINVAL;
+        return NULL;
+    }
+    if (len)
+        *len = b->size;
+    return b->buf;
+}
+
+int content_batch_next (const void *buf,
+                        int len,
+                        int *cursor,
+                        int *errnum,
+                        const void **data,
+                        int *size)
+{
+    uint32_t hdr[2];
+    int offset;
+    uint32_t n;
+
+    if ((!buf && len > 0) || len < 0 || !cursor) {
+        errno = EINVAL;
+        return -1;
+    }
+    offset = *cursor;
+    if (offset == len)
+        return 0;
+    if (offset < 0 || len - offset < RECORD_HDR_SIZE) {
+        errno = EPROTO;
+        return -1;
+    }
+    memcpy (hdr, (const char *)buf + offset, RECORD_HDR_SIZE);
+    offset += RECORD_HDR_SIZE;
+    n = ntohl (hdr[1]);
+    if (n > len - offset || ntohl (hdr[0]) > INT_MAX) {
+        errno = EPROTO;
+        return -1;
+    }
+    if (errnum)
+        *errnum = ntohl (hdr[0]);
+    if (data)
+        *data = n > 0 ? (const char *)buf + offset : NULL;
+    if (size)
+        *size = n;
+    *cursor = offset + n;
+    return 1;
+}
+
+static flux_future_t *batch_rpc (flux_t *h,
+                                 const char *method,
+                                 struct content_batch *b,
+                                 int flags)
+{
+    char topic[64];
+    const char *service = "content";
+    uint32_t rank = FLUX_NODEID_ANY;
+    const void *data;
+    int len;
+
+    if (!h || !b) {
+        errno = EINVAL;
+        return NULL;
+    }
+    if ((flags & CONTENT_FLAG_UPSTREAM))
+        rank = FLUX_NODEID_UPSTREAM;
+    if ((flags & CONTENT_FLAG_CACHE_BYPASS)) {
+        service = "content-backing";
+        rank = 0;
+    }
+    snprintf (topic, sizeof (topic), "%s.%s", service, method);
+    data = content_batch_data (b, &len);
+    return flux_rpc_raw (h, topic, data, len, rank, 0);
+}
+
+flux_future_t *content_load_batch (flux_t *h,
+                                   struct content_batch *b,
+                                   int flags)
+{
+    return batch_rpc (h, "load-batch", b, flags);
+}
+
+flux_future_t *content_store_batch (flux_t *h,
+                                    struct content_batch *b,
+                                    int flags)
+{
+    return batch_rpc (h, "store-batch", b, flags);
+}
+
+int content_batch_get (flux_future_t *f, const void **buf, int *len)
+{
+    const void *data;
+    int size;
+
+    if (flux_rpc_get_raw (f, &data, &size) < 0)
+        return -1;
+    if (buf)
+        *buf = data;
+    if (len)
+        *len = size;
+    return 0;
+}
+
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */
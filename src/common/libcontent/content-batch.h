@@ -0,0 +1,87 @@
+/************************************************************\
+ * Copyright 2024 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+/* Batched content load/store
+ *
+ * The content.load-batch, content.store-batch, content-backing.load-batch,
+ * and content-backing.store-batch methods carry many hashes or blobs in
+ * a single raw payload.  The payload is a sequence of records, each
+ * consisting of a 4 byte errno value and a 4 byte data length, both in
+ * network byte order, followed by the data.
+ *
+ *   load-batch request:    errnum=0, data=hash digest
+ *   load-batch response:   errnum=0, data=blob; or errnum!=0, no data
+ *   store-batch request:   errnum=0, data=blob
+ *   store-batch response:  errnum=0, data=hash digest; or errnum!=0, no data
+ *
+ * Response records are in the same order as request records.
+ */
+
+#ifndef _FLUX_CONTENT_BATCH_H
+#define _FLUX_CONTENT_BATCH_H
+
+#include <flux/core.h>
+
+struct content_batch;
+
+struct content_batch *content_batch_create (void);
+void content_batch_destroy (struct content_batch *b);
+
+/* Append a record to the batch.  'data' may be NULL if 'len' is 0.
+ * Returns 0 on success, -1 on failure with errno set.
+ */
+int content_batch_append (struct content_batch *b,
+                          int errnum,
+                          const void *data,
+                          int len);
+
+/* Get the number of records, and the encoded size of the batch in bytes.
+ */
+int content_batch_count (struct content_batch *b);
+int content_batch_size (struct content_batch *b);
+
+/* Access the encoded batch.
+ * Storage belongs to 'b' and is invalidated by content_batch_append().
+ */
+const void *content_batch_data (struct content_batch *b, int *len);
+
+/* Iterate over the records of an encoded batch.  Set '*cursor' to 0
+ * before the first call.  Returns 1 and assigns record fields, or 0
+ * when there are no more records, or -1 with errno set to EPROTO if the
+ * batch is malformed.  'data' points into 'buf'.
+ */
+int content_batch_next (const void *buf,
+                        int len,
+                        int *cursor,
+                        int *errnum,
+                        const void **data,
+                        int *size);
+
+/* Send a batched load or store request.
+ * Flags are the same as content_load_byhash() and content_store().
+ */
+flux_future_t *content_load_batch (flux_t *h,
+                                   struct content_batch *b,
+                                   int flags);
+flux_future_t *content_store_batch (flux_t *h,
+                                    struct content_batch *b,
+                                    int flags);
+
+/* Get the encoded response batch from a load or store batch request.
+ * Storage belongs to 'f' and is valid until 'f' is destroyed.
+ * Returns 0 on success, -1 on failure with errno set.
+ */
+int content_batch_get (flux_future_t *f, const void **buf, int *len);
+
+#endif /* !_FLUX_CONTENT_BATCH_H */
+
+/*
+ * vi:ts=4 sw=4 expandtab
+ */
@@ -73,6 +73,35 @@ flux_future_t *content_store (flux_t *h, const void *buf, int len, int flags)
     return flux_rpc_raw (h, topic, buf, len, rank, 0);
 }
 
+flux_future_t *content_store_msg (flux_t *h,
+                                  const flux_msg_t *payload_msg,
+                                  int flags)
+{
+    const char *topic = "content.store";
+    uint32_t rank = FLUX_NODEID_ANY;
+    flux_msg_t *msg;
+    flux_future_t *f;
+
+    if (!h || !payload_msg) {
+        errno = EINVAL;
+        return NULL;
+    }
+    if ((flags & CONTENT_FLAG_UPSTREAM))
+        rank = FLUX_NODEID_UPSTREAM;
+    if ((flags & CONTENT_FLAG_CACHE_BYPASS)) {
+        topic = "content-backing.store";
+        rank = 0;
+    }
+    if (!(msg = flux_request_encode (topic, NULL))
+        || flux_msg_share_payload (msg, payload_msg) < 0
+        || !(f = flux_rpc_message (h, msg, rank, 0))) {
+        ERRNO_SAFE_WRAP (flux_msg_destroy, msg);
+        return NULL;
+    }
+    flux_msg_destroy (msg);
+    return f;
+}
+
 int content_store_get_hash (flux_future_t *f, const void **hash, int *hash_size)
 {
     const void *buf;
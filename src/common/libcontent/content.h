@@ -38,6 +38,13 @@ int content_load_get (flux_future_t *f, const void **buf, int *len);
  */
 flux_future_t *content_store (flux_t *h, const void *buf, int len, int flags);
 
+/* Send request to store blob contained in the payload of 'payload_msg'.
+ * The payload is shared with the request rather than copied.
+ */
+flux_future_t *content_store_msg (flux_t *h,
+                                  const flux_msg_t *payload_msg,
+                                  int flags);
+
 /* Get result of store request (hash or blobref).
  * Storage belongs to 'f' and is valid until 'f' is destroyed.
  * Returns 0 on success, -1 on failure with errno set.
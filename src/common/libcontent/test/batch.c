@@ -0,0 +1,156 @@
+/************************************************************\
+ * Copyright 2024 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <arpa/inet.h>
+
+#include "src/common/libtap/tap.h"
+#include "src/common/libcontent/content-batch.h"
+
+void check_empty (void)
+{
+    struct content_batch *b;
+    const void *buf;
+    int len;
+    int cursor = 0;
+
+    ok ((b = content_batch_create ()) != NULL,
+        "content_batch_create works");
+    ok (content_batch_count (b) == 0 && content_batch_size (b) == 0,
+        "new batch has zero records and zero size");
+    buf = content_batch_data (b, &len);
+    ok (len == 0,
+        "content_batch_data returns zero length");
+    ok (content_batch_next (buf, len, &cursor, NULL, NULL, NULL) == 0,
+        "content_batch_next on empty batch returns 0");
+    content_batch_destroy (b);
+}
+
+void check_roundtrip (void)
+{
+    struct content_batch *b;
+    char big[10000];
+    const void *buf;
+    int len;
+    int cursor = 0;
+    int errnum;
+    const void *data;
+    int size;
+
+    memset (big, 'x', sizeof (big));
+    if (!(b = content_batch_create ()))
+        BAIL_OUT ("content_batch_create failed");
+    ok (content_batch_append (b, 0, "abc", 3) == 0,
+        "appended a small record");
+    ok (content_batch_append (b, ENOENT, NULL, 0) == 0,
+        "appended an error record");
+    ok (content_batch_append (b, 0, NULL, 0) == 0,
+        "appended an empty record");
+    ok (content_batch_append (b, 0, big, sizeof (big)) == 0,
+        "appended a record that requires buffer growth");
+    ok (content_batch_count (b) == 4,
+        "content_batch_count returns 4");
+    ok (content_batch_size (b) == 4*8 + 3 + sizeof (big),
+        "content_batch_size returns the expected size");
+
+    buf = content_batch_data (b, &len);
+    ok (content_batch_next (buf, len, &cursor, &errnum, &data, &size) == 1
+        && errnum == 0 && size == 3 && memcmp (data, "abc", 3) == 0,
+        "first record decodes correctly");
+    ok (content_batch_next (buf, len, &cursor, &errnum, &data, &size) == 1
+        && errnum == ENOENT && size == 0 && data == NULL,
+        "second record decodes correctly");
+    ok (content_batch_next (buf, len, &cursor, &errnum, &data, &size) == 1
+        && errnum == 0 && size == 0,
+        "third record decodes correctly");
+    ok (content_batch_next (buf, len, &cursor, &errnum, &data, &size) == 1
+        && errnum == 0 && size == sizeof (big)
+        && memcmp (data, big, sizeof (big)) == 0,
+        "fourth record decodes correctly");
+    ok (content_batch_next (buf, len, &cursor, &errnum, &data, &size) == 0,
+        "content_batch_next returns 0 at end of batch");
+
+    cursor = 0;
+    errno = 0;
+    ok (content_batch_next (buf, 12, &cursor, NULL, NULL, NULL) == 1
+        && content_batch_next (buf, 12, &cursor, NULL, NULL, NULL) < 0
+        && errno == EPROTO,
+        "content_batch_next fails with EPROTO on truncated header");
+    cursor = 0;
+    errno = 0;
+    ok (content_batch_next (buf, 10, &cursor, NULL, NULL, NULL) < 0
+        && errno == EPROTO,
+        "content_batch_next fails with EPROTO on truncated data");
+
+    content_batch_destroy (b);
+}
+
+void check_inval (void)
+{
+    struct content_batch *b;
+    uint32_t hdr[2];
+    int cursor = 0;
+
+    if (!(b = content_batch_create ()))
+        BAIL_OUT ("content_batch_create failed");
+    errno = 0;
+    ok (content_batch_append (NULL, 0, "a", 1) < 0 && errno == EINVAL,
+        "content_batch_append b=NULL fails with EINVAL");
+    errno = 0;
+    ok (content_batch_append (b, 0, NULL, 1) < 0 && errno == EINVAL,
+        "content_batch_append data=NULL len=1 fails with EINVAL");
+    errno = 0;
+    ok (content_batch_append (b, -1, NULL, 0) < 0 && errno == EINVAL,
+        "content_batch_append errnum=-1 fails with EINVAL");
+    errno = 0;
+    ok (content_batch_append (b, 0, "a", -1) < 0 && errno == EINVAL,
+        "content_batch_append len=-1 fails with EINVAL");
+    errno = 0;
+    ok (content_batch_next (NULL, 0, NULL, NULL, NULL, NULL) < 0
+        && errno == EINVAL,
+        "content_batch_next cursor=NULL fails with EINVAL");
+
+    hdr[0] = htonl (0);
+    hdr[1] = htonl (0xffffffff);
+    errno = 0;
+    ok (content_batch_next (hdr, sizeof (hdr), &cursor, NULL, NULL, NULL) < 0
+        && errno == EPROTO,
+        "content_batch_next fails with EPROTO on oversized length");
+    hdr[0] = htonl (0x80000000);
+    hdr[1] = htonl (0);
+    cursor = 0;
+    errno = 0;
+    ok (content_batch_next (hdr, sizeof (hdr), &cursor, NULL, NULL, NULL) < 0
+        && errno == EPROTO,
+        "content_batch_next fails with EPROTO on negative errnum");
+
+    content_batch_destroy (b);
+}
+
+int main (int argc, char *argv[])
+{
+    plan (NO_PLAN);
+
+    check_empty ();
+    check_roundtrip ();
+    check_inval ();
+
+    done_testing ();
+    return 0;
+}
+
+/*
+ * vi:ts=4 sw=4 expandtab
+ */
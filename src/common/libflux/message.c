@@ -94,7 +94,6 @@ flux_msg_t *flux_msg_create (int type)
 
     if (!(msg = calloc (1, sizeof (*msg))))
         return NULL;
-    list_head_init (&msg->routes);
     msg->type = type;
     if (msg->type != FLUX_MSGTYPE_ANY)
         msg_setup_type (msg);
@@ -111,7 +110,7 @@ void flux_msg_destroy (flux_msg_t *msg)
         if ((msg->flags & FLUX_MSGFLAG_ROUTE))
             msg_route_clear (msg);
         free (msg->topic);
-        free (msg->payload);
+        msg_payload_decref (msg->payload);
         json_decref (msg->json);
         aux_destroy (&msg->aux);
         free (msg->lasterr);
@@ -183,11 +182,11 @@ ssize_t flux_msg_encode_size (const flux_msg_t *msg)
     if (msg->flags & FLUX_MSGFLAG_TOPIC)
         encode_count (&size, strlen (msg->topic));
     if (msg->flags & FLUX_MSGFLAG_ROUTE) {
-        struct route_id *r = NULL;
+        int i;
         /* route delimeter */
         encode_count (&size, 0);
-        list_for_each (&msg->routes, r, route_id_node)
-            encode_count (&size, strlen (r->id));
+        for (i = 0; i < msg->routes_len; i++)
+            encode_count (&size, msg_route_get (msg, i)->len);
     }
     return size;
 }
@@ -234,12 +233,14 @@ int flux_msg_encode (const flux_msg_t *msg, void *buf, size_t size)
         return -1;
     }
     if (msg->flags & FLUX_MSGFLAG_ROUTE) {
-        struct route_id *r = NULL;
-        list_for_each (&msg->routes, r, route_id_node) {
+        int i;
+        /* last route is the first frame */
+        for (i = msg->routes_len - 1; i >= 0; i--) {
+            const struct route_id *r = msg_route_get (msg, i);
             if ((n = encode_frame (buf + total,
                                    size - total,
-                                   r->id,
-                                   strlen (r->id))) < 0)
+                                   (void *)route_id_str (r),
+                                   r->len)) < 0)
                 return -1;
             total += n;
         }
@@ -751,24 +752,20 @@ int flux_msg_route_delete_last (flux_msg_t *msg)
 /* replaces flux_msg_nexthop */
 const char *flux_msg_route_last (const flux_msg_t *msg)
 {
-    struct route_id *r;
-
     if (msg_validate (msg) < 0 || !(msg->flags & FLUX_MSGFLAG_ROUTE))
         return NULL;
-    if ((r = list_top (&msg->routes, struct route_id, route_id_node)))
-        return r->id;
+    if (msg->routes_len > 0)
+        return route_id_str (msg_route_get (msg, msg->routes_len - 1));
     return NULL;
 }
 
 /* replaces flux_msg_sender */
 const char *flux_msg_route_first (const flux_msg_t *msg)
 {
-    struct route_id *r;
-
     if (msg_validate (msg) < 0 || !(msg->flags & FLUX_MSGFLAG_ROUTE))
         return NULL;
-    if ((r = list_tail (&msg->routes, struct route_id, route_id_node)))
-        return r->id;
+    if (msg->routes_len > 0)
+        return route_id_str (msg_route_get (msg, 0));
     return NULL;
 }
 
@@ -787,23 +784,22 @@ int flux_msg_route_count (const flux_msg_t *msg)
  */
 static int flux_msg_route_size (const flux_msg_t *msg)
 {
-    struct route_id *r = NULL;
     int size = 0;
+    int i;
 
     assert (msg);
     if (!(msg->flags & FLUX_MSGFLAG_ROUTE)) {
         errno = EPROTO;
         return -1;
     }
-    list_for_each (&msg->routes, r, route_id_node)
-        size += strlen (r->id);
+    for (i = 0; i < msg->routes_len; i++)
+        size += msg_route_get (msg, i)->len;
     return size;
 }
 
 char *flux_msg_route_string (const flux_msg_t *msg)
 {
-    struct route_id *r = NULL;
-    int hops, len;
+    int hops, len, i;
     char *buf, *cp;
 
     if (msg_validate (msg) < 0)
@@ -817,20 +813,64 @@ char *flux_msg_route_string (const flux_msg_t *msg)
         return NULL;
     if (!(cp = buf = malloc (len + hops + 1)))
         return NULL;
-    list_for_each_rev (&msg->routes, r, route_id_node) {
+    for (i = 0; i < hops; i++) {
+        const struct route_id *r = msg_route_get (msg, i);
         if (cp > buf)
             *cp++ = '!';
-        int cpylen = strlen (r->id);
+        int cpylen = r->len;
         if (cpylen > 8) /* abbreviate long UUID */
             cpylen = 8;
         assert (cp - buf + cpylen < len + hops);
-        memcpy (cp, r->id, cpylen);
+        memcpy (cp, route_id_str (r), cpylen);
         cp += cpylen;
     }
     *cp = '\0';
     return buf;
 }
 
+/* Payload buffers are reference counted so that messages may share a
+ * payload without copying it.  A shared payload is never modified in
+ * place.  The count is stored in a header preceding the payload data,
+ * sized to preserve malloc alignment of the data.
+ */
+#define PAYLOAD_HDR_SIZE 16
+
+static inline int *payload_refcount (void *payload)
+{
+    return (int *)((char *)payload - PAYLOAD_HDR_SIZE);
+}
+
+void *msg_payload_alloc (size_t size)
+{
+    char *p;
+
+    if (!(p = malloc (PAYLOAD_HDR_SIZE + size)))
+        return NULL;
+    *(int *)p = 1;
+    return p + PAYLOAD_HDR_SIZE;
+}
+
+void *msg_payload_incref (void *payload)
+{
+    if (payload)
+        (*payload_refcount (payload))++;
+    return payload;
+}
+
+void msg_payload_decref (void *payload)
+{
+    if (payload && --(*payload_refcount (payload)) == 0) {
+        int saved_errno = errno;
+        free (payload_refcount (payload));
+        errno = saved_errno;
+    }
+}
+
+static inline bool payload_shared (void *payload)
+{
+    return *payload_refcount (payload) > 1;
+}
+
 static bool payload_overlap (flux_msg_t *msg, const void *b)
 {
     return ((char *)b >= (char *)msg->payload
@@ -858,21 +898,35 @@ int flux_msg_set_payload (flux_msg_t *msg, const void *buf, int size)
                 return -1;
             }
         }
-        if (size > msg->payload_size) {
+        /* Copy on write if the payload is shared with another message.
+         */
+        if (payload_shared (msg->payload)) {
             void *ptr;
-            if (!(ptr = realloc (msg->payload, size))) {
-                errno = ENOMEM;
+            if (!(ptr = msg_payload_alloc (size)))
                 return -1;
-            }
+            memcpy (ptr, buf, size);
+            msg_payload_decref (msg->payload);
             msg->payload = ptr;
-            msg->payload_size = size;
         }
-        memcpy (msg->payload, buf, size);
+        else {
+            if (size > msg->payload_size) {
+                char *ptr;
+                if (!(ptr = realloc (payload_refcount (msg->payload),
+                                     PAYLOAD_HDR_SIZE + size))) {
+                    errno = ENOMEM;
+                    return -1;
+                }
+                msg->payload = ptr + PAYLOAD_HDR_SIZE;
+            }
+            if (msg->payload != buf)
+                memcpy (msg->payload, buf, size);
+        }
+        msg->payload_size = size;
     /* Case #2: add payload.
      */
     } else if (!(flags & FLUX_MSGFLAG_PAYLOAD) && (buf != NULL && size > 0)) {
         assert (!msg->payload);
-        if (!(msg->payload = malloc (size)))
+        if (!(msg->payload = msg_payload_alloc (size)))
             return -1;
         msg->payload_size = size;
         memcpy (msg->payload, buf, size);
@@ -881,7 +935,7 @@ int flux_msg_set_payload (flux_msg_t *msg, const void *buf, int size)
      */
     } else if ((flags & FLUX_MSGFLAG_PAYLOAD) && (buf == NULL || size == 0)) {
         assert (msg->payload);
-        free (msg->payload);
+        msg_payload_decref (msg->payload);
         msg->payload = NULL;
         msg->payload_size = 0;
         flags &= ~(uint8_t)(FLUX_MSGFLAG_PAYLOAD);
@@ -891,6 +945,29 @@ int flux_msg_set_payload (flux_msg_t *msg, const void *buf, int size)
     return 0;
 }
 
+int flux_msg_share_payload (flux_msg_t *msg, const flux_msg_t *src)
+{
+    uint8_t flags;
+
+    if (msg_validate (msg) < 0 || msg_validate (src) < 0)
+        return -1;
+    if (msg == src)
+        return 0;
+    json_decref (msg->json);            /* invalidate cached json object */
+    msg->json = NULL;
+    flags = msg->flags;
+    msg_payload_decref (msg->payload);
+    msg->payload = msg_payload_incref (src->payload);
+    msg->payload_size = src->payload_size;
+    if (msg->payload)
+        flags |= FLUX_MSGFLAG_PAYLOAD;
+    else
+        flags &= ~(uint8_t)(FLUX_MSGFLAG_PAYLOAD);
+    if (flux_msg_set_flags (msg, flags) < 0)
+        return -1;
+    return 0;
+}
+
 static inline void msg_lasterr_reset (flux_msg_t *msg)
 {
     if (msg_validate (msg) == 0) {
@@ -1152,9 +1229,10 @@ flux_msg_t *flux_msg_copy (const flux_msg_t *msg, bool payload)
     cpy->aux2 = msg->aux2;
 
     if (flux_msg_route_count (msg) > 0) {
-        struct route_id *r = NULL;
-        list_for_each_rev (&msg->routes, r, route_id_node) {
-            if (flux_msg_route_push (cpy, r->id) < 0)
+        int i;
+        for (i = 0; i < msg->routes_len; i++) {
+            const struct route_id *r = msg_route_get (msg, i);
+            if (msg_route_push (cpy, route_id_str (r), r->len) < 0)
                 goto error;
         }
     }
@@ -1165,9 +1243,7 @@ flux_msg_t *flux_msg_copy (const flux_msg_t *msg, bool payload)
     if (msg->payload) {
         if (payload) {
             cpy->payload_size = msg->payload_size;
-            if (!(cpy->payload = malloc (cpy->payload_size)))
-                goto error;
-            memcpy (cpy->payload, msg->payload, msg->payload_size);
+            cpy->payload = msg_payload_incref (msg->payload);
         }
         else
             cpy->flags &= ~FLUX_MSGFLAG_PAYLOAD;
@@ -171,6 +171,13 @@ int flux_msg_get_topic (const flux_msg_t *msg, const char **topic);
  */
 int flux_msg_get_payload (const flux_msg_t *msg, const void **buf, int *size);
 int flux_msg_set_payload (flux_msg_t *msg, const void *buf, int size);
+
+/* Replace the payload of 'msg' with the payload of 'src' (or remove it,
+ * if 'src' has none) without copying.  Payloads are reference counted,
+ * so the shared payload remains valid after either message is destroyed,
+ * and it is copied if either message's payload is later modified.
+ */
+int flux_msg_share_payload (flux_msg_t *msg, const flux_msg_t *src);
 bool flux_msg_has_payload (const flux_msg_t *msg);
 
 /* Get/set flags
@@ -66,12 +66,15 @@ int iovec_to_msg (flux_msg_t *msg,
         /*     errno = EPROTO; */
         /*     return -1; */
         /* } */
-        while ((index < iovcnt) && iov[index].size > 0) {
-            if (msg_route_append (msg,
-                                  (char *)iov[index].data,
-                                  iov[index].size) < 0)
-                return -1;
+        int i;
+        while ((index < iovcnt) && iov[index].size > 0)
             index++;
+        /* first frame is the last route, so push in reverse order */
+        for (i = index - 1; i >= 0; i--) {
+            if (msg_route_push (msg,
+                                (char *)iov[i].data,
+                                iov[i].size) < 0)
+                return -1;
         }
         if (index < iovcnt)
             index++;
@@ -93,7 +96,7 @@ int iovec_to_msg (flux_msg_t *msg,
             return -1;
         }
         msg->payload_size = iov[index].size;
-        if (!(msg->payload = malloc (msg->payload_size)))
+        if (!(msg->payload = msg_payload_alloc (msg->payload_size)))
             return -1;
         memcpy (msg->payload, iov[index].data, msg->payload_size);
         if (index < iovcnt)
@@ -154,17 +157,18 @@ int msg_to_iovec (const flux_msg_t *msg,
         iov[index].size = strlen (msg->topic);
     }
     if (msg->flags & FLUX_MSGFLAG_ROUTE) {
-        struct route_id *r = NULL;
+        int i;
         /* delimeter */
         index--;
         assert (index >= 0);
         iov[index].data = NULL;
         iov[index].size = 0;
-        list_for_each_rev (&msg->routes, r, route_id_node) {
+        for (i = 0; i < msg->routes_len; i++) {
+            const struct route_id *r = msg_route_get (msg, i);
             index--;
             assert (index >= 0);
-            iov[index].data = r->id;
-            iov[index].size = strlen (r->id);
+            iov[index].data = route_id_str (r);
+            iov[index].size = r->len;
         }
     }
     (*iovp) = iov;
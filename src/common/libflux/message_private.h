@@ -14,21 +14,37 @@
 #include <stdint.h>
 #include <jansson.h>
 
-/* czmq and ccan both define streq */
-#ifdef streq
-#undef streq
-#endif
-#include "src/common/libccan/ccan/list/list.h"
+/* Route ids are usually UUID strings (36 chars) or broker ranks, so
+ * ids up to ROUTE_ID_INLINE_SIZE - 1 chars are stored in place.  Longer
+ * ids are copied to the heap.
+ */
+#define ROUTE_ID_INLINE_SIZE 44
+
+struct route_id {
+    char *spill;        // heap copy of id if too long for 'id', else NULL
+    uint32_t len;
+    char id[ROUTE_ID_INLINE_SIZE];
+};
+
+/* Number of route ids stored in the message itself before the route
+ * stack is moved to a heap array.
+ */
+#define ROUTES_INLINE_COUNT 4
 
 struct flux_msg {
-    // optional route list, if FLUX_MSGFLAG_ROUTE
-    struct list_head routes;
-    int routes_len;     /* to avoid looping */
+    // optional route stack, if FLUX_MSGFLAG_ROUTE
+    // stored in routes_inline until it outgrows it, then in routes_spill
+    // index 0 is the first (oldest) route, routes_len - 1 the last
+    struct route_id routes_inline[ROUTES_INLINE_COUNT];
+    struct route_id *routes_spill;
+    int routes_size;    // allocated size of routes_spill
+    int routes_len;
 
     // optional topic frame, if FLUX_MSGFLAG_TOPIC
     char *topic;
 
     // optional payload frame, if FLUX_MSGFLAG_PAYLOAD
+    // reference counted, may be shared with other messages
     void *payload;
     size_t payload_size;
 
@@ -56,6 +72,13 @@ struct flux_msg {
     int refcount;
 };
 
+/* Allocate a reference counted payload buffer of 'size' bytes,
+ * with an initial reference count of one.
+ */
+void *msg_payload_alloc (size_t size);
+void *msg_payload_incref (void *payload);
+void msg_payload_decref (void *payload);
+
 #endif /* !_FLUX_CORE_MESSAGE_PRIVATE_H */
 
 /*
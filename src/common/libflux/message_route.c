@@ -13,6 +13,7 @@
 #endif
 #include <errno.h>
 #include <stdbool.h>
+#include <stdlib.h>
 #include <string.h>
 #include <arpa/inet.h>
 #include <assert.h>
@@ -22,72 +23,95 @@
 #include "message_private.h"
 #include "message_route.h"
 
-static void route_id_destroy (void *data)
+/* Route ids are kept in a stack of fixed size slots, stored in the
+ * message itself for the common case of a few hops, so that pushing and
+ * popping a route at each hop does not allocate.  Deeper stacks move to
+ * a heap array that grows by doubling, and ids too long for a slot are
+ * copied to the heap individually.
+ */
+
+static struct route_id *routes_array (flux_msg_t *msg)
 {
-    if (data) {
-        struct route_id *r = data;
-        free (r);
-    }
+    return msg->routes_spill ? msg->routes_spill : msg->routes_inline;
 }
 
-static struct route_id *route_id_create (const char *id, unsigned int id_len)
+/* Ensure there is room to push one more route.
+ */
+static int routes_reserve (flux_msg_t *msg)
 {
-    struct route_id *r;
-    if (!(r = calloc (1, sizeof (*r) + id_len + 1)))
-        return NULL;
-    if (id && id_len) {
-        memcpy (r->id, id, id_len);
-        list_node_init (&(r->route_id_node));
-    }
-    return r;
+    int capacity = msg->routes_spill ? msg->routes_size : ROUTES_INLINE_COUNT;
+    struct route_id *routes;
+
+    if (msg->routes_len < capacity)
+        return 0;
+    if (msg->routes_spill)
+        routes = realloc (msg->routes_spill, 2 * capacity * sizeof (*routes));
+    else if ((routes = malloc (2 * capacity * sizeof (*routes))))
+        memcpy (routes, msg->routes_inline, sizeof (msg->routes_inline));
+    if (!routes)
+        return -1;
+    msg->routes_spill = routes;
+    msg->routes_size = 2 * capacity;
+    return 0;
 }
 
-int msg_route_push (flux_msg_t *msg,
-                    const char *id,
-                    unsigned int id_len)
+static int route_id_set (struct route_id *r,
+                         const char *id,
+                         unsigned int id_len)
 {
-    struct route_id *r;
-    if (!(r = route_id_create (id, strlen (id))))
-        return -1;
-    list_add (&msg->routes, &r->route_id_node);
-    msg->routes_len++;
+    char *dst = r->id;
+
+    r->spill = NULL;
+    if (id_len >= sizeof (r->id)) {
+        if (!(r->spill = malloc (id_len + 1)))
+            return -1;
+        dst = r->spill;
+    }
+    memcpy (dst, id, id_len);
+    dst[id_len] = '\0';
+    r->len = id_len;
     return 0;
 }
 
-int msg_route_append (flux_msg_t *msg,
-                      const char *id,
-                      unsigned int id_len)
+int msg_route_push (flux_msg_t *msg,
+                    const char *id,
+                    unsigned int id_len)
 {
-    struct route_id *r;
     assert (msg);
     assert ((msg->flags & FLUX_MSGFLAG_ROUTE));
     assert (id);
-    if (!(r = route_id_create (id, id_len)))
+    if (routes_reserve (msg) < 0
+        || route_id_set (&routes_array (msg)[msg->routes_len],
+                         id,
+                         id_len) < 0)
         return -1;
-    list_add_tail (&msg->routes, &r->route_id_node);
     msg->routes_len++;
     return 0;
 }
 
 void msg_route_clear (flux_msg_t *msg)
 {
-    struct route_id *r;
+    struct route_id *routes;
+    int i;
+
     assert (msg);
     assert ((msg->flags & FLUX_MSGFLAG_ROUTE));
-    while ((r = list_pop (&msg->routes, struct route_id, route_id_node)))
-        route_id_destroy (r);
-    list_head_init (&msg->routes);
+    routes = routes_array (msg);
+    for (i = 0; i < msg->routes_len; i++)
+        free (routes[i].spill);
+    free (msg->routes_spill);
+    msg->routes_spill = NULL;
+    msg->routes_size = 0;
     msg->routes_len = 0;
 }
 
 int msg_route_delete_last (flux_msg_t *msg)
 {
-    struct route_id *r;
     assert (msg);
     assert ((msg->flags & FLUX_MSGFLAG_ROUTE));
-    if ((r = list_pop (&msg->routes, struct route_id, route_id_node))) {
-        route_id_destroy (r);
+    if (msg->routes_len > 0) {
         msg->routes_len--;
+        free (routes_array (msg)[msg->routes_len].spill);
     }
     return 0;
 }
@@ -11,19 +11,28 @@
 #ifndef _FLUX_CORE_MESSAGE_ROUTE_H
 #define _FLUX_CORE_MESSAGE_ROUTE_H
 
-struct route_id {
-    struct list_node route_id_node;
-    char id[0];                 /* variable length id stored at end of struct */
-};
-
+/* Return a pointer to route 'index', where 0 is the first (oldest)
+ * route.  'index' must be less than msg->routes_len.
+ */
+static inline const struct route_id *msg_route_get (const flux_msg_t *msg,
+                                                    int index)
+{
+    if (msg->routes_spill)
+        return &msg->routes_spill[index];
+    return &msg->routes_inline[index];
+}
+
+static inline const char *route_id_str (const struct route_id *r)
+{
+    return r->spill ? r->spill : r->id;
+}
+
+/* Push 'id' as the last route.
+ */
 int msg_route_push (flux_msg_t *msg,
                     const char *id,
                     unsigned int id_len);
 
-int msg_route_append (flux_msg_t *msg,
-                      const char *id,
-                      unsigned int id_len);
-
 void msg_route_clear (flux_msg_t *msg);
 
 int msg_route_delete_last (flux_msg_t *msg);
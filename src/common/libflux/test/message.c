@@ -421,6 +421,79 @@ void check_routes (void)
     flux_msg_destroy (msg2);
 }
 
+/* Route stack deeper than the inline route slots, with an id too long
+ * to be stored inline, survives copy and encode/decode in order.
+ */
+void check_routes_deep (void)
+{
+    flux_msg_t *msg, *cpy, *msg2;
+    char longid[128];
+    char id[16];
+    const char *route;
+    void *buf;
+    ssize_t size;
+    int count = 10;
+    int i;
+
+    memset (longid, 'x', sizeof (longid) - 1);
+    longid[sizeof (longid) - 1] = '\0';
+
+    if (!(msg = flux_msg_create (FLUX_MSGTYPE_REQUEST)))
+        BAIL_OUT ("flux_msg_create failed");
+    flux_msg_route_enable (msg);
+    for (i = 0; i < count; i++) {
+        snprintf (id, sizeof (id), "%d", i);
+        if (flux_msg_route_push (msg, i == 3 ? longid : id) < 0)
+            BAIL_OUT ("flux_msg_route_push failed");
+    }
+    ok (flux_msg_route_count (msg) == count
+        && flux_msg_frames (msg) == count + 2,
+        "flux_msg_route_push works past inline route slots");
+    ok ((route = flux_msg_route_first (msg)) != NULL && !strcmp (route, "0"),
+        "flux_msg_route_first returns first route");
+    ok ((route = flux_msg_route_last (msg)) != NULL && !strcmp (route, "9"),
+        "flux_msg_route_last returns last route");
+
+    ok ((cpy = flux_msg_copy (msg, false)) != NULL
+        && flux_msg_route_count (cpy) == count,
+        "flux_msg_copy copies deep route stack");
+    size = flux_msg_encode_size (msg);
+    if (size < 0 || !(buf = malloc (size)))
+        BAIL_OUT ("could not allocate encode buffer");
+    ok (flux_msg_encode (msg, buf, size) == 0
+        && (msg2 = flux_msg_decode (buf, size)) != NULL,
+        "flux_msg_encode/decode works with deep route stack");
+    free (buf);
+    ok (flux_msg_route_count (msg2) == count,
+        "decoded message has expected route count");
+
+    for (i = count - 1; i >= 0; i--) {
+        const char *r1 = flux_msg_route_last (cpy);
+        const char *r2 = flux_msg_route_last (msg2);
+        snprintf (id, sizeof (id), "%d", i);
+        if (!r1 || !r2
+            || strcmp (r1, i == 3 ? longid : id) != 0
+            || strcmp (r2, i == 3 ? longid : id) != 0
+            || flux_msg_route_delete_last (cpy) < 0
+            || flux_msg_route_delete_last (msg2) < 0)
+            break;
+    }
+    ok (i < 0
+        && flux_msg_route_count (cpy) == 0
+        && flux_msg_route_count (msg2) == 0,
+        "copied and decoded routes pop off in reverse order");
+
+    flux_msg_route_clear (msg);
+    ok (flux_msg_route_count (msg) == 0
+        && flux_msg_route_push (msg, "foo") == 0
+        && flux_msg_route_count (msg) == 1,
+        "flux_msg_route_push works after clearing deep route stack");
+
+    flux_msg_destroy (msg);
+    flux_msg_destroy (cpy);
+    flux_msg_destroy (msg2);
+}
+
 /* flux_msg_get_topic, flux_msg_set_topic on message with and without routes
  */
 void check_topic (void)
@@ -709,6 +782,91 @@ void check_payload (void)
     flux_msg_destroy (msg);
 }
 
+void check_payload_share (void)
+{
+    flux_msg_t *msg, *msg2, *cpy;
+    const void *buf, *buf2;
+    char pay[1024];
+    char pay2[16];
+    int len, len2;
+
+    memset (pay, 42, sizeof (pay));
+    memset (pay2, 43, sizeof (pay2));
+    if (!(msg = flux_msg_create (FLUX_MSGTYPE_REQUEST))
+        || !(msg2 = flux_msg_create (FLUX_MSGTYPE_RESPONSE)))
+        BAIL_OUT ("flux_msg_create failed");
+
+    errno = 0;
+    ok (flux_msg_share_payload (NULL, msg) < 0 && errno == EINVAL,
+        "flux_msg_share_payload msg=NULL fails with EINVAL");
+    errno = 0;
+    ok (flux_msg_share_payload (msg2, NULL) < 0 && errno == EINVAL,
+        "flux_msg_share_payload src=NULL fails with EINVAL");
+
+    ok (flux_msg_set_payload (msg, pay, sizeof (pay)) == 0,
+        "flux_msg_set_payload works");
+    ok (flux_msg_share_payload (msg2, msg) == 0,
+        "flux_msg_share_payload works");
+    ok (flux_msg_get_payload (msg, &buf, &len) == 0
+        && flux_msg_get_payload (msg2, &buf2, &len2) == 0
+        && buf == buf2 && len == len2,
+        "messages share the same payload buffer");
+    ok (flux_msg_share_payload (msg2, msg) == 0
+        && flux_msg_get_payload (msg2, &buf2, &len2) == 0
+        && buf == buf2,
+        "flux_msg_share_payload works again on same payload");
+
+    ok ((cpy = flux_msg_copy (msg, true)) != NULL
+        && flux_msg_get_payload (cpy, &buf2, &len2) == 0
+        && buf == buf2 && len == len2,
+        "flux_msg_copy shares payload buffer");
+
+    /* modifying a shared payload copies it */
+    ok (flux_msg_set_payload (msg2, pay2, sizeof (pay2)) == 0
+        && flux_msg_get_payload (msg2, &buf2, &len2) == 0
+        && buf != buf2 && len2 == sizeof (pay2),
+        "flux_msg_set_payload on shared payload makes a copy");
+    cmp_mem (buf2, pay2, len2,
+        "and new payload is correct");
+    ok (flux_msg_get_payload (msg, &buf, &len) == 0 && len == sizeof (pay),
+        "original payload size is unchanged");
+    cmp_mem (buf, pay, len,
+        "original payload content is unchanged");
+
+    flux_msg_destroy (msg);
+    ok (flux_msg_get_payload (cpy, &buf, &len) == 0 && len == sizeof (pay),
+        "payload remains valid after original message is destroyed");
+    cmp_mem (buf, pay, len,
+        "and content is correct");
+
+    /* smaller replacement in place */
+    ok (flux_msg_set_payload (cpy, pay2, sizeof (pay2)) == 0
+        && flux_msg_get_payload (cpy, &buf, &len) == 0
+        && len == sizeof (pay2),
+        "flux_msg_set_payload with smaller payload updates size");
+
+    ok (flux_msg_share_payload (cpy, msg2) == 0
+        && flux_msg_get_payload (cpy, &buf, &len) == 0
+        && flux_msg_get_payload (msg2, &buf2, &len2) == 0
+        && buf == buf2 && len == len2,
+        "flux_msg_share_payload replaces existing payload");
+
+    if (!(msg = flux_msg_create (FLUX_MSGTYPE_REQUEST)))
+        BAIL_OUT ("flux_msg_create failed");
+    ok (flux_msg_share_payload (cpy, msg) == 0
+        && !flux_msg_has_payload (cpy),
+        "flux_msg_share_payload from message with no payload removes it");
+    ok (flux_msg_get_payload (msg2, &buf2, &len2) == 0
+        && len2 == sizeof (pay2),
+        "other message sharing the payload is unaffected");
+    cmp_mem (buf2, pay2, len2,
+        "and content is correct");
+
+    flux_msg_destroy (msg);
+    flux_msg_destroy (msg2);
+    flux_msg_destroy (cpy);
+}
+
 /* flux_msg_set_type, flux_msg_get_type
  * flux_msg_set_nodeid, flux_msg_get_nodeid
  * flux_msg_set_errnum, flux_msg_get_errnum
@@ -1251,8 +1409,10 @@ int main (int argc, char *argv[])
     check_cornercase ();
     check_proto ();
     check_routes ();
+    check_routes_deep ();
     check_topic ();
     check_payload ();
+    check_payload_share ();
     check_payload_json ();
     check_payload_json_formatted ();
     check_matchtag ();
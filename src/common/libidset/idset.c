@@ -18,6 +18,7 @@
 #include <stdio.h>
 #include <stdarg.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 #include "idset.h"
 #include "idset_private.h"
@@ -31,6 +32,381 @@ int validate_idset_flags (int flags, int allowed)
     return 0;
 }
 
+/* Bitmap helpers.
+ * N.B. the caller must ensure that 'words' covers all ids in a range.
+ */
+
+static inline unsigned int popcount (uint64_t w)
+{
+    return __builtin_popcountll (w);
+}
+
+/* Mask of bits lo..hi (inclusive) within one word, 0 <= lo <= hi < 64.
+ */
+static inline uint64_t word_mask (unsigned int lo, unsigned int hi)
+{
+    return (~0ULL << lo) & (~0ULL >> (IDSET_WORD_BITS - 1 - hi));
+}
+
+static size_t bits_set_range (uint64_t *words, unsigned int lo, unsigned int hi)
+{
+    size_t first = lo / IDSET_WORD_BITS;
+    size_t last = hi / IDSET_WORD_BITS;
+    size_t count = 0;
+    size_t i;
+
+    for (i = first; i <= last; i++) {
+        uint64_t mask = word_mask (i == first ? lo % IDSET_WORD_BITS : 0,
+                                   i == last ? hi % IDSET_WORD_BITS
+                                             : IDSET_WORD_BITS - 1);
+        count += popcount (mask & ~words[i]);
+        words[i] |= mask;
+    }
+    return count;
+}
+
+static size_t bits_clear_range (uint64_t *words,
+                                unsigned int lo,
+                                unsigned int hi)
+{
+    size_t first = lo / IDSET_WORD_BITS;
+    size_t last = hi / IDSET_WORD_BITS;
+    size_t count = 0;
+    size_t i;
+
+    for (i = first; i <= last; i++) {
+        uint64_t mask = word_mask (i == first ? lo % IDSET_WORD_BITS : 0,
+                                   i == last ? hi % IDSET_WORD_BITS
+                                             : IDSET_WORD_BITS - 1);
+        count += popcount (mask & words[i]);
+        words[i] &= ~mask;
+    }
+    return count;
+}
+
+/* Find the first set (clear if 'invert' is true) bit >= 'from'.
+ * Returns nwords * IDSET_WORD_BITS if there is none.
+ */
+static size_t bits_find (const uint64_t *words,
+                         size_t nwords,
+                         size_t from,
+                         bool invert)
+{
+    size_t i = from / IDSET_WORD_BITS;
+    uint64_t w;
+
+    if (i >= nwords)
+        return nwords * IDSET_WORD_BITS;
+    w = invert ? ~words[i] : words[i];
+    w &= ~0ULL << (from % IDSET_WORD_BITS);
+    while (w == 0) {
+        if (++i == nwords)
+            return nwords * IDSET_WORD_BITS;
+        w = invert ? ~words[i] : words[i];
+    }
+    return i * IDSET_WORD_BITS + __builtin_ctzll (w);
+}
+
+/* Return the number of words up to and including the last non-zero one.
+ */
+static size_t bits_used (const uint64_t *words, size_t nwords)
+{
+    while (nwords > 0 && words[nwords - 1] == 0)
+        nwords--;
+    return nwords;
+}
+
+/* Count runs of consecutive set bits by counting bits that are set
+ * where the next lower bit is clear.
+ */
+static size_t bits_count_runs (const uint64_t *words, size_t nwords)
+{
+    uint64_t carry = 0;
+    size_t runs = 0;
+    size_t i;
+
+    for (i = 0; i < nwords; i++) {
+        uint64_t w = words[i];
+        runs += popcount (w & ~((w << 1) | carry));
+        carry = w >> (IDSET_WORD_BITS - 1);
+    }
+    return runs;
+}
+
+/* Ensure the bitmap has at least 'nwords' words, zero filling new ones.
+ * Return 0 on success, -1 on failure with errno == ENOMEM.
+ */
+static int words_reserve (struct idset *idset, size_t nwords)
+{
+    size_t maxwords = UINT_MAX / IDSET_WORD_BITS + 1;
+    size_t newsize = idset->nwords > 0 ? idset->nwords : 1;
+    uint64_t *words;
+
+    if (nwords <= idset->nwords)
+        return 0;
+    while (newsize < nwords)
+        newsize <<= 1;
+    if (newsize > maxwords)
+        newsize = MAX (maxwords, nwords);
+    if (!(words = realloc (idset->words, newsize * sizeof (words[0]))))
+        return -1;
+    memset (&words[idset->nwords],
+            0,
+            (newsize - idset->nwords) * sizeof (words[0]));
+    idset->words = words;
+    idset->nwords = newsize;
+    return 0;
+}
+
+/* Range array helpers.
+ */
+
+static inline size_t range_size (const struct idset_range *r)
+{
+    return (size_t)r->hi - r->lo + 1;
+}
+
+/* Return the index of the first range with hi >= id, or nranges if none.
+ */
+static size_t ranges_search (const struct idset *idset, unsigned int id)
+{
+    size_t lo = 0;
+    size_t hi = idset->nranges;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (idset->ranges[mid].hi < id)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+static int ranges_reserve (struct idset *idset, size_t n)
+{
+    size_t newsize = idset->ranges_alloc > 0 ? idset->ranges_alloc : 4;
+    struct idset_range *ranges;
+
+    if (n <= idset->ranges_alloc)
+        return 0;
+    while (newsize < n)
+        newsize <<= 1;
+    if (!(ranges = realloc (idset->ranges, newsize * sizeof (ranges[0]))))
+        return -1;
+    idset->ranges = ranges;
+    idset->ranges_alloc = newsize;
+    return 0;
+}
+
+/* Insert lo..hi into the range array, merging any overlapping or
+ * adjacent ranges.  Return 0 on success, -1 on failure with errno set.
+ */
+static int ranges_insert (struct idset *idset, unsigned int lo, unsigned int hi)
+{
+    size_t i = ranges_search (idset, lo > 0 ? lo - 1 : 0);
+    size_t j = i;
+    size_t removed = 0;
+    struct idset_range *r = idset->ranges;
+
+    while (j < idset->nranges && r[j].lo <= hi + 1) {
+        removed += range_size (&r[j]);
+        j++;
+    }
+    if (j == i) {
+        if (ranges_reserve (idset, idset->nranges + 1) < 0)
+            return -1;
+        r = idset->ranges;
+        memmove (&r[i + 1], &r[i], (idset->nranges - i) * sizeof (r[0]));
+        idset->nranges++;
+    }
+    else {
+        if (r[i].lo < lo)
+            lo = r[i].lo;
+        if (r[j - 1].hi > hi)
+            hi = r[j - 1].hi;
+        memmove (&r[i + 1], &r[j], (idset->nranges - j) * sizeof (r[0]));
+        idset->nranges -= j - i - 1;
+    }
+    r[i].lo = lo;
+    r[i].hi = hi;
+    idset->count += range_size (&r[i]) - removed;
+    return 0;
+}
+
+/* Remove lo..hi from the range array, splitting a range if necessary.
+ * Return 0 on success, -1 on failure with errno set.
+ */
+static int ranges_remove (struct idset *idset, unsigned int lo, unsigned int hi)
+{
+    size_t i = ranges_search (idset, lo);
+    size_t j;
+    struct idset_range *r = idset->ranges;
+
+    if (i == idset->nranges)
+        return 0;
+    if (r[i].lo < lo && r[i].hi > hi) { // split
+        if (ranges_reserve (idset, idset->nranges + 1) < 0)
+            return -1;
+        r = idset->ranges;
+        memmove (&r[i + 1], &r[i], (idset->nranges - i) * sizeof (r[0]));
+        idset->nranges++;
+        r[i].hi = lo - 1;
+        r[i + 1].lo = hi + 1;
+        idset->count -= (size_t)hi - lo + 1;
+        return 0;
+    }
+    if (r[i].lo < lo) {                 // trim tail of first range
+        idset->count -= (size_t)r[i].hi - lo + 1;
+        r[i].hi = lo - 1;
+        i++;
+    }
+    j = i;
+    while (j < idset->nranges && r[j].hi <= hi) {
+        idset->count -= range_size (&r[j]);
+        j++;
+    }
+    if (j < idset->nranges && r[j].lo <= hi) { // trim head of last range
+        idset->count -= (size_t)hi - r[j].lo + 1;
+        r[j].lo = hi + 1;
+    }
+    memmove (&r[i], &r[j], (idset->nranges - j) * sizeof (r[0]));
+    idset->nranges -= j - i;
+    return 0;
+}
+
+/* Build a new range array by appending ranges in order of increasing 'lo'.
+ */
+struct range_builder {
+    struct idset_range *ranges;
+    size_t nranges;
+    size_t alloc;
+    size_t count;
+};
+
+static int builder_append (struct range_builder *rb,
+                           unsigned int lo,
+                           unsigned int hi)
+{
+    struct idset_range *last = NULL;
+
+    if (rb->nranges > 0)
+        last = &rb->ranges[rb->nranges - 1];
+    if (last && last->hi + 1 >= lo) {
+        if (hi > last->hi) {
+            rb->count += hi - last->hi;
+            last->hi = hi;
+        }
+        return 0;
+    }
+    if (rb->nranges == rb->alloc) {
+        size_t newsize = rb->alloc > 0 ? rb->alloc * 2 : 4;
+        struct idset_range *ranges;
+
+        if (!(ranges = realloc (rb->ranges, newsize * sizeof (ranges[0]))))
+            return -1;
+        rb->ranges = ranges;
+        rb->alloc = newsize;
+    }
+    rb->ranges[rb->nranges].lo = lo;
+    rb->ranges[rb->nranges].hi = hi;
+    rb->nranges++;
+    rb->count += (size_t)hi - lo + 1;
+    return 0;
+}
+
+/* Representation changes.
+ * These are optimizations, so if memory cannot be allocated for the new
+ * representation, the idset is left as is.
+ */
+
+static void idset_to_bitmap (struct idset *idset)
+{
+    size_t nwords = 0;
+    uint64_t *words;
+    size_t i;
+
+    if (idset->nranges > 0)
+        nwords = idset->ranges[idset->nranges - 1].hi / IDSET_WORD_BITS + 1;
+    if (!(words = calloc (nwords > 0 ? nwords : 1, sizeof (words[0]))))
+        return;
+    for (i = 0; i < idset->nranges; i++)
+        bits_set_range (words, idset->ranges[i].lo, idset->ranges[i].hi);
+    free (idset->ranges);
+    idset->ranges = NULL;
+    idset->nranges = idset->ranges_alloc = 0;
+    idset->words = words;
+    idset->nwords = nwords > 0 ? nwords : 1;
+    idset->bitmap = true;
+}
+
+static void idset_to_ranges (struct idset *idset, size_t nruns)
+{
+    struct idset_range *ranges;
+    unsigned int lo, hi;
+    unsigned int from = 0;
+    size_t n = 0;
+
+    if (!(ranges = calloc (nruns > 0 ? nruns : 1, sizeof (ranges[0]))))
+        return;
+    while (n < nruns && idset_next_run (idset, from, &lo, &hi)) {
+        ranges[n].lo = lo;
+        ranges[n].hi = hi;
+        n++;
+        from = hi + 1;
+    }
+    free (idset->words);
+    idset->words = NULL;
+    idset->nwords = 0;
+    idset->ranges = ranges;
+    idset->nranges = n;
+    idset->ranges_alloc = nruns > 0 ? nruns : 1;
+    idset->bitmap = false;
+}
+
+/* Switch to a bitmap once the range array is larger than a bitmap
+ * covering the same ids would be.
+ */
+static void idset_check_ranges (struct idset *idset)
+{
+    if (!idset->bitmap
+        && idset->nranges > IDSET_RANGES_MIN
+        && idset->nranges > idset->ranges[idset->nranges - 1].hi
+                            / IDSET_WORD_BITS + 1)
+        idset_to_bitmap (idset);
+}
+
+/* Switch back to ranges if a bitmap is no longer fragmented.
+ * Require the ranges to be half the size of the bitmap so that a set
+ * near the threshold doesn't flip back and forth.
+ */
+static void idset_compact (struct idset *idset)
+{
+    if (idset->bitmap) {
+        size_t used = bits_used (idset->words, idset->nwords);
+        size_t runs = bits_count_runs (idset->words, used);
+
+        if (runs <= IDSET_RANGES_MIN || runs <= used / 2)
+            idset_to_ranges (idset, runs);
+    }
+}
+
+/* Replace the contents of 'idset' with ranges from 'rb'.
+ */
+static void idset_take_ranges (struct idset *idset, struct range_builder *rb)
+{
+    free (idset->ranges);
+    free (idset->words);
+    idset->words = NULL;
+    idset->nwords = 0;
+    idset->bitmap = false;
+    idset->ranges = rb->ranges;
+    idset->nranges = rb->nranges;
+    idset->ranges_alloc = rb->alloc;
+    idset->count = rb->count;
+    idset_check_ranges (idset);
+}
+
 struct idset *idset_create (size_t size, int flags)
 {
     struct idset *idset;
@@ -39,16 +415,10 @@ struct idset *idset_create (size_t size, int flags)
         return NULL;
     if (size == 0)
         size = IDSET_DEFAULT_SIZE;
-    if (!(idset = malloc (sizeof (*idset))))
-        return NULL;
-    idset->T = vebnew (size, 0);
-    if (!idset->T.D) {
-        free (idset);
-        errno = ENOMEM;
+    if (!(idset = calloc (1, sizeof (*idset))))
         return NULL;
-    }
+    idset->size = size;
     idset->flags = flags;
-    idset->count = 0;
     return idset;
 }
 
@@ -56,38 +426,42 @@ void idset_destroy (struct idset *idset)
 {
     if (idset) {
         int saved_errno = errno;
-        free (idset->T.D);
+        free (idset->ranges);
+        free (idset->words);
         free (idset);
         errno = saved_errno;
     }
 }
 
-static Veb vebdup (Veb T)
-{
-    size_t size = vebsize (T.M);
-    Veb cpy;
-
-    cpy.k = T.k;
-    cpy.M = T.M;
-    if ((cpy.D = malloc (size)))
-        memcpy (cpy.D, T.D, size);
-    return cpy;
-}
-
 static struct idset *idset_copy_flags (const struct idset *idset, int flags)
 {
     struct idset *cpy;
 
-    if (!(cpy = malloc (sizeof (*idset))))
-        return NULL;
-    cpy->flags = flags;
-    cpy->T = vebdup (idset->T);
-    if (!cpy->T.D) {
-        idset_destroy (cpy);
+    if (!(cpy = idset_create (idset->size, flags)))
         return NULL;
+    if (idset->bitmap) {
+        if (!(cpy->words = malloc (idset->nwords * sizeof (cpy->words[0]))))
+            goto error;
+        memcpy (cpy->words,
+                idset->words,
+                idset->nwords * sizeof (cpy->words[0]));
+        cpy->nwords = idset->nwords;
+        cpy->bitmap = true;
+    }
+    else if (idset->nranges > 0) {
+        if (ranges_reserve (cpy, idset->nranges) < 0)
+            goto error;
+        memcpy (cpy->ranges,
+                idset->ranges,
+                idset->nranges * sizeof (cpy->ranges[0]));
+        cpy->nranges = idset->nranges;
     }
     cpy->count = idset->count;
     return cpy;
+error:
+    idset_destroy (cpy);
+    errno = ENOMEM;
+    return NULL;
 }
 
 struct idset *idset_copy (const struct idset *idset)
@@ -107,53 +481,70 @@ static bool valid_id (unsigned int id)
 }
 
 /* Double idset size until it has at least 'size' slots.
- * Return 0 on success, -1 on failure with errno == ENOMEM.
+ * Return 0 on success, -1 on failure with errno == EINVAL.
  */
 static int idset_grow (struct idset *idset, size_t size)
 {
-    size_t newsize = idset->T.M;
-    Veb T;
-    unsigned int id;
+    size_t newsize = idset->size;
 
     while (newsize < size)
         newsize <<= 1;
 
-    if (newsize > idset->T.M) {
+    if (newsize > idset->size) {
         if (!(idset->flags & IDSET_FLAG_AUTOGROW)) {
             errno = EINVAL;
             return -1;
         }
-        T = vebnew (newsize, 0);
-        if (!T.D)
-            return -1;
-
-        id = vebsucc (idset->T, 0);
-        while (id < idset->T.M) {
-            vebput (T, id);
-            id = vebsucc (idset->T, id + 1);
-        }
-        free (idset->T.D);
-        idset->T = T;
+        idset->size = newsize;
     }
     return 0;
 }
 
-/* Wrapper for vebput() which increments idset count if needed
+/* Add lo..hi to the set, adjusting count.
  */
-static void idset_put (struct idset *idset, unsigned int id)
+static int idset_put (struct idset *idset, unsigned int lo, unsigned int hi)
 {
-    if (!idset_test (idset, id))
-        idset->count++;
-    vebput (idset->T, id);
+    size_t nwords = hi / IDSET_WORD_BITS + 1;
+
+    /* Extending a bitmap to cover a distant id would cost more than
+     * storing all the ids as ranges, so switch to ranges first.
+     */
+    if (idset->bitmap
+        && nwords > idset->nwords
+        && nwords > idset->count + IDSET_RANGES_MIN) {
+        idset_to_ranges (idset,
+                         bits_count_runs (idset->words, idset->nwords));
+    }
+    if (idset->bitmap) {
+        if (words_reserve (idset, nwords) < 0)
+            return -1;
+        idset->count += bits_set_range (idset->words, lo, hi);
+        return 0;
+    }
+    if (ranges_insert (idset, lo, hi) < 0)
+        return -1;
+    idset_check_ranges (idset);
+    return 0;
 }
 
-/* Wrapper for vebdel() which decrements idset count if needed
+/* Remove lo..hi from the set, adjusting count.
  */
-static void idset_del (struct idset *idset, unsigned int id)
+static int idset_del (struct idset *idset, unsigned int lo, unsigned int hi)
 {
-    if (idset_test (idset, id))
-        idset->count--;
-    vebdel (idset->T, id);
+    if (idset->bitmap) {
+        size_t nbits = idset->nwords * IDSET_WORD_BITS;
+
+        if (lo >= nbits)
+            return 0;
+        if (hi >= nbits)
+            hi = nbits - 1;
+        idset->count -= bits_clear_range (idset->words, lo, hi);
+        return 0;
+    }
+    if (ranges_remove (idset, lo, hi) < 0)
+        return -1;
+    idset_check_ranges (idset);
+    return 0;
 }
 
 int idset_set (struct idset *idset, unsigned int id)
@@ -162,10 +553,9 @@ int idset_set (struct idset *idset, unsigned int id)
         errno = EINVAL;
         return -1;
     }
-    if (idset_grow (idset, id + 1) < 0)
+    if (idset_grow (idset, (size_t)id + 1) < 0)
         return -1;
-    idset_put (idset, id);
-    return 0;
+    return idset_put (idset, id, id);
 }
 
 static void normalize_range (unsigned int *lo, unsigned int *hi)
@@ -179,18 +569,14 @@ static void normalize_range (unsigned int *lo, unsigned int *hi)
 
 int idset_range_set (struct idset *idset, unsigned int lo, unsigned int hi)
 {
-    unsigned int id;
-
     if (!idset || !valid_id (lo) || !valid_id (hi)) {
         errno = EINVAL;
         return -1;
     }
     normalize_range (&lo, &hi);
-    if (idset_grow (idset, hi + 1) < 0)
+    if (idset_grow (idset, (size_t)hi + 1) < 0)
         return -1;
-    for (id = lo; id <= hi; id++)
-        idset_put (idset, id);
-    return 0;
+    return idset_put (idset, lo, hi);
 }
 
 int idset_clear (struct idset *idset, unsigned int id)
@@ -199,66 +585,98 @@ int idset_clear (struct idset *idset, unsigned int id)
         errno = EINVAL;
         return -1;
     }
-    idset_del (idset, id);
-    return 0;
+    return idset_del (idset, id, id);
 }
 
 int idset_range_clear (struct idset *idset, unsigned int lo, unsigned int hi)
 {
-    unsigned int id;
-
     if (!idset || !valid_id (lo) || !valid_id (hi)) {
         errno = EINVAL;
         return -1;
     }
     normalize_range (&lo, &hi);
-    for (id = lo; id <= hi && id < idset->T.M; id++)
-        idset_del (idset, id);
-    return 0;
+    if (lo >= idset->size)
+        return 0;
+    if (hi >= idset->size)
+        hi = idset->size - 1;
+    return idset_del (idset, lo, hi);
 }
 
 bool idset_test (const struct idset *idset, unsigned int id)
 {
-    if (!idset || !valid_id (id) || id >= idset->T.M)
+    if (!idset || !valid_id (id) || id >= idset->size)
         return false;
-    return (vebsucc (idset->T, id) == id);
+    if (idset->bitmap) {
+        size_t i = id / IDSET_WORD_BITS;
+        return (i < idset->nwords
+                && (idset->words[i] & (1ULL << (id % IDSET_WORD_BITS))));
+    }
+    else {
+        size_t i = ranges_search (idset, id);
+        return (i < idset->nranges && idset->ranges[i].lo <= id);
+    }
 }
 
-unsigned int idset_first (const struct idset *idset)
+bool idset_next_run (const struct idset *idset,
+                     unsigned int from,
+                     unsigned int *lo,
+                     unsigned int *hi)
 {
-    unsigned int next = IDSET_INVALID_ID;
+    if (idset->bitmap) {
+        size_t nbits = idset->nwords * IDSET_WORD_BITS;
+        size_t start = bits_find (idset->words, idset->nwords, from, false);
+
+        if (start >= nbits)
+            return false;
+        *lo = start;
+        *hi = bits_find (idset->words, idset->nwords, start, true) - 1;
+    }
+    else {
+        size_t i = ranges_search (idset, from);
 
-    if (idset) {
-        next = vebsucc (idset->T, 0);
-        if (next == idset->T.M)
-            next = IDSET_INVALID_ID;
+        if (i == idset->nranges)
+            return false;
+        *lo = MAX (idset->ranges[i].lo, from);
+        *hi = idset->ranges[i].hi;
     }
-    return next;
+    return true;
 }
 
+unsigned int idset_first (const struct idset *idset)
+{
+    unsigned int lo, hi;
+
+    if (!idset || !idset_next_run (idset, 0, &lo, &hi))
+        return IDSET_INVALID_ID;
+    return lo;
+}
 
 unsigned int idset_next (const struct idset *idset, unsigned int prev)
 {
-    unsigned int next = IDSET_INVALID_ID;
+    unsigned int lo, hi;
 
-    if (idset) {
-        next = vebsucc (idset->T, prev + 1);
-        if (next == idset->T.M)
-            next = IDSET_INVALID_ID;
-    }
-    return next;
+    if (!idset
+        || prev >= IDSET_INVALID_ID - 1
+        || !idset_next_run (idset, prev + 1, &lo, &hi))
+        return IDSET_INVALID_ID;
+    return lo;
 }
 
 unsigned int idset_last (const struct idset *idset)
 {
-    unsigned int last = IDSET_INVALID_ID;
-
     if (idset) {
-        last = vebpred (idset->T, idset->T.M - 1);
-        if (last == idset->T.M)
-            last = IDSET_INVALID_ID;
+        if (idset->bitmap) {
+            size_t used = bits_used (idset->words, idset->nwords);
+            if (used > 0) {
+                uint64_t w = idset->words[used - 1];
+                return (used - 1) * IDSET_WORD_BITS
+                       + IDSET_WORD_BITS - 1 - __builtin_clzll (w);
+            }
+        }
+        else if (idset->nranges > 0)
+            return idset->ranges[idset->nranges - 1].hi;
     }
-    return last;
+    return IDSET_INVALID_ID;
 }
 
 size_t idset_count (const struct idset *idset)
@@ -271,39 +689,62 @@ size_t idset_count (const struct idset *idset)
 bool idset_equal (const struct idset *idset1,
                   const struct idset *idset2)
 {
-    unsigned int id;
+    unsigned int lo1, hi1, lo2, hi2;
+    unsigned int from = 0;
 
     if (!idset1 || !idset2)
         return false;
     if (idset_count (idset1) != idset_count (idset2))
         return false;
+    if (idset_count (idset1) == 0)
+        return true;
+    if (!idset1->bitmap && !idset2->bitmap) {
+        return (idset1->nranges == idset2->nranges
+                && !memcmp (idset1->ranges,
+                            idset2->ranges,
+                            idset1->nranges * sizeof (idset1->ranges[0])));
+    }
+    if (idset1->bitmap && idset2->bitmap) {
+        size_t n = MIN (idset1->nwords, idset2->nwords);
 
-    id = vebsucc (idset1->T, 0);
-    while (id < idset1->T.M) {
-        if (vebsucc (idset2->T, id) != id)
-            return false; // id in idset1 not set in idset2
-        id = vebsucc (idset1->T, id + 1);
+        // counts are equal, so any ids beyond 'n' words would be a mismatch
+        return !memcmp (idset1->words, idset2->words, n * sizeof (uint64_t));
     }
-    id = vebsucc (idset2->T, 0);
-    while (id < idset2->T.M) {
-        if (vebsucc (idset1->T, id) != id)
-            return false; // id in idset2 not set in idset1
-        id = vebsucc (idset2->T, id + 1);
+    while (idset_next_run (idset1, from, &lo1, &hi1)) {
+        if (!idset_next_run (idset2, from, &lo2, &hi2)
+            || lo1 != lo2
+            || hi1 != hi2)
+            return false;
+        from = hi1 + 1;
     }
     return true;
 }
 
 bool idset_has_intersection (const struct idset *a, const struct idset *b)
 {
-    if (a && b) {
-        unsigned int id;
+    unsigned int alo, ahi, blo, bhi;
+    unsigned int from = 0;
+
+    if (!a || !b || a->count == 0 || b->count == 0)
+        return false;
+    if (a->bitmap && b->bitmap) {
+        size_t n = MIN (a->nwords, b->nwords);
+        size_t i;
 
-        id = idset_first (b);
-        while (id != IDSET_INVALID_ID) {
-            if (idset_test (a, id))
+        for (i = 0; i < n; i++) {
+            if ((a->words[i] & b->words[i]))
                 return true;
-            id = idset_next (b, id);
         }
+        return false;
+    }
+    /* Alternately skip ahead in a and b to the start of the other's
+     * next run, until runs overlap or either set is exhausted.
+     */
+    while (idset_next_run (a, from, &alo, &ahi)
+           && idset_next_run (b, alo, &blo, &bhi)) {
+        if (blo <= ahi)
+            return true;
+        from = blo;
     }
     return false;
 }
@@ -314,13 +755,58 @@ int idset_add (struct idset *a, const struct idset *b)
         errno = EINVAL;
         return -1;
     }
-    if (b) {
-        unsigned int id;
-        id = idset_first (b);
-        while (id != IDSET_INVALID_ID) {
-            if (idset_set (a, id) < 0)
+    if (b && b->count > 0) {
+        unsigned int last = idset_last (b);
+
+        if (idset_grow (a, (size_t)last + 1) < 0)
+            return -1;
+        if (b->bitmap) {
+            size_t nwords = last / IDSET_WORD_BITS + 1;
+            size_t i;
+
+            if (!a->bitmap)
+                idset_to_bitmap (a);
+            if (!a->bitmap || words_reserve (a, nwords) < 0) {
+                errno = ENOMEM;
+                return -1;
+            }
+            for (i = 0; i < nwords; i++) {
+                a->count += popcount (b->words[i] & ~a->words[i]);
+                a->words[i] |= b->words[i];
+            }
+            idset_compact (a);
+        }
+        else if (a->bitmap) {
+            size_t i;
+
+            if (words_reserve (a, last / IDSET_WORD_BITS + 1) < 0)
                 return -1;
-            id = idset_next (b, id);
+            for (i = 0; i < b->nranges; i++) {
+                a->count += bits_set_range (a->words,
+                                            b->ranges[i].lo,
+                                            b->ranges[i].hi);
+            }
+            idset_compact (a);
+        }
+        else {
+            struct range_builder rb = { 0 };
+            size_t i = 0;
+            size_t j = 0;
+
+            while (i < a->nranges || j < b->nranges) {
+                const struct idset_range *r;
+
+                if (j == b->nranges
+                    || (i < a->nranges && a->ranges[i].lo < b->ranges[j].lo))
+                    r = &a->ranges[i++];
+                else
+                    r = &b->ranges[j++];
+                if (builder_append (&rb, r->lo, r->hi) < 0) {
+                    free (rb.ranges);
+                    return -1;
+                }
+            }
+            idset_take_ranges (a, &rb);
         }
     }
     return 0;
@@ -349,15 +835,51 @@ int idset_subtract (struct idset *a, const struct idset *b)
         errno = EINVAL;
         return -1;
     }
-    if (b) {
-        unsigned int id;
+    if (!b || b->count == 0 || a->count == 0)
+        return 0;
+    if (a->bitmap && b->bitmap) {
+        size_t n = MIN (a->nwords, b->nwords);
+        size_t i;
+
+        for (i = 0; i < n; i++) {
+            a->count -= popcount (a->words[i] & b->words[i]);
+            a->words[i] &= ~b->words[i];
+        }
+        idset_compact (a);
+    }
+    else if (a->bitmap) {
+        size_t i;
 
-        id = idset_first (b);
-        while (id != IDSET_INVALID_ID) {
-            if (idset_clear (a, id) < 0)
+        for (i = 0; i < b->nranges; i++) {
+            if (idset_del (a, b->ranges[i].lo, b->ranges[i].hi) < 0)
                 return -1;
-            id = idset_next (b, id);
         }
+        idset_compact (a);
+    }
+    else {
+        struct range_builder rb = { 0 };
+        unsigned int blo, bhi;
+        size_t i;
+
+        for (i = 0; i < a->nranges; i++) {
+            unsigned int lo = a->ranges[i].lo;
+            unsigned int hi = a->ranges[i].hi;
+
+            while (lo <= hi
+                   && idset_next_run (b, lo, &blo, &bhi)
+                   && blo <= hi) {
+                if (blo > lo && builder_append (&rb, lo, blo - 1) < 0)
+                    goto error;
+                lo = bhi + 1;
+            }
+            if (lo <= hi && builder_append (&rb, lo, hi) < 0)
+                goto error;
+        }
+        idset_take_ranges (a, &rb);
+        return 0;
+error:
+        free (rb.ranges);
+        return -1;
     }
     return 0;
 }
@@ -382,21 +904,53 @@ struct idset *idset_difference (const struct idset *a, const struct idset *b)
 struct idset *idset_intersect (const struct idset *a, const struct idset *b)
 {
     struct idset *result;
-    unsigned int id;
 
     if (!a || !b) {
         errno = EINVAL;
         return NULL;
     }
-    if (!(result = idset_copy (a)))
-        return NULL;
-    id = idset_first (a);
-    while (id != IDSET_INVALID_ID) {
-        if (!idset_test (b, id) && idset_clear (result, id) < 0) {
-            idset_destroy (result);
+    if (a->bitmap && b->bitmap) {
+        size_t n = MIN (a->nwords, b->nwords);
+        size_t i;
+
+        if (!(result = idset_copy (a)))
+            return NULL;
+        result->count = 0;
+        for (i = 0; i < result->nwords; i++) {
+            if (i < n)
+                result->words[i] &= b->words[i];
+            else
+                result->words[i] = 0;
+            result->count += popcount (result->words[i]);
+        }
+        idset_compact (result);
+    }
+    else {
+        struct range_builder rb = { 0 };
+        unsigned int alo, ahi, blo, bhi;
+        unsigned int from = 0;
+
+        if (!(result = idset_create (a->size, a->flags)))
             return NULL;
+        /* For each run in a, append its overlap with runs in b,
+         * skipping runs in a that end before the next run in b.
+         */
+        while (idset_next_run (a, from, &alo, &ahi)
+               && idset_next_run (b, alo, &blo, &bhi)) {
+            from = ahi + 1;
+            while (blo <= ahi) {
+                if (builder_append (&rb, blo, MIN (bhi, ahi)) < 0) {
+                    free (rb.ranges);
+                    idset_destroy (result);
+                    return NULL;
+                }
+                if (bhi >= ahi || !idset_next_run (b, bhi + 1, &blo, &bhi))
+                    break;
+            }
+            if (blo > ahi)
+                from = blo;
         }
-        id = idset_next (a, id);
+        idset_take_ranges (result, &rb);
     }
     return result;
 }
@@ -25,40 +25,37 @@
 /* Format a string like printf, then append it to *s.
  * The allocated size of '*s' is '*sz'.
  * The current string length of '*s' is '*len'.
- * Grow *s by IDSET_ENCODE_CHUNK to allow new string to be appended.
+ * Grow *s by doubling, starting at IDSET_ENCODE_CHUNK, to allow new
+ * string to be appended.
  * Returns 0 on success, -1 on failure with errno = ENOMEM.
  */
 static int __attribute__ ((format (printf, 4, 5)))
 catprintf (char **s, size_t *sz, size_t *len, const char *fmt, ...)
 {
     va_list ap;
-    char *ns;
-    size_t nlen;
-    int rc;
+    char ns[64];
+    int nlen;
 
     va_start (ap, fmt);
-    rc = vasprintf (&ns, fmt, ap);
+    nlen = vsnprintf (ns, sizeof (ns), fmt, ap);
     va_end (ap);
-    if (rc < 0)
-        return -1;
-    nlen = strlen (ns);
+    if (nlen < 0 || (size_t)nlen >= sizeof (ns))
+        goto error;
 
-    while (*len + nlen + 1 > *sz) {
-        size_t nsz = *sz + IDSET_ENCODE_CHUNK;
+    if (*len + nlen + 1 > *sz) {
+        size_t nsz = *sz > 0 ? *sz : IDSET_ENCODE_CHUNK;
         char *p;
+        while (*len + nlen + 1 > nsz)
+            nsz *= 2;
         if (!(p = realloc (*s, nsz)))
             goto error;
-        if (*s == NULL)
-            *p = '\0';
         *s = p;
         *sz = nsz;
     }
-    strcat (*s, ns);
+    memcpy (*s + *len, ns, nlen + 1);
     *len += nlen;
-    free (ns);
     return 0;
 error:
-    free (ns);
     errno = ENOMEM;
     return -1;
 }
@@ -68,9 +65,9 @@ static int catrange (char **s, size_t *sz, size_t *len,
 {
     int rc;
     if (lo == hi)
-        rc = catprintf (s, sz, len, "%u%s", lo, sep);
+        rc = catprintf (s, sz, len, "%s%u", sep, lo);
     else
-        rc = catprintf (s, sz, len, "%u-%u%s", lo, hi, sep);
+        rc = catprintf (s, sz, len, "%s%u-%u", sep, lo, hi);
     return rc;
 }
 
@@ -80,35 +77,17 @@ static int catrange (char **s, size_t *sz, size_t *len,
 static int encode_ranged (const struct idset *idset,
                           char **s, size_t *sz, size_t *len)
 {
-    int count = 0;
-    unsigned int id;
-    unsigned int lo = 0;
-    unsigned int hi = 0;
-    bool first = true;
-
-    lo = hi = id = vebsucc (idset->T, 0);
-    while (id < idset->T.M) {
-        unsigned int next = vebsucc (idset->T, id + 1);;
-        bool last = (next == idset->T.M);
+    size_t count = 0;
+    unsigned int lo, hi;
+    unsigned int from = 0;
 
-        if (first)                  // first iteration
-            first = false;
-        else if (id == hi + 1)      // id is in range
-            hi++;
-        else {                      // id is NOT in range
-            if (catrange (s, sz, len, lo, hi, ",") < 0)
-                return -1;
-            lo = hi = id;
-        }
-        if (last) {                 // last iteration
-            if (catrange (s, sz, len, lo, hi, last ? "" : ",") < 0)
-                return -1;
-        }
-        if (count < INT_MAX)
-            count++;
-        id = next;
+    while (idset_next_run (idset, from, &lo, &hi)) {
+        if (catrange (s, sz, len, lo, hi, count > 0 ? "," : "") < 0)
+            return -1;
+        count += (size_t)hi - lo + 1;
+        from = hi + 1;
     }
-    return count;
+    return count > INT_MAX ? INT_MAX : count;
 }
 
 /* Return value: count of id's in set, or -1 on failure.
@@ -120,15 +99,13 @@ static int encode_simple (const struct idset *idset,
     int count = 0;
     unsigned int id;
 
-    id = vebsucc (idset->T, 0);
-    while (id != idset->T.M) {
-        int next = vebsucc (idset->T, id + 1);
-        char *sep = next == idset->T.M ? "" : ",";
-        if (catprintf (s, sz, len, "%d%s", id, sep) < 0)
+    id = idset_first (idset);
+    while (id != IDSET_INVALID_ID) {
+        if (catprintf (s, sz, len, "%s%u", count > 0 ? "," : "", id) < 0)
             return -1;
         if (count < INT_MAX)
             count++;
-        id = next;
+        id = idset_next (idset, id);
     }
     return count;
 }
@@ -11,20 +11,41 @@
 #ifndef HAVE_LIBIDSET_PRIVATE_H
 #define HAVE_LIBIDSET_PRIVATE_H 1
 
-/* Implemented as a Van Emde Boas tree using code.google.com/p/libveb.
- * T.D is data; T.M is size
- * All ops are O(log m), for key bitsize m: 2^m == T.M.
+/* An idset is stored in one of two forms:
+ * - a sorted array of disjoint, non-adjacent ranges, which is compact for
+ *   the mostly contiguous sets of ranks that Flux typically deals with
+ * - a dense bitmap of 64-bit words, used once the range array would be
+ *   larger than a bitmap covering the same ids
+ * Set algebra on two bitmaps is performed a word at a time.  Results are
+ * converted back to ranges when they are no longer fragmented.
+ * 'size' is the current upper bound on ids (see IDSET_FLAG_AUTOGROW).
  */
 
-#include "src/common/libutil/veb.h"
+#include <stdint.h>
+
 #include "idset.h"
 
+struct idset_range {
+    unsigned int lo;
+    unsigned int hi;
+};
+
 struct idset {
     size_t count;
-    Veb T;
+    size_t size;
     int flags;
+    bool bitmap;            // if true, 'words' is valid, otherwise 'ranges'
+
+    struct idset_range *ranges;
+    size_t nranges;
+    size_t ranges_alloc;
+
+    uint64_t *words;        // ids >= nwords * IDSET_WORD_BITS are not set
+    size_t nwords;
 };
 
+#define IDSET_WORD_BITS 64
+#define IDSET_RANGES_MIN 16     // never convert to bitmap below this
 #define IDSET_ENCODE_CHUNK 1024
 #define IDSET_DEFAULT_SIZE 1024 // default idset size if size=0
 
@@ -35,6 +56,15 @@ int format_first (char *buf,
                   const char *fmt,
                   unsigned int id);
 
+/* Find the first run of consecutive ids in 'idset' that are >= 'from'.
+ * A run that spans 'from' is clipped so that *lo == from.
+ * Returns true if a run was found, false if there are no more ids.
+ */
+bool idset_next_run (const struct idset *idset,
+                     unsigned int from,
+                     unsigned int *lo,
+                     unsigned int *hi);
+
 #endif /* !HAVE_LIBIDSET_PRIVATE_H */
 
 /*
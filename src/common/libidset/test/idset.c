@@ -656,7 +656,7 @@ void test_autogrow (void)
     idset = idset_create (1, 0);
     ok (idset != NULL,
         "idset_create size=1 flags=0 works");
-    ok (idset->T.M == 1,
+    ok (idset->size == 1,
         "idset internal size is 1");
     ok (idset_set (idset, 0) == 0,
         "idset_set 0 works");
@@ -668,13 +668,13 @@ void test_autogrow (void)
     idset = idset_create (1, IDSET_FLAG_AUTOGROW);
     ok (idset != NULL,
         "idset_create size=1 flags=AUTOGROW works");
-    ok (idset->T.M == 1,
+    ok (idset->size == 1,
         "idset internal size is 1");
     ok (idset_set (idset, 0) == 0,
         "idset_set 0 works");
     ok (idset_set (idset, 2) == 0,
         "idset_set 2 works");
-    ok (idset->T.M > 1,
+    ok (idset->size > 1,
         "idset internal size grew");
     ok (   idset_test (idset, 0)
         && !idset_test (idset, 1)
@@ -684,6 +684,127 @@ void test_autogrow (void)
     idset_destroy (idset);
 }
 
+/* Sets are stored as ranges or as a bitmap depending on fragmentation.
+ * Check set algebra against a bool array for each combination.
+ */
+#define HYBRID_SIZE 4096
+
+static unsigned int hybrid_seed = 1;
+
+static unsigned int hybrid_rand (void)
+{
+    hybrid_seed = hybrid_seed * 1103515245 + 12345;
+    return (hybrid_seed >> 16) & 0x7fff;
+}
+
+static struct idset *hybrid_create (int pattern, bool *ref)
+{
+    struct idset *idset;
+    unsigned int i;
+
+    if (!(idset = idset_create (0, IDSET_FLAG_AUTOGROW)))
+        BAIL_OUT ("idset_create failed");
+    memset (ref, 0, HYBRID_SIZE * sizeof (ref[0]));
+    for (i = 0; i < HYBRID_SIZE; i++) {
+        switch (pattern) {
+            case 0:     // empty
+                break;
+            case 1:     // a few long ranges
+                ref[i] = (i / 1000) % 2 == 0;
+                break;
+            case 2:     // every other id
+                ref[i] = i % 2 == 0;
+                break;
+            case 3:     // random
+                ref[i] = hybrid_rand () % 3 == 0;
+                break;
+            case 4:     // random runs
+                ref[i] = (i / 37 + hybrid_rand () % 2) % 3 == 0;
+                break;
+        }
+        if (ref[i] && idset_set (idset, i) < 0)
+            BAIL_OUT ("idset_set %u failed", i);
+    }
+    return idset;
+}
+
+static bool hybrid_check (struct idset *idset, bool *ref)
+{
+    size_t count = 0;
+    unsigned int i;
+
+    if (!idset)
+        return false;
+    for (i = 0; i < HYBRID_SIZE; i++) {
+        if (idset_test (idset, i) != ref[i])
+            return false;
+        if (ref[i])
+            count++;
+    }
+    return idset_count (idset) == count;
+}
+
+void test_hybrid (void)
+{
+    bool ra[HYBRID_SIZE], rb[HYBRID_SIZE], rx[HYBRID_SIZE];
+    int npatterns = 5;
+    int pa, pb;
+
+    for (pa = 0; pa < npatterns; pa++) {
+        for (pb = 0; pb < npatterns; pb++) {
+            struct idset *a = hybrid_create (pa, ra);
+            struct idset *b = hybrid_create (pb, rb);
+            struct idset *x;
+            bool intersects = false;
+            unsigned int i;
+            char *s;
+
+            ok (hybrid_check (a, ra) && hybrid_check (b, rb),
+                "hybrid %d,%d: sets contain expected ids", pa, pb);
+
+            for (i = 0; i < HYBRID_SIZE; i++)
+                rx[i] = ra[i] || rb[i];
+            x = idset_union (a, b);
+            ok (hybrid_check (x, rx),
+                "hybrid %d,%d: idset_union works", pa, pb);
+            idset_destroy (x);
+
+            for (i = 0; i < HYBRID_SIZE; i++) {
+                rx[i] = ra[i] && rb[i];
+                if (rx[i])
+                    intersects = true;
+            }
+            x = idset_intersect (a, b);
+            ok (hybrid_check (x, rx),
+                "hybrid %d,%d: idset_intersect works", pa, pb);
+            idset_destroy (x);
+            ok (idset_has_intersection (a, b) == intersects,
+                "hybrid %d,%d: idset_has_intersection works", pa, pb);
+
+            for (i = 0; i < HYBRID_SIZE; i++)
+                rx[i] = ra[i] && !rb[i];
+            x = idset_difference (a, b);
+            ok (hybrid_check (x, rx),
+                "hybrid %d,%d: idset_difference works", pa, pb);
+            idset_destroy (x);
+
+            ok (idset_equal (a, b) == (memcmp (ra, rb, sizeof (ra)) == 0),
+                "hybrid %d,%d: idset_equal works", pa, pb);
+
+            if (!(s = idset_encode (b, IDSET_FLAG_RANGE)))
+                BAIL_OUT ("idset_encode failed");
+            x = idset_decode (s);
+            ok (hybrid_check (x, rb) && idset_equal (x, b),
+                "hybrid %d,%d: encode/decode round trip works", pa, pb);
+            idset_destroy (x);
+            free (s);
+
+            idset_destroy (a);
+            idset_destroy (b);
+        }
+    }
+}
+
 /* N.B. internal function */
 void test_format_first (void)
 {
@@ -781,6 +902,7 @@ int main (int argc, char *argv[])
     test_equal ();
     test_copy ();
     test_autogrow ();
+    test_hybrid ();
     test_format_first ();
     issue_1974 ();
     issue_2336 ();
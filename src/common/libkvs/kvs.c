@@ -21,20 +21,38 @@
 #include "treeobj.h"
 #include "kvs_util_private.h"
 
-flux_future_t *flux_kvs_namespace_create (flux_t *h, const char *ns,
-                                          uint32_t owner, int flags)
+static flux_future_t *namespace_create_rpc (flux_t *h,
+                                            const char *ns,
+                                            const char *rootref,
+                                            uint32_t owner,
+                                            int flags,
+                                            const char *link)
+{
+    /* N.B. owner cast to int */
+    if (link)
+        return flux_rpc_pack (h, "kvs.namespace-create", 0, 0,
+                              "{ s:s s:s s:i s:i s:s }",
+                              "namespace", ns,
+                              "rootref", rootref,
+                              "owner", owner,
+                              "flags", flags,
+                              "link", link);
+    return flux_rpc_pack (h, "kvs.namespace-create", 0, 0,
+                          "{ s:s s:s s:i s:i }",
+                          "namespace", ns,
+                          "rootref", rootref,
+                          "owner", owner,
+                          "flags", flags);
+}
+
+/* Compute the blobref of an empty treeobj dir.
+ */
+static int empty_rootref (flux_t *h, char *rootref, size_t size)
 {
-    flux_future_t *rv = NULL;
     const char *hash_name;
     json_t *rootdir = NULL;
-    char rootref[BLOBREF_MAX_STRING_SIZE];
     void *data = NULL;
-    int len;
-
-    if (!ns || flags) {
-        errno = EINVAL;
-        return NULL;
-    }
+    int rc = -1;
 
     if (!(hash_name = flux_attr_get (h, "content.hash")))
         goto cleanup;
@@ -44,25 +62,31 @@ flux_future_t *flux_kvs_namespace_create (flux_t *h, const char *ns,
 
     if (!(data = treeobj_encode (rootdir)))
         goto cleanup;
-    len = strlen (data);
 
     /* N.B. blobref of empty treeobj dir guaranteed to be in content store
      * b/c that is how the primary KVS is initialized.
      */
-    if (blobref_hash (hash_name, data, len, rootref, sizeof (rootref)) < 0)
+    if (blobref_hash (hash_name, data, strlen (data), rootref, size) < 0)
         goto cleanup;
-
-    /* N.B. owner cast to int */
-    rv = flux_rpc_pack (h, "kvs.namespace-create", 0, 0,
-                           "{ s:s s:s s:i s:i }",
-                           "namespace", ns,
-                           "rootref", rootref,
-                           "owner", owner,
-                           "flags", flags);
+    rc = 0;
 cleanup:
     json_decref (rootdir);
     free (data);
-    return rv;
+    return rc;
+}
+
+flux_future_t *flux_kvs_namespace_create (flux_t *h, const char *ns,
+                                          uint32_t owner, int flags)
+{
+    char rootref[BLOBREF_MAX_STRING_SIZE];
+
+    if (!ns || flags) {
+        errno = EINVAL;
+        return NULL;
+    }
+    if (empty_rootref (h, rootref, sizeof (rootref)) < 0)
+        return NULL;
+    return namespace_create_rpc (h, ns, rootref, owner, flags, NULL);
 }
 
 flux_future_t *flux_kvs_namespace_create_with (flux_t *h, const char *ns,
@@ -73,14 +97,26 @@ flux_future_t *flux_kvs_namespace_create_with (flux_t *h, const char *ns,
         errno = EINVAL;
         return NULL;
     }
+    return namespace_create_rpc (h, ns, rootref, owner, flags, NULL);
+}
 
-    /* N.B. owner cast to int */
-    return flux_rpc_pack (h, "kvs.namespace-create", 0, 0,
-                          "{ s:s s:s s:i s:i }",
-                          "namespace", ns,
-                          "rootref", rootref,
-                          "owner", owner,
-                          "flags", flags);
+flux_future_t *flux_kvs_namespace_create_link (flux_t *h, const char *ns,
+                                               const char *rootref,
+                                               uint32_t owner, int flags,
+                                               const char *key)
+{
+    char buf[BLOBREF_MAX_STRING_SIZE];
+
+    if (!ns || !key || flags) {
+        errno = EINVAL;
+        return NULL;
+    }
+    if (!rootref) {
+        if (empty_rootref (h, buf, sizeof (buf)) < 0)
+            return NULL;
+        rootref = buf;
+    }
+    return namespace_create_rpc (h, ns, rootref, owner, flags, key);
 }
 
 flux_future_t *flux_kvs_namespace_remove (flux_t *h, const char *ns)
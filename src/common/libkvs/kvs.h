@@ -35,7 +35,8 @@ enum kvs_op {
     FLUX_KVS_APPEND = 32,
     FLUX_KVS_WATCH_FULL = 64,
     FLUX_KVS_WATCH_UNIQ = 128,
-    FLUX_KVS_WATCH_APPEND = 256
+    FLUX_KVS_WATCH_APPEND = 256,
+    FLUX_KVS_PREFETCH = 512
 };
 
 /* Namespace
@@ -46,12 +47,20 @@ enum kvs_op {
  *   Garbage collection will happen in the background and the
  *   namespace will official be removed.  The removal is "eventually
  *   consistent".
+ * - namespace create link also commits a symlink at 'key' in the primary
+ *   namespace to the new namespace, before responding.  If the link
+ *   cannot be committed, the namespace is removed.  If 'rootref' is NULL,
+ *   the namespace is initialized empty.
  */
 flux_future_t *flux_kvs_namespace_create (flux_t *h, const char *ns,
                                           uint32_t owner, int flags);
 flux_future_t *flux_kvs_namespace_create_with (flux_t *h, const char *ns,
                                                const char *rootref,
                                                uint32_t owner, int flags);
+flux_future_t *flux_kvs_namespace_create_link (flux_t *h, const char *ns,
+                                               const char *rootref,
+                                               uint32_t owner, int flags,
+                                               const char *key);
 flux_future_t *flux_kvs_namespace_remove (flux_t *h, const char *ns);
 
 /* Synchronization:
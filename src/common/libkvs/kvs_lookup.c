@@ -93,6 +93,9 @@ static int validate_lookup_flags (int flags, bool watch_ok)
 
     flags &= ~FLUX_KVS_WAITCREATE;
 
+    /* FLUX_KVS_PREFETCH is a hint and may be combined with any flags */
+    flags &= ~FLUX_KVS_PREFETCH;
+
     switch (flags) {
         case 0:
         case FLUX_KVS_TREEOBJ:
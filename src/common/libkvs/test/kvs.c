@@ -32,6 +32,11 @@ void errors (void)
         && errno == EINVAL,
         "flux_kvs_namespace_create_with fails on bad input");
 
+    errno = 0;
+    ok (flux_kvs_namespace_create_link (NULL, "ns", NULL, 0, 0, NULL) == NULL
+        && errno == EINVAL,
+        "flux_kvs_namespace_create_link fails with NULL key");
+
     errno = 0;
     ok (flux_kvs_namespace_remove (NULL, NULL) == NULL && errno == EINVAL,
         "flux_kvs_namespace_remove fails on bad input");
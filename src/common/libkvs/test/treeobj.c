@@ -99,6 +99,99 @@ const char *blobrefs[] = {
     "sha1-da39a3ee5e6b4b0d3255bfef95601890afd80709",
 };
 
+void test_codec_binary_roundtrip (json_t *obj, const char *desc)
+{
+    json_t *cpy;
+    void *buf;
+    size_t len;
+    char *s;
+
+    buf = treeobj_encode_binary (obj, &len);
+    ok (buf != NULL && treeobj_is_binary (buf, len),
+        "treeobj_encode_binary works on %s", desc);
+    cpy = treeobj_decodeb (buf, len);
+    ok (cpy != NULL && json_equal (cpy, obj) == 1,
+        "treeobj_decodeb of binary %s returns identical object", desc);
+    ok (cpy != NULL && treeobj_validate (cpy) == 0,
+        "decoded binary %s is valid", desc);
+    s = treeobj_encode (obj);
+    ok (s != NULL && len < strlen (s),
+        "binary %s is smaller than JSON (%zu < %zu)",
+        desc, len, s ? strlen (s) : 0);
+    free (s);
+    json_decref (cpy);
+    free (buf);
+}
+
+void test_codec_binary (void)
+{
+    json_t *obj, *dir, *hdir, *dirref;
+    uint8_t *buf;
+    size_t len;
+    size_t i;
+    int errors;
+
+    ok (treeobj_encode_binary (NULL, &len) == NULL && errno == EINVAL,
+        "treeobj_encode_binary obj=NULL fails with EINVAL");
+    ok (treeobj_is_binary ("{}", 2) == false,
+        "treeobj_is_binary returns false on JSON");
+
+    if (!(dir = create_large_dir ()))
+        BAIL_OUT ("could not create %d-entry dir", large_dir_entries);
+    test_codec_binary_roundtrip (dir, "large dir");
+
+    if (!(hdir = treeobj_split_dir (dir, 0)))
+        BAIL_OUT ("treeobj_split_dir failed");
+    test_codec_binary_roundtrip (hdir, "hdir");
+    json_decref (hdir);
+
+    if (!(dirref = treeobj_create_dirref (blobrefs[1]))
+        || treeobj_append_blobref (dirref, blobrefs[2]) < 0)
+        BAIL_OUT ("could not create dirref");
+    json_t *ents[] = {
+        treeobj_create_val ("foo\0bar", 7),
+        treeobj_create_symlink ("ns", "x.y"),
+        treeobj_create_symlink (NULL, "x.z"),
+        treeobj_create_valref (blobrefs[0]),
+        dirref,
+    };
+    if (!(obj = treeobj_create_dir ()))
+        BAIL_OUT ("treeobj_create_dir failed");
+    for (i = 0; i < sizeof (ents) / sizeof (ents[0]); i++) {
+        char name[16];
+        snprintf (name, sizeof (name), "e%zu", i);
+        if (!ents[i] || treeobj_insert_entry (obj, name, ents[i]) < 0)
+            BAIL_OUT ("could not create dir with all types");
+        json_decref (ents[i]);
+    }
+    test_codec_binary_roundtrip (obj, "dir with all types");
+
+    /* Every truncation of a valid encoding must fail cleanly.
+     */
+    buf = treeobj_encode_binary (obj, &len);
+    if (!buf)
+        BAIL_OUT ("treeobj_encode_binary failed");
+    errors = 0;
+    for (i = 0; i < len; i++) {
+        json_t *o;
+        errno = 0;
+        if ((o = treeobj_decodeb ((char *)buf, i)) || errno != EPROTO) {
+            json_decref (o);
+            errors++;
+        }
+    }
+    ok (errors == 0,
+        "treeobj_decodeb fails with EPROTO on all truncated inputs");
+    buf[1] = 99;
+    errno = 0;
+    ok (treeobj_decodeb ((char *)buf, len) == NULL && errno == EPROTO,
+        "treeobj_decodeb fails with EPROTO on unknown version");
+    free (buf);
+
+    json_decref (obj);
+    json_decref (dir);
+}
+
 void test_valref (void)
 {
     json_t *valref;
@@ -664,6 +757,112 @@ void test_deep_copy (void)
     json_decref (val3);
 }
 
+void test_hdir (void)
+{
+    json_t *hdir, *hdir2, *dir, *large, *shard, *cpy, *val;
+    const char *name;
+    json_t *entry;
+    int count, index, total;
+
+    hdir = treeobj_create_hdir (0);
+    ok (hdir != NULL,
+        "treeobj_create_hdir works");
+    diag_json (hdir);
+    ok (treeobj_validate (hdir) == 0,
+        "treeobj_validate likes empty hdir");
+    ok (treeobj_is_hdir (hdir) && !treeobj_is_dir (hdir),
+        "treeobj_is_hdir returns true, treeobj_is_dir returns false");
+    ok (treeobj_get_count (hdir) == 0,
+        "treeobj_get_count returns 0 for empty hdir");
+    ok (treeobj_get_hdir_level (hdir) == 0,
+        "treeobj_get_hdir_level returns 0");
+    index = treeobj_hdir_index (hdir, "foo");
+    ok (index >= 0 && index < TREEOBJ_HDIR_FANOUT,
+        "treeobj_hdir_index returns valid index");
+    errno = 0;
+    ok (treeobj_get_shard (hdir, index) == NULL && errno == ENOENT,
+        "treeobj_get_shard fails with ENOENT on empty shard");
+    errno = 0;
+    ok (treeobj_get_shard (hdir, TREEOBJ_HDIR_FANOUT) == NULL
+        && errno == EINVAL,
+        "treeobj_get_shard fails with EINVAL on bad index");
+
+    val = treeobj_create_val ("foo", 3);
+    if (!(dir = treeobj_create_dir ()) || !val)
+        BAIL_OUT ("can't continue without test value");
+    ok (treeobj_set_shard (hdir, index, val) < 0 && errno == EINVAL,
+        "treeobj_set_shard fails with EINVAL on val shard");
+    ok (treeobj_set_shard (hdir, index, dir) == 0,
+        "treeobj_set_shard works");
+    ok (treeobj_get_shard (hdir, index) == dir,
+        "treeobj_get_shard returns shard");
+    ok (treeobj_get_count (hdir) == 1,
+        "treeobj_get_count returns 1");
+    ok (treeobj_validate (hdir) == 0,
+        "treeobj_validate likes hdir with dir shard");
+    cpy = treeobj_copy (hdir);
+    ok (cpy != NULL && treeobj_get_shard (cpy, index) == dir,
+        "treeobj_copy of hdir is shallow");
+    ok (treeobj_set_shard (cpy, index, NULL) == 0
+        && treeobj_get_count (cpy) == 0
+        && treeobj_get_count (hdir) == 1,
+        "treeobj_set_shard on copy does not modify original");
+    json_decref (cpy);
+    json_decref (dir);
+
+    ok (treeobj_create_hdir (-1) == NULL && errno == EINVAL,
+        "treeobj_create_hdir fails with EINVAL on negative level");
+    ok (treeobj_create_hdir (TREEOBJ_HDIR_MAX_LEVEL + 1) == NULL
+        && errno == EINVAL,
+        "treeobj_create_hdir fails with EINVAL on excessive level");
+    ok (treeobj_hdir_index (val, "foo") < 0 && errno == EINVAL,
+        "treeobj_hdir_index fails with EINVAL on non-hdir");
+    json_decref (val);
+    json_decref (hdir);
+
+    if (!(large = create_large_dir ()))
+        BAIL_OUT ("could not create %d-entry dir", large_dir_entries);
+    hdir = treeobj_split_dir (large, 0);
+    ok (hdir != NULL && treeobj_validate (hdir) == 0,
+        "treeobj_split_dir works on %d-entry dir", large_dir_entries);
+    ok (treeobj_get_count (hdir) == TREEOBJ_HDIR_FANOUT,
+        "all %d shards are populated", TREEOBJ_HDIR_FANOUT);
+    ok (treeobj_get_count (large) == large_dir_entries,
+        "original dir was not modified");
+
+    total = 0;
+    for (index = 0; index < TREEOBJ_HDIR_FANOUT; index++) {
+        if ((shard = treeobj_get_shard (hdir, index)))
+            total += treeobj_get_count (shard);
+    }
+    ok (total == large_dir_entries,
+        "shards contain %d entries total", large_dir_entries);
+
+    count = 0;
+    json_object_foreach (treeobj_get_data (large), name, entry) {
+        shard = treeobj_get_shard (hdir, treeobj_hdir_index (hdir, name));
+        if (shard && treeobj_get_entry (shard, name) == entry)
+            count++;
+    }
+    ok (count == large_dir_entries,
+        "each entry is found in the shard selected by treeobj_hdir_index");
+
+    hdir2 = treeobj_split_dir (large, 1);
+    ok (hdir2 != NULL && treeobj_get_hdir_level (hdir2) == 1,
+        "treeobj_split_dir works at level 1");
+    ok (treeobj_hdir_index (hdir, "entry-0000000001")
+        != treeobj_hdir_index (hdir2, "entry-0000000001")
+        || treeobj_hdir_index (hdir, "entry-0000000002")
+        != treeobj_hdir_index (hdir2, "entry-0000000002"),
+        "different levels select shards with different hash bits");
+    ok (treeobj_split_dir (hdir, 0) == NULL && errno == EINVAL,
+        "treeobj_split_dir fails with EINVAL on non-dir");
+
+    json_decref (hdir2);
+    json_decref (hdir);
+    json_decref (large);
+}
+
 void test_symlink (void)
 {
     json_t *o, *data;
@@ -813,9 +1012,11 @@ int main(int argc, char** argv)
     test_copy ();
     test_deep_copy ();
     test_symlink ();
+    test_hdir ();
     test_corner_cases ();
 
     test_codec ();
+    test_codec_binary ();
 
     done_testing();
 }
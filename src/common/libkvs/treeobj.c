@@ -17,6 +17,7 @@
 #include <string.h>
 #include <assert.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <jansson.h>
 
 #include "src/common/libccan/ccan/base64/base64.h"
@@ -26,6 +27,12 @@
 
 static const int treeobj_version = 1;
 
+/* Number of hash bits consumed per hdir level (log2 of fanout).
+ */
+static const int hdir_bits = 6;
+
+static int treeobj_validate_hdir (const json_t *data);
+
 static int treeobj_unpack (json_t *obj, const char **typep, json_t **datap)
 {
     json_t *data;
@@ -103,6 +110,10 @@ int treeobj_validate (const json_t *obj)
                 goto inval;
         }
     }
+    else if (!strcmp (type, "hdir")) {
+        if (treeobj_validate_hdir (data) < 0)
+            goto inval;
+    }
     else if (!strcmp (type, "symlink")) {
         json_t *o;
         if (!json_is_object (data))
@@ -168,6 +179,12 @@ bool treeobj_is_dirref (const json_t *obj)
     return type && !strcmp (type, "dirref");
 }
 
+bool treeobj_is_hdir (const json_t *obj)
+{
+    const char *type = treeobj_get_type (obj);
+    return type && !strcmp (type, "hdir");
+}
+
 json_t *treeobj_get_data (json_t *obj)
 {
     json_t *data;
@@ -265,6 +282,17 @@ int treeobj_get_count (const json_t *obj)
     else if (!strcmp (type, "dir")) {
         count = json_object_size (data);
     }
+    else if (!strcmp (type, "hdir")) {
+        const json_t *shards = json_object_get (data, "shards");
+        size_t index;
+        json_t *o;
+
+        count = 0;
+        json_array_foreach (shards, index, o) {
+            if (!json_is_null (o))
+                count++;
+        }
+    }
     else if (!strcmp (type, "symlink") || !strcmp (type, "val")) {
         count = 1;
     } else {
@@ -366,6 +394,199 @@ const json_t *treeobj_peek_entry (const json_t *obj, const char *name)
     return obj2;
 }
 
+/* Validate hdir data object, recursing into non-empty shards.
+ */
+static int treeobj_validate_hdir (const json_t *data)
+{
+    const json_t *shards;
+    const json_t *o;
+    size_t index;
+    int level;
+
+    /* N.B. it should be safe to cast away const on 'data' as long as
+     * 'shards' is not modified.
+     */
+    if (!json_is_object (data)
+        || json_unpack ((json_t *)data, "{s:i s:o !}",
+                                        "level", &level,
+                                        "shards", &shards) < 0
+        || level < 0
+        || level > TREEOBJ_HDIR_MAX_LEVEL
+        || !json_is_array (shards)
+        || json_array_size (shards) != TREEOBJ_HDIR_FANOUT)
+        goto inval;
+    json_array_foreach (shards, index, o) {
+        const char *type;
+        if (json_is_null (o))
+            continue;
+        if (!(type = treeobj_get_type (o))
+            || (strcmp (type, "dir") != 0
+                && strcmp (type, "dirref") != 0
+                && strcmp (type, "hdir") != 0)
+            || treeobj_validate (o) < 0)
+            goto inval;
+    }
+    return 0;
+inval:
+    errno = EINVAL;
+    return -1;
+}
+
+/* Peek at hdir level and shards array.
+ */
+static int treeobj_peek_hdir (const json_t *obj,
+                              int *levelp,
+                              const json_t **shardsp)
+{
+    const char *type;
+    const json_t *data;
+    json_t *shards;
+    int level;
+
+    if (treeobj_peek (obj, &type, &data) < 0
+        || strcmp (type, "hdir") != 0
+        || json_unpack ((json_t *)data, "{s:i s:o}",
+                                        "level", &level,
+                                        "shards", &shards) < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (levelp)
+        *levelp = level;
+    if (shardsp)
+        *shardsp = shards;
+    return 0;
+}
+
+/* 32-bit FNV-1a hash of entry name.  This is part of the on-disk
+ * format of hdir objects and must never change.
+ */
+static uint32_t hdir_hash (const char *name)
+{
+    uint32_t hash = 2166136261U;
+
+    while (*name) {
+        hash ^= (unsigned char)*name++;
+        hash *= 16777619U;
+    }
+    return hash;
+}
+
+int treeobj_get_hdir_level (const json_t *obj)
+{
+    int level;
+
+    if (treeobj_peek_hdir (obj, &level, NULL) < 0)
+        return -1;
+    return level;
+}
+
+int treeobj_hdir_index (const json_t *obj, const char *name)
+{
+    int level;
+
+    if (!name || treeobj_peek_hdir (obj, &level, NULL) < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    return (hdir_hash (name) >> (level * hdir_bits))
+           & (TREEOBJ_HDIR_FANOUT - 1);
+}
+
+const json_t *treeobj_peek_shard (const json_t *obj, int index)
+{
+    const json_t *shards;
+    const json_t *shard;
+
+    if (treeobj_peek_hdir (obj, NULL, &shards) < 0
+        || !(shard = json_array_get (shards, index))) {
+        errno = EINVAL;
+        return NULL;
+    }
+    if (json_is_null (shard)) {
+        errno = ENOENT;
+        return NULL;
+    }
+    return shard;
+}
+
+json_t *treeobj_get_shard (json_t *obj, int index)
+{
+    /* N.B. safe to cast away const, 'obj' is not const here */
+    return (json_t *)treeobj_peek_shard (obj, index);
+}
+
+int treeobj_set_shard (json_t *obj, int index, json_t *shard)
+{
+    const json_t *shards;
+    const char *type;
+
+    if (treeobj_peek_hdir (obj, NULL, &shards) < 0
+        || index < 0
+        || index >= json_array_size (shards)) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (shard) {
+        if (!(type = treeobj_get_type (shard))
+            || (strcmp (type, "dir") != 0
+                && strcmp (type, "dirref") != 0
+                && strcmp (type, "hdir") != 0)) {
+            errno = EINVAL;
+            return -1;
+        }
+        json_incref (shard);
+    }
+    else if (!(shard = json_null ())) {
+        errno = ENOMEM;
+        return -1;
+    }
+    if (json_array_set_new ((json_t *)shards, index, shard) < 0) {
+        json_decref (shard);
+        errno = ENOMEM;
+        return -1;
+    }
+    return 0;
+}
+
+json_t *treeobj_split_dir (const json_t *obj, int level)
+{
+    const char *type;
+    const json_t *data;
+    json_t *hdir;
+    const char *name;
+    json_t *entry;
+
+    if (treeobj_peek (obj, &type, &data) < 0
+        || strcmp (type, "dir") != 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+    if (!(hdir = treeobj_create_hdir (level)))
+        return NULL;
+    json_object_foreach ((json_t *)data, name, entry) {
+        int index = treeobj_hdir_index (hdir, name);
+        json_t *shard;
+
+        if (!(shard = treeobj_get_shard (hdir, index))) {
+            if (!(shard = treeobj_create_dir ()))
+                goto error;
+            if (treeobj_set_shard (hdir, index, shard) < 0) {
+                json_decref (shard);
+                goto error;
+            }
+            json_decref (shard);
+        }
+        if (treeobj_insert_entry_novalidate (shard, name, entry) < 0)
+            goto error;
+    }
+    return hdir;
+error:
+    json_decref (hdir);
+    errno = ENOMEM;
+    return NULL;
+}
+
 json_t *treeobj_copy (json_t *obj)
 {
     json_t *data;
@@ -398,6 +619,31 @@ json_t *treeobj_copy (json_t *obj)
             return NULL;
         }
     }
+    else if (treeobj_is_hdir (obj)) {
+        json_t *shards;
+        int level;
+
+        if (json_unpack (data, "{s:i s:o}",
+                               "level", &level,
+                               "shards", &shards) < 0) {
+            errno = EINVAL;
+            return NULL;
+        }
+        if (!(datacpy = json_copy (shards))) {
+            errno = ENOMEM;
+            return NULL;
+        }
+        if (!(cpy = json_pack ("{s:i s:s s:{s:i s:o}}",
+                               "ver", treeobj_version,
+                               "type", "hdir",
+                               "data",
+                                 "level", level,
+                                 "shards", datacpy))) {
+            json_decref (datacpy);
+            errno = ENOMEM;
+            return NULL;
+        }
+    }
     else {
         if (!(cpy = json_deep_copy (obj)))
             return NULL;
@@ -471,6 +717,37 @@ json_t *treeobj_create_dir (void)
     return obj;
 }
 
+json_t *treeobj_create_hdir (int level)
+{
+    json_t *shards = NULL;
+    json_t *obj;
+    int i;
+
+    if (level < 0 || level > TREEOBJ_HDIR_MAX_LEVEL) {
+        errno = EINVAL;
+        return NULL;
+    }
+    if (!(shards = json_array ()))
+        goto nomem;
+    for (i = 0; i < TREEOBJ_HDIR_FANOUT; i++) {
+        if (json_array_append_new (shards, json_null ()) < 0)
+            goto nomem;
+    }
+    /* obj takes reference to "shards" */
+    if (!(obj = json_pack ("{s:i s:s s:{s:i s:o}}",
+                           "ver", treeobj_version,
+                           "type", "hdir",
+                           "data",
+                             "level", level,
+                             "shards", shards)))
+        goto nomem;
+    return obj;
+nomem:
+    json_decref (shards);
+    errno = ENOMEM;
+    return NULL;
+}
+
 json_t *treeobj_create_symlink (const char *ns, const char *target)
 {
     json_t *data, *obj;
@@ -595,6 +872,452 @@ error:
     return NULL;
 }
 
+/* Binary encoding
+ *
+ * magic:u8 version:u8 treeobj
+ *
+ * treeobj := tag:u8 <type specific>
+ *   val     varint(len) bytes
+ *   valref  varint(count) blobref...
+ *   dirref  varint(count) blobref...
+ *   dir     varint(count) (string treeobj)...
+ *   symlink flags:u8 [string(namespace)] string(target)
+ *   hdir    level:u8 bitmap:u64le treeobj... (one per bit set)
+ * blobref := string(hashtype) varint(len) digest
+ * string := varint(len) bytes
+ * varint := unsigned LEB128
+ *
+ * The magic byte can never begin a JSON treeobj, so both encodings can
+ * be decoded by treeobj_decodeb().
+ */
+#define TREEOBJ_BINARY_MAGIC        0xF1
+#define TREEOBJ_BINARY_VERSION      1
+#define TREEOBJ_SYMLINK_HAS_NS      0x01
+#define TREEOBJ_MAX_HASHTYPE_LEN    16
+
+enum {
+    TREEOBJ_TAG_VAL = 1,
+    TREEOBJ_TAG_VALREF = 2,
+    TREEOBJ_TAG_DIR = 3,
+    TREEOBJ_TAG_DIRREF = 4,
+    TREEOBJ_TAG_SYMLINK = 5,
+    TREEOBJ_TAG_HDIR = 6,
+};
+
+struct encbuf {
+    uint8_t *data;
+    size_t len;
+    size_t size;
+};
+
+static int encbuf_reserve (struct encbuf *eb, size_t len)
+{
+    if (eb->len + len > eb->size) {
+        size_t newsize = eb->size ? eb->size : 256;
+        uint8_t *newdata;
+
+        while (newsize < eb->len + len)
+            newsize *= 2;
+        if (!(newdata = realloc (eb->data, newsize)))
+            return -1;
+        eb->data = newdata;
+        eb->size = newsize;
+    }
+    return 0;
+}
+
+static int encbuf_put (struct encbuf *eb, const void *data, size_t len)
+{
+    if (encbuf_reserve (eb, len) < 0)
+        return -1;
+    if (len > 0)
+        memcpy (eb->data + eb->len, data, len);
+    eb->len += len;
+    return 0;
+}
+
+static int encbuf_put_u8 (struct encbuf *eb, uint8_t val)
+{
+    return encbuf_put (eb, &val, 1);
+}
+
+static int encbuf_put_varint (struct encbuf *eb, uint64_t val)
+{
+    uint8_t buf[10];
+    int n = 0;
+
+    do {
+        buf[n] = val & 0x7f;
+        val >>= 7;
+        if (val)
+            buf[n] |= 0x80;
+        n++;
+    } while (val);
+    return encbuf_put (eb, buf, n);
+}
+
+static int encbuf_put_string (struct encbuf *eb, const char *s, size_t len)
+{
+    if (encbuf_put_varint (eb, len) < 0
+        || encbuf_put (eb, s, len) < 0)
+        return -1;
+    return 0;
+}
+
+static int encbuf_put_blobref (struct encbuf *eb, const char *blobref)
+{
+    uint8_t hash[BLOBREF_MAX_DIGEST_SIZE];
+    const char *cp;
+    int hashlen;
+
+    if (!blobref
+        || !(cp = strchr (blobref, '-'))
+        || (hashlen = blobref_strtohash (blobref, hash, sizeof (hash))) < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (encbuf_put_string (eb, blobref, cp - blobref) < 0
+        || encbuf_put_varint (eb, hashlen) < 0
+        || encbuf_put (eb, hash, hashlen) < 0)
+        return -1;
+    return 0;
+}
+
+static int encode_binary (struct encbuf *eb, const json_t *obj)
+{
+    const char *type;
+    const json_t *data;
+
+    if (treeobj_peek (obj, &type, &data) < 0)
+        return -1;
+    if (!strcmp (type, "val")) {
+        void *val;
+        int len;
+
+        if (treeobj_decode_val (obj, &val, &len) < 0)
+            return -1;
+        if (encbuf_put_u8 (eb, TREEOBJ_TAG_VAL) < 0
+            || encbuf_put_varint (eb, len) < 0
+            || encbuf_put (eb, val, len) < 0) {
+            free (val);
+            return -1;
+        }
+        free (val);
+    }
+    else if (!strcmp (type, "valref") || !strcmp (type, "dirref")) {
+        size_t index;
+        json_t *o;
+
+        if (encbuf_put_u8 (eb, !strcmp (type, "valref")
+                               ? TREEOBJ_TAG_VALREF
+                               : TREEOBJ_TAG_DIRREF) < 0
+            || encbuf_put_varint (eb, json_array_size (data)) < 0)
+            return -1;
+        json_array_foreach (data, index, o) {
+            if (encbuf_put_blobref (eb, json_string_value (o)) < 0)
+                return -1;
+        }
+    }
+    else if (!strcmp (type, "dir")) {
+        const char *name;
+        json_t *o;
+
+        if (encbuf_put_u8 (eb, TREEOBJ_TAG_DIR) < 0
+            || encbuf_put_varint (eb, json_object_size (data)) < 0)
+            return -1;
+        /* N.B. safe to cast away const, 'data' is not modified */
+        json_object_foreach ((json_t *)data, name, o) {
+            if (encbuf_put_string (eb, name, strlen (name)) < 0
+                || encode_binary (eb, o) < 0)
+                return -1;
+        }
+    }
+    else if (!strcmp (type, "symlink")) {
+        const char *ns;
+        const char *target;
+
+        if (treeobj_get_symlink (obj, &ns, &target) < 0
+            || encbuf_put_u8 (eb, TREEOBJ_TAG_SYMLINK) < 0
+            || encbuf_put_u8 (eb, ns ? TREEOBJ_SYMLINK_HAS_NS : 0) < 0)
+            return -1;
+        if (ns && encbuf_put_string (eb, ns, strlen (ns)) < 0)
+            return -1;
+        if (encbuf_put_string (eb, target, strlen (target)) < 0)
+            return -1;
+    }
+    else if (!strcmp (type, "hdir")) {
+        uint8_t bitmap[8] = { 0 };
+        int level = treeobj_get_hdir_level (obj);
+        int i;
+
+        for (i = 0; i < TREEOBJ_HDIR_FANOUT; i++) {
+            if (treeobj_peek_shard (obj, i))
+                bitmap[i / 8] |= 1 << (i % 8);
+        }
+        if (encbuf_put_u8 (eb, TREEOBJ_TAG_HDIR) < 0
+            || encbuf_put_u8 (eb, level) < 0
+            || encbuf_put (eb, bitmap, sizeof (bitmap)) < 0)
+            return -1;
+        for (i = 0; i < TREEOBJ_HDIR_FANOUT; i++) {
+            const json_t *shard;
+            if ((shard = treeobj_peek_shard (obj, i))
+                && encode_binary (eb, shard) < 0)
+                return -1;
+        }
+    }
+    else {
+        errno = EINVAL;
+        return -1;
+    }
+    return 0;
+}
+
+void *treeobj_encode_binary (const json_t *obj, size_t *len)
+{
+    struct encbuf eb = { 0 };
+    int saved_errno;
+
+    if (!obj || !len) {
+        errno = EINVAL;
+        return NULL;
+    }
+    if (encbuf_put_u8 (&eb, TREEOBJ_BINARY_MAGIC) < 0
+        || encbuf_put_u8 (&eb, TREEOBJ_BINARY_VERSION) < 0
+        || encode_binary (&eb, obj) < 0)
+        goto error;
+    *len = eb.len;
+    return eb.data;
+error:
+    saved_errno = errno;
+    free (eb.data);
+    errno = saved_errno;
+    return NULL;
+}
+
+struct decbuf {
+    const uint8_t *data;
+    size_t len;
+    size_t pos;
+};
+
+static int decbuf_get (struct decbuf *db, const void **data, size_t len)
+{
+    if (len > db->len - db->pos)
+        return -1;
+    *data = db->data + db->pos;
+    db->pos += len;
+    return 0;
+}
+
+static int decbuf_get_u8 (struct decbuf *db, uint8_t *val)
+{
+    const void *p;
+
+    if (decbuf_get (db, &p, 1) < 0)
+        return -1;
+    *val = *(const uint8_t *)p;
+    return 0;
+}
+
+static int decbuf_get_varint (struct decbuf *db, size_t *val)
+{
+    uint64_t result = 0;
+    int shift = 0;
+    uint8_t byte;
+
+    do {
+        if (shift > 56 || decbuf_get_u8 (db, &byte) < 0)
+            return -1;
+        result |= (uint64_t)(byte & 0x7f) << shift;
+        shift += 7;
+    } while (byte & 0x80);
+    if (result > db->len)   /* no length can exceed the buffer */
+        return -1;
+    *val = result;
+    return 0;
+}
+
+/* Get a string and copy it to a NULL terminated buffer,
+ * which the caller must free.
+ */
+static char *decbuf_get_string (struct decbuf *db)
+{
+    const void *p;
+    size_t len;
+    char *s;
+
+    if (decbuf_get_varint (db, &len) < 0
+        || decbuf_get (db, &p, len) < 0
+        || memchr (p, '\0', len)
+        || !(s = malloc (len + 1)))
+        return NULL;
+    memcpy (s, p, len);
+    s[len] = '\0';
+    return s;
+}
+
+static int decbuf_get_blobref (struct decbuf *db, char *blobref, int size)
+{
+    char hashtype[TREEOBJ_MAX_HASHTYPE_LEN];
+    const void *p;
+    const void *hash;
+    size_t len;
+    size_t hashlen;
+
+    if (decbuf_get_varint (db, &len) < 0
+        || len >= sizeof (hashtype)
+        || decbuf_get (db, &p, len) < 0)
+        return -1;
+    memcpy (hashtype, p, len);
+    hashtype[len] = '\0';
+    if (decbuf_get_varint (db, &hashlen) < 0
+        || decbuf_get (db, &hash, hashlen) < 0
+        || blobref_hashtostr (hashtype, hash, hashlen, blobref, size) < 0)
+        return -1;
+    return 0;
+}
+
+static json_t *decode_binary (struct decbuf *db, int depth)
+{
+    json_t *obj = NULL;
+    uint8_t tag;
+
+    /* guard against stack exhaustion from malicious input */
+    if (depth > 256 || decbuf_get_u8 (db, &tag) < 0)
+        return NULL;
+    switch (tag) {
+        case TREEOBJ_TAG_VAL: {
+            const void *val;
+            size_t len;
+
+            if (decbuf_get_varint (db, &len) < 0
+                || decbuf_get (db, &val, len) < 0)
+                return NULL;
+            return treeobj_create_val (val, len);
+        }
+        case TREEOBJ_TAG_VALREF:
+        case TREEOBJ_TAG_DIRREF: {
+            char blobref[BLOBREF_MAX_STRING_SIZE];
+            size_t count;
+            size_t i;
+
+            if (decbuf_get_varint (db, &count) < 0 || count == 0)
+                return NULL;
+            if (tag == TREEOBJ_TAG_VALREF)
+                obj = treeobj_create_valref (NULL);
+            else
+                obj = treeobj_create_dirref (NULL);
+            if (!obj)
+                return NULL;
+            for (i = 0; i < count; i++) {
+                if (decbuf_get_blobref (db, blobref, sizeof (blobref)) < 0
+                    || treeobj_append_blobref (obj, blobref) < 0)
+                    goto error;
+            }
+            return obj;
+        }
+        case TREEOBJ_TAG_DIR: {
+            size_t count;
+            size_t i;
+
+            if (decbuf_get_varint (db, &count) < 0
+                || !(obj = treeobj_create_dir ()))
+                return NULL;
+            for (i = 0; i < count; i++) {
+                char *name;
+                json_t *entry;
+                int rc;
+
+                if (!(name = decbuf_get_string (db)))
+                    goto error;
+                if (!(entry = decode_binary (db, depth + 1))) {
+                    free (name);
+                    goto error;
+                }
+                rc = treeobj_insert_entry_novalidate (obj, name, entry);
+                json_decref (entry);
+                free (name);
+                if (rc < 0)
+                    goto error;
+            }
+            return obj;
+        }
+        case TREEOBJ_TAG_SYMLINK: {
+            char *ns = NULL;
+            char *target = NULL;
+            uint8_t flags;
+
+            if (decbuf_get_u8 (db, &flags) < 0
+                || ((flags & TREEOBJ_SYMLINK_HAS_NS)
+                    && !(ns = decbuf_get_string (db)))
+                || !(target = decbuf_get_string (db))) {
+                free (ns);
+                return NULL;
+            }
+            obj = treeobj_create_symlink (ns, target);
+            free (ns);
+            free (target);
+            return obj;
+        }
+        case TREEOBJ_TAG_HDIR: {
+            const uint8_t *bitmap;
+            uint8_t level;
+            int i;
+
+            if (decbuf_get_u8 (db, &level) < 0
+                || decbuf_get (db, (const void **)&bitmap, 8) < 0
+                || !(obj = treeobj_create_hdir (level)))
+                return NULL;
+            for (i = 0; i < TREEOBJ_HDIR_FANOUT; i++) {
+                json_t *shard;
+                int rc;
+
+                if (!(bitmap[i / 8] & (1 << (i % 8))))
+                    continue;
+                if (!(shard = decode_binary (db, depth + 1)))
+                    goto error;
+                rc = treeobj_set_shard (obj, i, shard);
+                json_decref (shard);
+                if (rc < 0)
+                    goto error;
+            }
+            return obj;
+        }
+    }
+error:
+    json_decref (obj);
+    return NULL;
+}
+
+bool treeobj_is_binary (const void *buf, size_t buflen)
+{
+    if (buf && buflen > 0 && *(const uint8_t *)buf == TREEOBJ_BINARY_MAGIC)
+        return true;
+    return false;
+}
+
+static json_t *treeobj_decode_binary (const void *buf, size_t buflen)
+{
+    struct decbuf db = { .data = buf, .len = buflen, .pos = 0 };
+    uint8_t magic, version;
+    json_t *obj;
+
+    if (decbuf_get_u8 (&db, &magic) < 0
+        || decbuf_get_u8 (&db, &version) < 0
+        || magic != TREEOBJ_BINARY_MAGIC
+        || version != TREEOBJ_BINARY_VERSION
+        || !(obj = decode_binary (&db, 0)))
+        goto error;
+    if (db.pos != db.len) {
+        json_decref (obj);
+        goto error;
+    }
+    return obj;
+error:
+    errno = EPROTO;
+    return NULL;
+}
+
 json_t *treeobj_decode (const char *buf)
 {
     if (!buf) {
@@ -607,6 +1330,8 @@ json_t *treeobj_decode (const char *buf)
 json_t *treeobj_decodeb (const char *buf, size_t buflen)
 {
     json_t *obj = NULL;
+    if (treeobj_is_binary (buf, buflen))
+        return treeobj_decode_binary (buf, buflen);
     if (!(obj = json_loadb (buf, buflen, 0, NULL))
             || treeobj_validate (obj) < 0) {
         errno = EPROTO;
@@ -29,6 +29,18 @@ json_t *treeobj_create_valref (const char *blobref);
 json_t *treeobj_create_dir (void);
 json_t *treeobj_create_dirref (const char *blobref);
 
+/* Sharded (hash array mapped) directories
+ * An hdir splits a large directory into TREEOBJ_HDIR_FANOUT shards
+ * selected by bits of a hash of the entry name.  Each shard is empty
+ * (JSON null), or a dir, dirref, or nested hdir at the next level.
+ * The level determines which bits of the hash select the shard.
+ * Beyond TREEOBJ_HDIR_MAX_LEVEL, shards are not split further.
+ */
+#define TREEOBJ_HDIR_FANOUT     64
+#define TREEOBJ_HDIR_MAX_LEVEL  4
+
+json_t *treeobj_create_hdir (int level);
+
 /* Validate treeobj, recursively.
  * Return 0 if valid, -1 with errno = EINVAL if invalid.
  */
@@ -45,10 +57,12 @@ bool treeobj_is_val (const json_t *obj);
 bool treeobj_is_valref (const json_t *obj);
 bool treeobj_is_dir (const json_t *obj);
 bool treeobj_is_dirref (const json_t *obj);
+bool treeobj_is_hdir (const json_t *obj);
 
 /* get type-specific value.
  * For dirref/valref, this is an array of blobrefs.
  * For directory, this is dictionary of treeobjs
+ * For hdir, this is an object containing level and shards array.
  * For symlink, this is an object with optinoal namespace and target.
  * For val this is string containing base64-encoded data.
  * Return JSON object on success, NULL on error with errno = EINVAL.
@@ -72,6 +86,7 @@ int treeobj_decode_val (const json_t *obj, void **data, int *len);
 /* get type-specific count.
  * For dirref/valref, this is the number of blobrefs.
  * For directory, this is number of entries
+ * For hdir, this is the number of non-empty shards.
  * For symlink or val, this is 1.
  * Return count on success, -1 on error with errno = EINVAL.
  */
@@ -101,10 +116,35 @@ int treeobj_insert_entry_novalidate (json_t *obj,
  */
 const json_t *treeobj_peek_entry (const json_t *obj, const char *name);
 
+/* get hdir level, or shard index of 'name' in hdir.
+ * Return level/index on success, -1 on error with errno = EINVAL.
+ */
+int treeobj_get_hdir_level (const json_t *obj);
+int treeobj_hdir_index (const json_t *obj, const char *name);
+
+/* get/set hdir shard at 'index'
+ * Get returns JSON object (owned by 'obj', do not destroy), NULL on error.
+ * If the shard is empty, errno is set to ENOENT.
+ * Set takes a reference on 'shard' (caller retains ownership).  If
+ * 'shard' is NULL, the shard is emptied.  Set does not recursively
+ * validate 'shard', only its type.
+ * Set returns 0 on success, -1 on error with errno set.
+ */
+json_t *treeobj_get_shard (json_t *obj, int index);
+const json_t *treeobj_peek_shard (const json_t *obj, int index);
+int treeobj_set_shard (json_t *obj, int index, json_t *shard);
+
+/* Create an hdir at 'level' from the entries of dir object 'obj'.
+ * Entries are distributed into dir shards; 'obj' is not modified.
+ * Return JSON object on success, NULL on failure with errno set.
+ */
+json_t *treeobj_split_dir (const json_t *obj, int level);
+
 /* Shallow copy a treeobj
  * Note that this is not a shallow copy on the json object, but is a
  * shallow copy on the data within a tree object.  For example, for a
- * dir object, the first level of directory entries will be copied.
+ * dir object, the first level of directory entries will be copied,
+ * and for an hdir object, the array of shards will be copied.
  */
 json_t *treeobj_copy (json_t *obj);
 
@@ -131,11 +171,25 @@ json_t *treeobj_create_valref_buf (const char *hashtype, int maxblob,
 /* Convert a treeobj to/from string.
  * The return value of treeobj_decode must be destroyed with json_decref().
  * The return value of treeobj_encode must be destroyed with free().
+ * treeobj_decodeb() accepts both JSON and binary encoded treeobjs.
  */
 json_t *treeobj_decode (const char *buf);
 json_t *treeobj_decodeb (const char *buf, size_t buflen);
 char *treeobj_encode (const json_t *obj);
 
+/* Convert a treeobj to compact binary encoding.
+ * The binary encoding is versioned and tagged by treeobj type.  Val
+ * data is stored as raw bytes instead of base64, and blobrefs are
+ * stored as raw digests.  It may be decoded with treeobj_decodeb().
+ * The return value must be destroyed with free().
+ * Return buffer on success, NULL on failure with errno set.
+ */
+void *treeobj_encode_binary (const json_t *obj, size_t *len);
+
+/* Return true if 'buf' contains a binary encoded treeobj.
+ */
+bool treeobj_is_binary (const void *buf, size_t buflen);
+
 #endif /* !_FLUX_KVS_TREEOBJ_H */
 
 /*
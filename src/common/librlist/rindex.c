@@ -0,0 +1,249 @@
+/************************************************************\
+ * Copyright 2024 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+/* rindex.c - index rnodes by rank and available core count
+ *
+ * Nodes are found by rank through an array indexed by rank.  Each up
+ * node is also a member of exactly one bucket, an idset of ranks keyed
+ * by the node's available core count.  Since idsets iterate in rank order,
+ * the lowest ranked node with exactly k available cores is the first id
+ * in bucket k, and each fit policy reduces to a scan over buckets.
+ */
+
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdlib.h>
+#include <errno.h>
+
+#include "rnode.h"
+#include "rindex.h"
+
+#define RINDEX_DOWN (-1)
+
+struct rindex_entry {
+    struct rnode *n;
+    int bucket;                 // available cores, or RINDEX_DOWN
+};
+
+struct rindex {
+    struct rindex_entry *ranks; // indexed by rank, n=NULL if unused
+    size_t ranks_size;
+    size_t count;
+
+    struct idset **buckets;     // indexed by available cores
+    int nbuckets;
+};
+
+void rindex_destroy (struct rindex *ri)
+{
+    if (ri) {
+        int saved_errno = errno;
+        int i;
+        for (i = 0; i < ri->nbuckets; i++)
+            idset_destroy (ri->buckets[i]);
+        free (ri->buckets);
+        free (ri->ranks);
+        free (ri);
+        errno = saved_errno;
+    }
+}
+
+struct rindex *rindex_create (void)
+{
+    return calloc (1, sizeof (struct rindex));
+}
+
+size_t rindex_count (struct rindex *ri)
+{
+    return ri->count;
+}
+
+static int grow_ranks (struct rindex *ri, uint32_t rank)
+{
+    size_t size = ri->ranks_size ? ri->ranks_size : 64;
+    struct rindex_entry *ranks;
+
+    while (size <= rank)
+        size *= 2;
+    if (!(ranks = realloc (ri->ranks, size * sizeof (ranks[0]))))
+        return -1;
+    while (ri->ranks_size < size) {
+        ranks[ri->ranks_size].n = NULL;
+        ranks[ri->ranks_size].bucket = RINDEX_DOWN;
+        ri->ranks_size++;
+    }
+    ri->ranks = ranks;
+    return 0;
+}
+
+static int grow_buckets (struct rindex *ri, int bucket)
+{
+    int nbuckets = bucket + 1;
+    struct idset **buckets;
+
+    if (!(buckets = realloc (ri->buckets, nbuckets * sizeof (buckets[0]))))
+        return -1;
+    while (ri->nbuckets < nbuckets)
+        buckets[ri->nbuckets++] = NULL;
+    ri->buckets = buckets;
+    return 0;
+}
+
+static int bucket_add (struct rindex *ri, int bucket, uint32_t rank)
+{
+    if (bucket >= ri->nbuckets && grow_buckets (ri, bucket) < 0)
+        return -1;
+    if (!ri->buckets[bucket]
+        && !(ri->buckets[bucket] = idset_create (0, IDSET_FLAG_AUTOGROW)))
+        return -1;
+    return idset_set (ri->buckets[bucket], rank);
+}
+
+static void bucket_remove (struct rindex *ri, int bucket, uint32_t rank)
+{
+    if (bucket != RINDEX_DOWN && bucket < ri->nbuckets && ri->buckets[bucket])
+        (void)idset_clear (ri->buckets[bucket], rank);
+}
+
+static int node_bucket (const struct rnode *n)
+{
+    return n->up ? (int)rnode_avail (n) : RINDEX_DOWN;
+}
+
+int rindex_insert (struct rindex *ri, struct rnode *n)
+{
+    int bucket;
+
+    if (!ri || !n) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (n->rank >= ri->ranks_size && grow_ranks (ri, n->rank) < 0)
+        return -1;
+    if (ri->ranks[n->rank].n) {
+        errno = EEXIST;
+        return -1;
+    }
+    bucket = node_bucket (n);
+    if (bucket != RINDEX_DOWN && bucket_add (ri, bucket, n->rank) < 0)
+        return -1;
+    ri->ranks[n->rank].n = n;
+    ri->ranks[n->rank].bucket = bucket;
+    ri->count++;
+    return 0;
+}
+
+int rindex_update (struct rindex *ri, struct rnode *n)
+{
+    struct rindex_entry *entry;
+    int bucket;
+
+    if (!ri || !n) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (n->rank >= ri->ranks_size || ri->ranks[n->rank].n != n) {
+        errno = ENOENT;
+        return -1;
+    }
+    entry = &ri->ranks[n->rank];
+    if ((bucket = node_bucket (n)) == entry->bucket)
+        return 0;
+    if (bucket != RINDEX_DOWN && bucket_add (ri, bucket, n->rank) < 0)
+        return -1;
+    bucket_remove (ri, entry->bucket, n->rank);
+    entry->bucket = bucket;
+    return 0;
+}
+
+struct rnode *rindex_lookup (struct rindex *ri, uint32_t rank)
+{
+    if (!ri || rank >= ri->ranks_size || !ri->ranks[rank].n) {
+        errno = ENOENT;
+        return NULL;
+    }
+    return ri->ranks[rank].n;
+}
+
+/*  Return lowest rank in bucket, or IDSET_INVALID_ID if empty.
+ */
+static unsigned int bucket_first (struct rindex *ri, int bucket)
+{
+    if (!ri->buckets[bucket])
+        return IDSET_INVALID_ID;
+    return idset_first (ri->buckets[bucket]);
+}
+
+struct rnode *rindex_first_fit (struct rindex *ri, int min)
+{
+    unsigned int best = IDSET_INVALID_ID;
+    int i;
+
+    for (i = min > 0 ? min : 0; i < ri->nbuckets; i++) {
+        unsigned int rank = bucket_first (ri, i);
+        if (rank != IDSET_INVALID_ID
+            && (best == IDSET_INVALID_ID || rank < best))
+            best = rank;
+    }
+    if (best == IDSET_INVALID_ID)
+        return NULL;
+    return ri->ranks[best].n;
+}
+
+struct rnode *rindex_best_fit (struct rindex *ri, int min)
+{
+    int i;
+
+    for (i = min > 0 ? min : 0; i < ri->nbuckets; i++) {
+        unsigned int rank = bucket_first (ri, i);
+        if (rank != IDSET_INVALID_ID)
+            return ri->ranks[rank].n;
+    }
+    return NULL;
+}
+
+struct rnode *rindex_worst_fit (struct rindex *ri, int min)
+{
+    int i;
+
+    for (i = ri->nbuckets - 1; i >= 0 && i >= min; i--) {
+        unsigned int rank = bucket_first (ri, i);
+        if (rank != IDSET_INVALID_ID)
+            return ri->ranks[rank].n;
+    }
+    return NULL;
+}
+
+int rindex_worst_fit_list (struct rindex *ri, int count, zlistx_t *l)
+{
+    int i;
+
+    for (i = ri->nbuckets - 1; i >= 0 && count > 0; i--) {
+        unsigned int rank = bucket_first (ri, i);
+        while (rank != IDSET_INVALID_ID && count > 0) {
+            if (!zlistx_add_end (l, ri->ranks[rank].n)) {
+                errno = ENOMEM;
+                return -1;
+            }
+            count--;
+            rank = idset_next (ri->buckets[i], rank);
+        }
+    }
+    if (count > 0) {
+        errno = ENOSPC;
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */
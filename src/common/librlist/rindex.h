@@ -0,0 +1,66 @@
+/************************************************************\
+ * Copyright 2024 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+#ifndef HAVE_SCHED_RINDEX_H
+#define HAVE_SCHED_RINDEX_H 1
+
+#include "src/common/libczmqcontainers/czmq_containers.h"
+
+#include "rnode.h"
+
+/*  An rindex indexes a set of rnodes by rank, and the nodes that are up
+ *   by their number of available cores, so that allocation can select
+ *   the next node for a given fit policy without sorting the node list.
+ *
+ *  The index does not own the rnodes.  rindex_update() must be called
+ *   after the availability or up/down state of an indexed node changes.
+ */
+struct rindex;
+
+struct rindex *rindex_create (void);
+void rindex_destroy (struct rindex *ri);
+
+/*  Add rnode 'n' to the index.  Fails with EEXIST if n->rank is already
+ *   indexed.
+ */
+int rindex_insert (struct rindex *ri, struct rnode *n);
+
+/*  Update index after available cores or up state of 'n' changed.
+ */
+int rindex_update (struct rindex *ri, struct rnode *n);
+
+/*  Return number of nodes in the index.
+ */
+size_t rindex_count (struct rindex *ri);
+
+/*  Return the node with rank 'rank', or NULL with errno set to ENOENT.
+ */
+struct rnode *rindex_lookup (struct rindex *ri, uint32_t rank);
+
+/*  Return the up node with at least 'min' available cores that sorts first
+ *   in order of:
+ *    first-fit: rank
+ *    best-fit:  fewest available cores, then rank
+ *    worst-fit: most available cores, then rank
+ *   or NULL if there is no such node.  Cost is proportional to the number
+ *   of distinct available core counts, plus O(log n).
+ */
+typedef struct rnode * (*rindex_fit_f) (struct rindex *ri, int min);
+
+struct rnode *rindex_first_fit (struct rindex *ri, int min);
+struct rnode *rindex_best_fit (struct rindex *ri, int min);
+struct rnode *rindex_worst_fit (struct rindex *ri, int min);
+
+/*  Append the first 'count' up nodes in worst-fit order to list 'l'.
+ *   Fails with ENOSPC if fewer than 'count' nodes are up.
+ */
+int rindex_worst_fit_list (struct rindex *ri, int count, zlistx_t *l);
+
+#endif /* !HAVE_SCHED_RINDEX_H */
@@ -26,6 +26,7 @@
 
 #include "rnode.h"
 #include "match.h"
+#include "rindex.h"
 #include "rlist.h"
 #include "rhwloc.h"
 
@@ -62,6 +63,7 @@ void rlist_destroy (struct rlist *rl)
         int saved_errno = errno;
         zlistx_destroy (&rl->nodes);
         zhashx_destroy (&rl->noremap);
+        rindex_destroy (rl->index);
         json_decref (rl->scheduling);
         free (rl);
         errno = saved_errno;
@@ -130,6 +132,56 @@ static struct rnode *rlist_find_rank (const struct rlist *rl, uint32_t rank)
     return NULL;
 }
 
+/*  Discard the allocation index after a change to the set of nodes
+ *   or their ranks.  It will be rebuilt on next use.
+ */
+static void rlist_index_invalidate (struct rlist *rl)
+{
+    rindex_destroy (rl->index);
+    rl->index = NULL;
+}
+
+static struct rindex *rlist_index (struct rlist *rl)
+{
+    struct rnode *n;
+
+    if (rl->index && rindex_count (rl->index) == zlistx_size (rl->nodes))
+        return rl->index;
+    rlist_index_invalidate (rl);
+    if (!(rl->index = rindex_create ()))
+        return NULL;
+    n = zlistx_first (rl->nodes);
+    while (n) {
+        if (rindex_insert (rl->index, n) < 0) {
+            rlist_index_invalidate (rl);
+            return NULL;
+        }
+        n = zlistx_next (rl->nodes);
+    }
+    return rl->index;
+}
+
+/*  Update the allocation index, if any, after a change in the
+ *   available cores or up state of 'n'.
+ */
+static void rlist_index_update (struct rlist *rl, struct rnode *n)
+{
+    if (rl->index && rindex_update (rl->index, n) < 0)
+        rlist_index_invalidate (rl);
+}
+
+/*  Find rank using the allocation index.  Unlike rlist_find_rank(), this
+ *   does not set the rl->nodes cursor.
+ */
+static struct rnode *rlist_lookup_rank (struct rlist *rl, uint32_t rank)
+{
+    struct rindex *ri;
+
+    if (!(ri = rlist_index (rl)))
+        return rlist_find_rank (rl, rank);
+    return rindex_lookup (ri, rank);
+}
+
 static void rlist_update_totals (struct rlist *rl, struct rnode *n)
 {
     rl->total += rnode_count (n);
@@ -141,6 +193,7 @@ static int rlist_add_rnode_new (struct rlist *rl, struct rnode *n)
 {
     if (!zlistx_add_end (rl->nodes, n))
         return -1;
+    rlist_index_invalidate (rl);
     rlist_update_totals (rl, n);
     return 0;
 }
@@ -155,6 +208,7 @@ static int rlist_add_rnode (struct rlist *rl, struct rnode *n)
     if (found) {
         if (rnode_add (found, n) < 0)
             return -1;
+        rlist_index_update (rl, found);
         rlist_update_totals (rl, n);
         rnode_destroy (n);
     }
@@ -348,6 +402,7 @@ int rlist_remove_ranks (struct rlist *rl, struct idset *ranks)
         }
         i = idset_next (ranks, i);
     }
+    rlist_index_invalidate (rl);
     return count;
 }
 
@@ -360,6 +415,7 @@ int rlist_remap (struct rlist *rl)
      */
     zlistx_set_comparator (rl->nodes, by_rank);
     zlistx_sort (rl->nodes);
+    rlist_index_invalidate (rl);
 
     n = zlistx_first (rl->nodes);
     while (n) {
@@ -389,6 +445,8 @@ static int rlist_rerank_hostlist (struct rlist *rl,
 {
     uint32_t rank = 0;
     const char *host = hostlist_first (hl);
+
+    rlist_index_invalidate (rl);
     while (host) {
         struct rnode *n = rlist_find_host (rl, host);
         if (!n) {
@@ -451,8 +509,10 @@ done:
 static struct rnode *rlist_detach_rank (struct rlist *rl, uint32_t rank)
 {
     struct rnode *n = rlist_find_rank (rl, rank);
-    if (n)
+    if (n) {
         zlistx_detach_cur (rl->nodes);
+        rlist_index_invalidate (rl);
+    }
     return n;
 }
 
@@ -814,6 +874,7 @@ int rlist_rank_add_child (struct rlist *rl,
     }
     if (rnode_add_child (n, name, ids) == NULL)
         return -1;
+    rlist_index_update (rl, n);
     return 0;
 }
 
@@ -1672,16 +1733,6 @@ static int by_rank (const void *item1, const void *item2)
     return (x->rank - y->rank);
 }
 
-static int by_avail (const void *item1, const void *item2)
-{
-    int n;
-    const struct rnode *x = item1;
-    const struct rnode *y = item2;
-    if ((n = rnode_avail (x) - rnode_avail (y)) == 0)
-        n = by_rank (x, y);
-    return n;
-}
-
 static int by_used (const void *item1, const void *item2)
 {
     int n;
@@ -1700,63 +1751,46 @@ static int rlist_rnode_alloc (struct rlist *rl, struct rnode *n,
     if (!n || rnode_alloc (n, count, idsetp) < 0)
         return -1;
     rl->avail -= idset_count (*idsetp);
+    rlist_index_update (rl, n);
     return 0;
 }
 
-#if 0
-static uint32_t rlist_rnode_rank (struct rlist *rl)
-{
-    struct rnode *n = zlistx_item (rl->nodes);
-    if (n)
-        return n->rank;
-    else
-        return (uint32_t)-1;
-}
-#endif
-
-static struct rnode *rlist_first (struct rlist *rl)
-{
-    return zlistx_first (rl->nodes);
-}
-
-static struct rnode *rlist_next (struct rlist *rl)
-{
-    return zlistx_next (rl->nodes);
-}
-
 /*
- *  Allocate the first available N slots of size cores_per_slot from
- *   resource list rl after sorting the nodes with the current sort strategy.
+ *  Allocate N slots of size cores_per_slot from resource list rl,
+ *   filling each node chosen by the 'fit' policy before choosing the next.
+ *   Since nodes are only left once they cannot fit another slot, the
+ *   remaining candidates keep their original relative order, and the
+ *   result is the same as walking the node list sorted by the policy.
  */
-static struct rlist * rlist_alloc_first_fit (struct rlist *rl,
-                                             int cores_per_slot,
-                                             int slots)
+static struct rlist * rlist_alloc_fit (struct rlist *rl,
+                                       rindex_fit_f fit,
+                                       int cores_per_slot,
+                                       int slots)
 {
     int rc;
     struct idset *ids = NULL;
     struct rnode *n = NULL;
+    struct rindex *ri;
     struct rlist *result = NULL;
 
-    zlistx_sort (rl->nodes);
-
-    if (!(n = rlist_first (rl)))
+    if (!(ri = rlist_index (rl)))
         return NULL;
 
     if (!(result = rlist_create ()))
         return NULL;
 
-    /* 2. assign slots to first nodes where they fit
+    /*  Assign slots to first nodes where they fit
      */
-    while (n && slots) {
-        /*  Try to allocate a slot on this node. If we fail with ENOSPC,
-         *   then advance to the next node and try again.
+    while (slots) {
+        /*  Advance to the next node that fits a slot if the current
+         *   node is full.
          */
-        if ((rc = rlist_rnode_alloc (rl, n, cores_per_slot, &ids)) < 0) {
-            if (errno != ENOSPC)
+        if (!n || rnode_avail (n) < cores_per_slot) {
+            if (!(n = fit (ri, cores_per_slot)))
                 goto unwind;
-            n = rlist_next (rl);
-            continue;
         }
+        if ((rc = rlist_rnode_alloc (rl, n, cores_per_slot, &ids)) < 0)
+            goto unwind;
         /*  Append the allocated cores to the result set and continue
          *   if needed
          */
@@ -1776,56 +1810,55 @@ unwind:
     return result;
 }
 
+/*
+ *  Allocate the first available N slots of size cores_per_slot from
+ *   resource list rl in rank order.
+ */
+static struct rlist * rlist_alloc_first_fit (struct rlist *rl,
+                                             int cores_per_slot,
+                                             int slots)
+{
+    return rlist_alloc_fit (rl, rindex_first_fit, cores_per_slot, slots);
+}
+
 /*
  *  Allocate `slots` of size cores_per_slot from rlist `rl` and return
- *   the result. Sorts the node list by smallest available first, so that
+ *   the result. Uses nodes with smallest available first, so that
  *   we get something like "best fit". (minimize nodes used)
  */
 static struct rlist * rlist_alloc_best_fit (struct rlist *rl,
                                             int cores_per_slot,
                                             int slots)
 {
-    zlistx_set_comparator (rl->nodes, by_avail);
-    return rlist_alloc_first_fit (rl, cores_per_slot, slots);
+    return rlist_alloc_fit (rl, rindex_best_fit, cores_per_slot, slots);
 }
 
 /*
  *  Allocate `slots` of size cores_per_slot from rlist `rl` and return
- *   the result. Sorts the node list by least utilized first, so that
+ *   the result. Uses least utilized nodes first, so that
  *   we get something like "worst fit". (Spread jobs across nodes)
  */
 static struct rlist * rlist_alloc_worst_fit (struct rlist *rl,
                                              int cores_per_slot,
                                              int slots)
 {
-    zlistx_set_comparator (rl->nodes, by_used);
-    return rlist_alloc_first_fit (rl, cores_per_slot, slots);
+    return rlist_alloc_fit (rl, rindex_worst_fit, cores_per_slot, slots);
 }
 
-
+/*  Return a list of the first `nnodes` up nodes, least utilized first.
+ */
 static zlistx_t *rlist_get_nnodes (struct rlist *rl, int nnodes)
 {
-    struct rnode *n;
-    zlistx_t *l = zlistx_new ();
-    if (!l)
+    struct rindex *ri;
+    zlistx_t *l;
+
+    if (!(ri = rlist_index (rl)) || !(l = zlistx_new ()))
+        return NULL;
+    if (rindex_worst_fit_list (ri, nnodes, l) < 0) {
+        zlistx_destroy (&l);
         return NULL;
-    n = zlistx_first (rl->nodes);
-    while (nnodes > 0) {
-        if (n == NULL) {
-            errno = ENOSPC;
-            goto err;
-        }
-        if (n->up) {
-            if (!zlistx_add_end (l, n))
-                goto err;
-            nnodes--;
-        }
-        n = zlistx_next (rl->nodes);
     }
     return (l);
-err:
-    zlistx_destroy (&l);
-    return NULL;
 }
 
 /*  Allocate 'slots' of size 'cores_per_slot' across exactly `nnodes`.
@@ -1851,22 +1884,16 @@ static struct rlist *rlist_alloc_nnodes (struct rlist *rl,
     if (!(result = rlist_create ()))
         return NULL;
 
-    /* 1. sort rank list by used cores ascending:
-     */
-    zlistx_set_comparator (rl->nodes, by_used);
-    zlistx_sort (rl->nodes);
-
     if (ai->exclusive) {
-        int nleft = ai->nnodes;
         struct rnode *cpy;
-        n = zlistx_first (rl->nodes);
-        while (n && nleft) {
-            /*
-             *  We can abort after we find the first non-idle or down node:
-             *
-             *  Note: by_used() sorts down nodes to back of list and
-             *   rnode_avail() returns 0 if node is not up
-             */
+
+        /*  Get the least utilized up nodes.  We can abort after we find
+         *   the first non-idle node, or if there are not enough up nodes.
+         */
+        if (!(cl = rlist_get_nnodes (rl, ai->nnodes)))
+            goto unwind;
+        n = zlistx_first (cl);
+        while (n) {
             if (rnode_avail (n) < rnode_count (n))
                 goto unwind;
 
@@ -1876,15 +1903,14 @@ static struct rlist *rlist_alloc_nnodes (struct rlist *rl,
                 goto unwind;
             }
             rnode_alloc_idset (n, n->cores->ids);
-            nleft--;
-            n = zlistx_next (rl->nodes);
+            rlist_index_update (rl, n);
+            n = zlistx_next (cl);
         }
-        if (nleft) /* Unable to allocate all nodes exclusively */
-            goto unwind;
+        zlistx_destroy (&cl);
         return result;
     }
 
-    /* 2. get a list of the first up n nodes
+    /* 1. get a list of the first up n nodes, least utilized first
      */
     if (!(cl = rlist_get_nnodes (rl, ai->nnodes)))
         goto unwind;
@@ -1895,7 +1921,7 @@ static struct rlist *rlist_alloc_nnodes (struct rlist *rl,
     zlistx_set_comparator (cl, by_used);
 
     /*
-     * 3. divide slots across all nodes, placing each slot
+     * 2. divide slots across all nodes, placing each slot
      *    on most empty node first
      */
     while (slots > 0) {
@@ -1946,9 +1972,6 @@ static struct rlist *rlist_try_alloc (struct rlist *rl,
         return NULL;
     }
 
-    /*  Reset default sort to order nodes by "rank" */
-    zlistx_set_comparator (rl->nodes, by_rank);
-
     if (ai->nnodes > 0)
         result = rlist_alloc_nnodes (rl, ai);
     else if (mode == NULL || strcmp (mode, "worst-fit") == 0)
@@ -2101,7 +2124,7 @@ struct rlist *rlist_alloc (struct rlist *rl,
 
 static int rlist_free_rnode (struct rlist *rl, struct rnode *n)
 {
-    struct rnode *rnode = rlist_find_rank (rl, n->rank);
+    struct rnode *rnode = rlist_lookup_rank (rl, n->rank);
     if (!rnode) {
         errno = ENOENT;
         return -1;
@@ -2110,12 +2133,13 @@ static int rlist_free_rnode (struct rlist *rl, struct rnode *n)
         return -1;
     if (rnode->up)
         rl->avail += idset_count (n->cores->ids);
+    rlist_index_update (rl, rnode);
     return 0;
 }
 
 static int rlist_alloc_rnode (struct rlist *rl, struct rnode *n)
 {
-    struct rnode *rnode = rlist_find_rank (rl, n->rank);
+    struct rnode *rnode = rlist_lookup_rank (rl, n->rank);
     if (!rnode) {
         errno = ENOENT;
         return -1;
@@ -2124,6 +2148,7 @@ static int rlist_alloc_rnode (struct rlist *rl, struct rnode *n)
         return -1;
     if (rnode->up)
         rl->avail -= idset_count (n->cores->avail);
+    rlist_index_update (rl, rnode);
     return 0;
 }
 
@@ -2210,6 +2235,7 @@ static int rlist_mark_all (struct rlist *rl, bool up)
         n->up = up;
         n = zlistx_next (rl->nodes);
     }
+    rlist_index_invalidate (rl);
     return count;
 }
 
@@ -2222,10 +2248,11 @@ static int rlist_mark_state (struct rlist *rl, bool up, const char *ids)
         return -1;
     i = idset_first (idset);
     while (i != IDSET_INVALID_ID) {
-        struct rnode *n = rlist_find_rank (rl, i);
+        struct rnode *n = rlist_lookup_rank (rl, i);
         if (n->up != up)
             count += idset_count (n->cores->avail);
         n->up = up;
+        rlist_index_update (rl, n);
         i = idset_next (idset, i);
     }
     idset_destroy (idset);
@@ -34,6 +34,12 @@ struct rlist {
     /*  Hash of property->idset mapping */
     zhashx_t *properties;
 
+    /*  Index of nodes by rank and available cores, built on demand
+     *   for allocation.  Discarded when nodes are added, removed, or
+     *   reranked.
+     */
+    struct rindex *index;
+
     /*  Rv1 optional starttime, expiration:
      */
     double starttime;
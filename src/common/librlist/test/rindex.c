@@ -0,0 +1,165 @@
+/************************************************************\
+ * Copyright 2024 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+#include <errno.h>
+
+#include "src/common/libtap/tap.h"
+#include "rnode.h"
+#include "rindex.h"
+
+#define NNODES 5
+
+/*  Create nodes with ranks 0-4 and 4 cores each, then allocate so that
+ *   available cores by rank are: 4 1 3 1 2
+ */
+static void nodes_create (struct rnode **nodes)
+{
+    int avail[NNODES] = { 4, 1, 3, 1, 2 };
+    int i;
+
+    for (i = 0; i < NNODES; i++) {
+        struct idset *ids = NULL;
+        if (!(nodes[i] = rnode_create ("foo", i, "0-3")))
+            BAIL_OUT ("rnode_create failed");
+        if (avail[i] < 4
+            && rnode_alloc (nodes[i], 4 - avail[i], &ids) < 0)
+            BAIL_OUT ("rnode_alloc failed");
+        idset_destroy (ids);
+    }
+}
+
+static void nodes_destroy (struct rnode **nodes)
+{
+    int i;
+    for (i = 0; i < NNODES; i++)
+        rnode_destroy (nodes[i]);
+}
+
+static int rank_of (struct rnode *n)
+{
+    return n ? (int)n->rank : -1;
+}
+
+static void test_fit (void)
+{
+    struct rnode *nodes[NNODES];
+    struct rindex *ri;
+    struct idset *ids = NULL;
+    int i;
+
+    nodes_create (nodes);
+    if (!(ri = rindex_create ()))
+        BAIL_OUT ("rindex_create failed");
+    for (i = 0; i < NNODES; i++) {
+        if (rindex_insert (ri, nodes[i]) < 0)
+            BAIL_OUT ("rindex_insert failed");
+    }
+    ok (rindex_count (ri) == NNODES,
+        "rindex_count returns %d", NNODES);
+    ok (rindex_insert (ri, nodes[0]) < 0 && errno == EEXIST,
+        "rindex_insert of duplicate rank fails with EEXIST");
+    ok (rindex_lookup (ri, 3) == nodes[3],
+        "rindex_lookup finds rank 3");
+    ok (rindex_lookup (ri, 42) == NULL && errno == ENOENT,
+        "rindex_lookup of unknown rank fails with ENOENT");
+
+    ok (rank_of (rindex_first_fit (ri, 1)) == 0,
+        "first-fit min=1 selects rank 0");
+    ok (rank_of (rindex_first_fit (ri, 2)) == 0,
+        "first-fit min=2 selects rank 0");
+    ok (rank_of (rindex_best_fit (ri, 1)) == 1,
+        "best-fit min=1 selects rank 1");
+    ok (rank_of (rindex_best_fit (ri, 2)) == 4,
+        "best-fit min=2 selects rank 4");
+    ok (rank_of (rindex_worst_fit (ri, 1)) == 0,
+        "worst-fit min=1 selects rank 0");
+    ok (rindex_worst_fit (ri, 5) == NULL
+        && rindex_best_fit (ri, 5) == NULL
+        && rindex_first_fit (ri, 5) == NULL,
+        "no node fits min=5");
+
+    /*  Allocate all of rank 0, then mark rank 2 down
+     */
+    if (rnode_alloc (nodes[0], 4, &ids) < 0)
+        BAIL_OUT ("rnode_alloc failed");
+    ok (rindex_update (ri, nodes[0]) == 0,
+        "rindex_update works after rnode_alloc");
+    nodes[2]->up = false;
+    ok (rindex_update (ri, nodes[2]) == 0,
+        "rindex_update works after node marked down");
+    ok (rank_of (rindex_first_fit (ri, 1)) == 1,
+        "first-fit min=1 now selects rank 1");
+    ok (rank_of (rindex_worst_fit (ri, 1)) == 4,
+        "worst-fit min=1 now selects rank 4");
+    ok (rindex_first_fit (ri, 3) == NULL,
+        "no node fits min=3");
+
+    /*  Free rank 0 again
+     */
+    ok (rnode_free_idset (nodes[0], ids) == 0
+        && rindex_update (ri, nodes[0]) == 0,
+        "rindex_update works after rnode_free_idset");
+    ok (rank_of (rindex_worst_fit (ri, 1)) == 0,
+        "worst-fit min=1 selects rank 0 again");
+    idset_destroy (ids);
+
+    rindex_destroy (ri);
+    nodes_destroy (nodes);
+}
+
+static void test_worst_fit_list (void)
+{
+    struct rnode *nodes[NNODES];
+    struct rindex *ri;
+    zlistx_t *l;
+    struct rnode *n;
+    int expected[] = { 0, 2, 4, 1 };
+    int i;
+
+    nodes_create (nodes);
+    nodes[3]->up = false;
+    if (!(ri = rindex_create ()) || !(l = zlistx_new ()))
+        BAIL_OUT ("rindex_create/zlistx_new failed");
+    for (i = 0; i < NNODES; i++) {
+        if (rindex_insert (ri, nodes[i]) < 0)
+            BAIL_OUT ("rindex_insert failed");
+    }
+    ok (rindex_worst_fit_list (ri, 4, l) == 0 && zlistx_size (l) == 4,
+        "rindex_worst_fit_list returns 4 up nodes");
+    i = 0;
+    n = zlistx_first (l);
+    while (n) {
+        if (rank_of (n) != expected[i])
+            break;
+        i++;
+        n = zlistx_next (l);
+    }
+    ok (i == 4,
+        "nodes are ordered by most available cores, then rank");
+    zlistx_purge (l);
+    ok (rindex_worst_fit_list (ri, 5, l) < 0 && errno == ENOSPC,
+        "rindex_worst_fit_list fails with ENOSPC if too few nodes are up");
+
+    zlistx_destroy (&l);
+    rindex_destroy (ri);
+    nodes_destroy (nodes);
+}
+
+int main (int ac, char *av[])
+{
+    plan (NO_PLAN);
+    test_fit ();
+    test_worst_fit_list ();
+    done_testing ();
+}
+
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */
@@ -19,6 +19,7 @@
 
 #include "router.h"
 #include "subhash.h"
+#include "subtrie.h"
 #include "servhash.h"
 #include "disconnect.h"
 
@@ -36,6 +37,7 @@ struct router {
     zhashx_t *routes;               // uuid => 'struct router_entry'
     void *arg;
     struct subhash *subscriptions;  // router's subscriber hash
+    struct subtrie *subscribers;    // topic => subscribed router entries
     struct servhash *services;
     flux_msg_handler_t **handlers;
     bool mute;
@@ -227,12 +229,21 @@ static int broker_unsubscribe (const char *topic, void *arg)
 
 /* A client asks the router to subscribe.
  * This might generate a broker_subscribe() or just usecount++.
+ * The client's subhash calls this only for its first subscription to
+ * 'topic', so the entry is added to rtr->subscribers once per topic.
  */
 static int router_subscribe (const char *topic, void *arg)
 {
-    struct router *rtr = arg;
+    struct router_entry *entry = arg;
+    struct router *rtr = entry->rtr;
 
-    return subhash_subscribe (rtr->subscriptions, topic);
+    if (subhash_subscribe (rtr->subscriptions, topic) < 0)
+        return -1;
+    if (subtrie_insert (rtr->subscribers, topic, entry) < 0) {
+        ERRNO_SAFE_WRAP (subhash_unsubscribe, rtr->subscriptions, topic);
+        return -1;
+    }
+    return 0;
 }
 
 /* A client asks the router to unsubscribe.
@@ -240,9 +251,13 @@ static int router_subscribe (const char *topic, void *arg)
  */
 static int router_unsubscribe (const char *topic, void *arg)
 {
-    struct router *rtr = arg;
+    struct router_entry *entry = arg;
+    struct router *rtr = entry->rtr;
 
-    return subhash_unsubscribe (rtr->subscriptions, topic);
+    if (subhash_unsubscribe (rtr->subscriptions, topic) < 0)
+        return -1;
+    (void)subtrie_remove (rtr->subscribers, topic, entry);
+    return 0;
 }
 
 static void disconnect_cb (const flux_msg_t *msg, void *arg)
@@ -318,8 +333,8 @@ struct router_entry *router_entry_add (struct router *rtr,
     if (!(entry = router_entry_create (uuid, cb, arg)))
         return NULL;
 
-    subhash_set_subscribe (entry->subscriptions, router_subscribe, rtr);
-    subhash_set_unsubscribe (entry->subscriptions, router_unsubscribe, rtr);
+    subhash_set_subscribe (entry->subscriptions, router_subscribe, entry);
+    subhash_set_unsubscribe (entry->subscriptions, router_unsubscribe, entry);
 
     if (zhashx_insert (rtr->routes, uuid, entry) < 0) {
         router_entry_destroy (entry);
@@ -397,6 +412,20 @@ error:
     return;
 }
 
+/* subtrie_match_f footprint */
+static int event_send (void *item, void *arg)
+{
+    struct router_entry *entry = item;
+    const flux_msg_t *msg = arg;
+
+    if (entry->send (msg, entry->arg) < 0) {
+        flux_log_error (entry->rtr->h,
+                        "router: event > client=%.5s",
+                        entry->uuid);
+    }
+    return 0;
+}
+
 /* Receive event from broker.
  * Distribute to all router entries with matching subscriptions.
  */
@@ -406,22 +435,13 @@ static void event_cb (flux_t *h,
                       void *arg)
 {
     struct router *rtr = arg;
-    struct router_entry *entry;
     const char *topic;
 
     if (flux_msg_get_topic (msg, &topic) < 0) {
         flux_log_error (h, "router: event > client");
         return;
     }
-
-    entry = zhashx_first (rtr->routes);
-    while ((entry)) {
-        if (subhash_topic_match (entry->subscriptions, topic)) {
-            if (entry->send (msg, entry->arg) < 0)
-                flux_log_error (h, "router: event > client=%.5s", entry->uuid);
-        }
-        entry = zhashx_next (rtr->routes);
-    }
+    (void)subtrie_match (rtr->subscribers, topic, event_send, (void *)msg);
 }
 
 static const struct flux_msg_handler_spec htab[] = {
@@ -451,6 +471,8 @@ struct router *router_create (flux_t *h)
         goto error;
     subhash_set_subscribe (rtr->subscriptions, broker_subscribe, rtr);
     subhash_set_unsubscribe (rtr->subscriptions, broker_unsubscribe, rtr);
+    if (!(rtr->subscribers = subtrie_create ()))
+        goto error;
 
     if (!(rtr->services = servhash_create (h)))
         goto error;
@@ -468,9 +490,13 @@ void router_destroy (struct router *rtr)
 {
     if (rtr) {
         flux_msg_handler_delvec (rtr->handlers);
+        /* Destroy entries first, since they unsubscribe from
+         * rtr->subscriptions and rtr->subscribers as they go.
+         */
+        ERRNO_SAFE_WRAP (zhashx_destroy, &rtr->routes);
         subhash_destroy (rtr->subscriptions);
+        subtrie_destroy (rtr->subscribers);
         servhash_destroy (rtr->services);
-        ERRNO_SAFE_WRAP (zhashx_destroy, &rtr->routes);
         ERRNO_SAFE_WRAP (free, rtr);
     }
 }
@@ -39,6 +39,13 @@
  *   is assembled, then it is freed.  The static buffer is sized somewhat
  *   arbitrarily at 4K.
  *
+ * - msgbuf_read() and msgbuf_write() use the same encoding, but move a
+ *   byte stream that may contain many messages with each system call.
+ *   A reader drains all complete messages from the buffer after one read,
+ *   and a writer encodes several queued messages before one write.
+ *   The buffer is sized to MSGBUF_SIZE, and is grown temporarily to
+ *   hold a message that does not fit.
+ *
  * - sendfd/recvfd do not encrypt messages, therefore this transport
  *   is only appropriate for use on AF_LOCAL sockets or on file descriptors
  *   tunneled through a secure channel.
@@ -49,12 +56,16 @@
 #endif
 #include <arpa/inet.h>
 #include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
 #include <flux/core.h>
 
 #include "sendfd.h"
 
 #define IOBUF_MAGIC 0xffee0012
 
+#define MSGBUF_SIZE 65536
+
 void iobuf_init (struct iobuf *iobuf)
 {
     memset (iobuf, 0, sizeof (*iobuf));
@@ -178,6 +189,178 @@ done:
     return msg;
 }
 
+void msgbuf_init (struct msgbuf *mb)
+{
+    memset (mb, 0, sizeof (*mb));
+}
+
+void msgbuf_clean (struct msgbuf *mb)
+{
+    free (mb->buf);
+    memset (mb, 0, sizeof (*mb));
+}
+
+size_t msgbuf_used (struct msgbuf *mb)
+{
+    return mb->tail - mb->head;
+}
+
+/* Called when msgbuf becomes empty.  Rewind it, and release memory that
+ * was grown to hold a large message.
+ */
+static void msgbuf_reset (struct msgbuf *mb)
+{
+    mb->head = mb->tail = 0;
+    if (mb->size > MSGBUF_SIZE) {
+        free (mb->buf);
+        mb->buf = NULL;
+        mb->size = 0;
+    }
+}
+
+/* Ensure there is room for 'len' more bytes at the tail.
+ */
+static int msgbuf_reserve (struct msgbuf *mb, size_t len)
+{
+    if (mb->size - mb->tail >= len)
+        return 0;
+    if (mb->head > 0) {
+        memmove (mb->buf, mb->buf + mb->head, mb->tail - mb->head);
+        mb->tail -= mb->head;
+        mb->head = 0;
+        if (mb->size - mb->tail >= len)
+            return 0;
+    }
+    size_t size = mb->size > 0 ? mb->size : MSGBUF_SIZE;
+    uint8_t *buf;
+
+    while (size - mb->tail < len)
+        size *= 2;
+    if (!(buf = realloc (mb->buf, size)))
+        return -1;
+    mb->buf = buf;
+    mb->size = size;
+    return 0;
+}
+
+int msgbuf_encode (struct msgbuf *mb, const flux_msg_t *msg)
+{
+    uint32_t hdr[2];
+    ssize_t s;
+    uint8_t *p;
+
+    if (!mb || !msg) {
+        errno = EINVAL;
+        return -1;
+    }
+    if ((s = flux_msg_encode_size (msg)) < 0
+        || msgbuf_reserve (mb, s + 8) < 0)
+        return -1;
+    /* Messages are packed back to back, so the header may be unaligned.
+     */
+    p = mb->buf + mb->tail;
+    hdr[0] = IOBUF_MAGIC;
+    hdr[1] = htonl (s);
+    memcpy (p, hdr, 8);
+    if (flux_msg_encode (msg, &p[8], s) < 0)
+        return -1;
+    mb->tail += s + 8;
+    return 0;
+}
+
+int msgbuf_write (int fd, struct msgbuf *mb)
+{
+    ssize_t n;
+
+    if (fd < 0 || !mb) {
+        errno = EINVAL;
+        return -1;
+    }
+    while (mb->head < mb->tail) {
+        if ((n = write (fd, mb->buf + mb->head, mb->tail - mb->head)) < 0)
+            return -1;
+        mb->head += n;
+    }
+    msgbuf_reset (mb);
+    return 0;
+}
+
+/* Return the encoded size of the first buffered message, or 0 if its
+ * header is incomplete or corrupt.
+ */
+static size_t msgbuf_frame_size (struct msgbuf *mb)
+{
+    uint32_t hdr[2];
+
+    if (mb->tail - mb->head < 8)
+        return 0;
+    memcpy (hdr, mb->buf + mb->head, 8);
+    if (hdr[0] != IOBUF_MAGIC)
+        return 0;
+    return ntohl (hdr[1]) + 8;
+}
+
+int msgbuf_read (int fd, struct msgbuf *mb)
+{
+    size_t need = 8;
+    size_t frame;
+    ssize_t n;
+
+    if (fd < 0 || !mb) {
+        errno = EINVAL;
+        return -1;
+    }
+    if ((frame = msgbuf_frame_size (mb)) > 0)
+        need = frame;
+    if (msgbuf_reserve (mb, need > msgbuf_used (mb)
+                            ? need - msgbuf_used (mb) : 1) < 0)
+        return -1;
+    if ((n = read (fd, mb->buf + mb->tail, mb->size - mb->tail)) < 0)
+        return -1;
+    if (n == 0) {
+        errno = ECONNRESET;
+        return -1;
+    }
+    mb->tail += n;
+    return 0;
+}
+
+bool msgbuf_has_msg (struct msgbuf *mb)
+{
+    size_t frame;
+
+    if (msgbuf_used (mb) < 8)
+        return false;
+    if ((frame = msgbuf_frame_size (mb)) == 0) // bad magic
+        return true;
+    return msgbuf_used (mb) >= frame;
+}
+
+flux_msg_t *msgbuf_decode (struct msgbuf *mb)
+{
+    flux_msg_t *msg;
+    size_t frame;
+
+    if (!mb) {
+        errno = EINVAL;
+        return NULL;
+    }
+    if (!msgbuf_has_msg (mb)) {
+        errno = EAGAIN;
+        return NULL;
+    }
+    if ((frame = msgbuf_frame_size (mb)) == 0) {
+        errno = EPROTO;
+        return NULL;
+    }
+    if (!(msg = flux_msg_decode (mb->buf + mb->head + 8, frame - 8)))
+        return NULL;
+    mb->head += frame;
+    if (mb->head == mb->tail)
+        msgbuf_reset (mb);
+    return msg;
+}
+
 /*
  * vi:tabstop=4 shiftwidth=4 expandtab
  */
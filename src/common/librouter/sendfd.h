@@ -11,6 +11,7 @@
 #ifndef _ROUTER_SENDFD_H
 #define _ROUTER_SENDFD_H
 
+#include <stdbool.h>
 #include <flux/core.h>
 
 struct iobuf {
@@ -41,6 +42,57 @@ void iobuf_init (struct iobuf *iobuf);
  */
 void iobuf_clean (struct iobuf *iobuf);
 
+/* A msgbuf holds a byte stream of messages in the sendfd() encoding,
+ * so that many messages can be moved with one read(2) or write(2).
+ * Bytes are appended at 'tail' and consumed from 'head'.
+ */
+struct msgbuf {
+    uint8_t *buf;
+    size_t size;
+    size_t head;
+    size_t tail;
+};
+
+/* Initialize msgbuf members.
+ */
+void msgbuf_init (struct msgbuf *mb);
+
+/* Free any internal memory allocated to msgbuf.
+ */
+void msgbuf_clean (struct msgbuf *mb);
+
+/* Return the number of buffered bytes.
+ */
+size_t msgbuf_used (struct msgbuf *mb);
+
+/* Append encoded message to msgbuf.
+ * Returns 0 on success, -1 on failure with errno set.
+ */
+int msgbuf_encode (struct msgbuf *mb, const flux_msg_t *msg);
+
+/* Write as much of msgbuf as possible to file descriptor.
+ * Returns 0 once msgbuf is empty, -1 on failure with errno set.
+ * EAGAIN/EWOULDBLOCK indicates that the remainder is still buffered.
+ */
+int msgbuf_write (int fd, struct msgbuf *mb);
+
+/* Perform one read(2) from file descriptor into msgbuf, ensuring that there
+ * is room for at least the rest of the partially buffered message.
+ * Returns 0 on success, -1 on failure with errno set (ECONNRESET on EOF).
+ */
+int msgbuf_read (int fd, struct msgbuf *mb);
+
+/* Return true if a complete message (or a corrupt header) is buffered,
+ * i.e. msgbuf_decode() will not fail with EAGAIN.
+ */
+bool msgbuf_has_msg (struct msgbuf *mb);
+
+/* Remove the first message from msgbuf and decode it.
+ * Returns message on success, NULL on failure with errno set
+ * (EAGAIN if a complete message is not yet buffered).
+ */
+flux_msg_t *msgbuf_decode (struct msgbuf *mb);
+
 #endif /* !_ROUTER_SENDFD_H */
 
 /*
@@ -0,0 +1,285 @@
+/************************************************************\
+ * Copyright 2024 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+/* subtrie.c - event subscription topic trie
+ *
+ * Each node represents one character of a subscription topic, with the
+ * root representing the empty topic (which matches everything).  A node
+ * has a hash of subscribers (item => refcount) if any subscription ends
+ * there.  Children are kept in a sibling list, since topics are drawn
+ * from a small alphabet and few topics share a node.
+ *
+ * To match an event topic, walk its characters down from the root.  Every
+ * node passed that has subscribers holds a matching subscription.  When
+ * only one such node is found (the usual case), its subscribers are
+ * visited directly.  O/w, an item subscribed to more than one matching
+ * prefix (e.g. "job-" and "job-state") is visited only once.
+ */
+
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+#include <flux/core.h>
+
+#include "src/common/libutil/errno_safe.h"
+#include "src/common/libczmqcontainers/czmq_containers.h"
+
+#include "subtrie.h"
+
+struct subtrie_node {
+    char c;
+    struct subtrie_node *parent;
+    struct subtrie_node *child;     // first child
+    struct subtrie_node *sibling;   // next sibling
+    zhashx_t *subs;                 // item => refcount (NULL if none)
+};
+
+struct subtrie {
+    struct subtrie_node root;
+    zhashx_t *seen;                 // items visited during subtrie_match()
+};
+
+static size_t item_hasher (const void *key)
+{
+    uintptr_t n = (uintptr_t)key;
+    return n ^ (n >> 16);
+}
+
+static int item_cmp (const void *key1, const void *key2)
+{
+    if (key1 < key2)
+        return -1;
+    if (key1 > key2)
+        return 1;
+    return 0;
+}
+
+static zhashx_t *item_hash_create (void)
+{
+    zhashx_t *hash;
+
+    if (!(hash = zhashx_new ())) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    zhashx_set_key_hasher (hash, item_hasher);
+    zhashx_set_key_comparator (hash, item_cmp);
+    zhashx_set_key_duplicator (hash, NULL);
+    zhashx_set_key_destructor (hash, NULL);
+    return hash;
+}
+
+static void node_destroy_children (struct subtrie_node *node)
+{
+    struct subtrie_node *child = node->child;
+
+    while (child) {
+        struct subtrie_node *next = child->sibling;
+        node_destroy_children (child);
+        zhashx_destroy (&child->subs);
+        free (child);
+        child = next;
+    }
+    node->child = NULL;
+}
+
+static struct subtrie_node *node_child (struct subtrie_node *node, char c)
+{
+    struct subtrie_node *child = node->child;
+
+    while (child && child->c != c)
+        child = child->sibling;
+    return child;
+}
+
+/* Find the node for 'topic', or NULL if none.
+ */
+static struct subtrie_node *node_lookup (struct subtrie *st, const char *topic)
+{
+    struct subtrie_node *node = &st->root;
+
+    while (node && *topic)
+        node = node_child (node, *topic++);
+    return node;
+}
+
+/* Remove 'node' and any ancestors that no longer lead to a subscription.
+ */
+static void node_prune (struct subtrie_node *node)
+{
+    while (node->parent && !node->subs && !node->child) {
+        struct subtrie_node *parent = node->parent;
+        struct subtrie_node **prev = &parent->child;
+
+        while (*prev != node)
+            prev = &(*prev)->sibling;
+        *prev = node->sibling;
+        free (node);
+        node = parent;
+    }
+}
+
+int subtrie_insert (struct subtrie *st, const char *topic, void *item)
+{
+    struct subtrie_node *node;
+    struct subtrie_node *child;
+    const char *cp;
+    uintptr_t refcount;
+
+    if (!st || !topic || !item) {
+        errno = EINVAL;
+        return -1;
+    }
+    node = &st->root;
+    for (cp = topic; *cp; cp++) {
+        if (!(child = node_child (node, *cp))) {
+            if (!(child = calloc (1, sizeof (*child))))
+                goto error;
+            child->c = *cp;
+            child->parent = node;
+            child->sibling = node->child;
+            node->child = child;
+        }
+        node = child;
+    }
+    if (!node->subs && !(node->subs = item_hash_create ()))
+        goto error;
+    refcount = (uintptr_t)zhashx_lookup (node->subs, item);
+    zhashx_update (node->subs, item, (void *)(refcount + 1));
+    return 0;
+error:
+    node_prune (node);
+    return -1;
+}
+
+int subtrie_remove (struct subtrie *st, const char *topic, void *item)
+{
+    struct subtrie_node *node;
+    uintptr_t refcount;
+
+    if (!st || !topic || !item) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (!(node = node_lookup (st, topic))
+        || !node->subs
+        || !(refcount = (uintptr_t)zhashx_lookup (node->subs, item))) {
+        errno = ENOENT;
+        return -1;
+    }
+    if (--refcount > 0)
+        zhashx_update (node->subs, item, (void *)refcount);
+    else {
+        zhashx_delete (node->subs, item);
+        if (zhashx_size (node->subs) == 0) {
+            zhashx_destroy (&node->subs);
+            node_prune (node);
+        }
+    }
+    return 0;
+}
+
+/* Visit the items of one node.  If 'seen' is non-NULL, skip (and record)
+ * items already visited.
+ */
+static int node_visit (struct subtrie_node *node,
+                       zhashx_t *seen,
+                       subtrie_match_f cb,
+                       void *arg)
+{
+    void *refcount;
+    int count = 0;
+
+    refcount = zhashx_first (node->subs);
+    while (refcount) {
+        const void *item = zhashx_cursor (node->subs);
+
+        if (!seen || zhashx_insert (seen, item, refcount) == 0) {
+            if (cb && cb ((void *)item, arg) < 0)
+                return -1;
+            count++;
+        }
+        refcount = zhashx_next (node->subs);
+    }
+    return count;
+}
+
+int subtrie_match (struct subtrie *st,
+                   const char *topic,
+                   subtrie_match_f cb,
+                   void *arg)
+{
+    struct subtrie_node *node;
+    struct subtrie_node *first = NULL;
+    int nodes = 0;
+    const char *cp;
+    int count = 0;
+    int n;
+
+    if (!st || !topic) {
+        errno = EINVAL;
+        return -1;
+    }
+    node = &st->root;
+    for (cp = topic; node; node = *cp ? node_child (node, *cp++) : NULL) {
+        if (node->subs) {
+            if (nodes++ == 0)
+                first = node;
+        }
+    }
+    if (nodes == 0)
+        return 0;
+    if (nodes == 1)
+        return node_visit (first, NULL, cb, arg);
+
+    zhashx_purge (st->seen);
+    node = &st->root;
+    for (cp = topic; node; node = *cp ? node_child (node, *cp++) : NULL) {
+        if (node->subs) {
+            if ((n = node_visit (node, st->seen, cb, arg)) < 0)
+                return -1;
+            count += n;
+        }
+    }
+    return count;
+}
+
+void subtrie_destroy (struct subtrie *st)
+{
+    if (st) {
+        int saved_errno = errno;
+        node_destroy_children (&st->root);
+        zhashx_destroy (&st->root.subs);
+        zhashx_destroy (&st->seen);
+        free (st);
+        errno = saved_errno;
+    }
+}
+
+struct subtrie *subtrie_create (void)
+{
+    struct subtrie *st;
+
+    if (!(st = calloc (1, sizeof (*st))))
+        return NULL;
+    if (!(st->seen = item_hash_create ()))
+        goto error;
+    return st;
+error:
+    subtrie_destroy (st);
+    return NULL;
+}
+
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */
@@ -0,0 +1,52 @@
+/************************************************************\
+ * Copyright 2024 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+#ifndef _ROUTER_SUBTRIE_H
+#define _ROUTER_SUBTRIE_H
+
+/* A subtrie maps event subscription topics to subscribers (opaque items).
+ * A subscription topic matches any event topic that it is a prefix of,
+ * so subtrie_match() finds all interested subscribers by walking the
+ * event topic through the trie once, independent of the number of
+ * subscribers.
+ */
+
+typedef int (*subtrie_match_f)(void *item, void *arg);
+
+struct subtrie *subtrie_create (void);
+void subtrie_destroy (struct subtrie *st);
+
+/* Subscribe 'item' to 'topic'.  Subscriptions are reference counted,
+ * so each subtrie_insert() must be balanced by a subtrie_remove().
+ * Returns 0 on success, -1 on failure with errno set.
+ */
+int subtrie_insert (struct subtrie *st, const char *topic, void *item);
+
+/* Drop a reference on the subscription of 'item' to 'topic'.
+ * Returns 0 on success, -1 on failure with errno set (ENOENT if
+ * 'item' is not subscribed to 'topic').
+ */
+int subtrie_remove (struct subtrie *st, const char *topic, void *item);
+
+/* Call 'cb' once for each item with a subscription matching 'topic'.
+ * 'cb' may be NULL to just count the matching items.  The subtrie must
+ * not be modified from 'cb'.  If 'cb' returns -1, iteration stops.
+ * Returns the number of matching items, or -1 on failure.
+ */
+int subtrie_match (struct subtrie *st,
+                   const char *topic,
+                   subtrie_match_f cb,
+                   void *arg);
+
+#endif /* !_ROUTER_SUBTRIE_H */
+
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */
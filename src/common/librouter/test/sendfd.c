@@ -22,6 +22,7 @@
 #include "src/common/librouter/sendfd.h"
 #include "src/common/libutil/fdutils.h"
 #include "src/common/libtap/tap.h"
+#include "ccan/str/str.h"
 
 /* Send a small message over a blocking pipe.
  * We assume that there's enough buffer to do this in one go.
@@ -292,6 +293,110 @@ next:
     free (buf);
 }
 
+/* Send a batch of messages, one large, through a non-blocking pipe
+ * with msgbuf, and check that they arrive intact and in order.
+ */
+void test_msgbuf (void)
+{
+    int pfd[2];
+    struct msgbuf out;
+    struct msgbuf in;
+    int count = 64;
+    int sizes[64];
+    int received = 0;
+    bool errors = false;
+    bool encoded = true;
+    int i;
+
+    if (pipe2 (pfd, O_CLOEXEC) < 0)
+        BAIL_OUT ("pipe2 failed");
+    if (fd_set_nonblocking (pfd[0]) < 0 || fd_set_nonblocking (pfd[1]) < 0)
+        BAIL_OUT ("fd_set_nonblocking failed");
+    msgbuf_init (&out);
+    msgbuf_init (&in);
+
+    for (i = 0; i < count; i++) {
+        flux_msg_t *msg;
+        char *buf;
+
+        sizes[i] = i == count / 2 ? 200000 : i;
+        if (!(buf = calloc (1, sizes[i] + 1)))
+            BAIL_OUT ("out of memory");
+        memset (buf, 'a' + i % 26, sizes[i]);
+        if (!(msg = flux_request_encode ("foo.bar", buf)))
+            BAIL_OUT ("flux_request_encode failed");
+        if (msgbuf_encode (&out, msg) < 0)
+            encoded = false;
+        flux_msg_destroy (msg);
+        free (buf);
+    }
+    ok (encoded == true,
+        "msgbuf_encode encoded %d messages", count);
+    while (received < count && !errors) {
+        if (msgbuf_write (pfd[1], &out) < 0
+            && errno != EAGAIN && errno != EWOULDBLOCK)
+            break;
+        if (msgbuf_read (pfd[0], &in) < 0
+            && errno != EAGAIN && errno != EWOULDBLOCK)
+            break;
+        while (msgbuf_has_msg (&in)) {
+            flux_msg_t *msg;
+            const char *payload;
+
+            if (!(msg = msgbuf_decode (&in))
+                || flux_request_decode (msg, NULL, &payload) < 0
+                || strlen (payload) != sizes[received]
+                || (sizes[received] > 0
+                    && payload[0] != 'a' + received % 26))
+                errors = true;
+            flux_msg_destroy (msg);
+            received++;
+        }
+    }
+    ok (received == count && !errors,
+        "msgbuf_read/decode received %d messages intact", received);
+    ok (msgbuf_used (&out) == 0 && msgbuf_used (&in) == 0,
+        "both msgbufs are empty");
+    errno = 0;
+    ok (msgbuf_decode (&in) == NULL && errno == EAGAIN,
+        "msgbuf_decode on empty msgbuf fails with EAGAIN");
+
+    /* sendfd() and msgbuf use the same encoding.
+     */
+    flux_msg_t *msg;
+    const char *topic;
+    if (!(msg = flux_request_encode ("baz", NULL)))
+        BAIL_OUT ("flux_request_encode failed");
+    ok (sendfd (pfd[1], msg, NULL) == 0,
+        "sendfd works");
+    flux_msg_destroy (msg);
+    msg = NULL;
+    ok (msgbuf_read (pfd[0], &in) == 0
+        && (msg = msgbuf_decode (&in)) != NULL
+        && flux_msg_get_topic (msg, &topic) == 0
+        && streq (topic, "baz"),
+        "msgbuf_read/decode received message from sendfd");
+    flux_msg_destroy (msg);
+
+    if (write (pfd[1], "xxxxxxxxxxxx", 12) != 12)
+        BAIL_OUT ("write failed");
+    errno = 0;
+    ok (msgbuf_read (pfd[0], &in) == 0
+        && msgbuf_has_msg (&in)
+        && msgbuf_decode (&in) == NULL && errno == EPROTO,
+        "msgbuf_decode fails with EPROTO on bad magic");
+
+    close (pfd[1]);
+    msgbuf_clean (&in);
+    errno = 0;
+    ok (msgbuf_read (pfd[0], &in) < 0 && errno == ECONNRESET,
+        "msgbuf_read fails with ECONNRESET on EOF");
+    close (pfd[0]);
+
+    msgbuf_clean (&in);
+    msgbuf_clean (&out);
+}
+
 void test_inval (void)
 {
     flux_msg_t *msg;
@@ -324,6 +429,7 @@ int main (int argc, char *argv[])
     test_nonblock (4096, 256);
     test_nonblock (16384, 64);
     test_nonblock (1048586, 1);
+    test_msgbuf ();
     test_inval ();
 
     done_testing();
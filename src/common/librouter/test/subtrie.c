@@ -0,0 +1,168 @@
+/************************************************************\
+ * Copyright 2024 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <flux/core.h>
+
+#include "src/common/libtap/tap.h"
+#include "src/common/librouter/subtrie.h"
+
+/* Items are counters, incremented each time they are matched.
+ */
+int count_cb (void *item, void *arg)
+{
+    int *count = item;
+    (*count)++;
+    return 0;
+}
+
+int fail_cb (void *item, void *arg)
+{
+    return -1;
+}
+
+void test_match (void)
+{
+    struct subtrie *st;
+    int a = 0, b = 0, c = 0;
+
+    st = subtrie_create ();
+    ok (st != NULL,
+        "subtrie_create works");
+
+    ok (subtrie_match (st, "foo", count_cb, NULL) == 0,
+        "subtrie_match on empty subtrie matches nothing");
+
+    ok (subtrie_insert (st, "foo", &a) == 0,
+        "subtrie_insert foo a");
+    ok (subtrie_insert (st, "foo.bar", &b) == 0,
+        "subtrie_insert foo.bar b");
+    ok (subtrie_insert (st, "baz", &c) == 0,
+        "subtrie_insert baz c");
+
+    ok (subtrie_match (st, "foo", count_cb, NULL) == 1 && a == 1,
+        "subtrie_match foo matches a");
+    ok (subtrie_match (st, "foobar", count_cb, NULL) == 1 && a == 2,
+        "subtrie_match foobar matches a");
+    ok (subtrie_match (st, "foo.bar.x", count_cb, NULL) == 2
+        && a == 3 && b == 1,
+        "subtrie_match foo.bar.x matches a and b");
+    ok (subtrie_match (st, "fo", count_cb, NULL) == 0,
+        "subtrie_match fo matches nothing");
+    ok (subtrie_match (st, "ba", count_cb, NULL) == 0,
+        "subtrie_match ba matches nothing");
+    ok (subtrie_match (st, "baz", NULL, NULL) == 1 && c == 0,
+        "subtrie_match baz with cb=NULL counts c");
+    ok (subtrie_match (st, "baz", fail_cb, NULL) < 0,
+        "subtrie_match fails if callback fails");
+
+    /* an item subscribed to overlapping topics is matched once */
+    ok (subtrie_insert (st, "foo.bar", &a) == 0,
+        "subtrie_insert foo.bar a");
+    a = b = 0;
+    ok (subtrie_match (st, "foo.bar", count_cb, NULL) == 2
+        && a == 1 && b == 1,
+        "subtrie_match foo.bar matches a and b once each");
+    ok (subtrie_remove (st, "foo.bar", &a) == 0,
+        "subtrie_remove foo.bar a");
+
+    /* the empty topic matches everything */
+    ok (subtrie_insert (st, "", &c) == 0,
+        "subtrie_insert \"\" c");
+    c = 0;
+    ok (subtrie_match (st, "anything", count_cb, NULL) == 1 && c == 1,
+        "subtrie_match anything matches c");
+    ok (subtrie_remove (st, "", &c) == 0,
+        "subtrie_remove \"\" c");
+
+    subtrie_destroy (st);
+}
+
+void test_refcount (void)
+{
+    struct subtrie *st;
+    int a = 0;
+
+    if (!(st = subtrie_create ()))
+        BAIL_OUT ("subtrie_create failed");
+
+    ok (subtrie_insert (st, "foo", &a) == 0
+        && subtrie_insert (st, "foo", &a) == 0,
+        "subtrie_insert foo a twice");
+    ok (subtrie_match (st, "foo", count_cb, NULL) == 1 && a == 1,
+        "subtrie_match foo matches a once");
+    ok (subtrie_remove (st, "foo", &a) == 0,
+        "subtrie_remove foo a");
+    ok (subtrie_match (st, "foo", NULL, NULL) == 1,
+        "subtrie_match foo still matches a");
+    ok (subtrie_remove (st, "foo", &a) == 0,
+        "subtrie_remove foo a (again)");
+    ok (subtrie_match (st, "foo", NULL, NULL) == 0,
+        "subtrie_match foo matches nothing");
+    errno = 0;
+    ok (subtrie_remove (st, "foo", &a) < 0 && errno == ENOENT,
+        "subtrie_remove foo a (once more) fails with ENOENT");
+
+    subtrie_destroy (st);
+}
+
+void test_errors (void)
+{
+    struct subtrie *st;
+    int a;
+
+    if (!(st = subtrie_create ()))
+        BAIL_OUT ("subtrie_create failed");
+
+    errno = 0;
+    ok (subtrie_insert (NULL, "foo", &a) < 0 && errno == EINVAL,
+        "subtrie_insert st=NULL fails with EINVAL");
+    errno = 0;
+    ok (subtrie_insert (st, NULL, &a) < 0 && errno == EINVAL,
+        "subtrie_insert topic=NULL fails with EINVAL");
+    errno = 0;
+    ok (subtrie_insert (st, "foo", NULL) < 0 && errno == EINVAL,
+        "subtrie_insert item=NULL fails with EINVAL");
+    errno = 0;
+    ok (subtrie_remove (NULL, "foo", &a) < 0 && errno == EINVAL,
+        "subtrie_remove st=NULL fails with EINVAL");
+    errno = 0;
+    ok (subtrie_remove (st, "foo", &a) < 0 && errno == ENOENT,
+        "subtrie_remove topic=<unknown> fails with ENOENT");
+    errno = 0;
+    ok (subtrie_match (NULL, "foo", NULL, NULL) < 0 && errno == EINVAL,
+        "subtrie_match st=NULL fails with EINVAL");
+    errno = 0;
+    ok (subtrie_match (st, NULL, NULL, NULL) < 0 && errno == EINVAL,
+        "subtrie_match topic=NULL fails with EINVAL");
+
+    lives_ok ({ subtrie_destroy (NULL);},
+        "subtrie_destroy st=NULL doesn't crash");
+
+    subtrie_destroy (st);
+}
+
+int main (int argc, char *argv[])
+{
+    plan (NO_PLAN);
+
+    test_match ();
+    test_refcount ();
+    test_errors ();
+
+    done_testing ();
+    return (0);
+}
+
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */
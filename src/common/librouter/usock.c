@@ -31,6 +31,11 @@
  * - usock_conn_send() adds a message to a queue, starts fd (write) watcher.
  * - Register a receive callback to receive complete messages from client.
  * - Register an error callback to be notified when I/O errors occur.
+ *
+ * Messages are batched in each direction (see msgbuf in sendfd.c).
+ * A read wakeup reads up to MSGBUF_SIZE bytes and delivers every complete
+ * message in the buffer.  A write wakeup encodes queued messages up to
+ * OUT_BATCH_SIZE bytes and sends them with one write.
  */
 
 #if HAVE_CONFIG_H
@@ -57,6 +62,8 @@
 
 #define LISTEN_BACKLOG 5
 
+#define OUT_BATCH_SIZE 65536
+
 #ifndef UUID_STR_LEN
 #define UUID_STR_LEN 37     // defined in later libuuid headers
 #endif
@@ -74,7 +81,7 @@ struct usock_server {
 struct usock_io {
     int fd;
     flux_watcher_t *w;
-    struct iobuf iobuf;
+    struct msgbuf mbuf;
 };
 
 struct usock_conn {
@@ -97,14 +104,14 @@ struct usock_conn {
 
     struct aux_item *aux;
     struct usock_server *server;
-    int refcount;
+    bool *destroyed; // set if conn is destroyed while delivering messages
 
     unsigned char enable_close_on_destroy:1;
 };
 
 struct usock_client {
     int fd;
-    struct iobuf in_iobuf;
+    struct msgbuf in_mbuf;
     struct iobuf out_iobuf;
 };
 
@@ -201,32 +208,47 @@ static void conn_read_cb (flux_reactor_t *r,
                           void *arg)
 {
     struct usock_conn *conn = arg;
+    bool destroyed = false;
 
     if ((revents & FLUX_POLLERR)) {
         errno = EIO;
         goto error;
     }
     if ((revents & FLUX_POLLIN)) {
-        flux_msg_t *msg;
-
-        if (!(msg = recvfd (conn->in.fd, &conn->in.iobuf))) {
+        if (msgbuf_read (conn->in.fd, &conn->in.mbuf) < 0) {
             if (errno != EWOULDBLOCK && errno != EAGAIN)
                 goto error;
+            return;
         }
-        else {
+        /* Deliver all complete messages.  The recv callback may destroy
+         * the connection, so stop if that happens.
+         */
+        conn->destroyed = &destroyed;
+        while (msgbuf_has_msg (&conn->in.mbuf)) {
+            flux_msg_t *msg;
+
+            if (!(msg = msgbuf_decode (&conn->in.mbuf)))
+                goto error;
             /* Update message credentials based on connected creds.
              */
-            if (auth_init_message (msg, &conn->cred) < 0)
+            if (auth_init_message (msg, &conn->cred) < 0) {
+                flux_msg_destroy (msg);
                 goto error;
-
+            }
             if (conn->recv_cb)
                 conn->recv_cb (conn, msg, conn->recv_arg);
             flux_msg_destroy (msg);
+            if (destroyed)
+                return;
         }
+        conn->destroyed = NULL;
     }
     return;
 error:
-    conn_io_error (conn, errno);
+    if (!destroyed) {
+        conn->destroyed = NULL;
+        conn_io_error (conn, errno);
+    }
 }
 
 static int conn_outqueue_drop (struct usock_conn *conn)
@@ -251,9 +273,20 @@ static void conn_write_cb (flux_reactor_t *r,
     }
 
     if ((revents & FLUX_POLLOUT)) {
-        const flux_msg_t *msg = zlist_head (conn->outqueue);
-        if (msg) {
-            if (sendfd (conn->out.fd, msg, &conn->out.iobuf) < 0) {
+        const flux_msg_t *msg;
+
+        /* Refill the output buffer once it has been completely written.
+         */
+        if (msgbuf_used (&conn->out.mbuf) == 0) {
+            while (msgbuf_used (&conn->out.mbuf) < OUT_BATCH_SIZE
+                   && (msg = zlist_head (conn->outqueue))) {
+                if (msgbuf_encode (&conn->out.mbuf, msg) < 0)
+                    goto error;
+                (void) conn_outqueue_drop (conn);
+            }
+        }
+        if (msgbuf_used (&conn->out.mbuf) > 0) {
+            if (msgbuf_write (conn->out.fd, &conn->out.mbuf) < 0) {
                 if (errno == EPIPE) {
                     /* Remote peer has closed connection.
                      * However, there may still be pending messages sent
@@ -264,17 +297,17 @@ static void conn_write_cb (flux_reactor_t *r,
                      */
                     while (conn_outqueue_drop (conn))
                         ;
+                    msgbuf_clean (&conn->out.mbuf);
                     flux_watcher_stop (conn->out.w);
                 }
                 else if (errno != EWOULDBLOCK && errno != EAGAIN)
                     goto error;
             }
-            else {
-                (void) conn_outqueue_drop (conn);
-                if (zlist_size (conn->outqueue) == 0)
-                    flux_watcher_stop (conn->out.w);
-            }
+            else if (zlist_size (conn->outqueue) == 0)
+                flux_watcher_stop (conn->out.w);
         }
+        else
+            flux_watcher_stop (conn->out.w);
     }
     return;
 error:
@@ -326,11 +359,13 @@ void usock_conn_destroy (struct usock_conn *conn)
 {
     if (conn) {
         int saved_errno = errno;
+        if (conn->destroyed)
+            *conn->destroyed = true;
         if (conn->close_cb)
             (*conn->close_cb) (conn, conn->close_arg);
         aux_destroy (&conn->aux);
         flux_watcher_destroy (conn->in.w);
-        iobuf_clean (&conn->in.iobuf);
+        msgbuf_clean (&conn->in.mbuf);
         if (conn->outqueue) {
             const flux_msg_t *msg;
             while ((msg = zlist_pop (conn->outqueue)))
@@ -338,7 +373,7 @@ void usock_conn_destroy (struct usock_conn *conn)
             zlist_destroy (&conn->outqueue);
         }
         flux_watcher_destroy (conn->out.w);
-        iobuf_clean (&conn->out.iobuf);
+        msgbuf_clean (&conn->out.mbuf);
         if (conn->server)
             zlist_remove (conn->server->connections, conn);
         if (conn->enable_close_on_destroy) {
@@ -432,7 +467,7 @@ struct usock_conn *usock_conn_create (flux_reactor_t *r, int infd, int outfd)
                                                conn_read_cb,
                                                conn)))
         goto error;
-    iobuf_init (&conn->in.iobuf);
+    msgbuf_init (&conn->in.mbuf);
 
     if (!(conn->out.w = flux_fd_watcher_create (r,
                                                 conn->out.fd,
@@ -440,7 +475,7 @@ struct usock_conn *usock_conn_create (flux_reactor_t *r, int infd, int outfd)
                                                 conn_write_cb,
                                                 conn)))
         goto error;
-    iobuf_init (&conn->out.iobuf);
+    msgbuf_init (&conn->out.mbuf);
     uuid_generate (conn->uuid);
     uuid_unparse (conn->uuid, conn->uuid_str);
 
@@ -579,6 +614,8 @@ static bool is_poll_error (int revents)
 
 /* Check which events are pending events on client fd (non-blocking).
  * If none are pending, return 0.  If an error occurred, return FLUX_POLLERR.
+ * A message that was already read into the input buffer counts as POLLIN,
+ * since the fd will not become readable for it.
  * N.B. see op->pollevents in libflux/connector.h
  */
 int usock_client_pollevents (struct usock_client *client)
@@ -586,6 +623,9 @@ int usock_client_pollevents (struct usock_client *client)
     struct pollfd pfd;
     int flux_revents = 0;
 
+    if (msgbuf_has_msg (&client->in_mbuf))
+        flux_revents |= FLUX_POLLIN;
+
     pfd.fd = client->fd;
     pfd.events = POLLIN | POLLOUT;
     pfd.revents = 0;
@@ -650,23 +690,24 @@ int usock_client_send (struct usock_client *client,
     return 0;
 }
 
-/* Try to recv message.  If flags does not include FLUX_O_NONBLOCK,
- * and recvfd fails with EWOULDBLOCK/EAGAIN, then poll(POLLIN) and
- * keep trying until the full message is received
+/* Try to recv message.  Messages are read into a buffer in batches, so
+ * the next message may already be buffered.  If not, and flags does not
+ * include FLUX_O_NONBLOCK, and the read fails with EWOULDBLOCK/EAGAIN,
+ * then poll(POLLIN) and keep trying until the full message is received.
  */
 flux_msg_t *usock_client_recv (struct usock_client *client, int flags)
 {
-    flux_msg_t *msg;
-
-    while (!(msg = recvfd (client->fd, &client->in_iobuf))) {
-        if (errno != EWOULDBLOCK && errno != EAGAIN)
-            return NULL;
-        if ((flags & FLUX_O_NONBLOCK))
-            return NULL;
-        if (usock_client_poll (client->fd, POLLIN) < 0)
-            return NULL;
+    while (!msgbuf_has_msg (&client->in_mbuf)) {
+        if (msgbuf_read (client->fd, &client->in_mbuf) < 0) {
+            if (errno != EWOULDBLOCK && errno != EAGAIN)
+                return NULL;
+            if ((flags & FLUX_O_NONBLOCK))
+                return NULL;
+            if (usock_client_poll (client->fd, POLLIN) < 0)
+                return NULL;
+        }
     }
-    return msg;
+    return msgbuf_decode (&client->in_mbuf);
 }
 
 /* Open socket and connect it to 'sockpath'.
@@ -745,7 +786,7 @@ struct usock_client *usock_client_create (int fd)
         return NULL;
 
     client->fd = fd;
-    iobuf_init (&client->in_iobuf);
+    msgbuf_init (&client->in_mbuf);
     iobuf_init (&client->out_iobuf);
 
     if (usock_client_read_zero (client->fd) < 0)
@@ -761,7 +802,7 @@ error:
 void usock_client_destroy (struct usock_client *client)
 {
     if (client) {
-        iobuf_clean (&client->in_iobuf);
+        msgbuf_clean (&client->in_mbuf);
         iobuf_clean (&client->out_iobuf);
         ERRNO_SAFE_WRAP (free, client);
     }
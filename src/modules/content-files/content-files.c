@@ -10,11 +10,17 @@
 
 /* content-files.c - content addressable storage with files back end
  *
- * This is mainly for demo/experimentation purposes.
- * The "store" is a flat directory with blobrefs as filenames.
+ * By default, the "store" is a flat directory with blobrefs as filenames.
  * As such, it is hungry for inodes and may run the file system out of them
  * if used in anger!
  *
+ * With the "pack" module option, blobs are instead appended to a single
+ * pack file with an mmapped hash index (see packdb.h), so stores are
+ * sequential writes and loads are O(1).  Blobs stored in the flat layout
+ * before pack mode was enabled can still be loaded.  The pack is synced
+ * before each checkpoint, and compacted periodically if it contains much
+ * unreferenced data.
+ *
  * There are four main operations (RPC handlers):
  *
  * content-backing.load:
@@ -23,6 +29,9 @@
  * content-backing.store:
  * Given a blob, store it and return its hash
  *
+ * (content-backing.load-batch and content-backing.store-batch are the same
+ * operations applied to a batch of hashes or blobs)
+ *
  * content-backing.checkpoint-get:
  * Given a string key, lookup string value and return it or a "not found" error.
  *
@@ -61,8 +70,14 @@
 #include "src/common/libutil/unlink_recursive.h"
 
 #include "src/common/libcontent/content-util.h"
+#include "src/common/libcontent/content-batch.h"
 
 #include "filedb.h"
+#include "packdb.h"
+
+/* In pack mode, check this often whether the pack should be compacted.
+ */
+const double pack_compact_period = 3600.;
 
 struct content_files {
     flux_msg_handler_t **handlers;
@@ -70,8 +85,88 @@ struct content_files {
     flux_t *h;
     const char *hashfun;
     int hash_size;
+    struct packdb *pdb;         /* NULL unless in pack mode */
+    flux_watcher_t *compact_w;
 };
 
+/* Load blob by hash, from the pack if in pack mode, falling back to a
+ * file named by its blobref.
+ */
+static int content_files_get (struct content_files *ctx,
+                              const void *hash,
+                              int hash_size,
+                              void **datap,
+                              size_t *sizep,
+                              const char **errstr)
+{
+    char blobref[BLOBREF_MAX_STRING_SIZE];
+
+    if (ctx->pdb) {
+        if (packdb_get (ctx->pdb, hash, hash_size, datap, sizep) == 0)
+            return 0;
+        if (errno != ENOENT)
+            return -1;
+    }
+    if (blobref_hashtostr (ctx->hashfun,
+                           hash,
+                           hash_size,
+                           blobref,
+                           sizeof (blobref)) < 0)
+        return -1;
+    return filedb_get (ctx->dbpath, blobref, datap, sizep, errstr);
+}
+
+/* Store blob with precomputed hash, to the pack if in pack mode,
+ * otherwise to a file named by its blobref.
+ */
+static int content_files_put (struct content_files *ctx,
+                              const void *hash,
+                              int hash_size,
+                              const void *data,
+                              size_t size,
+                              const char **errstr)
+{
+    char blobref[BLOBREF_MAX_STRING_SIZE];
+
+    if (ctx->pdb)
+        return packdb_put (ctx->pdb, hash, hash_size, data, size);
+    if (blobref_hashtostr (ctx->hashfun,
+                           hash,
+                           hash_size,
+                           blobref,
+                           sizeof (blobref)) < 0)
+        return -1;
+    return filedb_put (ctx->dbpath, blobref, data, size, errstr);
+}
+
+/* Compact the pack if more than a quarter of it is unreferenced.
+ */
+static void content_files_compact (struct content_files *ctx)
+{
+    size_t size = packdb_size (ctx->pdb);
+    size_t garbage = packdb_garbage (ctx->pdb);
+
+    if (garbage * 4 <= size)
+        return;
+    if (packdb_compact (ctx->pdb) < 0) {
+        flux_log_error (ctx->h, "error compacting pack");
+        return;
+    }
+    flux_log (ctx->h,
+              LOG_INFO,
+              "compacted pack from %zu to %zu bytes",
+              size,
+              packdb_size (ctx->pdb));
+}
+
+static void compact_cb (flux_reactor_t *r,
+                        flux_watcher_t *w,
+                        int revents,
+                        void *arg)
+{
+    content_files_compact (arg);
+}
+
 static int file_count_cb (dirwalk_t *d, void *arg)
 {
     int *count = arg;
@@ -97,6 +192,17 @@ static void stats_get_cb (flux_t *h,
     struct content_files *ctx = arg;
     int count;
 
+    if (ctx->pdb) {
+        if (flux_respond_pack (h,
+                               msg,
+                               "{s:i s:I s:I}",
+                               "object_count", packdb_count (ctx->pdb),
+                               "pack_size", (json_int_t)packdb_size (ctx->pdb),
+                               "pack_garbage",
+                               (json_int_t)packdb_garbage (ctx->pdb)) < 0)
+            flux_log_error (h, "error responding to stats.get request");
+        return;
+    }
     if ((count = get_object_count (ctx->dbpath)) < 0)
         goto error;
 
@@ -122,7 +228,6 @@ static void load_cb (flux_t *h,
     struct content_files *ctx = arg;
     const void *hash;
     int hash_size;
-    char blobref[BLOBREF_MAX_STRING_SIZE];
     void *data = NULL;
     size_t size;
     const char *errstr = NULL;
@@ -133,13 +238,7 @@ static void load_cb (flux_t *h,
         errno = EPROTO;
         goto error;
     }
-    if (blobref_hashtostr (ctx->hashfun,
-                           hash,
-                           hash_size,
-                           blobref,
-                           sizeof (blobref)) < 0)
-        goto error;
-    if (filedb_get (ctx->dbpath, blobref, &data, &size, &errstr) < 0)
+    if (content_files_get (ctx, hash, hash_size, &data, &size, &errstr) < 0)
         goto error;
     if (flux_respond_raw (h, msg, data, size) < 0)
         flux_log_error (h, "error responding to load request");
@@ -164,7 +263,6 @@ void store_cb (flux_t *h,
     struct content_files *ctx = arg;
     const void *data;
     int size;
-    char blobref[BLOBREF_MAX_STRING_SIZE];
     char hash[BLOBREF_MAX_DIGEST_SIZE];
     int hash_size;
     const char *errstr = NULL;
@@ -177,13 +275,7 @@ void store_cb (flux_t *h,
                                        hash,
                                        sizeof (hash))) < 0)
         goto error;
-    if (blobref_hashtostr (ctx->hashfun,
-                           hash,
-                           hash_size,
-                           blobref,
-                           sizeof (blobref)) < 0)
-        goto error;
-    if (filedb_put (ctx->dbpath, blobref, data, size, &errstr) < 0)
+    if (content_files_put (ctx, hash, hash_size, data, size, &errstr) < 0)
         goto error;
     if (flux_respond_raw (h, msg, hash, hash_size) < 0)
         flux_log_error (h, "error responding to store request");
@@ -193,12 +285,137 @@ error:
         flux_log_error (h, "error responding to store request");
 }
 
+/* Handle a content-backing.load-batch request.  The payload formats are
+ * described in content-batch.h.
+ */
+static void load_batch_cb (flux_t *h,
+                           flux_msg_handler_t *mh,
+                           const flux_msg_t *msg,
+                           void *arg)
+{
+    struct content_files *ctx = arg;
+    struct content_batch *b = NULL;
+    const void *buf;
+    int len;
+    int cursor = 0;
+    const void *hash;
+    int hash_size;
+    const char *errstr = NULL;
+    int rc;
+
+    if (flux_request_decode_raw (msg, NULL, &buf, &len) < 0
+        || !(b = content_batch_create ()))
+        goto error;
+    while ((rc = content_batch_next (buf,
+                                     len,
+                                     &cursor,
+                                     NULL,
+                                     &hash,
+                                     &hash_size)) > 0) {
+        void *data = NULL;
+        size_t size;
+
+        if (hash_size != ctx->hash_size) {
+            errno = EPROTO;
+            goto error;
+        }
+        if (content_files_get (ctx,
+                               hash,
+                               hash_size,
+                               &data,
+                               &size,
+                               &errstr) < 0) {
+            if (errno != ENOENT)
+                goto error;
+            errstr = NULL;
+            rc = content_batch_append (b, ENOENT, NULL, 0);
+        }
+        else {
+            rc = content_batch_append (b, 0, data, size);
+            free (data);
+        }
+        if (rc < 0)
+            goto error;
+    }
+    if (rc < 0)
+        goto error;
+    buf = content_batch_data (b, &len);
+    if (flux_respond_raw (h, msg, buf, len) < 0)
+        flux_log_error (h, "error responding to load-batch request");
+    content_batch_destroy (b);
+    return;
+error:
+    if (flux_respond_error (h, msg, errno, errstr) < 0)
+        flux_log_error (h, "error responding to load-batch request");
+    content_batch_destroy (b);
+}
+
+/* Handle a content-backing.store-batch request.  The payload formats are
+ * described in content-batch.h.
+ */
+static void store_batch_cb (flux_t *h,
+                            flux_msg_handler_t *mh,
+                            const flux_msg_t *msg,
+                            void *arg)
+{
+    struct content_files *ctx = arg;
+    struct content_batch *b = NULL;
+    const void *buf;
+    int len;
+    int cursor = 0;
+    const void *data;
+    int size;
+    const char *errstr = NULL;
+    int rc;
+
+    if (flux_request_decode_raw (msg, NULL, &buf, &len) < 0
+        || !(b = content_batch_create ()))
+        goto error;
+    while ((rc = content_batch_next (buf,
+                                     len,
+                                     &cursor,
+                                     NULL,
+                                     &data,
+                                     &size)) > 0) {
+        char hash[BLOBREF_MAX_DIGEST_SIZE];
+        int hash_size;
+
+        if ((hash_size = blobref_hash_raw (ctx->hashfun,
+                                           data,
+                                           size,
+                                           hash,
+                                           sizeof (hash))) < 0)
+            goto error;
+        if (content_files_put (ctx,
+                               hash,
+                               hash_size,
+                               data,
+                               size,
+                               &errstr) < 0)
+            goto error;
+        if (content_batch_append (b, 0, hash, hash_size) < 0)
+            goto error;
+    }
+    if (rc < 0)
+        goto error;
+    buf = content_batch_data (b, &len);
+    if (flux_respond_raw (h, msg, buf, len) < 0)
+        flux_log_error (h, "error responding to store-batch request");
+    content_batch_destroy (b);
+    return;
+error:
+    if (flux_respond_error (h, msg, errno, errstr) < 0)
+        flux_log_error (h, "error responding to store-batch request");
+    content_batch_destroy (b);
+}
+
 /* Handle a content-backing.checkpoint-get request from the rank 0 kvs module.
  * The KVS stores its last root reference here for restart purposes.
  *
  * N.B. filedb_get() calls read_all() which ensures that the returned buffer
  * is padded with an extra NULL not included in the returned length,
  * so it is safe to use the result as a string argument in flux_respond_pack().
+ * packdb_checkpoint_get() does the same.
  */
 void checkpoint_get_cb (flux_t *h,
                         flux_msg_handler_t *mh,
@@ -215,7 +432,13 @@ void checkpoint_get_cb (flux_t *h,
 
     if (flux_request_unpack (msg, NULL, "{s:s}", "key", &key) < 0)
         goto error;
-    if (filedb_get (ctx->dbpath, key, &data, &size, &errstr) < 0)
+    if (ctx->pdb) {
+        if (packdb_checkpoint_get (ctx->pdb, key, &data, &size, &errstr) < 0
+            && (errno != ENOENT
+                || filedb_get (ctx->dbpath, key, &data, &size, &errstr) < 0))
+            goto error;
+    }
+    else if (filedb_get (ctx->dbpath, key, &data, &size, &errstr) < 0)
         goto error;
     /* recovery from version 0 checkpoint blobref not supported */
     if (!(o = json_loadb (data, size, 0, &error))) {
@@ -266,7 +489,19 @@ void checkpoint_put_cb (flux_t *h,
         errno = EINVAL;
         goto error;
     }
-    if (filedb_put (ctx->dbpath, key, value, strlen (value), &errstr) < 0)
+    if (ctx->pdb) {
+        if (packdb_checkpoint_put (ctx->pdb,
+                                   key,
+                                   value,
+                                   strlen (value),
+                                   &errstr) < 0)
+            goto error;
+    }
+    else if (filedb_put (ctx->dbpath,
+                         key,
+                         value,
+                         strlen (value),
+                         &errstr) < 0)
         goto error;
     if (flux_respond (h, msg, NULL) < 0)
         flux_log_error (h, "error responding to checkpoint-put request");
@@ -285,6 +520,8 @@ static void content_files_destroy (struct content_files *ctx)
     if (ctx) {
         int saved_errno = errno;
         flux_msg_handler_delvec (ctx->handlers);
+        flux_watcher_destroy (ctx->compact_w);
+        packdb_close (ctx->pdb);
         free (ctx->dbpath);
         free (ctx);
         errno = saved_errno;
@@ -297,6 +534,8 @@ static void content_files_destroy (struct content_files *ctx)
 static const struct flux_msg_handler_spec htab[] = {
     { FLUX_MSGTYPE_REQUEST, "content-backing.load",    load_cb, 0 },
     { FLUX_MSGTYPE_REQUEST, "content-backing.store",   store_cb, 0 },
+    { FLUX_MSGTYPE_REQUEST, "content-backing.load-batch", load_batch_cb, 0 },
+    { FLUX_MSGTYPE_REQUEST, "content-backing.store-batch", store_batch_cb, 0 },
     { FLUX_MSGTYPE_REQUEST, "content-backing.checkpoint-get", checkpoint_get_cb, 0 },
     { FLUX_MSGTYPE_REQUEST, "content-backing.checkpoint-put", checkpoint_put_cb, 0 },
     { FLUX_MSGTYPE_REQUEST, "content-files.stats.get", stats_get_cb, 0 },
@@ -305,10 +544,13 @@ static const struct flux_msg_handler_spec htab[] = {
 
 /* Create module context and perform some initialization.
  */
-static struct content_files *content_files_create (flux_t *h, bool truncate)
+static struct content_files *content_files_create (flux_t *h,
+                                                   bool truncate,
+                                                   bool pack)
 {
     struct content_files *ctx;
     const char *dbdir;
+    const char *errstr = NULL;
 
     if (!(ctx = calloc (1, sizeof (*ctx))))
         return NULL;
@@ -342,6 +584,27 @@ static struct content_files *content_files_create (flux_t *h, bool truncate)
         flux_log_error (h, "could not create %s", ctx->dbpath);
         goto error;
     }
+    if (pack) {
+        if (!(ctx->pdb = packdb_open (ctx->dbpath,
+                                      ctx->hash_size,
+                                      false,
+                                      &errstr))) {
+            flux_log (h,
+                      LOG_ERR,
+                      "could not open pack in %s: %s",
+                      ctx->dbpath,
+                      errstr ? errstr : strerror (errno));
+            goto error;
+        }
+        content_files_compact (ctx);
+        if (!(ctx->compact_w = flux_timer_watcher_create (flux_get_reactor (h),
+                                                          pack_compact_period,
+                                                          pack_compact_period,
+                                                          compact_cb,
+                                                          ctx)))
+            goto error;
+        flux_watcher_start (ctx->compact_w);
+    }
     if (flux_msg_handler_addvec (h, htab, ctx, &ctx->handlers) < 0)
         goto error;
     return ctx;
@@ -354,7 +617,8 @@ static int parse_args (flux_t *h,
                        int argc,
                        char **argv,
                        bool *testing,
-                       bool *truncate)
+                       bool *truncate,
+                       bool *pack)
 {
     int i;
     for (i = 0; i < argc; i++) {
@@ -362,6 +626,8 @@ static int parse_args (flux_t *h,
             *testing = true;
         else if (!strcmp (argv[i], "truncate"))
             *truncate = true;
+        else if (!strcmp (argv[i], "pack"))
+            *pack = true;
         else {
             flux_log (h, LOG_ERR, "Unknown module option: %s", argv[i]);
             return -1;
@@ -387,11 +653,12 @@ int mod_main (flux_t *h, int argc, char **argv)
     struct content_files *ctx;
     bool testing = false;
     bool truncate = false;
+    bool pack = false;
     int rc = -1;
 
-    if (parse_args (h, argc, argv, &testing, &truncate) < 0)
+    if (parse_args (h, argc, argv, &testing, &truncate, &pack) < 0)
         return -1;
-    if (!(ctx = content_files_create (h, truncate))) {
+    if (!(ctx = content_files_create (h, truncate, pack))) {
         flux_log_error (h, "content_files_create failed");
         return -1;
     }
@@ -0,0 +1,952 @@
+/************************************************************\
+ * Copyright 2024 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+/* packdb.c - append-only pack file with an mmapped hash index
+ *
+ * pack.data is a 16 byte file header followed by records:
+ *   magic, data size, checksum (over hash and data), hash, data
+ * Records are never modified once written.  Fields are in host byte
+ * order, since the files are not meant to be moved between systems.
+ *
+ * pack.index is a 64 byte header followed by a power of two number of
+ * slots, probed linearly starting from the first 8 bytes of the hash.
+ * Each slot holds the pack offset of a record plus one (zero if empty),
+ * then the hash.
+ *
+ * The index header is marked dirty, and synced, before the first change
+ * after a packdb_sync().  If it is dirty on open, slots that refer to the
+ * unsynced part of the pack are dropped before that part is scanned.
+ *
+ * The generation number in the pack header changes each time the pack
+ * is compacted.  If the index generation does not match, the pack was
+ * replaced without its index (a crash during compaction), and the index
+ * is rebuilt.
+ */
+
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <stdio.h>
+
+#include "src/common/libutil/read_all.h"
+#include "src/common/libutil/errno_safe.h"
+
+#include "packdb.h"
+
+#define PACK_MAGIC          0x4b434150  // "PACK"
+#define PACK_VERSION        1
+#define RECORD_MAGIC        0x424f4c42  // "BLOB"
+#define INDEX_MAGIC         0x58444e49  // "INDX"
+#define INDEX_VERSION       1
+#define INDEX_MIN_SLOTS     4096
+#define HASH_MAX_SIZE       64
+
+struct pack_header {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t generation;
+};
+
+struct record_header {
+    uint32_t magic;
+    uint32_t size;
+    uint32_t check;
+};
+
+struct index_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t hash_size;
+    uint32_t slot_size;
+    uint64_t generation;    // must match pack header
+    uint64_t nslots;
+    uint64_t count;
+    uint64_t synced_len;    // pack bytes covered by index and durable
+    uint64_t garbage;       // pack bytes not referenced by index
+    uint64_t dirty;         // modified since synced_len was set
+};
+
+struct index {
+    int fd;
+    void *map;
+    size_t len;
+    struct index_header *hdr;
+    uint8_t *slots;
+};
+
+struct packdb {
+    char *dbpath;
+    int hash_size;
+    size_t slot_size;
+    int fd;                 // pack.data
+    uint64_t generation;
+    uint64_t pack_size;
+    struct index ix;        // pack.index
+};
+
+static int mkpath (struct packdb *pdb,
+                   const char *name,
+                   char *buf,
+                   size_t size)
+{
+    if (snprintf (buf, size, "%s/%s", pdb->dbpath, name) >= size) {
+        errno = EOVERFLOW;
+        return -1;
+    }
+    return 0;
+}
+
+static int fsync_dir (const char *path)
+{
+    int fd;
+
+    if ((fd = open (path, O_RDONLY | O_DIRECTORY)) < 0)
+        return -1;
+    if (fsync (fd) < 0) {
+        ERRNO_SAFE_WRAP (close, fd);
+        return -1;
+    }
+    return close (fd);
+}
+
+static ssize_t pread_all (int fd, void *buf, size_t len, off_t offset)
+{
+    char *p = buf;
+    size_t count = 0;
+    ssize_t n;
+
+    while (count < len) {
+        if ((n = pread (fd, p + count, len - count, offset + count)) < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        if (n == 0)
+            break;
+        count += n;
+    }
+    return count;
+}
+
+static int pwrite_all (int fd, const void *buf, size_t len, off_t offset)
+{
+    const char *p = buf;
+    size_t count = 0;
+    ssize_t n;
+
+    while (count < len) {
+        if ((n = pwrite (fd, p + count, len - count, offset + count)) < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        count += n;
+    }
+    return 0;
+}
+
+/* 32-bit FNV-1a, continued from 'h'.
+ */
+static uint32_t checksum (uint32_t h, const void *data, size_t size)
+{
+    const uint8_t *p = data;
+    size_t i;
+
+    for (i = 0; i < size; i++) {
+        h ^= p[i];
+        h *= 16777619;
+    }
+    return h;
+}
+
+static uint32_t record_checksum (const void *hash,
+                                 int hash_size,
+                                 const void *data,
+                                 size_t size)
+{
+    return checksum (checksum (2166136261U, hash, hash_size), data, size);
+}
+
+static size_t record_header_size (struct packdb *pdb)
+{
+    return sizeof (struct record_header) + pdb->hash_size;
+}
+
+/* Read the record header and hash at 'offset' into 'buf'.
+ * Returns 0 on success, -1 with errno set on error or if the record
+ * is truncated or has bad magic (EINVAL).
+ */
+static int record_read_header (struct packdb *pdb,
+                               uint64_t offset,
+                               void *buf,
+                               struct record_header *rh)
+{
+    size_t len = record_header_size (pdb);
+    ssize_t n;
+
+    if ((n = pread_all (pdb->fd, buf, len, offset)) < 0)
+        return -1;
+    memcpy (rh, buf, sizeof (*rh));
+    if (n < len
+        || rh->magic != RECORD_MAGIC
+        || offset + len + rh->size > pdb->pack_size) {
+        errno = EINVAL;
+        return -1;
+    }
+    return 0;
+}
+
+static uint8_t *index_slot (struct index *ix, size_t slot_size, uint64_t i)
+{
+    return ix->slots + i * slot_size;
+}
+
+static uint64_t slot_get_offset (const uint8_t *slot)
+{
+    uint64_t val;
+    memcpy (&val, slot, sizeof (val));
+    return val;
+}
+
+/* Find the slot holding 'hash', or if not found, the empty slot where
+ * it would be inserted.
+ */
+static uint8_t *index_probe (struct index *ix,
+                             size_t slot_size,
+                             const void *hash,
+                             int hash_size)
+{
+    uint64_t mask = ix->hdr->nslots - 1;
+    uint64_t i;
+    uint8_t *slot;
+
+    memcpy (&i, hash, sizeof (i));
+    for (;;) {
+        slot = index_slot (ix, slot_size, i & mask);
+        if (slot_get_offset (slot) == 0
+            || memcmp (slot + sizeof (uint64_t), hash, hash_size) == 0)
+            return slot;
+        i++;
+    }
+}
+
+static void index_insert (struct index *ix,
+                          size_t slot_size,
+                          const void *hash,
+                          int hash_size,
+                          uint64_t offset)
+{
+    uint8_t *slot = index_probe (ix, slot_size, hash, hash_size);
+    uint64_t val = offset + 1;
+
+    if (slot_get_offset (slot) == 0) {
+        memcpy (slot + sizeof (uint64_t), hash, hash_size);
+        ix->hdr->count++;
+    }
+    memcpy (slot, &val, sizeof (val));
+}
+
+static void index_unmap (struct index *ix)
+{
+    int saved_errno = errno;
+    if (ix->map)
+        (void)munmap (ix->map, ix->len);
+    if (ix->fd >= 0)
+        (void)close (ix->fd);
+    ix->map = NULL;
+    ix->fd = -1;
+    errno = saved_errno;
+}
+
+static int index_map (struct index *ix, int fd, size_t len)
+{
+    void *map;
+
+    if ((map = mmap (NULL,
+                     len,
+                     PROT_READ | PROT_WRITE,
+                     MAP_SHARED,
+                     fd,
+                     0)) == MAP_FAILED)
+        return -1;
+    ix->fd = fd;
+    ix->map = map;
+    ix->len = len;
+    ix->hdr = map;
+    ix->slots = (uint8_t *)map + sizeof (struct index_header);
+    return 0;
+}
+
+/* Create an empty index file at 'path' with 'nslots' slots.
+ */
+static int index_create (struct packdb *pdb,
+                         struct index *ix,
+                         const char *path,
+                         uint64_t nslots)
+{
+    size_t len = sizeof (struct index_header) + nslots * pdb->slot_size;
+    int fd;
+
+    if ((fd = open (path, O_RDWR | O_CREAT | O_TRUNC, 0666)) < 0)
+        return -1;
+    if (ftruncate (fd, len) < 0 || index_map (ix, fd, len) < 0) {
+        ERRNO_SAFE_WRAP (close, fd);
+        return -1;
+    }
+    ix->hdr->magic = INDEX_MAGIC;
+    ix->hdr->version = INDEX_VERSION;
+    ix->hdr->hash_size = pdb->hash_size;
+    ix->hdr->slot_size = pdb->slot_size;
+    ix->hdr->generation = pdb->generation;
+    ix->hdr->nslots = nslots;
+    ix->hdr->synced_len = sizeof (struct pack_header);
+    return 0;
+}
+
+/* Map an existing index file at 'path'.
+ * Fails with EINVAL if it does not belong to the current pack.
+ */
+static int index_load (struct packdb *pdb, struct index *ix, const char *path)
+{
+    struct index_header hdr;
+    struct stat sb;
+    int fd;
+
+    if ((fd = open (path, O_RDWR)) < 0)
+        return -1;
+    if (fstat (fd, &sb) < 0
+        || pread_all (fd, &hdr, sizeof (hdr), 0) != sizeof (hdr))
+        goto error;
+    if (hdr.magic != INDEX_MAGIC
+        || hdr.version != INDEX_VERSION
+        || hdr.hash_size != pdb->hash_size
+        || hdr.slot_size != pdb->slot_size
+        || hdr.generation != pdb->generation
+        || hdr.nslots < INDEX_MIN_SLOTS
+        || (hdr.nslots & (hdr.nslots - 1)) != 0
+        || sb.st_size != sizeof (hdr) + hdr.nslots * pdb->slot_size
+        || hdr.synced_len > pdb->pack_size) {
+        errno = EINVAL;
+        goto error;
+    }
+    if (index_map (ix, fd, sb.st_size) < 0)
+        goto error;
+    return 0;
+error:
+    ERRNO_SAFE_WRAP (close, fd);
+    return -1;
+}
+
+/* Replace the index with one of 'nslots' slots, keeping only entries
+ * for records below 'limit'.
+ */
+static int index_rebuild (struct packdb *pdb, uint64_t nslots, uint64_t limit)
+{
+    struct index *ix = &pdb->ix;
+    struct index new = { .fd = -1 };
+    char path[1024];
+    char tmppath[1024];
+    uint64_t i;
+
+    if (mkpath (pdb, "pack.index", path, sizeof (path)) < 0
+        || mkpath (pdb, "pack.index.tmp", tmppath, sizeof (tmppath)) < 0
+        || index_create (pdb, &new, tmppath, nslots) < 0)
+        return -1;
+    new.hdr->synced_len = ix->hdr->synced_len;
+    new.hdr->garbage = ix->hdr->garbage;
+    new.hdr->dirty = ix->hdr->dirty;
+    for (i = 0; i < ix->hdr->nslots; i++) {
+        uint8_t *slot = index_slot (ix, pdb->slot_size, i);
+        uint64_t val = slot_get_offset (slot);
+        if (val > 0 && val - 1 < limit)
+            index_insert (&new,
+                          pdb->slot_size,
+                          slot + sizeof (uint64_t),
+                          pdb->hash_size,
+                          val - 1);
+    }
+    if (msync (new.map, new.len, MS_SYNC) < 0
+        || rename (tmppath, path) < 0) {
+        index_unmap (&new);
+        (void)unlink (tmppath);
+        return -1;
+    }
+    index_unmap (ix);
+    *ix = new;
+    return 0;
+}
+
+/* Mark the index dirty before it is first changed after a sync.
+ */
+static int index_mark_dirty (struct packdb *pdb)
+{
+    if (!pdb->ix.hdr->dirty) {
+        pdb->ix.hdr->dirty = 1;
+        if (msync (pdb->ix.map, sizeof (struct index_header), MS_SYNC) < 0)
+            return -1;
+    }
+    return 0;
+}
+
+/* Add an entry, first doubling the number of slots if one more entry
+ * would make the table more than half full.
+ */
+static int index_add (struct packdb *pdb, const void *hash, uint64_t offset)
+{
+    uint64_t nslots = pdb->ix.hdr->nslots;
+
+    if ((pdb->ix.hdr->count + 1) * 2 > nslots
+        && index_rebuild (pdb, nslots * 2, UINT64_MAX) < 0)
+        return -1;
+    index_insert (&pdb->ix, pdb->slot_size, hash, pdb->hash_size, offset);
+    return 0;
+}
+
+static uint64_t index_lookup (struct packdb *pdb, const void *hash)
+{
+    uint8_t *slot = index_probe (&pdb->ix,
+                                 pdb->slot_size,
+                                 hash,
+                                 pdb->hash_size);
+    return slot_get_offset (slot);
+}
+
+/* Add records that follow the synced part of the pack to the index.
+ * Stop at the first record that is incomplete or fails its checksum,
+ * and truncate the pack there.
+ */
+static int packdb_recover (struct packdb *pdb)
+{
+    uint64_t offset = pdb->ix.hdr->synced_len;
+    uint8_t hbuf[sizeof (struct record_header) + HASH_MAX_SIZE];
+    void *data = NULL;
+    size_t datalen = 0;
+    const void *hash = hbuf + sizeof (struct record_header);
+
+    if (offset < pdb->pack_size && index_mark_dirty (pdb) < 0)
+        return -1;
+    while (offset < pdb->pack_size) {
+        struct record_header rh;
+        size_t len;
+        ssize_t n;
+
+        if (record_read_header (pdb, offset, hbuf, &rh) < 0) {
+            if (errno != EINVAL)
+                goto error;
+            break;
+        }
+        if (datalen < rh.size) {
+            void *p;
+            if (!(p = realloc (data, rh.size)))
+                goto error;
+            data = p;
+            datalen = rh.size;
+        }
+        len = record_header_size (pdb);
+        if ((n = pread_all (pdb->fd, data, rh.size, offset + len)) != rh.size) {
+            if (n >= 0)
+                errno = EIO;
+            goto error;
+        }
+        if (rh.check != record_checksum (hash, pdb->hash_size, data, rh.size))
+            break;
+        len += rh.size;
+        if (index_lookup (pdb, hash) > 0) // duplicate of an earlier record
+            pdb->ix.hdr->garbage += len;
+        else if (index_add (pdb, hash, offset) < 0)
+            goto error;
+        offset += len;
+    }
+    if (offset < pdb->pack_size) {
+        if (ftruncate (pdb->fd, offset) < 0)
+            goto error;
+        pdb->pack_size = offset;
+    }
+    free (data);
+    return 0;
+error:
+    ERRNO_SAFE_WRAP (free, data);
+    return -1;
+}
+
+/* Open pack.data, writing a new header if it is empty or was torn
+ * before its header was complete.
+ */
+static int pack_open (struct packdb *pdb, const char *path, const char **errstr)
+{
+    struct pack_header hdr;
+    struct stat sb;
+
+    if ((pdb->fd = open (path, O_RDWR | O_CREAT, 0666)) < 0
+        || fstat (pdb->fd, &sb) < 0)
+        return -1;
+    if (sb.st_size < sizeof (hdr)) {
+        hdr.magic = PACK_MAGIC;
+        hdr.version = PACK_VERSION;
+        hdr.generation = 1;
+        if (ftruncate (pdb->fd, 0) < 0
+            || pwrite_all (pdb->fd, &hdr, sizeof (hdr), 0) < 0
+            || fsync (pdb->fd) < 0)
+            return -1;
+        pdb->pack_size = sizeof (hdr);
+    }
+    else {
+        if (pread_all (pdb->fd, &hdr, sizeof (hdr), 0) != sizeof (hdr))
+            return -1;
+        if (hdr.magic != PACK_MAGIC || hdr.version != PACK_VERSION) {
+            if (errstr)
+                *errstr = "pack.data has an unknown format";
+            errno = EINVAL;
+            return -1;
+        }
+        pdb->pack_size = sb.st_size;
+    }
+    pdb->generation = hdr.generation;
+    return 0;
+}
+
+/* Release resources without syncing.  On a failed open the index may
+ * cover only part of the pack, so it must stay dirty for the next open.
+ */
+static void packdb_close_nosync (struct packdb *pdb)
+{
+    if (pdb) {
+        int saved_errno = errno;
+        index_unmap (&pdb->ix);
+        if (pdb->fd >= 0)
+            (void)close (pdb->fd);
+        free (pdb->dbpath);
+        free (pdb);
+        errno = saved_errno;
+    }
+}
+
+void packdb_close (struct packdb *pdb)
+{
+    if (pdb) {
+        int saved_errno = errno;
+        if (pdb->fd >= 0 && pdb->ix.map)
+            (void)packdb_sync (pdb);
+        packdb_close_nosync (pdb);
+        errno = saved_errno;
+    }
+}
+
+struct packdb *packdb_open (const char *dbpath,
+                            int hash_size,
+                            bool truncate,
+                            const char **errstr)
+{
+    struct packdb *pdb;
+    char path[1024];
+
+    if (!dbpath || hash_size < sizeof (uint64_t) || hash_size > HASH_MAX_SIZE) {
+        errno = EINVAL;
+        return NULL;
+    }
+    if (!(pdb = calloc (1, sizeof (*pdb))))
+        return NULL;
+    pdb->fd = -1;
+    pdb->ix.fd = -1;
+    pdb->hash_size = hash_size;
+    pdb->slot_size = (sizeof (uint64_t) + hash_size + 7) & ~(size_t)7;
+    if (!(pdb->dbpath = strdup (dbpath)))
+        goto error;
+
+    /* Remove leftovers from an interrupted index_rebuild() or packdb_compact().
+     */
+    if (mkpath (pdb, "pack.index.tmp", path, sizeof (path)) < 0)
+        goto error_path;
+    (void)unlink (path);
+    if (mkpath (pdb, "pack.data.tmp", path, sizeof (path)) < 0)
+        goto error_path;
+    (void)unlink (path);
+
+    if (mkpath (pdb, "pack.data", path, sizeof (path)) < 0)
+        goto error_path;
+    if (truncate)
+        (void)unlink (path);
+    if (pack_open (pdb, path, errstr) < 0)
+        goto error;
+
+    if (mkpath (pdb, "pack.index", path, sizeof (path)) < 0)
+        goto error_path;
+    if (truncate || index_load (pdb, &pdb->ix, path) < 0) {
+        if (index_create (pdb, &pdb->ix, path, INDEX_MIN_SLOTS) < 0)
+            goto error;
+    }
+    else if (pdb->ix.hdr->dirty) {
+        if (index_rebuild (pdb,
+                           pdb->ix.hdr->nslots,
+                           pdb->ix.hdr->synced_len) < 0)
+            goto error;
+    }
+    if (packdb_recover (pdb) < 0 || packdb_sync (pdb) < 0)
+        goto error;
+    return pdb;
+error_path:
+    if (errstr)
+        *errstr = "dbpath too long for internal buffer";
+error:
+    packdb_close_nosync (pdb);
+    return NULL;
+}
+
+int packdb_get (struct packdb *pdb,
+                const void *hash,
+                int hash_size,
+                void **datap,
+                size_t *sizep)
+{
+    uint8_t hbuf[sizeof (struct record_header) + HASH_MAX_SIZE];
+    struct record_header rh;
+    uint64_t val;
+    uint8_t *data;
+    ssize_t n;
+
+    if (!pdb || !hash || hash_size != pdb->hash_size || !datap || !sizep) {
+        errno = EINVAL;
+        return -1;
+    }
+    if ((val = index_lookup (pdb, hash)) == 0) {
+        errno = ENOENT;
+        return -1;
+    }
+    if (record_read_header (pdb, val - 1, hbuf, &rh) < 0
+        || memcmp (hbuf + sizeof (rh), hash, hash_size) != 0) {
+        errno = EIO;
+        return -1;
+    }
+    if (!(data = malloc (rh.size + 1)))
+        return -1;
+    if ((n = pread_all (pdb->fd,
+                        data,
+                        rh.size,
+                        val - 1 + record_header_size (pdb))) != rh.size) {
+        if (n >= 0)
+            errno = EIO;
+        ERRNO_SAFE_WRAP (free, data);
+        return -1;
+    }
+    data[rh.size] = '\0';
+    *datap = data;
+    *sizep = rh.size;
+    return 0;
+}
+
+int packdb_put (struct packdb *pdb,
+                const void *hash,
+                int hash_size,
+                const void *data,
+                size_t size)
+{
+    uint8_t hbuf[sizeof (struct record_header) + HASH_MAX_SIZE];
+    struct record_header rh;
+    uint64_t offset;
+    size_t len;
+
+    if (!pdb || !hash || hash_size != pdb->hash_size || (size > 0 && !data)) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (size > UINT32_MAX) {
+        errno = EFBIG;
+        return -1;
+    }
+    if (index_lookup (pdb, hash) > 0)
+        return 0;
+    if (index_mark_dirty (pdb) < 0)
+        return -1;
+    rh.magic = RECORD_MAGIC;
+    rh.size = size;
+    rh.check = record_checksum (hash, hash_size, data, size);
+    memcpy (hbuf, &rh, sizeof (rh));
+    memcpy (hbuf + sizeof (rh), hash, hash_size);
+    len = record_header_size (pdb);
+    offset = pdb->pack_size;
+    if (pwrite_all (pdb->fd, hbuf, len, offset) < 0
+        || pwrite_all (pdb->fd, data, size, offset + len) < 0
+        || index_add (pdb, hash, offset) < 0) {
+        ERRNO_SAFE_WRAP (ftruncate, pdb->fd, offset);
+        return -1;
+    }
+    pdb->pack_size += len + size;
+    return 0;
+}
+
+int packdb_sync (struct packdb *pdb)
+{
+    if (!pdb) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (!pdb->ix.hdr->dirty && pdb->ix.hdr->synced_len == pdb->pack_size)
+        return 0;
+    /* Slots must be on disk before the header that covers them.
+     */
+    if (fsync (pdb->fd) < 0
+        || msync (pdb->ix.map, pdb->ix.len, MS_SYNC) < 0)
+        return -1;
+    pdb->ix.hdr->synced_len = pdb->pack_size;
+    pdb->ix.hdr->dirty = 0;
+    if (msync (pdb->ix.map, sizeof (struct index_header), MS_SYNC) < 0)
+        return -1;
+    return 0;
+}
+
+static int offset_cmp (const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+
+    return x < y ? -1 : x > y ? 1 : 0;
+}
+
+int packdb_compact (struct packdb *pdb)
+{
+    struct pack_header hdr;
+    struct index new = { .fd = -1 };
+    char path[1024];
+    char tmppath[1024];
+    char ixpath[1024];
+    char ixtmppath[1024];
+    uint64_t *offsets = NULL;
+    uint64_t count = 0;
+    uint64_t nslots = INDEX_MIN_SLOTS;
+    uint64_t old_generation;
+    uint64_t new_size;
+    void *buf = NULL;
+    size_t buflen = 0;
+    int fd = -1;
+    uint64_t i;
+
+    if (!pdb) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (mkpath (pdb, "pack.data", path, sizeof (path)) < 0
+        || mkpath (pdb, "pack.data.tmp", tmppath, sizeof (tmppath)) < 0
+        || mkpath (pdb, "pack.index", ixpath, sizeof (ixpath)) < 0
+        || mkpath (pdb, "pack.index.tmp", ixtmppath, sizeof (ixtmppath)) < 0)
+        return -1;
+
+    /* Copy live records in pack order, so the old pack is read sequentially.
+     */
+    if (!(offsets = calloc (pdb->ix.hdr->count + 1, sizeof (offsets[0]))))
+        return -1;
+    for (i = 0; i < pdb->ix.hdr->nslots; i++) {
+        uint64_t val = slot_get_offset (index_slot (&pdb->ix,
+                                                    pdb->slot_size,
+                                                    i));
+        if (val > 0)
+            offsets[count++] = val - 1;
+    }
+    qsort (offsets, count, sizeof (offsets[0]), offset_cmp);
+
+    old_generation = pdb->generation;
+    pdb->generation++;
+    while (nslots < count * 4)
+        nslots *= 2;
+    if (index_create (pdb, &new, ixtmppath, nslots) < 0)
+        goto error;
+    if ((fd = open (tmppath, O_RDWR | O_CREAT | O_TRUNC, 0666)) < 0)
+        goto error;
+    hdr.magic = PACK_MAGIC;
+    hdr.version = PACK_VERSION;
+    hdr.generation = pdb->generation;
+    if (pwrite_all (fd, &hdr, sizeof (hdr), 0) < 0)
+        goto error;
+    new_size = sizeof (hdr);
+    for (i = 0; i < count; i++) {
+        struct record_header rh;
+        size_t len;
+        ssize_t n;
+
+        if (buflen < record_header_size (pdb)) {
+            buflen = record_header_size (pdb);
+            if (!(buf = malloc (buflen)))
+                goto error;
+        }
+        if (record_read_header (pdb, offsets[i], buf, &rh) < 0)
+            goto error;
+        len = record_header_size (pdb) + rh.size;
+        if (buflen < len) {
+            void *p;
+            if (!(p = realloc (buf, len)))
+                goto error;
+            buf = p;
+            buflen = len;
+        }
+        if ((n = pread_all (pdb->fd, buf, len, offsets[i])) != len) {
+            if (n >= 0)
+                errno = EIO;
+            goto error;
+        }
+        if (pwrite_all (fd, buf, len, new_size) < 0)
+            goto error;
+        index_insert (&new,
+                      pdb->slot_size,
+                      (uint8_t *)buf + sizeof (rh),
+                      pdb->hash_size,
+                      new_size);
+        new_size += len;
+    }
+    new.hdr->synced_len = new_size;
+    if (fsync (fd) < 0 || msync (new.map, new.len, MS_SYNC) < 0)
+        goto error;
+
+    /* If a crash occurs between the two renames, the generation of the
+     * old index will not match the new pack, and it will be rebuilt.
+     */
+    if (rename (tmppath, path) < 0)
+        goto error;
+    /* The new pack is in place, so carry on with it even if the index
+     * could not be renamed.  The index is rebuilt on the next open then.
+     */
+    (void)rename (ixtmppath, ixpath);
+    (void)fsync_dir (pdb->dbpath);
+    (void)close (pdb->fd);
+    pdb->fd = fd;
+    pdb->pack_size = new_size;
+    index_unmap (&pdb->ix);
+    pdb->ix = new;
+    free (buf);
+    free (offsets);
+    return 0;
+error:
+    pdb->generation = old_generation;
+    index_unmap (&new);
+    if (fd >= 0)
+        ERRNO_SAFE_WRAP (close, fd);
+    ERRNO_SAFE_WRAP (unlink, tmppath);
+    ERRNO_SAFE_WRAP (unlink, ixtmppath);
+    ERRNO_SAFE_WRAP (free, buf);
+    ERRNO_SAFE_WRAP (free, offsets);
+    return -1;
+}
+
+int packdb_count (struct packdb *pdb)
+{
+    return pdb ? pdb->ix.hdr->count : 0;
+}
+
+size_t packdb_size (struct packdb *pdb)
+{
+    return pdb ? pdb->pack_size : 0;
+}
+
+size_t packdb_garbage (struct packdb *pdb)
+{
+    return pdb ? pdb->ix.hdr->garbage : 0;
+}
+
+static int checkpoint_path (struct packdb *pdb,
+                            const char *key,
+                            const char *suffix,
+                            char *buf,
+                            size_t size,
+                            const char **errstr)
+{
+    if (!pdb || !key || strlen (key) == 0 || strchr (key, '/')) {
+        errno = EINVAL;
+        if (errstr)
+            *errstr = "invalid key name";
+        return -1;
+    }
+    if (snprintf (buf,
+                  size,
+                  "%s/checkpoint.%s%s",
+                  pdb->dbpath,
+                  key,
+                  suffix) >= size) {
+        errno = EOVERFLOW;
+        if (errstr)
+            *errstr = "key name too long for internal buffer";
+        return -1;
+    }
+    return 0;
+}
+
+int packdb_checkpoint_get (struct packdb *pdb,
+                           const char *key,
+                           void **datap,
+                           size_t *sizep,
+                           const char **errstr)
+{
+    char path[1024];
+    void *data;
+    ssize_t size;
+    int fd;
+
+    if (checkpoint_path (pdb, key, "", path, sizeof (path), errstr) < 0)
+        return -1;
+    if ((fd = open (path, O_RDONLY)) < 0)
+        return -1;
+    if ((size = read_all (fd, &data)) < 0) {
+        ERRNO_SAFE_WRAP (close, fd);
+        return -1;
+    }
+    if (close (fd) < 0) {
+        ERRNO_SAFE_WRAP (free, data);
+        return -1;
+    }
+    *datap = data;
+    *sizep = size;
+    return 0;
+}
+
+int packdb_checkpoint_put (struct packdb *pdb,
+                           const char *key,
+                           const void *data,
+                           size_t size,
+                           const char **errstr)
+{
+    char path[1024];
+    char tmppath[1024];
+    int fd;
+
+    if (checkpoint_path (pdb, key, "", path, sizeof (path), errstr) < 0
+        || checkpoint_path (pdb,
+                            key,
+                            ".tmp",
+                            tmppath,
+                            sizeof (tmppath),
+                            errstr) < 0)
+        return -1;
+    if (packdb_sync (pdb) < 0)
+        return -1;
+    if ((fd = open (tmppath, O_WRONLY | O_CREAT | O_TRUNC, 0666)) < 0)
+        return -1;
+    if (write_all (fd, data, size) < 0 || fsync (fd) < 0) {
+        ERRNO_SAFE_WRAP (close, fd);
+        goto error;
+    }
+    if (close (fd) < 0
+        || rename (tmppath, path) < 0
+        || fsync_dir (pdb->dbpath) < 0)
+        goto error;
+    return 0;
+error:
+    ERRNO_SAFE_WRAP (unlink, tmppath);
+    return -1;
+}
+
+/*
+ * vi:ts=4 sw=4 expandtab
+ */
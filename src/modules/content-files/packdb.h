@@ -0,0 +1,110 @@
+/************************************************************\
+ * Copyright 2024 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+#ifndef _CONTENT_FILES_PACKDB_H
+#define _CONTENT_FILES_PACKDB_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* A packdb stores blobs in one append-only file (pack.data) within the
+ * dbpath directory, with an open addressing hash table (pack.index) that
+ * is mmapped for lookups.  Blobs are keyed by their hash digest.
+ *
+ * The index covers the pack only up to the last packdb_sync().  When the
+ * packdb is opened, records appended after that are verified and added
+ * to the index, and a torn record at the end of the pack is truncated.
+ * If the index is missing or does not match the pack, it is rebuilt.
+ */
+
+struct packdb;
+
+/* Open (creating if necessary) the packdb in directory 'dbpath', which
+ * must exist.  If 'truncate' is true, any existing pack is removed first.
+ * On failure, NULL is returned with errno set.
+ * Pass '*errstr' in pre-set to NULL and if a human readable error message
+ * is appropriate, it is assigned on error (do not free).
+ */
+struct packdb *packdb_open (const char *dbpath,
+                            int hash_size,
+                            bool truncate,
+                            const char **errstr);
+
+/* Sync and close the packdb.
+ */
+void packdb_close (struct packdb *pdb);
+
+/* Look up blob by 'hash'.
+ * On success, 'datap' and 'sizep' are assigned the blob and its size
+ * and 0 is returned (*datap must be freed).  The returned buffer is padded
+ * with an extra NULL not included in the returned size.
+ * On failure, -1 is returned with errno set (ENOENT if not found).
+ */
+int packdb_get (struct packdb *pdb,
+                const void *hash,
+                int hash_size,
+                void **datap,
+                size_t *sizep);
+
+/* Append blob 'data' of length 'size' with digest 'hash' to the pack,
+ * unless it is already stored.  Returns 0 on success, -1 on failure
+ * with errno set.
+ */
+int packdb_put (struct packdb *pdb,
+                const void *hash,
+                int hash_size,
+                const void *data,
+                size_t size);
+
+/* Make all blobs stored so far durable, and extend the index to cover them.
+ * Returns 0 on success, -1 on failure with errno set.
+ */
+int packdb_sync (struct packdb *pdb);
+
+/* Rewrite the pack without records that are not referenced by the index,
+ * and rebuild the index at a size suited to the number of blobs.
+ * Returns 0 on success, -1 on failure with errno set.
+ */
+int packdb_compact (struct packdb *pdb);
+
+/* Return the number of blobs stored.
+ */
+int packdb_count (struct packdb *pdb);
+
+/* Return the size of the pack, and the number of bytes in it that are
+ * not referenced by the index and would be reclaimed by packdb_compact().
+ */
+size_t packdb_size (struct packdb *pdb);
+size_t packdb_garbage (struct packdb *pdb);
+
+/* Get/put checkpoint 'key', stored as a separate file.  packdb_checkpoint_put()
+ * syncs the pack first, then replaces the checkpoint atomically, so that
+ * a checkpoint never refers to blobs that were lost in a crash.
+ * Return 0 on success, -1 on failure with errno set.  packdb_checkpoint_get()
+ * pads the returned buffer like packdb_get() (*datap must be freed).
+ * Pass '*errstr' in pre-set to NULL and if a human readable error message
+ * is appropriate, it is assigned on error (do not free).
+ */
+int packdb_checkpoint_get (struct packdb *pdb,
+                           const char *key,
+                           void **datap,
+                           size_t *sizep,
+                           const char **errstr);
+int packdb_checkpoint_put (struct packdb *pdb,
+                           const char *key,
+                           const void *data,
+                           size_t size,
+                           const char **errstr);
+
+#endif /* !_CONTENT_FILES_PACKDB_H */
+
+/*
+ * vi:ts=4 sw=4 expandtab
+ */
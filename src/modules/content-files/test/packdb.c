@@ -0,0 +1,447 @@
+/************************************************************\
+ * Copyright 2024 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/stat.h>
+
+#include "src/common/libtap/tap.h"
+#include "src/modules/content-files/packdb.h"
+#include "src/common/libutil/unlink_recursive.h"
+#include "src/common/libutil/read_all.h"
+
+#define HASH_SIZE 20
+
+/* Make a unique "hash" for blob number 'n' (not a real digest).
+ */
+static void mkhash (int n, char *hash)
+{
+    int i;
+    for (i = 0; i < HASH_SIZE; i++)
+        hash[i] = (n * 7919 + i * 31 + (n >> (i % 16))) & 0xff;
+    memcpy (hash, &n, sizeof (n));
+}
+
+static void mkblob (int n, char *buf, size_t *sizep)
+{
+    *sizep = snprintf (buf, 64, "blob-%d", n);
+}
+
+static bool check_blob (struct packdb *pdb, int n)
+{
+    char hash[HASH_SIZE];
+    char buf[64];
+    size_t size;
+    void *data;
+    size_t len;
+    bool match;
+
+    mkhash (n, hash);
+    mkblob (n, buf, &size);
+    if (packdb_get (pdb, hash, HASH_SIZE, &data, &len) < 0)
+        return false;
+    match = (len == size && memcmp (data, buf, size) == 0);
+    free (data);
+    return match;
+}
+
+static int put_blobs (struct packdb *pdb, int first, int count)
+{
+    int n;
+
+    for (n = first; n < first + count; n++) {
+        char hash[HASH_SIZE];
+        char buf[64];
+        size_t size;
+
+        mkhash (n, hash);
+        mkblob (n, buf, &size);
+        if (packdb_put (pdb, hash, HASH_SIZE, buf, size) < 0)
+            return -1;
+    }
+    return 0;
+}
+
+static int check_blobs (struct packdb *pdb, int first, int count)
+{
+    int n;
+
+    for (n = first; n < first + count; n++) {
+        if (!check_blob (pdb, n))
+            return -1;
+    }
+    return 0;
+}
+
+void test_badargs (const char *dbpath)
+{
+    char hash[HASH_SIZE] = { 0 };
+    const char *errstr;
+    struct packdb *pdb;
+    void *data;
+    size_t size;
+
+    errno = 0;
+    ok (packdb_open (NULL, HASH_SIZE, false, NULL) == NULL && errno == EINVAL,
+        "packdb_open dbpath=NULL fails with EINVAL");
+    errno = 0;
+    ok (packdb_open (dbpath, 4, false, NULL) == NULL && errno == EINVAL,
+        "packdb_open hash_size=4 fails with EINVAL");
+    errno = 0;
+    ok (packdb_open ("/noexist", HASH_SIZE, false, NULL) == NULL
+        && errno == ENOENT,
+        "packdb_open dbpath=/noexist fails with ENOENT");
+
+    if (!(pdb = packdb_open (dbpath, HASH_SIZE, true, NULL)))
+        BAIL_OUT ("packdb_open failed");
+    errno = 0;
+    ok (packdb_get (pdb, hash, HASH_SIZE - 1, &data, &size) < 0
+        && errno == EINVAL,
+        "packdb_get with wrong hash size fails with EINVAL");
+    errno = 0;
+    ok (packdb_put (pdb, hash, HASH_SIZE - 1, "x", 1) < 0 && errno == EINVAL,
+        "packdb_put with wrong hash size fails with EINVAL");
+    errno = 0;
+    ok (packdb_get (pdb, hash, HASH_SIZE, &data, &size) < 0 && errno == ENOENT,
+        "packdb_get unknown hash fails with ENOENT");
+    errno = 0;
+    errstr = NULL;
+    ok (packdb_checkpoint_put (pdb, "a/b", "x", 1, &errstr) < 0
+        && errno == EINVAL && errstr != NULL,
+        "packdb_checkpoint_put key=a/b fails with EINVAL and errstr");
+    errno = 0;
+    errstr = NULL;
+    ok (packdb_checkpoint_get (pdb, "noexist", &data, &size, &errstr) < 0
+        && errno == ENOENT,
+        "packdb_checkpoint_get unknown key fails with ENOENT");
+    packdb_close (pdb);
+}
+
+void test_simple (const char *dbpath)
+{
+    struct packdb *pdb;
+    char hash[HASH_SIZE];
+    size_t pack_size;
+    void *data;
+    size_t size;
+
+    if (!(pdb = packdb_open (dbpath, HASH_SIZE, true, NULL)))
+        BAIL_OUT ("packdb_open failed");
+    ok (packdb_count (pdb) == 0,
+        "packdb_count is 0 after truncate");
+    ok (put_blobs (pdb, 0, 100) == 0,
+        "packdb_put 100 blobs works");
+    ok (packdb_count (pdb) == 100,
+        "packdb_count is 100");
+    ok (check_blobs (pdb, 0, 100) == 0,
+        "packdb_get returns the 100 blobs");
+
+    pack_size = packdb_size (pdb);
+    ok (put_blobs (pdb, 0, 100) == 0
+        && packdb_count (pdb) == 100
+        && packdb_size (pdb) == pack_size,
+        "storing the same blobs again does not grow the pack");
+
+    mkhash (1000, hash);
+    ok (packdb_put (pdb, hash, HASH_SIZE, NULL, 0) == 0,
+        "packdb_put of empty blob works");
+    ok (packdb_get (pdb, hash, HASH_SIZE, &data, &size) == 0 && size == 0,
+        "packdb_get of empty blob works");
+    free (data);
+
+    ok (packdb_checkpoint_put (pdb, "foo", "bar", 3, NULL) == 0,
+        "packdb_checkpoint_put foo=bar works");
+    ok (packdb_checkpoint_put (pdb, "foo", "bazz", 4, NULL) == 0,
+        "packdb_checkpoint_put foo=bazz works (overwrite)");
+    ok (packdb_checkpoint_get (pdb, "foo", &data, &size, NULL) == 0
+        && size == 4 && !strcmp (data, "bazz"),
+        "packdb_checkpoint_get foo returns bazz");
+    free (data);
+    packdb_close (pdb);
+
+    if (!(pdb = packdb_open (dbpath, HASH_SIZE, false, NULL)))
+        BAIL_OUT ("packdb_open failed");
+    ok (packdb_count (pdb) == 101 && check_blobs (pdb, 0, 100) == 0,
+        "blobs are still there after reopen");
+    ok (packdb_garbage (pdb) == 0,
+        "pack has no garbage");
+    packdb_close (pdb);
+}
+
+void test_grow (const char *dbpath)
+{
+    struct packdb *pdb;
+
+    if (!(pdb = packdb_open (dbpath, HASH_SIZE, true, NULL)))
+        BAIL_OUT ("packdb_open failed");
+    ok (put_blobs (pdb, 0, 20000) == 0,
+        "packdb_put 20000 blobs works (index must grow)");
+    ok (packdb_count (pdb) == 20000 && check_blobs (pdb, 0, 20000) == 0,
+        "packdb_get returns the 20000 blobs");
+    packdb_close (pdb);
+
+    if (!(pdb = packdb_open (dbpath, HASH_SIZE, false, NULL)))
+        BAIL_OUT ("packdb_open failed");
+    ok (packdb_count (pdb) == 20000 && check_blobs (pdb, 0, 20000) == 0,
+        "the 20000 blobs are still there after reopen");
+    packdb_close (pdb);
+}
+
+static int path_append (const char *dbpath,
+                        const char *name,
+                        const void *data,
+                        size_t size)
+{
+    char path[1024];
+    int fd;
+    int rc = 0;
+
+    snprintf (path, sizeof (path), "%s/%s", dbpath, name);
+    if ((fd = open (path, O_WRONLY | O_APPEND)) < 0)
+        return -1;
+    if (write (fd, data, size) != size)
+        rc = -1;
+    close (fd);
+    return rc;
+}
+
+static int path_unlink (const char *dbpath, const char *name)
+{
+    char path[1024];
+
+    snprintf (path, sizeof (path), "%s/%s", dbpath, name);
+    return unlink (path);
+}
+
+void test_recovery (const char *dbpath)
+{
+    struct packdb *pdb;
+    size_t pack_size;
+    char junk[100];
+    pid_t pid;
+    int status;
+
+    if (!(pdb = packdb_open (dbpath, HASH_SIZE, true, NULL)))
+        BAIL_OUT ("packdb_open failed");
+    if (put_blobs (pdb, 0, 100) < 0 || packdb_sync (pdb) < 0)
+        BAIL_OUT ("packdb_put failed");
+    pack_size = packdb_size (pdb);
+    packdb_close (pdb);
+
+    /* torn record at end of pack */
+    memset (junk, 0x42, sizeof (junk));
+    ok (path_append (dbpath, "pack.data", junk, sizeof (junk)) == 0,
+        "appended junk to pack.data");
+    pdb = packdb_open (dbpath, HASH_SIZE, false, NULL);
+    ok (pdb != NULL,
+        "packdb_open works");
+    ok (packdb_size (pdb) == pack_size,
+        "junk was truncated");
+    ok (packdb_count (pdb) == 100 && check_blobs (pdb, 0, 100) == 0,
+        "blobs are intact");
+    packdb_close (pdb);
+
+    /* crash before sync */
+    pid = fork ();
+    if (pid < 0)
+        BAIL_OUT ("fork failed");
+    if (pid == 0) {
+        if (!(pdb = packdb_open (dbpath, HASH_SIZE, false, NULL))
+            || put_blobs (pdb, 100, 100) < 0)
+            _exit (1);
+        _exit (0);
+    }
+    ok (waitpid (pid, &status, 0) == pid
+        && WIFEXITED (status)
+        && WEXITSTATUS (status) == 0,
+        "child stored more blobs and exited without closing");
+    pdb = packdb_open (dbpath, HASH_SIZE, false, NULL);
+    ok (pdb != NULL,
+        "packdb_open works");
+    ok (packdb_count (pdb) == 200 && check_blobs (pdb, 0, 200) == 0,
+        "unsynced blobs were recovered");
+    ok (packdb_garbage (pdb) == 0,
+        "pack has no garbage");
+    packdb_close (pdb);
+
+    /* lost index */
+    ok (path_unlink (dbpath, "pack.index") == 0,
+        "removed pack.index");
+    pdb = packdb_open (dbpath, HASH_SIZE, false, NULL);
+    ok (pdb != NULL,
+        "packdb_open works");
+    ok (packdb_count (pdb) == 200 && check_blobs (pdb, 0, 200) == 0,
+        "index was rebuilt");
+    packdb_close (pdb);
+}
+
+/* Read the dirty flag from the pack.index header.
+ * N.B. this depends on the index header layout in packdb.c.
+ */
+static int index_dirty (const char *dbpath, uint64_t *dirty)
+{
+    char path[1024];
+    int fd;
+    int rc = 0;
+
+    snprintf (path, sizeof (path), "%s/pack.index", dbpath);
+    if ((fd = open (path, O_RDONLY)) < 0)
+        return -1;
+    if (pread (fd, dirty, sizeof (*dirty), 56) != sizeof (*dirty))
+        rc = -1;
+    close (fd);
+    return rc;
+}
+
+void test_recovery_fail (const char *dbpath)
+{
+    struct packdb *pdb;
+    char path[1024];
+    uint64_t dirty;
+    pid_t pid;
+    int status;
+
+    if (!(pdb = packdb_open (dbpath, HASH_SIZE, true, NULL)))
+        BAIL_OUT ("packdb_open failed");
+    if (put_blobs (pdb, 0, 10) < 0 || packdb_sync (pdb) < 0)
+        BAIL_OUT ("packdb_put failed");
+    packdb_close (pdb);
+
+    /* leave a dirty index with a stale synced_len */
+    pid = fork ();
+    if (pid < 0)
+        BAIL_OUT ("fork failed");
+    if (pid == 0) {
+        if (!(pdb = packdb_open (dbpath, HASH_SIZE, false, NULL))
+            || put_blobs (pdb, 10, 10) < 0)
+            _exit (1);
+        _exit (0);
+    }
+    ok (waitpid (pid, &status, 0) == pid
+        && WIFEXITED (status)
+        && WEXITSTATUS (status) == 0,
+        "child stored more blobs and exited without closing");
+
+    /* A directory in place of pack.index.tmp makes the index rebuild
+     * on open fail.
+     */
+    snprintf (path, sizeof (path), "%s/pack.index.tmp", dbpath);
+    if (mkdir (path, 0700) < 0)
+        BAIL_OUT ("mkdir %s failed", path);
+    ok (packdb_open (dbpath, HASH_SIZE, false, NULL) == NULL,
+        "packdb_open fails when index rebuild fails");
+    ok (index_dirty (dbpath, &dirty) == 0 && dirty != 0,
+        "index is still marked dirty after failed open");
+    if (rmdir (path) < 0)
+        BAIL_OUT ("rmdir %s failed", path);
+
+    pdb = packdb_open (dbpath, HASH_SIZE, false, NULL);
+    ok (pdb != NULL,
+        "packdb_open works");
+    ok (packdb_count (pdb) == 20 && check_blobs (pdb, 0, 20) == 0,
+        "unsynced blobs were recovered");
+    packdb_close (pdb);
+}
+
+void test_compact (const char *dbpath)
+{
+    struct packdb *pdb;
+    size_t pack_size;
+    char path[1024];
+    void *data;
+    ssize_t size;
+    int fd;
+
+    if (!(pdb = packdb_open (dbpath, HASH_SIZE, true, NULL)))
+        BAIL_OUT ("packdb_open failed");
+    if (put_blobs (pdb, 0, 1000) < 0)
+        BAIL_OUT ("packdb_put failed");
+    pack_size = packdb_size (pdb);
+    packdb_close (pdb);
+
+    /* Append a second copy of all the records, which become garbage
+     * when the unsynced part of the pack is scanned on open.
+     * The pack header is 16 bytes.
+     */
+    snprintf (path, sizeof (path), "%s/pack.data", dbpath);
+    if ((fd = open (path, O_RDONLY)) < 0
+        || (size = read_all (fd, &data)) < 0)
+        BAIL_OUT ("could not read pack.data");
+    close (fd);
+    ok (path_append (dbpath, "pack.data", data + 16, size - 16) == 0,
+        "appended a copy of all records to pack.data");
+    free (data);
+    if (!(pdb = packdb_open (dbpath, HASH_SIZE, false, NULL)))
+        BAIL_OUT ("packdb_open failed");
+    ok (packdb_count (pdb) == 1000
+        && packdb_garbage (pdb) == pack_size - 16
+        && packdb_size (pdb) == pack_size * 2 - 16,
+        "duplicate records are counted as garbage");
+
+    errno = 0;
+    ok (packdb_compact (NULL) < 0 && errno == EINVAL,
+        "packdb_compact pdb=NULL fails with EINVAL");
+    ok (packdb_compact (pdb) == 0,
+        "packdb_compact works");
+    ok (packdb_size (pdb) == pack_size && packdb_garbage (pdb) == 0,
+        "garbage was reclaimed");
+    ok (packdb_count (pdb) == 1000 && check_blobs (pdb, 0, 1000) == 0,
+        "blobs are intact after compaction");
+    ok (put_blobs (pdb, 1000, 10) == 0 && check_blobs (pdb, 0, 1010) == 0,
+        "more blobs can be stored after compaction");
+    packdb_close (pdb);
+
+    if (!(pdb = packdb_open (dbpath, HASH_SIZE, false, NULL)))
+        BAIL_OUT ("packdb_open failed");
+    ok (packdb_count (pdb) == 1010 && check_blobs (pdb, 0, 1010) == 0,
+        "blobs are intact after reopen");
+    packdb_close (pdb);
+}
+
+int main (int argc, char *argv[])
+{
+    char dir[1024];
+    const char *tmp = getenv ("TMPDIR");
+
+    plan (NO_PLAN);
+
+    if (!tmp)
+        tmp = "/tmp";
+    if (snprintf (dir, sizeof (dir), "%s/packdb.XXXXXX", tmp) >= sizeof (dir))
+        BAIL_OUT ("internal buffer ovverflow");
+    if (!mkdtemp (dir))
+        BAIL_OUT ("mkdtemp failed");
+    diag ("mkdir %s", dir);
+
+    test_badargs (dir);
+    test_simple (dir);
+    test_grow (dir);
+    test_recovery (dir);
+    test_recovery_fail (dir);
+    test_compact (dir);
+
+    if (unlink_recursive (dir) < 0)
+        BAIL_OUT ("unlink_recursive failed");
+
+    done_testing ();
+    return (0);
+}
+
+// vi: ts=4 sw=4 expandtab
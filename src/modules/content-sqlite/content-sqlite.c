@@ -18,6 +18,11 @@
 #include <unistd.h>
 #include <unistd.h>
 #include <sys/statvfs.h>
+#include <strings.h>
+#include <sys/eventfd.h>
+#include <pthread.h>
+#include <signal.h>
+#include <time.h>
 #include <sqlite3.h>
 #include <lz4.h>
 #include <flux/core.h>
@@ -29,8 +34,12 @@
 #include "src/common/libutil/errno_safe.h"
 #include "src/common/libutil/tstat.h"
 #include "src/common/libutil/monotime.h"
+#include "src/common/libutil/fsd.h"
+#include "src/common/libczmqcontainers/czmq_containers.h"
+#include "src/common/libccan/ccan/list/list.h"
 
 #include "src/common/libcontent/content-util.h"
+#include "src/common/libcontent/content-batch.h"
 
 const size_t lzo_buf_chunksize = 1024*1024;
 const size_t compression_threshold = 256; /* compress blobs >= this size */
@@ -60,6 +69,8 @@ struct content_stats {
     tstat_t store;
 };
 
+struct writeback;
+
 struct content_sqlite {
     flux_msg_handler_t **handlers;
     char *dbfile;
@@ -77,6 +88,13 @@ struct content_sqlite {
     const char *journal_mode;
     const char *synchronous;
     bool truncate;
+    bool shared;                /* another connection has the db open */
+    bool readonly;              /* open the db read-only */
+    bool iothread;              /* errors are saved to errstr, not logged */
+    char errstr[128];
+    bool writeback;
+    double writeback_interval;
+    struct writeback *wb;       /* NULL unless in writeback mode */
 };
 
 static void log_sqlite_error (struct content_sqlite *ctx, const char *fmt, ...)
@@ -88,6 +106,19 @@ static void log_sqlite_error (struct content_sqlite *ctx, const char *fmt, ...)
     (void)vsnprintf (buf, sizeof (buf), fmt, ap);
     va_end (ap);
 
+    /* The flux_t handle may not be used from the I/O thread.
+     * Save the error so it can be logged from the reactor thread.
+     */
+    if (ctx->iothread) {
+        const char *errmsg = ctx->db ? sqlite3_errmsg (ctx->db) : NULL;
+        snprintf (ctx->errstr,
+                  sizeof (ctx->errstr),
+                  "%s: %s(%d)",
+                  buf,
+                  errmsg ? errmsg : "unknown error code",
+                  ctx->db ? sqlite3_extended_errcode (ctx->db) : 0);
+        return;
+    }
     if (ctx->db) {
         const char *errmsg = sqlite3_errmsg (ctx->db);
         flux_log (ctx->h,
@@ -212,26 +243,18 @@ error:
     return -1;
 }
 
-/* Store blob to objects table, compressing if necessary.
- * hash over 'data' is stored to 'hash'.
- * Returns hash size on success, -1 on error with errno set.
+/* Insert blob with precomputed 'hash' to objects table, compressing
+ * if necessary.
+ * Returns 0 on success, -1 on error with errno set.
  */
-static int content_sqlite_store (struct content_sqlite *ctx,
-                                 const void *data,
-                                 int size,
-                                 void *hash,
-                                 int hash_len)
+static int content_sqlite_insert (struct content_sqlite *ctx,
+                                  const void *hash,
+                                  int hash_size,
+                                  const void *data,
+                                  int size)
 {
     int uncompressed_size = -1;
-    int hash_size;
 
-    if ((hash_size = blobref_hash_raw (ctx->hashfun,
-                                       data,
-                                       size,
-                                       hash,
-                                       hash_len)) < 0)
-        return -1;
-    assert (hash_size == ctx->hash_size);
     if (size >= compression_threshold) {
         int r;
         int out_len = LZ4_compressBound(size);
@@ -248,7 +271,7 @@ static int content_sqlite_store (struct content_sqlite *ctx,
     }
     if (sqlite3_bind_text (ctx->store_stmt,
                            1,
-                           hash,
+                           (char *)hash,
                            hash_size,
                            SQLITE_STATIC) != SQLITE_OK) {
         log_sqlite_error (ctx, "store: binding key");
@@ -282,12 +305,544 @@ static int content_sqlite_store (struct content_sqlite *ctx,
         goto error;
     }
     sqlite3_reset (ctx->store_stmt);
-    return hash_size;
+    return 0;
 error:
     ERRNO_SAFE_WRAP (sqlite3_reset, ctx->store_stmt);
     return -1;
 }
 
+/* Store blob to objects table, compressing if necessary.
+ * hash over 'data' is stored to 'hash'.
+ * Returns hash size on success, -1 on error with errno set.
+ */
+static int content_sqlite_store (struct content_sqlite *ctx,
+                                 const void *data,
+                                 int size,
+                                 void *hash,
+                                 int hash_len)
+{
+    int hash_size;
+
+    if ((hash_size = blobref_hash_raw (ctx->hashfun,
+                                       data,
+                                       size,
+                                       hash,
+                                       hash_len)) < 0)
+        return -1;
+    assert (hash_size == ctx->hash_size);
+    if (content_sqlite_insert (ctx, hash, hash_size, data, size) < 0)
+        return -1;
+    return hash_size;
+}
+
+/* Execute a statement such as BEGIN or COMMIT.
+ * Returns 0 on success, -1 on failure with errno set.
+ */
+static int content_sqlite_exec (struct content_sqlite *ctx, const char *sql)
+{
+    if (sqlite3_exec (ctx->db, sql, NULL, NULL, NULL) != SQLITE_OK) {
+        log_sqlite_error (ctx, "%s", sql);
+        set_errno_from_sqlite_error (ctx);
+        return -1;
+    }
+    return 0;
+}
+
+/* Write checkpoint 'value' under 'key' to checkpt table.
+ * Returns 0 on success, -1 on error with errno set.
+ */
+static int content_sqlite_checkpt_put (struct content_sqlite *ctx,
+                                       const char *key,
+                                       const char *value)
+{
+    if (sqlite3_bind_text (ctx->checkpt_put_stmt,
+                           1,
+                           (char *)key,
+                           strlen (key),
+                           SQLITE_STATIC) != SQLITE_OK) {
+        log_sqlite_error (ctx, "checkpt_put: binding key");
+        set_errno_from_sqlite_error (ctx);
+        goto error;
+    }
+    if (sqlite3_bind_text (ctx->checkpt_put_stmt,
+                           2,
+                           value,
+                           strlen (value),
+                           SQLITE_STATIC) != SQLITE_OK) {
+        log_sqlite_error (ctx, "checkpt_put: binding value");
+        set_errno_from_sqlite_error (ctx);
+        goto error;
+    }
+    if (sqlite3_step (ctx->checkpt_put_stmt) != SQLITE_DONE
+                    && sqlite3_errcode (ctx->db) != SQLITE_CONSTRAINT) {
+        log_sqlite_error (ctx, "checkpt_put: executing stmt");
+        set_errno_from_sqlite_error (ctx);
+        goto error;
+    }
+    (void )sqlite3_reset (ctx->checkpt_put_stmt);
+    return 0;
+error:
+    ERRNO_SAFE_WRAP (sqlite3_reset, ctx->checkpt_put_stmt);
+    return -1;
+}
+
+/* Write-behind mode.
+ *
+ * Stores and checkpoint updates are queued to an I/O thread that has its
+ * own read-write connection to the database.  The thread applies all
+ * queued requests in one transaction, and starts a new transaction at
+ * most once per group commit interval.  Stores are answered as soon as
+ * they are queued, so store throughput is bounded by disk bandwidth, not
+ * by the latency of a transaction per blob.  A checkpoint update is
+ * answered once it has been committed.  The queue is ordered, so a
+ * committed checkpoint never refers to a blob that is not yet on disk.
+ *
+ * Loads are served on the reactor thread from a read-only connection.
+ * Blobs that are queued but not yet committed are found in the 'pending'
+ * hash first, so a load always sees an earlier store.
+ *
+ * When more than writeback_max_bytes are queued, store responses are held
+ * until the blob is committed, to bound memory use.  A failed commit is
+ * sticky:  later stores and checkpoint updates fail until the module is
+ * reloaded.
+ */
+enum {
+    WB_STORE,
+    WB_CHECKPT,
+};
+
+struct wb_entry {
+    struct list_node list;
+    int type;                       // WB_STORE or WB_CHECKPT
+    const flux_msg_t *msg;          // request
+    bool respond;                   // respond to msg once committed
+    int errnum;                     // set by I/O thread if commit failed
+
+    /* WB_STORE */
+    const void *data;               // points into msg payload
+    int size;
+    uint8_t hash[BLOBREF_MAX_DIGEST_SIZE];
+    int hash_size;
+    char blobref[BLOBREF_MAX_STRING_SIZE];
+    struct content_batch *reply;    // store-batch response (if respond)
+
+    /* WB_CHECKPT */
+    char *key;
+    char *value;
+};
+
+struct writeback {
+    struct content_sqlite *wctx;    // I/O thread's connection
+    double interval;                // group commit interval (seconds)
+    pthread_t thread;
+    bool started;
+
+    /* Protected by 'lock'.
+     */
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    struct list_head queue;         // reactor -> I/O thread
+    size_t queue_bytes;
+    struct list_head done;          // I/O thread -> reactor
+    char errstr[128];
+    bool shutdown;
+
+    /* Reactor thread only.
+     */
+    int efd;                        // signaled when 'done' is not empty
+    flux_watcher_t *w;
+    zhashx_t *pending;              // blobref => struct wb_entry
+    size_t pending_bytes;
+    int errnum;                     // sticky commit error
+};
+
+const size_t writeback_max_bytes = 64*1024*1024;
+const size_t writeback_batch_bytes = 16*1024*1024;
+
+static void wb_entry_destroy (struct wb_entry *e)
+{
+    if (e) {
+        int saved_errno = errno;
+        flux_msg_decref (e->msg);
+        content_batch_destroy (e->reply);
+        free (e->key);
+        free (e->value);
+        free (e);
+        errno = saved_errno;
+    }
+}
+
+static struct wb_entry *wb_entry_create (int type, const flux_msg_t *msg)
+{
+    struct wb_entry *e;
+
+    if (!(e = calloc (1, sizeof (*e))))
+        return NULL;
+    e->type = type;
+    e->msg = flux_msg_incref (msg);
+    return e;
+}
+
+static void wb_entry_list_destroy (struct list_head *l)
+{
+    struct wb_entry *e;
+
+    while ((e = list_pop (l, struct wb_entry, list)))
+        wb_entry_destroy (e);
+}
+
+/* Create a store entry for 'data', which is contained in the payload
+ * of 'msg', computing its hash.
+ */
+static struct wb_entry *wb_entry_create_store (struct content_sqlite *ctx,
+                                               const flux_msg_t *msg,
+                                               const void *data,
+                                               int size)
+{
+    struct wb_entry *e;
+
+    if (!(e = wb_entry_create (WB_STORE, msg)))
+        return NULL;
+    if ((e->hash_size = blobref_hash_raw (ctx->hashfun,
+                                          data,
+                                          size,
+                                          e->hash,
+                                          sizeof (e->hash))) < 0
+        || blobref_hashtostr (ctx->hashfun,
+                              e->hash,
+                              e->hash_size,
+                              e->blobref,
+                              sizeof (e->blobref)) < 0) {
+        wb_entry_destroy (e);
+        return NULL;
+    }
+    assert (e->hash_size == ctx->hash_size);
+    e->data = data;
+    e->size = size;
+    return e;
+}
+
+/* Hold store responses if too much data is waiting to be written.
+ */
+static bool writeback_congested (struct writeback *wb)
+{
+    return wb->pending_bytes >= writeback_max_bytes;
+}
+
+/* Look up a blob that is queued but not yet committed.
+ */
+static struct wb_entry *writeback_lookup (struct content_sqlite *ctx,
+                                          const void *hash,
+                                          int hash_size)
+{
+    char blobref[BLOBREF_MAX_STRING_SIZE];
+
+    if (zhashx_size (ctx->wb->pending) == 0
+        || blobref_hashtostr (ctx->hashfun,
+                              hash,
+                              hash_size,
+                              blobref,
+                              sizeof (blobref)) < 0)
+        return NULL;
+    return zhashx_lookup (ctx->wb->pending, blobref);
+}
+
+/* Move 'entries' to the I/O thread's queue.
+ */
+static void writeback_enqueue (struct writeback *wb, struct list_head *entries)
+{
+    struct wb_entry *e;
+    size_t bytes = 0;
+
+    list_for_each (entries, e, list) {
+        if (e->type == WB_STORE) {
+            (void)zhashx_insert (wb->pending, e->blobref, e);
+            bytes += e->size;
+        }
+    }
+    wb->pending_bytes += bytes;
+
+    pthread_mutex_lock (&wb->lock);
+    list_append_list (&wb->queue, entries);
+    wb->queue_bytes += bytes;
+    pthread_cond_signal (&wb->cond);
+    pthread_mutex_unlock (&wb->lock);
+}
+
+/* Queue a blob stored with content-backing.store, and respond with its
+ * hash unless congested.
+ */
+static int writeback_store (struct content_sqlite *ctx,
+                            const flux_msg_t *msg,
+                            const void *data,
+                            int size)
+{
+    struct writeback *wb = ctx->wb;
+    struct wb_entry *e;
+    struct list_head l;
+
+    if (wb->errnum) {
+        errno = wb->errnum;
+        return -1;
+    }
+    if (!(e = wb_entry_create_store (ctx, msg, data, size)))
+        return -1;
+    if (writeback_congested (wb))
+        e->respond = true;
+    else if (flux_respond_raw (ctx->h, msg, e->hash, e->hash_size) < 0)
+        flux_log_error (ctx->h, "store: flux_respond_raw");
+    list_head_init (&l);
+    list_add_tail (&l, &e->list);
+    writeback_enqueue (wb, &l);
+    return 0;
+}
+
+/* Queue the blobs stored with content-backing.store-batch, and respond
+ * with their hashes unless congested.  If congested, the response is
+ * attached to the last entry, which is committed after the others.
+ */
+static int writeback_store_batch (struct content_sqlite *ctx,
+                                  const flux_msg_t *msg,
+                                  const void *buf,
+                                  int len)
+{
+    struct writeback *wb = ctx->wb;
+    struct content_batch *b;
+    struct list_head l;
+    struct wb_entry *e;
+    int cursor = 0;
+    const void *data;
+    int size;
+    int rc;
+
+    if (wb->errnum) {
+        errno = wb->errnum;
+        return -1;
+    }
+    if (!(b = content_batch_create ()))
+        return -1;
+    list_head_init (&l);
+    while ((rc = content_batch_next (buf,
+                                     len,
+                                     &cursor,
+                                     NULL,
+                                     &data,
+                                     &size)) > 0) {
+        if (!(e = wb_entry_create_store (ctx, msg, data, size)))
+            goto error;
+        list_add_tail (&l, &e->list);
+        if (content_batch_append (b, 0, e->hash, e->hash_size) < 0)
+            goto error;
+    }
+    if (rc < 0)
+        goto error;
+    if (writeback_congested (wb) && (e = list_tail (&l, struct wb_entry, list))) {
+        e->respond = true;
+        e->reply = b;
+    }
+    else {
+        buf = content_batch_data (b, &len);
+        if (flux_respond_raw (ctx->h, msg, buf, len) < 0)
+            flux_log_error (ctx->h, "store-batch: flux_respond_raw");
+        content_batch_destroy (b);
+    }
+    writeback_enqueue (wb, &l);
+    return 0;
+error:
+    wb_entry_list_destroy (&l);
+    content_batch_destroy (b);
+    return -1;
+}
+
+/* Queue a checkpoint update.  The response is sent once it is committed.
+ */
+static int writeback_checkpoint_put (struct content_sqlite *ctx,
+                                     const flux_msg_t *msg,
+                                     const char *key,
+                                     const char *value)
+{
+    struct writeback *wb = ctx->wb;
+    struct wb_entry *e;
+    struct list_head l;
+
+    if (wb->errnum) {
+        errno = wb->errnum;
+        return -1;
+    }
+    if (!(e = wb_entry_create (WB_CHECKPT, msg)))
+        return -1;
+    if (!(e->key = strdup (key)) || !(e->value = strdup (value))) {
+        wb_entry_destroy (e);
+        return -1;
+    }
+    e->respond = true;
+    list_head_init (&l);
+    list_add_tail (&l, &e->list);
+    writeback_enqueue (wb, &l);
+    return 0;
+}
+
+/* Apply 'batch' in one transaction (I/O thread).
+ * On failure, errnum is set in every entry.
+ */
+static void writeback_apply (struct writeback *wb, struct list_head *batch)
+{
+    struct content_sqlite *wctx = wb->wctx;
+    struct wb_entry *e;
+    int rc;
+
+    if (content_sqlite_exec (wctx, "BEGIN") < 0)
+        goto error;
+    list_for_each (batch, e, list) {
+        if (e->type == WB_STORE)
+            rc = content_sqlite_insert (wctx,
+                                        e->hash,
+                                        e->hash_size,
+                                        e->data,
+                                        e->size);
+        else
+            rc = content_sqlite_checkpt_put (wctx, e->key, e->value);
+        if (rc < 0)
+            goto error_rollback;
+    }
+    if (content_sqlite_exec (wctx, "COMMIT") < 0)
+        goto error_rollback;
+    return;
+error_rollback:
+    ERRNO_SAFE_WRAP (sqlite3_exec, wctx->db, "ROLLBACK", NULL, NULL, NULL);
+error:
+    rc = errno;
+    list_for_each (batch, e, list)
+        e->errnum = rc;
+}
+
+static void *writeback_thread (void *arg)
+{
+    struct writeback *wb = arg;
+    struct list_head batch;
+    struct timespec next = { 0 }; // earliest start of the next transaction
+    uint64_t one = 1;
+
+    list_head_init (&batch);
+    pthread_mutex_lock (&wb->lock);
+    for (;;) {
+        while (list_empty (&wb->queue) && !wb->shutdown)
+            pthread_cond_wait (&wb->cond, &wb->lock);
+        if (list_empty (&wb->queue))
+            break;
+        /* Let more requests accumulate until the group commit interval
+         * has elapsed, unless unloading or a lot of data is already queued.
+         */
+        while (!wb->shutdown
+               && wb->queue_bytes < writeback_batch_bytes
+               && pthread_cond_timedwait (&wb->cond,
+                                          &wb->lock,
+                                          &next) != ETIMEDOUT)
+            ;
+        list_append_list (&batch, &wb->queue);
+        wb->queue_bytes = 0;
+        pthread_mutex_unlock (&wb->lock);
+
+        clock_gettime (CLOCK_MONOTONIC, &next);
+        next.tv_sec += (time_t)wb->interval;
+        next.tv_nsec += (long)((wb->interval - (time_t)wb->interval) * 1E9);
+        if (next.tv_nsec >= 1000000000L) {
+            next.tv_sec++;
+            next.tv_nsec -= 1000000000L;
+        }
+        wb->wctx->errstr[0] = '\0';
+        writeback_apply (wb, &batch);
+
+        pthread_mutex_lock (&wb->lock);
+        if (wb->wctx->errstr[0] != '\0')
+            snprintf (wb->errstr, sizeof (wb->errstr), "%s", wb->wctx->errstr);
+        list_append_list (&wb->done, &batch);
+        if (write (wb->efd, &one, sizeof (one)) < 0) {
+            /* counter overflow is the only possible failure, and it
+             * means the reactor thread has already been signaled */
+        }
+    }
+    pthread_mutex_unlock (&wb->lock);
+    return NULL;
+}
+
+static void writeback_respond (struct content_sqlite *ctx, struct wb_entry *e)
+{
+    flux_t *h = ctx->h;
+    int errnum = e->errnum ? e->errnum : ctx->wb->errnum;
+
+    if (errnum) {
+        if (flux_respond_error (h, e->msg, errnum, NULL) < 0)
+            flux_log_error (h, "writeback: flux_respond_error");
+    }
+    else if (e->type == WB_CHECKPT) {
+        if (flux_respond (h, e->msg, NULL) < 0)
+            flux_log_error (h, "writeback: flux_respond");
+    }
+    else if (e->reply) {
+        const void *buf;
+        int len;
+
+        buf = content_batch_data (e->reply, &len);
+        if (flux_respond_raw (h, e->msg, buf, len) < 0)
+            flux_log_error (h, "writeback: flux_respond_raw");
+    }
+    else {
+        if (flux_respond_raw (h, e->msg, e->hash, e->hash_size) < 0)
+            flux_log_error (h, "writeback: flux_respond_raw");
+    }
+}
+
+/* Finish entries that the I/O thread has committed (reactor thread).
+ */
+static void writeback_complete (struct content_sqlite *ctx)
+{
+    struct writeback *wb = ctx->wb;
+    struct list_head done;
+    struct wb_entry *e;
+    char errstr[sizeof (wb->errstr)];
+
+    list_head_init (&done);
+    pthread_mutex_lock (&wb->lock);
+    list_append_list (&done, &wb->done);
+    snprintf (errstr, sizeof (errstr), "%s", wb->errstr);
+    wb->errstr[0] = '\0';
+    pthread_mutex_unlock (&wb->lock);
+
+    if (errstr[0] != '\0')
+        flux_log (ctx->h, LOG_ERR, "writeback: %s", errstr);
+    while ((e = list_pop (&done, struct wb_entry, list))) {
+        if (e->errnum && !wb->errnum) {
+            wb->errnum = e->errnum;
+            flux_log (ctx->h,
+                      LOG_CRIT,
+                      "writeback: commit failed: %s, further updates will fail",
+                      strerror (e->errnum));
+        }
+        if (e->type == WB_STORE) {
+            if (zhashx_lookup (wb->pending, e->blobref) == e)
+                zhashx_delete (wb->pending, e->blobref);
+            wb->pending_bytes -= e->size;
+        }
+        if (e->respond)
+            writeback_respond (ctx, e);
+        wb_entry_destroy (e);
+    }
+}
+
+static void writeback_done_cb (flux_reactor_t *r,
+                               flux_watcher_t *w,
+                               int revents,
+                               void *arg)
+{
+    struct content_sqlite *ctx = arg;
+    uint64_t count;
+
+    if (read (ctx->wb->efd, &count, sizeof (count)) < 0 && errno != EAGAIN)
+        flux_log_error (ctx->h, "writeback: read eventfd");
+    writeback_complete (ctx);
+}
+
 static void load_cb (flux_t *h,
                      flux_msg_handler_t *mh,
                      const flux_msg_t *msg,
@@ -299,6 +854,7 @@ static void load_cb (flux_t *h,
     const void *data;
     int size;
     struct timespec t0;
+    struct wb_entry *e;
 
     if (flux_request_decode_raw (msg,
                                  NULL,
@@ -309,6 +865,11 @@ static void load_cb (flux_t *h,
         errno = EPROTO;
         goto error;
     }
+    if (ctx->wb && (e = writeback_lookup (ctx, hash, hash_size))) {
+        if (flux_respond_raw (h, msg, e->data, e->size) < 0)
+            flux_log_error (h, "load: flux_respond_raw");
+        return;
+    }
     monotime (&t0);
     if (content_sqlite_load (ctx, hash, hash_size, &data, &size) < 0)
         goto error;
@@ -339,6 +900,12 @@ void store_cb (flux_t *h,
         goto error;
     }
     monotime (&t0);
+    if (ctx->wb) {
+        if (writeback_store (ctx, msg, data, size) < 0)
+            goto error;
+        tstat_push (&ctx->stats.store, monotime_since (t0));
+        return;
+    }
     if ((hash_size = content_sqlite_store (ctx,
                                            data,
                                            size,
@@ -354,6 +921,147 @@ error:
         flux_log_error (h, "store: flux_respond_error");
 }
 
+/* Handle a content-backing.load-batch request.  All of the blobs are
+ * loaded within a single transaction.  See content-batch.h for the
+ * payload format.
+ */
+static void load_batch_cb (flux_t *h,
+                           flux_msg_handler_t *mh,
+                           const flux_msg_t *msg,
+                           void *arg)
+{
+    struct content_sqlite *ctx = arg;
+    struct content_batch *b = NULL;
+    const void *buf;
+    int len;
+    int cursor = 0;
+    const void *hash;
+    int hash_size;
+    int rc;
+
+    if (flux_request_decode_raw (msg, NULL, &buf, &len) < 0
+        || !(b = content_batch_create ()))
+        goto error;
+    if (content_sqlite_exec (ctx, "BEGIN") < 0)
+        goto error;
+    while ((rc = content_batch_next (buf,
+                                     len,
+                                     &cursor,
+                                     NULL,
+                                     &hash,
+                                     &hash_size)) > 0) {
+        const void *data;
+        int size;
+        struct timespec t0;
+        struct wb_entry *e;
+
+        if (hash_size != ctx->hash_size) {
+            errno = EPROTO;
+            goto error_rollback;
+        }
+        if (ctx->wb && (e = writeback_lookup (ctx, hash, hash_size))) {
+            if (content_batch_append (b, 0, e->data, e->size) < 0)
+                goto error_rollback;
+            continue;
+        }
+        monotime (&t0);
+        if (content_sqlite_load (ctx, hash, hash_size, &data, &size) < 0) {
+            if (errno != ENOENT)
+                goto error_rollback;
+            if (content_batch_append (b, ENOENT, NULL, 0) < 0)
+                goto error_rollback;
+            continue;
+        }
+        tstat_push (&ctx->stats.load, monotime_since (t0));
+        rc = content_batch_append (b, 0, data, size);
+        (void )sqlite3_reset (ctx->load_stmt);
+        if (rc < 0)
+            goto error_rollback;
+    }
+    if (rc < 0)
+        goto error_rollback;
+    if (content_sqlite_exec (ctx, "COMMIT") < 0)
+        goto error;
+    buf = content_batch_data (b, &len);
+    if (flux_respond_raw (h, msg, buf, len) < 0)
+        flux_log_error (h, "load-batch: flux_respond_raw");
+    content_batch_destroy (b);
+    return;
+error_rollback:
+    ERRNO_SAFE_WRAP (sqlite3_exec, ctx->db, "ROLLBACK", NULL, NULL, NULL);
+error:
+    if (flux_respond_error (h, msg, errno, NULL) < 0)
+        flux_log_error (h, "load-batch: flux_respond_error");
+    content_batch_destroy (b);
+}
+
+/* Handle a content-backing.store-batch request.  All of the blobs are
+ * stored within a single transaction, so that a batch costs one commit
+ * rather than one per blob.  See content-batch.h for the payload format.
+ */
+static void store_batch_cb (flux_t *h,
+                            flux_msg_handler_t *mh,
+                            const flux_msg_t *msg,
+                            void *arg)
+{
+    struct content_sqlite *ctx = arg;
+    struct content_batch *b = NULL;
+    const void *buf;
+    int len;
+    int cursor = 0;
+    const void *data;
+    int size;
+    int rc;
+
+    if (flux_request_decode_raw (msg, NULL, &buf, &len) < 0)
+        goto error;
+    if (ctx->wb) {
+        if (writeback_store_batch (ctx, msg, buf, len) < 0)
+            goto error;
+        return;
+    }
+    if (!(b = content_batch_create ()))
+        goto error;
+    if (content_sqlite_exec (ctx, "BEGIN") < 0)
+        goto error;
+    while ((rc = content_batch_next (buf,
+                                     len,
+                                     &cursor,
+                                     NULL,
+                                     &data,
+                                     &size)) > 0) {
+        uint8_t hash[BLOBREF_MAX_DIGEST_SIZE];
+        int hash_size;
+        struct timespec t0;
+
+        monotime (&t0);
+        if ((hash_size = content_sqlite_store (ctx,
+                                               data,
+                                               size,
+                                               hash,
+                                               sizeof (hash))) < 0)
+            goto error_rollback;
+        tstat_push (&ctx->stats.store, monotime_since (t0));
+        if (content_batch_append (b, 0, hash, hash_size) < 0)
+            goto error_rollback;
+    }
+    if (rc < 0)
+        goto error_rollback;
+    if (content_sqlite_exec (ctx, "COMMIT") < 0)
+        goto error_rollback;
+    buf = content_batch_data (b, &len);
+    if (flux_respond_raw (h, msg, buf, len) < 0)
+        flux_log_error (h, "store-batch: flux_respond_raw");
+    content_batch_destroy (b);
+    return;
+error_rollback:
+    ERRNO_SAFE_WRAP (sqlite3_exec, ctx->db, "ROLLBACK", NULL, NULL, NULL);
+error:
+    if (flux_respond_error (h, msg, errno, NULL) < 0)
+        flux_log_error (h, "store-batch: flux_respond_error");
+    content_batch_destroy (b);
+}
+
 void checkpoint_get_cb (flux_t *h,
                         flux_msg_handler_t *mh,
                         const flux_msg_t *msg,
@@ -440,39 +1148,21 @@ void checkpoint_put_cb (flux_t *h,
         errno = EINVAL;
         goto error;
     }
-    if (sqlite3_bind_text (ctx->checkpt_put_stmt,
-                           1,
-                           (char *)key,
-                           strlen (key),
-                           SQLITE_STATIC) != SQLITE_OK) {
-        log_sqlite_error (ctx, "checkpt_put: binding key");
-        set_errno_from_sqlite_error (ctx);
-        goto error;
-    }
-    if (sqlite3_bind_text (ctx->checkpt_put_stmt,
-                           2,
-                           value,
-                           strlen (value),
-                           SQLITE_STATIC) != SQLITE_OK) {
-        log_sqlite_error (ctx, "checkpt_put: binding value");
-        set_errno_from_sqlite_error (ctx);
-        goto error;
+    if (ctx->wb) {
+        if (writeback_checkpoint_put (ctx, msg, key, value) < 0)
+            goto error;
+        free (value);
+        return;
     }
-    if (sqlite3_step (ctx->checkpt_put_stmt) != SQLITE_DONE
-                    && sqlite3_errcode (ctx->db) != SQLITE_CONSTRAINT) {
-        log_sqlite_error (ctx, "checkpt_put: executing stmt");
-        set_errno_from_sqlite_error (ctx);
+    if (content_sqlite_checkpt_put (ctx, key, value) < 0)
         goto error;
-    }
     if (flux_respond (h, msg, NULL) < 0)
         flux_log_error (h, "flux_respond");
-    (void )sqlite3_reset (ctx->checkpt_put_stmt);
     free (value);
     return;
 error:
     if (flux_respond_error (h, msg, errno, errstr) < 0)
         flux_log_error (h, "flux_respond_error");
-    (void )sqlite3_reset (ctx->checkpt_put_stmt);
     free (value);
 }
 
@@ -611,6 +1301,35 @@ static int content_sqlite_opendb (struct content_sqlite *ctx, bool truncate)
     if (truncate)
         (void)unlink (ctx->dbfile);
 
+    /* A read-only connection relies on the read-write connection,
+     * which is opened first, to set up the database.
+     */
+    if (ctx->readonly) {
+        if (sqlite3_open_v2 (ctx->dbfile,
+                             &ctx->db,
+                             SQLITE_OPEN_READONLY,
+                             NULL) != SQLITE_OK) {
+            log_sqlite_error (ctx, "opening %s", ctx->dbfile);
+            goto error;
+        }
+        if (sqlite3_prepare_v2 (ctx->db,
+                                sql_load,
+                                -1,
+                                &ctx->load_stmt,
+                                NULL) != SQLITE_OK) {
+            log_sqlite_error (ctx, "preparing load stmt");
+            goto error;
+        }
+        if (sqlite3_prepare_v2 (ctx->db,
+                                sql_checkpt_get,
+                                -1,
+                                &ctx->checkpt_get_stmt,
+                                NULL) != SQLITE_OK) {
+            log_sqlite_error (ctx, "preparing checkpt_get stmt");
+            goto error;
+        }
+        return 0;
+    }
     if (sqlite3_open_v2 (ctx->dbfile, &ctx->db, flags, NULL) != SQLITE_OK) {
         log_sqlite_error (ctx, "opening %s", ctx->dbfile);
         goto error;
@@ -633,11 +1352,11 @@ static int content_sqlite_opendb (struct content_sqlite *ctx, bool truncate)
         log_sqlite_error (ctx, "setting sqlite 'synchronous' pragma");
         goto error;
     }
-    if (sqlite3_exec (ctx->db,
-                      "PRAGMA locking_mode=EXCLUSIVE",
-                      NULL,
-                      NULL,
-                      NULL) != SQLITE_OK) {
+    if (!ctx->shared && sqlite3_exec (ctx->db,
+                                      "PRAGMA locking_mode=EXCLUSIVE",
+                                      NULL,
+                                      NULL,
+                                      NULL) != SQLITE_OK) {
         log_sqlite_error (ctx, "setting sqlite 'locking_mode' pragma");
         goto error;
     }
@@ -718,6 +1437,123 @@ error:
     return -1;
 }
 
+static void writeback_destroy (struct content_sqlite *ctx)
+{
+    struct writeback *wb;
+
+    if (ctx && (wb = ctx->wb)) {
+        int saved_errno = errno;
+        if (wb->started) {
+            pthread_mutex_lock (&wb->lock);
+            wb->shutdown = true;
+            pthread_cond_signal (&wb->cond);
+            pthread_mutex_unlock (&wb->lock);
+            pthread_join (wb->thread, NULL);
+            writeback_complete (ctx);
+        }
+        flux_watcher_destroy (wb->w);
+        if (wb->efd >= 0)
+            close (wb->efd);
+        zhashx_destroy (&wb->pending);
+        pthread_cond_destroy (&wb->cond);
+        pthread_mutex_destroy (&wb->lock);
+        if (wb->wctx) {
+            wb->wctx->iothread = false;
+            content_sqlite_closedb (wb->wctx);
+            free (wb->wctx->dbfile);
+            free (wb->wctx->lzo_buf);
+            free (wb->wctx);
+        }
+        free (wb);
+        ctx->wb = NULL;
+        errno = saved_errno;
+    }
+}
+
+/* Open a read-write connection for the I/O thread, then start it.
+ * The caller opens ctx->db read-only afterwards.
+ */
+static int writeback_create (struct content_sqlite *ctx, bool truncate)
+{
+    struct writeback *wb;
+    struct content_sqlite *wctx;
+    pthread_condattr_t attr;
+    sigset_t sigs, oldsigs;
+    int e;
+
+    if (strcasecmp (ctx->journal_mode, "WAL") != 0) {
+        flux_log (ctx->h, LOG_ERR, "writeback requires journal_mode=WAL");
+        errno = EINVAL;
+        return -1;
+    }
+    if (!(wb = calloc (1, sizeof (*wb))))
+        return -1;
+    ctx->wb = wb;
+    wb->interval = ctx->writeback_interval;
+    wb->efd = -1;
+    pthread_mutex_init (&wb->lock, NULL);
+    pthread_condattr_init (&attr);
+    pthread_condattr_setclock (&attr, CLOCK_MONOTONIC);
+    pthread_cond_init (&wb->cond, &attr);
+    pthread_condattr_destroy (&attr);
+    list_head_init (&wb->queue);
+    list_head_init (&wb->done);
+
+    if (!(wctx = calloc (1, sizeof (*wctx))))
+        goto error;
+    wb->wctx = wctx;
+    wctx->h = ctx->h;
+    wctx->hashfun = ctx->hashfun;
+    wctx->hash_size = ctx->hash_size;
+    wctx->journal_mode = ctx->journal_mode;
+    wctx->synchronous = ctx->synchronous;
+    wctx->shared = true;
+    if (!(wctx->dbfile = strdup (ctx->dbfile))
+        || !(wctx->lzo_buf = calloc (1, lzo_buf_chunksize)))
+        goto error;
+    wctx->lzo_bufsize = lzo_buf_chunksize;
+    if (content_sqlite_opendb (wctx, truncate) < 0)
+        goto error;
+    wctx->iothread = true;
+
+    /* do not duplicate hash keys, use blobrefs stored in entry */
+    if (!(wb->pending = zhashx_new ())) {
+        errno = ENOMEM;
+        goto error;
+    }
+    zhashx_set_key_destructor (wb->pending, NULL);
+    zhashx_set_key_duplicator (wb->pending, NULL);
+    if ((wb->efd = eventfd (0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0)
+        goto error;
+    if (!(wb->w = flux_fd_watcher_create (flux_get_reactor (ctx->h),
+                                          wb->efd,
+                                          FLUX_POLLIN,
+                                          writeback_done_cb,
+                                          ctx)))
+        goto error;
+    flux_watcher_start (wb->w);
+
+    /* I/O thread should not receive signals */
+    sigfillset (&sigs);
+    pthread_sigmask (SIG_SETMASK, &sigs, &oldsigs);
+    e = pthread_create (&wb->thread, NULL, writeback_thread, wb);
+    pthread_sigmask (SIG_SETMASK, &oldsigs, NULL);
+    if (e != 0) {
+        errno = e;
+        goto error;
+    }
+    wb->started = true;
+    ctx->readonly = true;
+    flux_log (ctx->h,
+              LOG_DEBUG,
+              "writeback enabled, group commit interval %.3fs",
+              wb->interval);
+    return 0;
+error:
+    writeback_destroy (ctx);
+    return -1;
+}
+
 static void content_sqlite_destroy (struct content_sqlite *ctx)
 {
     if (ctx) {
@@ -733,6 +1569,10 @@ static void content_sqlite_destroy (struct content_sqlite *ctx)
 static const struct flux_msg_handler_spec htab[] = {
     { FLUX_MSGTYPE_REQUEST, "content-backing.load",    load_cb, 0 },
     { FLUX_MSGTYPE_REQUEST, "content-backing.store",   store_cb, 0 },
+    { FLUX_MSGTYPE_REQUEST, "content-backing.load-batch",
+                            load_batch_cb, 0 },
+    { FLUX_MSGTYPE_REQUEST, "content-backing.store-batch",
+                            store_batch_cb, 0 },
     { FLUX_MSGTYPE_REQUEST, "content-backing.checkpoint-get",
                             checkpoint_get_cb, 0 },
     { FLUX_MSGTYPE_REQUEST, "content-backing.checkpoint-put",
@@ -754,6 +1594,7 @@ static struct content_sqlite *content_sqlite_create (flux_t *h)
     ctx->h = h;
     ctx->journal_mode = "WAL";
     ctx->synchronous = "NORMAL";
+    ctx->writeback_interval = 0.05;
 
     /* Some tunables:
      * - the hash function, e.g. sha1, sha256
@@ -817,6 +1658,19 @@ static int process_args (struct content_sqlite *ctx,
         else if (strcmp ("truncate", argv[i]) == 0) {
             *truncate = true;
         }
+        else if (strcmp ("writeback", argv[i]) == 0) {
+            ctx->writeback = true;
+        }
+        else if (strncmp ("writeback_interval=", argv[i], 19) == 0) {
+            if (fsd_parse_duration (argv[i] + 19,
+                                    &ctx->writeback_interval) < 0) {
+                flux_log (ctx->h,
+                          LOG_ERR,
+                          "Invalid writeback_interval: '%s'",
+                          argv[i] + 19);
+                return -1;
+            }
+        }
         else {
             flux_log (ctx->h, LOG_ERR, "Unknown module option: '%s'", argv[i]);
             return -1;
@@ -838,6 +1692,11 @@ int mod_main (flux_t *h, int argc, char **argv)
     // override pragmas set above
     if (process_args (ctx, argc, argv, &truncate) < 0)
         goto done;
+    if (ctx->writeback) {
+        if (writeback_create (ctx, truncate) < 0)
+            goto done;
+        truncate = false;
+    }
     if (content_sqlite_opendb (ctx, truncate) < 0)
         goto done;
     if (content_register_service (h, "content-backing") < 0)
@@ -852,6 +1711,7 @@ int mod_main (flux_t *h, int argc, char **argv)
 done_unreg:
     (void)content_unregister_backing_store (h);
 done:
+    writeback_destroy (ctx);
     content_sqlite_closedb (ctx);
     content_sqlite_destroy (ctx);
     return rc;
@@ -13,12 +13,15 @@
 #endif
 
 #include <sys/wait.h>
+#include <jansson.h>
 #define EXIT_CODE(x) __W_EXITCODE(x,0)
 
 #include <flux/core.h>
 #include <flux/idset.h>
 
 #include "src/common/libczmqcontainers/czmq_containers.h"
+#include "src/common/libsubprocess/command.h"
+#include "src/common/libioencode/ioencode.h"
 #include "src/common/libutil/aux.h"
 #include "bulk-exec.h"
 
@@ -28,6 +31,16 @@ struct exec_cmd {
     int flags;
 };
 
+/*  One job-exec.launch request per command in tree launch mode
+ */
+struct tree_launch {
+    struct bulk_exec *exec;
+    char *name;
+    uint32_t rank;           /* rank of the relay the launch was sent to */
+    struct idset *pending;   /* ranks that have not exited or failed */
+    flux_future_t *f;
+};
+
 struct bulk_exec {
     flux_t *h;
 
@@ -35,6 +48,7 @@ struct bulk_exec {
 
     int max_start_per_loop;  /* Max subprocess started per event loop cb */
     int total;               /* Total processes expected to run */
+    int launched;            /* Number of processes requested (tree mode) */
     int started;             /* Number of processes that have reached start */
     int complete;            /* Number of processes that have completed */
 
@@ -54,6 +68,10 @@ struct bulk_exec {
     zlist_t *commands;
     zlist_t *processes;
 
+    char *tree_name;         /* Launch via job-exec.launch if set */
+    json_t *tree_info;       /* Sent with each job-exec.launch request */
+    zlist_t *launches;       /* struct tree_launch */
+
     struct bulk_exec_ops *handlers;
     void *arg;
 };
@@ -67,6 +85,8 @@ int bulk_exec_rc (struct bulk_exec *exec)
 
 int bulk_exec_current (struct bulk_exec *exec)
 {
+    if (exec->tree_name)
+        return exec->launched;
     return zlist_size (exec->processes);
 }
 
@@ -75,10 +95,55 @@ int bulk_exec_total (struct bulk_exec *exec)
     return exec->total;
 }
 
+/*  Send data and/or EOF for 'stream' to all processes of all launches.
+ *   The relays forward the request down the TBON.
+ */
+static int tree_write (struct bulk_exec *exec,
+                       const char *stream,
+                       const char *buf,
+                       size_t len,
+                       bool eof)
+{
+    struct tree_launch *tl = zlist_first (exec->launches);
+    while (tl) {
+        flux_future_t *f;
+        json_t *o;
+        char *s = NULL;
+
+        if (!(o = json_pack ("{s:s s:s s:b}",
+                             "name", tl->name,
+                             "stream", stream,
+                             "eof", eof))
+            || (buf && json_object_set_new (o,
+                                            "data",
+                                            json_stringn (buf, len)) < 0)
+            || !(s = json_dumps (o, JSON_COMPACT))
+            || !(f = flux_rpc (exec->h,
+                               "job-exec.launch-write",
+                               s,
+                               tl->rank,
+                               FLUX_RPC_NORESPONSE))) {
+            json_decref (o);
+            free (s);
+            errno = ENOMEM;
+            return -1;
+        }
+        flux_future_destroy (f);
+        json_decref (o);
+        free (s);
+        tl = zlist_next (exec->launches);
+    }
+    return 0;
+}
+
 int bulk_exec_write (struct bulk_exec *exec, const char *stream,
                      const char *buf, size_t len)
 {
-    flux_subprocess_t *p = zlist_first (exec->processes);
+    flux_subprocess_t *p;
+
+    if (exec->tree_name)
+        return tree_write (exec, stream, buf, len, false);
+    p = zlist_first (exec->processes);
     while (p) {
         if (flux_subprocess_write (p, stream, buf, len) < len)
             return -1;
@@ -89,7 +154,11 @@ int bulk_exec_write (struct bulk_exec *exec, const char *stream,
 
 int bulk_exec_close (struct bulk_exec *exec, const char *stream)
 {
-    flux_subprocess_t *p = zlist_first (exec->processes);
+    flux_subprocess_t *p;
+
+    if (exec->tree_name)
+        return tree_write (exec, stream, NULL, 0, true);
+    p = zlist_first (exec->processes);
     while (p) {
         if (flux_subprocess_close (p, stream) < 0)
             return -1;
@@ -125,9 +194,8 @@ static void exit_batch_cb (flux_reactor_t *r, flux_watcher_t *w,
  *  This appraoch avoids unecessarily calling into user's callback
  *   multiple times when all tasks exit within 0.01s.
  */
-static void exit_batch_append (struct bulk_exec *exec, flux_subprocess_t *p)
+static void exit_batch_append (struct bulk_exec *exec, int rank)
 {
-    int rank = flux_subprocess_rank (p);
     if (idset_set (exec->exit_batch, rank) < 0) {
         flux_log_error (exec->h, "exit_batch_append:idset_set");
         return;
@@ -147,10 +215,10 @@ static void exit_batch_append (struct bulk_exec *exec, flux_subprocess_t *p)
     }
 }
 
-static void exec_add_completed (struct bulk_exec *exec, flux_subprocess_t *p)
+static void exec_add_completed (struct bulk_exec *exec, int rank)
 {
     /* Append this process to the current batch for notification */
-    exit_batch_append (exec, p);
+    exit_batch_append (exec, rank);
 
     if (++exec->complete == exec->total) {
         exec_exit_notify (exec);
@@ -167,37 +235,50 @@ static void exec_complete_cb (flux_subprocess_t *p)
     if (status > exec->exit_status)
         exec->exit_status = status;
 
-    exec_add_completed (exec, p);
+    exec_add_completed (exec, flux_subprocess_rank (p));
 }
 
-static void exec_state_cb (flux_subprocess_t *p, flux_subprocess_state_t state)
+/*  Process on 'rank' failed to start or lost contact with errno 'errnum'.
+ */
+static void exec_add_failed (struct bulk_exec *exec, int rank, int errnum)
 {
-    struct bulk_exec *exec = flux_subprocess_aux_get (p, "job-exec::exec");
-    if (state == FLUX_SUBPROCESS_RUNNING) {
-        if (++exec->started == exec->total) {
-            if (exec->handlers->on_start)
-                (*exec->handlers->on_start) (exec, exec->arg);
-        }
-    }
-    else if (state == FLUX_SUBPROCESS_FAILED
-            || state == FLUX_SUBPROCESS_EXEC_FAILED) {
-        int errnum = flux_subprocess_fail_errno (p);
-        int code = EXIT_CODE(1);
+    int code = EXIT_CODE(1);
 
-        if (errnum == EPERM || errnum == EACCES)
-            code = EXIT_CODE(126);
-        else if (errnum == ENOENT)
-            code = EXIT_CODE(127);
-        else if (errnum == EHOSTUNREACH)
-            code = EXIT_CODE(68);
+    if (errnum == EPERM || errnum == EACCES)
+        code = EXIT_CODE(126);
+    else if (errnum == ENOENT)
+        code = EXIT_CODE(127);
+    else if (errnum == EHOSTUNREACH)
+        code = EXIT_CODE(68);
 
-        if (code > exec->exit_status)
-            exec->exit_status = code;
+    if (code > exec->exit_status)
+        exec->exit_status = code;
 
-        if (exec->handlers->on_error)
-            (*exec->handlers->on_error) (exec, p, exec->arg);
+    if (exec->handlers->on_error)
+        (*exec->handlers->on_error) (exec, rank, errnum, exec->arg);
+
+    exec_add_completed (exec, rank);
+}
 
-        exec_add_completed (exec, p);
+static void exec_add_started (struct bulk_exec *exec, int count)
+{
+    exec->started += count;
+    if (exec->started == exec->total) {
+        if (exec->handlers->on_start)
+            (*exec->handlers->on_start) (exec, exec->arg);
+    }
+}
+
+static void exec_state_cb (flux_subprocess_t *p, flux_subprocess_state_t state)
+{
+    struct bulk_exec *exec = flux_subprocess_aux_get (p, "job-exec::exec");
+    if (state == FLUX_SUBPROCESS_RUNNING)
+        exec_add_started (exec, 1);
+    else if (state == FLUX_SUBPROCESS_FAILED
+            || state == FLUX_SUBPROCESS_EXEC_FAILED) {
+        exec_add_failed (exec,
+                         flux_subprocess_rank (p),
+                         flux_subprocess_fail_errno (p));
     }
 }
 
@@ -214,12 +295,196 @@ static void exec_output_cb (flux_subprocess_t *p, const char *stream)
     if (len) {
         int rank = flux_subprocess_rank (p);
         if (exec->handlers->on_output)
-            (*exec->handlers->on_output) (exec, p, stream, s, len, exec->arg);
+            (*exec->handlers->on_output) (exec,
+                                          rank,
+                                          stream,
+                                          s,
+                                          len,
+                                          exec->arg);
         else
             flux_log (exec->h, LOG_INFO, "rank %d: %s: %s", rank, stream, s);
     }
 }
 
+static void tree_launch_destroy (struct tree_launch *tl)
+{
+    if (tl) {
+        int saved_errno = errno;
+        flux_future_destroy (tl->f);
+        idset_destroy (tl->pending);
+        free (tl->name);
+        free (tl);
+        errno = saved_errno;
+    }
+}
+
+static int tree_launch_output (struct tree_launch *tl, flux_future_t *f)
+{
+    struct bulk_exec *exec = tl->exec;
+    json_t *io;
+    const char *stream;
+    const char *rank;
+    char *data = NULL;
+    int len;
+
+    if (flux_rpc_get_unpack (f, "{s:o}", "io", &io) < 0
+        || iodecode (io, &stream, &rank, &data, &len, NULL) < 0)
+        return -1;
+    if (len) {
+        if (exec->handlers->on_output)
+            (*exec->handlers->on_output) (exec,
+                                          strtoul (rank, NULL, 10),
+                                          stream,
+                                          data,
+                                          len,
+                                          exec->arg);
+        else
+            flux_log (exec->h, LOG_INFO, "rank %s: %s: %s", rank, stream, data);
+    }
+    free (data);
+    return 0;
+}
+
+static int tree_launch_exit (struct tree_launch *tl, flux_future_t *f)
+{
+    struct bulk_exec *exec = tl->exec;
+    const char *s;
+    int status;
+    struct idset *ids;
+    unsigned int rank;
+
+    if (flux_rpc_get_unpack (f, "{s:s s:i}", "ranks", &s, "status", &status) < 0
+        || !(ids = idset_decode (s)))
+        return -1;
+    if (status > exec->exit_status)
+        exec->exit_status = status;
+    rank = idset_first (ids);
+    while (rank != IDSET_INVALID_ID) {
+        if (idset_test (tl->pending, rank)) {
+            idset_clear (tl->pending, rank);
+            exec_add_completed (exec, rank);
+        }
+        rank = idset_next (ids, rank);
+    }
+    idset_destroy (ids);
+    return 0;
+}
+
+/*  The launch request failed as a whole with 'errnum'.
+ *   Fail every rank that has not yet exited.
+ */
+static void tree_launch_fail (struct tree_launch *tl, int errnum)
+{
+    unsigned int rank;
+
+    flux_log (tl->exec->h,
+              LOG_ERR,
+              "%s: launch failed: %s",
+              tl->name,
+              future_strerror (tl->f, errnum));
+    while ((rank = idset_first (tl->pending)) != IDSET_INVALID_ID) {
+        idset_clear (tl->pending, rank);
+        exec_add_failed (tl->exec, rank, errnum);
+    }
+}
+
+static void tree_launch_continuation (flux_future_t *f, void *arg)
+{
+    struct tree_launch *tl = arg;
+    struct bulk_exec *exec = tl->exec;
+    const char *type;
+    const char *s;
+    int rank;
+    int errnum;
+    struct idset *ids;
+
+    if (flux_rpc_get_unpack (f, "{s:s}", "type", &type) < 0) {
+        if (errno != ENODATA || idset_count (tl->pending) > 0)
+            tree_launch_fail (tl, errno == ENODATA ? EPROTO : errno);
+        return;
+    }
+    if (!strcmp (type, "start")) {
+        if (flux_rpc_get_unpack (f, "{s:s}", "ranks", &s) < 0
+            || !(ids = idset_decode (s)))
+            goto error;
+        exec_add_started (exec, idset_count (ids));
+        idset_destroy (ids);
+    }
+    else if (!strcmp (type, "exit")) {
+        if (tree_launch_exit (tl, f) < 0)
+            goto error;
+    }
+    else if (!strcmp (type, "error")) {
+        if (flux_rpc_get_unpack (f,
+                                 "{s:i s:i}",
+                                 "rank", &rank,
+                                 "errno", &errnum) < 0)
+            goto error;
+        if (idset_test (tl->pending, rank)) {
+            idset_clear (tl->pending, rank);
+            exec_add_failed (exec, rank, errnum);
+        }
+    }
+    else if (!strcmp (type, "output")) {
+        if (tree_launch_output (tl, f) < 0)
+            goto error;
+    }
+    flux_future_reset (f);
+    return;
+error:
+    flux_log_error (exec->h, "%s: error handling launch response", tl->name);
+    flux_future_reset (f);
+}
+
+/*  Launch 'cmd' on all of its ranks with a single job-exec.launch
+ *   request to the local relay, which fans it out across the TBON.
+ */
+static int exec_start_tree (struct bulk_exec *exec, struct exec_cmd *cmd)
+{
+    struct tree_launch *tl;
+    char *ranks = NULL;
+    char *cmd_json = NULL;
+
+    if (!(tl = calloc (1, sizeof (*tl))))
+        return -1;
+    tl->exec = exec;
+    if (asprintf (&tl->name,
+                  "%s.%d",
+                  exec->tree_name,
+                  (int) zlist_size (exec->launches)) < 0
+        || flux_get_rank (exec->h, &tl->rank) < 0
+        || !(tl->pending = idset_copy (cmd->ranks))
+        || !(ranks = idset_encode (cmd->ranks, IDSET_FLAG_RANGE))
+        || !(cmd_json = flux_cmd_tojson (cmd->cmd))
+        || !(tl->f = flux_rpc_pack (exec->h,
+                                    "job-exec.launch",
+                                    tl->rank,
+                                    FLUX_RPC_STREAMING,
+                                    "{s:s s:s s:s s:i s:O?}",
+                                    "name", tl->name,
+                                    "ranks", ranks,
+                                    "cmd", cmd_json,
+                                    "flags", cmd->flags,
+                                    "info", exec->tree_info))
+        || flux_future_then (tl->f, -1., tree_launch_continuation, tl) < 0
+        || zlist_append (exec->launches, tl) < 0)
+        goto error;
+    zlist_freefn (exec->launches,
+                  tl,
+                  (zlist_free_fn *) tree_launch_destroy,
+                  true);
+    exec->launched += idset_count (cmd->ranks);
+    idset_range_clear (cmd->ranks, 0, INT_MAX);
+    free (ranks);
+    free (cmd_json);
+    return 0;
+error:
+    tree_launch_destroy (tl);
+    free (ranks);
+    free (cmd_json);
+    return -1;
+}
+
 static void exec_cmd_destroy (void *arg)
 {
     struct exec_cmd *cmd = arg;
@@ -314,7 +579,17 @@ static int exec_start_cmds (struct bulk_exec *exec, int max)
 {
     while (zlist_size (exec->commands) && (max != 0)) {
         struct exec_cmd *cmd = zlist_first (exec->commands);
-        int rc = exec_start_cmd (exec, cmd, max);
+        int rc;
+
+        if (exec->tree_name) {
+            if (exec_start_tree (exec, cmd) < 0) {
+                flux_log_error (exec->h, "exec_start_tree failed");
+                return -1;
+            }
+            zlist_remove (exec->commands, cmd);
+            continue;
+        }
+        rc = exec_start_cmd (exec, cmd, max);
         if (rc < 0) {
             flux_log_error (exec->h, "exec_start_cmd failed");
             return -1;
@@ -352,7 +627,7 @@ static void check_cb (flux_reactor_t *r, flux_watcher_t *w,
     if (exec_start_cmds (exec, exec->max_start_per_loop) < 0) {
         bulk_exec_stop (exec);
         if (exec->handlers->on_error)
-            (*exec->handlers->on_error) (exec, NULL, exec->arg);
+            (*exec->handlers->on_error) (exec, -1, errno, exec->arg);
     }
 }
 
@@ -361,6 +636,9 @@ void bulk_exec_destroy (struct bulk_exec *exec)
     if (exec) {
         zlist_destroy (&exec->processes);
         zlist_destroy (&exec->commands);
+        zlist_destroy (&exec->launches);
+        free (exec->tree_name);
+        json_decref (exec->tree_info);
         idset_destroy (exec->exit_batch);
         flux_watcher_destroy (exec->prep);
         flux_watcher_destroy (exec->check);
@@ -387,6 +665,7 @@ struct bulk_exec * bulk_exec_create (struct bulk_exec_ops *ops, void *arg)
     exec->arg = arg;
     exec->processes = zlist_new ();
     exec->commands = zlist_new ();
+    exec->launches = zlist_new ();
     exec->exit_batch = idset_create (0, IDSET_FLAG_AUTOGROW);
     exec->max_start_per_loop = 1;
 
@@ -403,6 +682,32 @@ int bulk_exec_set_max_per_loop (struct bulk_exec *exec, int max)
     return 0;
 }
 
+int bulk_exec_set_tree_launch (struct bulk_exec *exec, const char *name)
+{
+    char *cpy;
+
+    if (!name || exec->active) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (!(cpy = strdup (name)))
+        return -1;
+    free (exec->tree_name);
+    exec->tree_name = cpy;
+    return 0;
+}
+
+int bulk_exec_set_launch_info (struct bulk_exec *exec, json_t *info)
+{
+    if (!info || exec->active) {
+        errno = EINVAL;
+        return -1;
+    }
+    json_decref (exec->tree_info);
+    exec->tree_info = json_incref (info);
+    return 0;
+}
+
 int bulk_exec_push_cmd (struct bulk_exec *exec,
                        const struct idset *ranks,
                        flux_cmd_t *cmd,
@@ -489,6 +794,32 @@ void bulk_exec_kill_log_error (flux_future_t *f, flux_jobid_t id)
     }
 }
 
+/*  Send a job-exec.launch-kill request for each launch with ranks
+ *   that have not exited.  The relays forward it down the TBON.
+ */
+static int tree_kill (struct bulk_exec *exec, flux_future_t *cf, int signum)
+{
+    struct tree_launch *tl = zlist_first (exec->launches);
+    while (tl) {
+        if (idset_count (tl->pending) > 0) {
+            flux_future_t *f;
+            if (!(f = flux_rpc_pack (exec->h,
+                                     "job-exec.launch-kill",
+                                     tl->rank,
+                                     0,
+                                     "{s:s s:i}",
+                                     "name", tl->name,
+                                     "signum", signum))
+                || flux_future_push (cf, tl->name, f) < 0) {
+                flux_future_destroy (f);
+                return -1;
+            }
+        }
+        tl = zlist_next (exec->launches);
+    }
+    return 0;
+}
+
 flux_future_t *bulk_exec_kill (struct bulk_exec *exec, int signum)
 {
     flux_subprocess_t *p = zlist_first (exec->processes);
@@ -498,6 +829,11 @@ flux_future_t *bulk_exec_kill (struct bulk_exec *exec, int signum)
         return NULL;
     flux_future_set_flux (cf, exec->h);
 
+    if (exec->tree_name && tree_kill (exec, cf, signum) < 0) {
+        flux_future_destroy (cf);
+        return NULL;
+    }
+
     while (p) {
         if (flux_subprocess_state (p) == FLUX_SUBPROCESS_RUNNING
             || flux_subprocess_state (p) == FLUX_SUBPROCESS_INIT) {
@@ -534,13 +870,12 @@ flux_future_t *bulk_exec_kill (struct bulk_exec *exec, int signum)
 }
 
 static void imp_kill_output (struct bulk_exec *kill,
-                             flux_subprocess_t *p,
+                             int rank,
                              const char *stream,
                              const char *data,
                              int len,
                              void *arg)
 {
-    int rank = flux_subprocess_rank (p);
     flux_log (kill->h, LOG_INFO,
               "%s (rank %d): imp kill: %s",
               flux_get_hostbyrank (kill->h, rank),
@@ -558,10 +893,11 @@ static void imp_kill_complete (struct bulk_exec *kill, void *arg)
 }
 
 static void imp_kill_error (struct bulk_exec *kill,
-                            flux_subprocess_t *p,
+                            int rank,
+                            int errnum,
                             void *arg)
 {
-    int rank = flux_subprocess_rank (p);
+    errno = errnum;
     flux_log_error (kill->h,
                     "imp kill on %s (rank %d) failed",
                     flux_get_hostbyrank (kill->h, rank),
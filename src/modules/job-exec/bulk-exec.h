@@ -13,6 +13,7 @@
 #ifndef HAVE_JOB_EXEC_BULK_EXEC_H
 #define HAVE_JOB_EXEC_BULK_EXEC_H 1
 
+#include <jansson.h>
 #include <flux/core.h>
 
 struct bulk_exec;
@@ -23,14 +24,16 @@ typedef void (*exec_exit_f) (struct bulk_exec *, void *arg,
                              const struct idset *ranks);
 
 typedef void (*exec_io_f)   (struct bulk_exec *,
-                             flux_subprocess_t *,
+                             int rank,
                              const char *stream,
 			     const char *data,
 			     int data_len,
                              void *arg);
 
+/*  'rank' is -1 if the error is not specific to one process */
 typedef void (*exec_error_f) (struct bulk_exec *,
-                              flux_subprocess_t *,
+                              int rank,
+                              int errnum,
                               void *arg);
 
 struct bulk_exec_ops {
@@ -55,6 +58,21 @@ int bulk_exec_aux_set (struct bulk_exec *exec,
  */
 int bulk_exec_set_max_per_loop (struct bulk_exec *exec, int max);
 
+/*  Launch each command with one request to the job-exec.launch service
+ *   on the local broker, which fans it out over the TBON, instead of one
+ *   flux_rexec(3) per rank.  The job-exec module must be loaded on all
+ *   brokers for this to reduce the traffic on this rank.  'name' must be
+ *   unique among active bulk_exec objects.  Must be called before
+ *   bulk_exec_start().
+ */
+int bulk_exec_set_tree_launch (struct bulk_exec *exec, const char *name);
+
+/*  Send JSON object 'info' with each tree launch request, for the relays
+ *   to serve to the launched processes.  Must be called before
+ *   bulk_exec_start().
+ */
+int bulk_exec_set_launch_info (struct bulk_exec *exec, json_t *info);
+
 void bulk_exec_destroy (struct bulk_exec *exec);
 
 int bulk_exec_push_cmd (struct bulk_exec *exec,
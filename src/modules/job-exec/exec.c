@@ -137,14 +137,16 @@ static int exec_barrier_enter (struct bulk_exec *exec)
     return 0;
 }
 
-static void output_cb (struct bulk_exec *exec, flux_subprocess_t *p,
+static void output_cb (struct bulk_exec *exec,
+                       int rank,
                        const char *stream,
                        const char *data,
                        int len,
                        void *arg)
 {
     struct jobinfo *job = arg;
-    const char *cmd = flux_cmd_arg (flux_subprocess_get_cmd (p), 0);
+    const char *cmd = job->multiuser ? config_get_imp_path ()
+                                     : config_get_job_shell (job);
 
     if (strcmp (stream, "FLUX_EXEC_PROTOCOL_FD") == 0) {
         if (strcmp (data, "enter\n") == 0
@@ -156,46 +158,41 @@ static void output_cb (struct bulk_exec *exec, flux_subprocess_t *p,
         return;
     }
     jobinfo_log_output (job,
-                        flux_subprocess_rank (p),
+                        rank,
                         basename (cmd),
                         stream,
                         data,
                         len);
 }
 
-static void error_cb (struct bulk_exec *exec, flux_subprocess_t *p, void *arg)
+static void error_cb (struct bulk_exec *exec,
+                      int rank,
+                      int errnum,
+                      void *arg)
 {
     struct jobinfo *job = arg;
-    flux_cmd_t *cmd = flux_subprocess_get_cmd (p);
-    int errnum = flux_subprocess_fail_errno (p);
-    int rank = flux_subprocess_rank (p);
-    const char *hostname = flux_get_hostbyrank (job->h, rank);
+    const char *errmsg;
 
-    /*  cmd may be NULL here if exec implementation failed to
-     *   create flux_cmd_t
+    /*  rank is -1 if the exec implementation failed before any
+     *   particular job shell was involved
      */
-    if (cmd) {
-        const char *errmsg = "job shell execution error";
-        if (errnum == EHOSTUNREACH) {
-            errmsg = "lost contact with job shell";
-            errnum = 0;
-        }
-        else
-            errmsg = "job shell exec error";
-
-        jobinfo_fatal_error (job,
-                             errnum,
-                             "%s on broker %s (rank %d)",
-                             errmsg,
-                             hostname,
-                             rank);
+    if (rank < 0) {
+        jobinfo_fatal_error (job, errnum, "job shell launch error");
+        return;
+    }
+    if (errnum == EHOSTUNREACH) {
+        errmsg = "lost contact with job shell";
+        errnum = 0;
     }
     else
-        jobinfo_fatal_error (job,
-                             flux_subprocess_fail_errno (p),
-                             "job shell exec error on %s (rank %d)",
-                             hostname,
-                             rank);
+        errmsg = "job shell exec error";
+
+    jobinfo_fatal_error (job,
+                         errnum,
+                         "%s on broker %s (rank %d)",
+                         errmsg,
+                         flux_get_hostbyrank (job->h, rank),
+                         rank);
 }
 
 
@@ -263,6 +260,10 @@ static int exec_init (struct jobinfo *job)
     struct exec_ctx *ctx = NULL;
     struct bulk_exec *exec = NULL;
     const struct idset *ranks = NULL;
+    /*  The IMP kill helper needs the pid of each job shell, which is
+     *   not available to this rank in tree launch mode.
+     */
+    bool tree_launch = config_use_tree_launch () && !job->multiuser;
 
     if (job->multiuser && !config_get_imp_path ()) {
         flux_log (job->h,
@@ -303,8 +304,24 @@ static int exec_init (struct jobinfo *job)
             goto err;
         }
     }
-    if (flux_cmd_argv_append (cmd, config_get_job_shell (job)) < 0
-        || flux_cmd_argv_appendf (cmd, "%ju", (uintmax_t) job->id) < 0) {
+    if (flux_cmd_argv_append (cmd, config_get_job_shell (job)) < 0) {
+        flux_log_error (job->h, "exec_init: flux_cmd_argv_append");
+        goto err;
+    }
+    /*  In tree launch mode, jobspec and R are relayed with the launch
+     *   request, so each shell can get them from its local broker rather
+     *   than with a job-info lookup on rank 0.
+     */
+    if (tree_launch && job->shell_info) {
+        if (bulk_exec_set_launch_info (exec, job->shell_info) < 0
+            || flux_cmd_argv_append (cmd,
+                                     "--jobinfo-service="
+                                     "job-exec.jobinfo") < 0) {
+            flux_log_error (job->h, "exec_init: bulk_exec_set_launch_info");
+            goto err;
+        }
+    }
+    if (flux_cmd_argv_appendf (cmd, "%ju", (uintmax_t) job->id) < 0) {
         flux_log_error (job->h, "exec_init: flux_cmd_argv_append");
         goto err;
     }
@@ -321,6 +338,14 @@ static int exec_init (struct jobinfo *job)
             goto err;
         }
     }
+    if (tree_launch) {
+        char name[64];
+        (void) snprintf (name, sizeof (name), "%ju", (uintmax_t) job->id);
+        if (bulk_exec_set_tree_launch (exec, name) < 0) {
+            flux_log_error (job->h, "exec_init: bulk_exec_set_tree_launch");
+            goto err;
+        }
+    }
     if (bulk_exec_push_cmd (exec, ranks, cmd, 0) < 0) {
         flux_log_error (job->h, "exec_init: bulk_exec_push_cmd");
         goto err;
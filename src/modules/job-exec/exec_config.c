@@ -22,6 +22,7 @@
 static const char *default_cwd = "/tmp";
 static const char *default_job_shell = NULL;
 static const char *flux_imp_path = NULL;
+static int tree_launch = 0;
 
 static const char *jobspec_get_job_shell (json_t *jobspec)
 {
@@ -68,6 +69,11 @@ const char *config_get_imp_path (void)
     return flux_imp_path;
 }
 
+bool config_use_tree_launch (void)
+{
+    return tree_launch ? true : false;
+}
+
 /*  Initialize common configurations for use by job-exec exec modules.
  */
 int config_init (flux_t *h, int argc, char **argv)
@@ -103,6 +109,18 @@ int config_init (flux_t *h, int argc, char **argv)
         return -1;
     }
 
+    /*  Check configuration for exec.tree-launch */
+    if (flux_conf_unpack (flux_get_conf (h),
+                          &err,
+                          "{s?:{s?b}}",
+                          "exec",
+                            "tree-launch", &tree_launch) < 0) {
+        flux_log (h, LOG_ERR,
+                  "error reading config value exec.tree-launch: %s",
+                  err.text);
+        return -1;
+    }
+
     if (argv && argc) {
         /* Finally, override values on cmdline */
         for (int i = 0; i < argc; i++) {
@@ -110,6 +128,8 @@ int config_init (flux_t *h, int argc, char **argv)
                 default_job_shell = argv[i]+10;
             else if (strncmp (argv[i], "imp=", 4) == 0)
                 flux_imp_path = argv[i]+4;
+            else if (strcmp (argv[i], "tree-launch") == 0)
+                tree_launch = 1;
         }
     }
 
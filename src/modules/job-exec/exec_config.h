@@ -11,6 +11,7 @@
 #ifndef HAVE_JOB_EXEC_CONFIG_H
 #define HAVE_JOB_EXEC_CONFIG_H 1
 
+#include <stdbool.h>
 #include <flux/core.h>
 
 #include "job-exec.h"
@@ -21,6 +22,11 @@ const char *config_get_cwd (struct jobinfo *job);
 
 const char *config_get_imp_path (void);
 
+/*  Return true if job shells should be launched over the TBON
+ *   (exec.tree-launch) rather than with one rexec per rank.
+ */
+bool config_use_tree_launch (void);
+
 int config_init (flux_t *h, int argc, char **argv);
 
 #endif /* !HAVE_JOB_EXEC_CONFIG_EXEC_H */
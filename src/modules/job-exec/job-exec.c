@@ -28,9 +28,10 @@
  *
  * On receipt of a start request, the exec service enters initialization
  * phase of the job, where the jobspec and R are fetched from the KVS,
- * and the guest namespace is created and linked from the primary
- * namespace. A guest.exec.eventlog is created with an initial "init"
- * event posted.
+ * and the guest namespace is created and linked from the primary namespace
+ * in a single KVS request.  Once it exists, a guest.exec.eventlog is
+ * created with an initial "init" event posted.  These steps are issued
+ * concurrently where they do not depend on each other.
  *
  * Jobspec and R are parsed as soon as asynchronous initialization tasks
  * complete. If any of these steps fail, an exec initialization exception
@@ -56,7 +57,8 @@
  * the following tasks:
  *
  *  - terminating "done" event is posted to the exec.eventlog
- *  - the guest namespace, now quiesced, is copied to the primary namespace
+ *  - the guest namespace, now quiesced, is copied to the primary namespace,
+ *    batched with copies for other jobs (see kvsbatch.c)
  *  - the guest namespace is removed
  *  - the final "release final=true" response is sent to the job manager
  *  - the local job object is destroyed
@@ -74,6 +76,13 @@
  *                             execution (currently "init" and "run")
  * }
  *
+ * TREE LAUNCH:
+ *
+ * The module is loaded on every broker rank.  Ranks other than 0 only
+ * provide the job-exec.launch relay (see launch.c), which lets the "bulk"
+ * implementation start all job shells of a job with a single request
+ * that fans out over the TBON, if exec.tree-launch is configured.
+ *
  * The "bulk" execution implementation supports testing and other
  * paramters under attributes.system.exec.bulkexec, including:
  *
@@ -96,10 +105,12 @@
 #include "src/common/libeventlog/eventlog.h"
 #include "src/common/libeventlog/eventlogger.h"
 #include "src/common/libutil/fsd.h"
-#include "src/common/libutil/errno_safe.h"
 
 #include "job-exec.h"
 #include "checkpoint.h"
+#include "launch.h"
+#include "exec_config.h"
+#include "kvsbatch.h"
 
 static double kill_timeout=5.0;
 
@@ -122,6 +133,7 @@ struct job_exec_ctx {
     flux_t *              h;
     flux_msg_handler_t ** handlers;
     zhashx_t *            jobs;
+    struct kvsbatch *     kvsbatch;
 };
 
 void jobinfo_incref (struct jobinfo *job)
@@ -145,6 +157,7 @@ void jobinfo_decref (struct jobinfo *job)
         free (job->J);
         resource_set_destroy (job->R);
         json_decref (job->jobspec);
+        json_decref (job->shell_info);
         free (job->rootref);
         free (job);
         errno = saved_errno;
@@ -558,19 +571,30 @@ static void namespace_delete (flux_future_t *f, void *arg)
     flux_future_destroy (f);
 }
 
+/*  The response to the commit of the "done" event contains the final
+ *   root of the guest namespace, so the copy into the primary namespace
+ *   can be made without a separate lookup.  The copy is batched with
+ *   other primary namespace updates from the same reactor loop iteration.
+ */
 static void namespace_copy (flux_future_t *f, void *arg)
 {
     struct jobinfo *job = arg;
     flux_t *h = job->ctx->h;
     flux_future_t *fnext = NULL;
+    const char *treeobj;
     char dst [256];
 
+    if (flux_kvs_commit_get_treeobj (flux_future_get_child (f, "done"),
+                                     &treeobj) < 0) {
+        flux_log_error (h, "namespace_move: flux_kvs_commit_get_treeobj");
+        goto done;
+    }
     if (flux_job_kvs_key (dst, sizeof (dst), job->id, "guest") < 0) {
         flux_log_error (h, "namespace_move: flux_job_kvs_key");
         goto done;
     }
-    if (!(fnext = flux_kvs_copy (h, job->ns, ".", NULL, dst, 0)))
-        flux_log_error (h, "namespace_move: flux_kvs_copy");
+    if (!(fnext = kvsbatch_put_treeobj (job->ctx->kvsbatch, dst, treeobj)))
+        flux_log_error (h, "namespace_move: kvsbatch_put_treeobj");
 done:
     if (fnext)
         flux_future_continue (f, fnext);
@@ -583,7 +607,8 @@ done:
  *   issuing the `done` terminating event into the exec.eventlog.
  *
  *  The process is split into a chained future of 3 parts:
- *   1. Issue the final write into the exec.eventlog
+ *   1. Flush pending eventlog entries and issue the final write into
+ *      the exec.eventlog
  *   2. Copy the namespace into the primary
  *   3. Delete the guest namespace
  */
@@ -593,18 +618,29 @@ static flux_future_t * namespace_move (struct jobinfo *job)
     flux_future_t *f = NULL;
     flux_future_t *fnext = NULL;
 
-    if (jobinfo_emit_event_pack_nowait (job, "done", NULL) < 0)
-        flux_log_error (h, "emit_event");
+    if (!(f = flux_future_wait_all_create ())) {
+        flux_log_error (h, "namespace_move: flux_future_wait_all_create");
+        goto error;
+    }
+    flux_future_set_flux (f, h);
     /*
-     *  Ensure the final eventlog entry ("done", from above), is committed
-     *   to then eventlog before performing the next steps. This ensures
-     *   the eventlog is quiesced before the namspace is moved and becomes
-     *   read-only.
+     *  Flush pending eventlog entries, then commit the final "done"
+     *   entry directly.  Commits to the guest namespace are applied in
+     *   the order they are sent, so both may be in flight at once, and
+     *   the eventlog is quiesced with "done" last once both complete,
+     *   before the namespace is moved and becomes read-only.
      */
-    if (!(f = eventlogger_commit (job->ev))) {
+    if (!(fnext = eventlogger_commit (job->ev))
+        || flux_future_push (f, "flush", fnext) < 0) {
+        flux_log_error (h, "namespace_move: eventlogger_commit");
+        goto error;
+    }
+    if (!(fnext = jobinfo_emit_event_pack (job, "done", NULL))
+        || flux_future_push (f, "done", fnext) < 0) {
         flux_log_error (h, "namespace_move: jobinfo_emit_event");
         goto error;
     }
+    fnext = NULL;
     if (   !(fnext = flux_future_and_then (f, namespace_copy, job))
         || !(fnext = flux_future_and_then (f=fnext, namespace_delete, job))) {
         flux_log_error (h, "namespace_move: flux_future_and_then");
@@ -762,10 +798,9 @@ static void jobinfo_start_continue (flux_future_t *f, void *arg)
     struct jobinfo *job = arg;
 
     if (flux_future_get (flux_future_get_child (f, "ns"), NULL) < 0) {
-        jobinfo_fatal_error (job, errno, "failed to create guest ns");
+        jobinfo_fatal_error (job, errno, "failed to create or link guest ns");
         goto done;
     }
-    job->has_namespace = 1;
 
 
     /*  If an exception was received during startup, no need to continue
@@ -788,6 +823,17 @@ static void jobinfo_start_continue (flux_future_t *f, void *arg)
             goto done;
         }
     }
+    if (flux_future_get_child (f, "jobspec")) {
+        const char *jobspec = jobinfo_kvs_lookup_get (f, "jobspec");
+        if (!jobspec
+            || !(job->shell_info = json_pack ("{s:I s:s s:s}",
+                                              "id", job->id,
+                                              "jobspec", jobspec,
+                                              "R", R))) {
+            jobinfo_fatal_error (job, errno, "reading jobspec");
+            goto done;
+        }
+    }
     if (jobinfo_load_implementation (job) < 0) {
         jobinfo_fatal_error (job, errno, "failed to initialize implementation");
         goto done;
@@ -801,85 +847,51 @@ done:
     flux_future_destroy (f);
 }
 
-static flux_future_t * jobinfo_link_guestns (struct jobinfo *job)
-{
-    int saved_errno;
-    flux_t *h = job->ctx->h;
-    flux_kvs_txn_t *txn = NULL;
-    flux_future_t *f = NULL;
-    char key [64];
-
-    if (flux_job_kvs_key (key, sizeof (key), job->id, "guest") < 0) {
-        flux_log_error (h, "link guestns: flux_job_kvs_key");
-        return NULL;
-    }
-    if (!(txn = flux_kvs_txn_create ())) {
-        flux_log_error (h, "link guestns: flux_kvs_txn_create");
-        return NULL;
-    }
-    if (flux_kvs_txn_symlink (txn, 0, key, job->ns, ".") < 0) {
-        flux_log_error (h, "link guestns: flux_kvs_txn_symlink");
-        goto out;
-    }
-    if (!(f = flux_kvs_commit (h, NULL, 0, txn)))
-        flux_log_error (h, "link_guestns: flux_kvs_commit");
-out:
-    saved_errno = errno;
-    flux_kvs_txn_destroy (txn);
-    errno = saved_errno;
-    return f;
-}
-
-static void namespace_link (flux_future_t *fprev, void *arg)
+/*  The guest namespace was created and linked.  Post the first exec
+ *   eventlog event.
+ */
+static void namespace_init (flux_future_t *fprev, void *arg)
 {
-    int saved_errno;
-    flux_t *h = flux_future_get_flux (fprev);
     struct jobinfo *job = arg;
-    flux_future_t *cf = NULL;
-    flux_future_t *f = NULL;
+    flux_future_t *f;
 
-    if (!(cf = flux_future_wait_all_create ())) {
-        flux_log_error (h, "namespace_link: flux_future_wait_all_create");
-        goto error;
-    }
-    flux_future_set_flux (cf, h);
+    job->has_namespace = 1;
     if (!(f = jobinfo_emit_event_pack (job,
                                        job->reattach ? "reattach" : "init",
-                                       NULL))
-        || flux_future_push (cf, "emit event", f) < 0)
-        goto error;
-
-    if (!(f = jobinfo_link_guestns (job))
-        || flux_future_push (cf, "link guestns", f) < 0)
-        goto error;
-    flux_future_continue (fprev, cf);
-    flux_future_destroy (fprev);
-    return;
-error:
-    saved_errno = errno;
-    flux_future_destroy (cf);
-    flux_future_continue_error (fprev, saved_errno, NULL);
+                                       NULL))) {
+        flux_future_continue_error (fprev, errno, NULL);
+        flux_future_destroy (fprev);
+        return;
+    }
+    flux_future_continue (fprev, f);
     flux_future_destroy (fprev);
 }
 
-static flux_future_t *ns_create_and_link (flux_t *h,
-                                          struct jobinfo *job,
-                                          int flags)
+/*  Create the guest namespace and link it into the primary namespace in
+ *   one request.  The KVS removes the namespace if the link fails, so a
+ *   failed create never leaves a dangling link behind.
+ */
+static flux_future_t *ns_create (flux_t *h, struct jobinfo *job, int flags)
 {
     flux_future_t *f = NULL;
     flux_future_t *f2 = NULL;
+    const char *rootref = NULL;
+    char key[64];
 
+    if (flux_job_kvs_key (key, sizeof (key), job->id, "guest") < 0) {
+        flux_log_error (h, "ns_create: flux_job_kvs_key");
+        return NULL;
+    }
     if (job->reattach && job->rootref)
-        f = flux_kvs_namespace_create_with (h,
-                                            job->ns,
-                                            job->rootref,
-                                            job->userid,
-                                            flags);
-    else
-        f = flux_kvs_namespace_create (h, job->ns, job->userid, flags);
-
-    if (!f || !(f2 = flux_future_and_then (f, namespace_link, job))) {
-        flux_log_error (h, "namespace_move: flux_future_and_then");
+        rootref = job->rootref;
+    f = flux_kvs_namespace_create_link (h,
+                                        job->ns,
+                                        rootref,
+                                        job->userid,
+                                        flags,
+                                        key);
+    if (!f || !(f2 = flux_future_and_then (f, namespace_init, job))) {
+        flux_log_error (h, "ns_create: flux_future_and_then");
         flux_future_destroy (f);
         return NULL;
     }
@@ -902,7 +914,7 @@ static void get_rootref_cb (flux_future_t *fprev, void *arg)
                   (uintmax_t)job->id);
 
     /* if rootref not found, still create namespace */
-    if (!(f = ns_create_and_link (h, job, 0)))
+    if (!(f = ns_create (h, job, 0)))
         goto error;
 
     flux_future_continue (fprev, f);
@@ -951,10 +963,20 @@ static flux_future_t *jobinfo_start_init (struct jobinfo *job)
         || flux_future_push (f, "J", f_kvs) < 0)) {
         goto err;
     }
+    /*  The job-manager only provides the redacted jobspec, so fetch the
+     *   full jobspec once here if it is to be sent to the job shells
+     *   with a tree launch.  See exec.c.
+     */
+    if (config_use_tree_launch ()
+        && !job->multiuser
+        && (!(f_kvs = flux_jobid_kvs_lookup (h, job->id, 0, "jobspec"))
+        || flux_future_push (f, "jobspec", f_kvs) < 0)) {
+        goto err;
+    }
     if (job->reattach)
         f_kvs = ns_get_rootref (h, job, 0);
     else
-        f_kvs = ns_create_and_link (h, job, 0);
+        f_kvs = ns_create (h, job, 0);
 
     if (flux_future_push (f, "ns", f_kvs) < 0)
         goto err;
@@ -1119,6 +1141,7 @@ static void job_exec_ctx_destroy (struct job_exec_ctx *ctx)
     if (ctx == NULL)
         return;
     zhashx_destroy (&ctx->jobs);
+    kvsbatch_destroy (ctx->kvsbatch);
     flux_msg_handler_delvec (ctx->handlers);
     free (ctx);
 }
@@ -1129,8 +1152,9 @@ static struct job_exec_ctx * job_exec_ctx_create (flux_t *h)
     if (ctx == NULL)
         return NULL;
     ctx->h = h;
-    if (!(ctx->jobs = job_hash_create ())) {
-        ERRNO_SAFE_WRAP (free, ctx);
+    if (!(ctx->jobs = job_hash_create ())
+        || !(ctx->kvsbatch = kvsbatch_create (h))) {
+        job_exec_ctx_destroy (ctx);
         return NULL;
     }
     return (ctx);
@@ -1259,17 +1283,48 @@ static const struct flux_msg_handler_spec htab[]  = {
     FLUX_MSGHANDLER_TABLE_END
 };
 
+/*  Ranks other than 0 only relay tree launch requests.
+ */
+static int relay_main (flux_t *h)
+{
+    struct launch_relay *relay;
+    int rc;
+
+    if (!(relay = launch_relay_create (h))) {
+        flux_log_error (h, "job-exec: launch relay initialization failed");
+        return -1;
+    }
+    rc = flux_reactor_run (flux_get_reactor (h), 0);
+    launch_relay_destroy (relay);
+    return rc;
+}
+
 int mod_main (flux_t *h, int argc, char **argv)
 {
     int saved_errno = 0;
     int rc = -1;
-    struct job_exec_ctx *ctx = job_exec_ctx_create (h);
+    struct job_exec_ctx *ctx;
+    struct launch_relay *relay = NULL;
+    uint32_t rank;
+
+    if (flux_get_rank (h, &rank) < 0) {
+        flux_log_error (h, "flux_get_rank");
+        return -1;
+    }
+    if (rank > 0)
+        return relay_main (h);
+
+    ctx = job_exec_ctx_create (h);
 
     if (job_exec_initialize (h, argc, argv) < 0
         || configure_implementations (h, argc, argv) < 0) {
         flux_log_error (h, "job-exec: module initialization failed");
         goto out;
     }
+    if (!(relay = launch_relay_create (h))) {
+        flux_log_error (h, "job-exec: launch relay initialization failed");
+        goto out;
+    }
 
     if (flux_msg_handler_addvec (h, htab, ctx, &ctx->handlers) < 0) {
         flux_log_error (h, "flux_msg_handler_addvec");
@@ -1289,6 +1344,7 @@ out:
     saved_errno = errno;
     if (flux_event_unsubscribe (h, "job-exception") < 0)
         flux_log_error (h, "flux_event_unsubscribe ('job-exception')");
+    launch_relay_destroy (relay);
     job_exec_ctx_destroy (ctx);
     errno = saved_errno;
     return rc;
@@ -69,6 +69,8 @@ struct jobinfo {
     struct resource_set * R;         /* Fetched and parsed resource set R */
     json_t *              jobspec;   /* Fetched jobspec */
     char *                J;         /* Signed jobspec */
+    json_t *              shell_info; /* Unredacted jobspec and R for shells,
+                                       * fetched only for tree launch */
 
     uint8_t               multiuser:1;
     uint8_t               has_namespace:1;
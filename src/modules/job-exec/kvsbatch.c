@@ -0,0 +1,224 @@
+/************************************************************\
+ * Copyright 2024 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+/* kvsbatch.c - coalesce primary namespace commits across jobs
+ *
+ * Each job finalization copies the guest namespace back into the primary
+ * namespace.  When many jobs finish together, issuing one commit per job
+ * serializes them behind each other in the KVS.  Instead, operations are
+ * added to the current batch transaction, and the batch is committed from
+ * a prepare watcher, i.e. once all messages handled in the current reactor
+ * loop iteration have been processed.
+ */
+
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <flux/core.h>
+
+#include "src/common/libczmqcontainers/czmq_containers.h"
+
+#include "kvsbatch.h"
+
+struct batch {
+    struct kvsbatch *kb;
+    flux_kvs_txn_t *txn;
+    zlist_t *futures;   // futures fulfilled when commit completes
+    flux_future_t *f;
+};
+
+struct kvsbatch {
+    flux_t *h;
+    flux_watcher_t *prep;
+    struct batch *current;
+    zlist_t *pending;   // batches with commit in progress
+};
+
+/*  Fulfill all futures in batch `b`, then drop our reference.
+ */
+static void batch_fulfill (struct batch *b, int errnum, const char *errstr)
+{
+    flux_future_t *f;
+
+    while ((f = zlist_pop (b->futures))) {
+        if (errnum)
+            flux_future_fulfill_error (f, errnum, errstr);
+        else
+            flux_future_fulfill (f, NULL, NULL);
+        flux_future_decref (f);
+    }
+}
+
+static void batch_destroy (struct batch *b)
+{
+    if (b) {
+        int saved_errno = errno;
+        if (b->futures) {
+            batch_fulfill (b, ECANCELED, NULL);
+            zlist_destroy (&b->futures);
+        }
+        flux_kvs_txn_destroy (b->txn);
+        flux_future_destroy (b->f);
+        free (b);
+        errno = saved_errno;
+    }
+}
+
+static struct batch *batch_create (struct kvsbatch *kb)
+{
+    struct batch *b;
+
+    if (!(b = calloc (1, sizeof (*b))))
+        return NULL;
+    b->kb = kb;
+    if (!(b->txn = flux_kvs_txn_create ())
+        || !(b->futures = zlist_new ())) {
+        batch_destroy (b);
+        errno = ENOMEM;
+        return NULL;
+    }
+    return b;
+}
+
+static void batch_complete (struct batch *b)
+{
+    if (flux_future_get (b->f, NULL) < 0)
+        batch_fulfill (b, errno, future_strerror (b->f, errno));
+    else
+        batch_fulfill (b, 0, NULL);
+}
+
+static void commit_continuation (flux_future_t *f, void *arg)
+{
+    struct batch *b = arg;
+
+    batch_complete (b);
+    zlist_remove (b->kb->pending, b);
+    batch_destroy (b);
+}
+
+/*  Close the current batch, if any, and commit it.
+ */
+static void kvsbatch_commit (struct kvsbatch *kb)
+{
+    struct batch *b = kb->current;
+
+    flux_watcher_stop (kb->prep);
+    if (!b)
+        return;
+    kb->current = NULL;
+    if (!(b->f = flux_kvs_commit (kb->h, NULL, 0, b->txn))
+        || flux_future_then (b->f, -1., commit_continuation, b) < 0
+        || zlist_append (kb->pending, b) < 0) {
+        flux_log_error (kb->h, "kvsbatch: failed to commit batch");
+        batch_fulfill (b, errno, NULL);
+        batch_destroy (b);
+    }
+}
+
+static void prep_cb (flux_reactor_t *r,
+                     flux_watcher_t *w,
+                     int revents,
+                     void *arg)
+{
+    kvsbatch_commit (arg);
+}
+
+/*  Return the current batch, creating it if necessary.
+ */
+static struct batch *kvsbatch_current (struct kvsbatch *kb)
+{
+    if (!kb->current) {
+        if (!(kb->current = batch_create (kb)))
+            return NULL;
+        flux_watcher_start (kb->prep);
+    }
+    return kb->current;
+}
+
+/*  Return a future for the commit of batch `b`.  The batch holds a
+ *   reference so the caller may destroy the future at any time.
+ */
+static flux_future_t *batch_future (struct kvsbatch *kb, struct batch *b)
+{
+    flux_future_t *f;
+
+    if (!(f = flux_future_create (NULL, NULL)))
+        return NULL;
+    flux_future_set_flux (f, kb->h);
+    if (zlist_append (b->futures, f) < 0) {
+        flux_future_destroy (f);
+        errno = ENOMEM;
+        return NULL;
+    }
+    flux_future_incref (f);
+    return f;
+}
+
+flux_future_t *kvsbatch_put_treeobj (struct kvsbatch *kb,
+                                     const char *key,
+                                     const char *treeobj)
+{
+    struct batch *b;
+
+    if (!kb || !key || !treeobj) {
+        errno = EINVAL;
+        return NULL;
+    }
+    if (!(b = kvsbatch_current (kb))
+        || flux_kvs_txn_put_treeobj (b->txn, 0, key, treeobj) < 0)
+        return NULL;
+    return batch_future (kb, b);
+}
+
+void kvsbatch_destroy (struct kvsbatch *kb)
+{
+    if (kb) {
+        int saved_errno = errno;
+        if (kb->pending) {
+            struct batch *b;
+            kvsbatch_commit (kb);
+            while ((b = zlist_pop (kb->pending))) {
+                (void)flux_future_wait_for (b->f, -1.);
+                batch_complete (b);
+                batch_destroy (b);
+            }
+            zlist_destroy (&kb->pending);
+        }
+        batch_destroy (kb->current);
+        flux_watcher_destroy (kb->prep);
+        free (kb);
+        errno = saved_errno;
+    }
+}
+
+struct kvsbatch *kvsbatch_create (flux_t *h)
+{
+    struct kvsbatch *kb;
+
+    if (!(kb = calloc (1, sizeof (*kb))))
+        return NULL;
+    kb->h = h;
+    if (!(kb->pending = zlist_new ())) {
+        errno = ENOMEM;
+        goto error;
+    }
+    if (!(kb->prep = flux_prepare_watcher_create (flux_get_reactor (h),
+                                                  prep_cb,
+                                                  kb)))
+        goto error;
+    return kb;
+error:
+    kvsbatch_destroy (kb);
+    return NULL;
+}
+
+/* vi: ts=4 sw=4 expandtab
+ */
@@ -0,0 +1,42 @@
+/************************************************************\
+ * Copyright 2024 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+#ifndef HAVE_JOB_EXEC_KVSBATCH_H
+#define HAVE_JOB_EXEC_KVSBATCH_H 1
+
+#include <flux/core.h>
+
+/*  Coalesce updates to the primary KVS namespace made by different jobs
+ *   during the same reactor loop iteration into a single commit.
+ *
+ *  Each operation returns a future that is fulfilled (or fulfilled with
+ *   an error) when the commit containing that operation completes.
+ *   Since all operations in a batch share one transaction, a failed
+ *   commit fails every operation in the batch.
+ */
+struct kvsbatch;
+
+struct kvsbatch *kvsbatch_create (flux_t *h);
+
+/*  Commit any pending operations and wait for all outstanding commits
+ *   to complete before destroying the batch object.
+ */
+void kvsbatch_destroy (struct kvsbatch *kb);
+
+/*  Add an RFC 11 treeobj at `key`, e.g. a snapshot of a guest namespace.
+ */
+flux_future_t *kvsbatch_put_treeobj (struct kvsbatch *kb,
+                                     const char *key,
+                                     const char *treeobj);
+
+#endif /* !HAVE_JOB_EXEC_KVSBATCH_H */
+
+/* vi: ts=4 sw=4 expandtab
+ */
@@ -0,0 +1,981 @@
+/************************************************************\
+ * Copyright 2024 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+/* launch.c - TBON launch relay for job-exec
+ *
+ * DESCRIPTION
+ *
+ * Each relay runs the command on its own rank via the local broker's
+ * rexec service, and forwards one job-exec.launch request to each TBON
+ * child whose subtree contains target ranks.  Start and exit notifications
+ * are batched for a short time and merged with those from the children,
+ * so each relay sends only a few responses upstream no matter how large
+ * its subtree is.  If a child has no relay loaded (ENOSYS), its target
+ * ranks are executed directly from this rank instead.
+ *
+ * PROTOCOL
+ *
+ * job-exec.launch (streaming)
+ *   request:  {"name":s, "ranks":s, "cmd":s, "flags":i, "info"?:o}
+ *   responses:
+ *     {"type":"start", "ranks":s}             processes on ranks are running
+ *     {"type":"exit", "ranks":s, "status":i}  processes on ranks exited,
+ *                                             with max wait status of the set
+ *     {"type":"error", "rank":i, "errno":i}   process on rank failed
+ *     {"type":"output", "io":o}               line of output (see ioencode)
+ *   ENODATA ends the stream once every target has exited or failed.
+ *
+ * job-exec.launch-write (no response)
+ *   request:  {"name":s, "stream":s, "data"?:s, "eof"?:b}
+ *
+ * job-exec.launch-kill
+ *   request:  {"name":s, "signum":i}
+ *   response: success if any process in the subtree was signaled,
+ *             otherwise an error (ENOENT if there was nothing to signal).
+ *
+ * job-exec.jobinfo
+ *   request:  {"id":I}
+ *   response: "info" object of the active launch with info.id == id,
+ *             or ENOENT if there is none on this rank.
+ *
+ * "name" identifies the launch in all of the above, and must be unique
+ * among active launches.  "info" is relayed with the launch to every rank
+ * in the subtree, so that processes started by the launch, e.g. job shells,
+ * may fetch it from their local broker.
+ */
+
+#if HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <limits.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <jansson.h>
+#include <flux/core.h>
+#include <flux/idset.h>
+
+#include "src/common/libczmqcontainers/czmq_containers.h"
+#include "src/common/libsubprocess/command.h"
+#include "src/common/libioencode/ioencode.h"
+#include "src/common/libutil/errno_safe.h"
+
+#include "launch.h"
+
+/* Start and exit notifications are held for this long (in seconds)
+ * so that they may be sent upstream together.
+ */
+static const double batch_timeout = 0.01;
+
+static const char *auxkey = "job-exec::launch";
+
+struct launch_child {
+    uint32_t rank;
+    struct idset *ranks;        /* child and its descendants */
+};
+
+struct launch_relay {
+    flux_t *h;
+    uint32_t rank;
+    struct idset *subtree;      /* this rank and its descendants */
+    struct launch_child *children;
+    int child_count;
+    zhashx_t *launches;         /* name => struct launch */
+    flux_msg_handler_t **handlers;
+};
+
+struct sublaunch {
+    struct launch *l;
+    struct launch_child *child;
+    struct idset *pending;      /* ranks that have not exited or failed */
+    flux_future_t *f;
+    bool responded;
+    void *handle;
+};
+
+struct launch {
+    struct launch_relay *lr;
+    char *name;
+    const flux_msg_t *msg;
+    char *cmd_json;
+    flux_cmd_t *cmd;
+    int flags;
+    json_t *info;               /* optional, served by job-exec.jobinfo */
+
+    zlistx_t *procs;            /* flux_subprocess_t, one per local rexec */
+    int active;                 /* procs that have not exited or failed */
+    zlistx_t *subs;             /* struct sublaunch, removed when done */
+
+    struct idset *started;      /* batched start notifications */
+    struct idset *exited;       /* batched exit notifications */
+    int exit_status;            /* max wait status in exited batch */
+    flux_watcher_t *timer;
+    bool timer_armed;
+};
+
+static void launch_respond_error (struct launch *l, int rank, int errnum)
+{
+    if (flux_respond_pack (l->lr->h,
+                           l->msg,
+                           "{s:s s:i s:i}",
+                           "type", "error",
+                           "rank", rank,
+                           "errno", errnum) < 0)
+        flux_log_error (l->lr->h, "%s: error responding to launch", l->name);
+}
+
+static void launch_respond_ids (struct launch *l,
+                                const char *type,
+                                struct idset *ids)
+{
+    char *s;
+    int rc;
+
+    if (idset_count (ids) == 0)
+        return;
+    if (!(s = idset_encode (ids, IDSET_FLAG_RANGE))) {
+        flux_log_error (l->lr->h, "%s: idset_encode", l->name);
+        return;
+    }
+    if (ids == l->exited)
+        rc = flux_respond_pack (l->lr->h,
+                                l->msg,
+                                "{s:s s:s s:i}",
+                                "type", type,
+                                "ranks", s,
+                                "status", l->exit_status);
+    else
+        rc = flux_respond_pack (l->lr->h,
+                                l->msg,
+                                "{s:s s:s}",
+                                "type", type,
+                                "ranks", s);
+    if (rc < 0)
+        flux_log_error (l->lr->h, "%s: error responding to launch", l->name);
+    free (s);
+    idset_range_clear (ids, 0, INT_MAX);
+}
+
+/*  Report every rank in 'ids' as failed with 'errnum'.
+ */
+static void launch_fail (struct launch *l,
+                         const struct idset *ids,
+                         int errnum)
+{
+    uint32_t rank = idset_first (ids);
+    while (rank != IDSET_INVALID_ID) {
+        launch_respond_error (l, rank, errnum);
+        rank = idset_next (ids, rank);
+    }
+}
+
+/*  Send batched start and exit notifications upstream.
+ */
+static void launch_flush (struct launch *l)
+{
+    launch_respond_ids (l, "start", l->started);
+    launch_respond_ids (l, "exit", l->exited);
+    l->exit_status = 0;
+    flux_watcher_stop (l->timer);
+    l->timer_armed = false;
+}
+
+static void batch_timer_cb (flux_reactor_t *r,
+                            flux_watcher_t *w,
+                            int revents,
+                            void *arg)
+{
+    launch_flush (arg);
+}
+
+static void launch_batch_arm (struct launch *l)
+{
+    if (!l->timer_armed) {
+        flux_timer_watcher_reset (l->timer, batch_timeout, 0.);
+        flux_watcher_start (l->timer);
+        l->timer_armed = true;
+    }
+}
+
+/*  Once all local processes and all children are done, flush any
+ *   batched notifications, end the response stream, and destroy 'l'.
+ */
+static void launch_check_done (struct launch *l)
+{
+    if (l->active > 0 || zlistx_size (l->subs) > 0)
+        return;
+    launch_flush (l);
+    if (flux_respond_error (l->lr->h, l->msg, ENODATA, NULL) < 0)
+        flux_log_error (l->lr->h, "%s: error responding to launch", l->name);
+    zhashx_delete (l->lr->launches, l->name);
+}
+
+static void proc_state_cb (flux_subprocess_t *p,
+                           flux_subprocess_state_t state)
+{
+    struct launch *l = flux_subprocess_aux_get (p, auxkey);
+
+    if (state == FLUX_SUBPROCESS_RUNNING) {
+        if (idset_set (l->started, flux_subprocess_rank (p)) < 0)
+            flux_log_error (l->lr->h, "%s: idset_set", l->name);
+        launch_batch_arm (l);
+    }
+    else if (state == FLUX_SUBPROCESS_FAILED
+             || state == FLUX_SUBPROCESS_EXEC_FAILED) {
+        /* Keep start before error for this rank */
+        launch_flush (l);
+        launch_respond_error (l,
+                              flux_subprocess_rank (p),
+                              flux_subprocess_fail_errno (p));
+        l->active--;
+        launch_check_done (l);
+    }
+}
+
+static void proc_completion_cb (flux_subprocess_t *p)
+{
+    struct launch *l = flux_subprocess_aux_get (p, auxkey);
+    int status = flux_subprocess_status (p);
+
+    if (idset_set (l->exited, flux_subprocess_rank (p)) < 0)
+        flux_log_error (l->lr->h, "%s: idset_set", l->name);
+    if (status > l->exit_status)
+        l->exit_status = status;
+    launch_batch_arm (l);
+    l->active--;
+    launch_check_done (l);
+}
+
+static void proc_output_cb (flux_subprocess_t *p, const char *stream)
+{
+    struct launch *l = flux_subprocess_aux_get (p, auxkey);
+    const char *s;
+    int len;
+    char rank[16];
+    json_t *io;
+
+    if (!(s = flux_subprocess_getline (p, stream, &len))) {
+        flux_log_error (l->lr->h, "flux_subprocess_getline");
+        return;
+    }
+    if (len == 0)
+        return;
+    (void) snprintf (rank, sizeof (rank), "%d", flux_subprocess_rank (p));
+    if (!(io = ioencode (stream, rank, s, len, false))) {
+        flux_log_error (l->lr->h, "%s: ioencode", l->name);
+        return;
+    }
+    if (flux_respond_pack (l->lr->h,
+                           l->msg,
+                           "{s:s s:O}",
+                           "type", "output",
+                           "io", io) < 0)
+        flux_log_error (l->lr->h, "%s: error responding to launch", l->name);
+    json_decref (io);
+}
+
+static flux_subprocess_ops_t proc_ops = {
+    .on_completion =   proc_completion_cb,
+    .on_state_change = proc_state_cb,
+    .on_channel_out =  proc_output_cb,
+    .on_stdout =       proc_output_cb,
+    .on_stderr =       proc_output_cb,
+};
+
+static void proc_destructor (void **item)
+{
+    if (item) {
+        flux_subprocess_unref (*item);
+        *item = NULL;
+    }
+}
+
+/*  Run the command on 'rank' via the rexec service there.  Failure is
+ *   reported upstream as an error for that rank.
+ */
+static void launch_exec (struct launch *l, uint32_t rank)
+{
+    flux_subprocess_t *p;
+
+    if (!(p = flux_rexec (l->lr->h, rank, l->flags, l->cmd, &proc_ops))) {
+        launch_respond_error (l, rank, errno);
+        return;
+    }
+    if (flux_subprocess_aux_set (p, auxkey, l, NULL) < 0
+        || !zlistx_add_end (l->procs, p)) {
+        launch_respond_error (l, rank, errno);
+        flux_subprocess_unref (p);
+        return;
+    }
+    l->active++;
+}
+
+static void sublaunch_destroy (struct sublaunch *sub)
+{
+    if (sub) {
+        int saved_errno = errno;
+        idset_destroy (sub->pending);
+        flux_future_destroy (sub->f);
+        free (sub);
+        errno = saved_errno;
+    }
+}
+
+static void sublaunch_destructor (void **item)
+{
+    if (item) {
+        sublaunch_destroy (*item);
+        *item = NULL;
+    }
+}
+
+/*  Child 'sub' will send no more responses.  Report ranks it never
+ *   accounted for as failed with 'errnum', or if the child has no relay,
+ *   run them directly from here.
+ */
+static void sublaunch_finish (struct sublaunch *sub, int errnum)
+{
+    struct launch *l = sub->l;
+
+    if (errnum == 0)
+        ; // stream ended normally with all ranks accounted for
+    else if (errnum == ENOSYS && !sub->responded) {
+        uint32_t rank = idset_first (sub->pending);
+        while (rank != IDSET_INVALID_ID) {
+            launch_exec (l, rank);
+            rank = idset_next (sub->pending, rank);
+        }
+    }
+    else
+        launch_fail (l, sub->pending, errnum);
+    zlistx_delete (l->subs, sub->handle);
+    launch_check_done (l);
+}
+
+static int merge_ranks (struct idset *dst, const char *s)
+{
+    struct idset *ids;
+    int rc;
+
+    if (!(ids = idset_decode (s)))
+        return -1;
+    rc = idset_add (dst, ids);
+    idset_destroy (ids);
+    return rc;
+}
+
+static void sublaunch_continuation (flux_future_t *f, void *arg)
+{
+    struct sublaunch *sub = arg;
+    struct launch *l = sub->l;
+    flux_t *h = l->lr->h;
+    const char *type;
+    const char *ranks;
+    const char *payload;
+    int status;
+    int rank;
+
+    /* Child ends its stream with ENODATA after all its ranks are done.
+     * Keep the sublaunch until then so the RPC matchtag is retired.
+     */
+    if (flux_rpc_get_unpack (f, "{s:s}", "type", &type) < 0) {
+        if (errno == ENODATA) {
+            if (idset_count (sub->pending) == 0)
+                errno = 0;
+            else
+                errno = EPROTO; // ranks unaccounted for
+        }
+        sublaunch_finish (sub, errno);
+        return;
+    }
+    sub->responded = true;
+    if (!strcmp (type, "start")) {
+        if (flux_rpc_get_unpack (f, "{s:s}", "ranks", &ranks) < 0
+            || merge_ranks (l->started, ranks) < 0)
+            goto error;
+        launch_batch_arm (l);
+    }
+    else if (!strcmp (type, "exit")) {
+        struct idset *ids;
+
+        if (flux_rpc_get_unpack (f,
+                                 "{s:s s:i}",
+                                 "ranks", &ranks,
+                                 "status", &status) < 0
+            || !(ids = idset_decode (ranks)))
+            goto error;
+        if (idset_add (l->exited, ids) < 0
+            || idset_subtract (sub->pending, ids) < 0) {
+            idset_destroy (ids);
+            goto error;
+        }
+        idset_destroy (ids);
+        if (status > l->exit_status)
+            l->exit_status = status;
+        launch_batch_arm (l);
+    }
+    else {
+        if (!strcmp (type, "error")) {
+            if (flux_rpc_get_unpack (f, "{s:i}", "rank", &rank) < 0)
+                goto error;
+            idset_clear (sub->pending, rank);
+        }
+        /* Pass errors and output through unchanged */
+        if (flux_rpc_get (f, &payload) < 0
+            || flux_respond (h, l->msg, payload) < 0)
+            goto error;
+    }
+    flux_future_reset (f);
+    return;
+error:
+    flux_log_error (h, "%s: error handling launch response from rank %u",
+                    l->name,
+                    (unsigned int) sub->child->rank);
+    flux_future_reset (f);
+}
+
+static int launch_forward (struct launch *l,
+                           struct launch_child *child,
+                           struct idset *ids)
+{
+    struct sublaunch *sub;
+    char *s = NULL;
+
+    if (!(sub = calloc (1, sizeof (*sub))))
+        return -1;
+    sub->l = l;
+    sub->child = child;
+    if (!(sub->pending = idset_intersect (ids, child->ranks)))
+        goto error;
+    if (idset_count (sub->pending) == 0) {
+        sublaunch_destroy (sub);
+        return 0;
+    }
+    if (!(s = idset_encode (sub->pending, IDSET_FLAG_RANGE))
+        || !(sub->f = flux_rpc_pack (l->lr->h,
+                                     "job-exec.launch",
+                                     child->rank,
+                                     FLUX_RPC_STREAMING,
+                                     "{s:s s:s s:s s:i s:O?}",
+                                     "name", l->name,
+                                     "ranks", s,
+                                     "cmd", l->cmd_json,
+                                     "flags", l->flags,
+                                     "info", l->info))
+        || flux_future_then (sub->f, -1., sublaunch_continuation, sub) < 0
+        || !(sub->handle = zlistx_add_end (l->subs, sub)))
+        goto error;
+    free (s);
+    return 0;
+error:
+    ERRNO_SAFE_WRAP (free, s);
+    sublaunch_destroy (sub);
+    return -1;
+}
+
+static void launch_destroy (struct launch *l)
+{
+    if (l) {
+        int saved_errno = errno;
+        zlistx_destroy (&l->subs);
+        zlistx_destroy (&l->procs);
+        flux_watcher_destroy (l->timer);
+        idset_destroy (l->started);
+        idset_destroy (l->exited);
+        flux_cmd_destroy (l->cmd);
+        free (l->cmd_json);
+        json_decref (l->info);
+        flux_msg_decref (l->msg);
+        free (l->name);
+        free (l);
+        errno = saved_errno;
+    }
+}
+
+static void launch_destructor (void **item)
+{
+    if (item) {
+        launch_destroy (*item);
+        *item = NULL;
+    }
+}
+
+static struct launch *launch_create (struct launch_relay *lr,
+                                     const flux_msg_t *msg,
+                                     const char *name,
+                                     const char *cmd,
+                                     int flags,
+                                     json_t *info)
+{
+    struct launch *l;
+
+    if (!(l = calloc (1, sizeof (*l))))
+        return NULL;
+    l->lr = lr;
+    l->msg = flux_msg_incref (msg);
+    l->flags = flags;
+    if (json_is_object (info))
+        l->info = json_incref (info);
+    if (!(l->name = strdup (name))
+        || !(l->cmd_json = strdup (cmd))
+        || !(l->procs = zlistx_new ())
+        || !(l->subs = zlistx_new ())
+        || !(l->started = idset_create (0, IDSET_FLAG_AUTOGROW))
+        || !(l->exited = idset_create (0, IDSET_FLAG_AUTOGROW))
+        || !(l->timer = flux_timer_watcher_create (flux_get_reactor (lr->h),
+                                                   batch_timeout,
+                                                   0.,
+                                                   batch_timer_cb,
+                                                   l)))
+        goto error;
+    if (!(l->cmd = flux_cmd_fromjson (cmd, NULL))) {
+        errno = EPROTO;
+        goto error;
+    }
+    zlistx_set_destructor (l->procs, proc_destructor);
+    zlistx_set_destructor (l->subs, sublaunch_destructor);
+    return l;
+error:
+    launch_destroy (l);
+    return NULL;
+}
+
+static void launch_cb (flux_t *h,
+                       flux_msg_handler_t *mh,
+                       const flux_msg_t *msg,
+                       void *arg)
+{
+    struct launch_relay *lr = arg;
+    const char *name;
+    const char *ranks;
+    const char *cmd;
+    int flags;
+    json_t *info = NULL;
+    struct idset *ids = NULL;
+    struct idset *outside = NULL;
+    struct launch *l;
+    const char *errstr = NULL;
+
+    if (flux_request_unpack (msg,
+                             NULL,
+                             "{s:s s:s s:s s:i s?o}",
+                             "name", &name,
+                             "ranks", &ranks,
+                             "cmd", &cmd,
+                             "flags", &flags,
+                             "info", &info) < 0)
+        goto error;
+    if (zhashx_lookup (lr->launches, name)) {
+        errstr = "launch name is already in use";
+        errno = EEXIST;
+        goto error;
+    }
+    if (!(ids = idset_decode (ranks))
+        || !(outside = idset_difference (ids, lr->subtree)))
+        goto error;
+    if (idset_count (outside) > 0) {
+        errstr = "launch targets ranks outside of this TBON subtree";
+        errno = EINVAL;
+        goto error;
+    }
+    if (!(l = launch_create (lr, msg, name, cmd, flags, info)))
+        goto error;
+    if (zhashx_insert (lr->launches, name, l) < 0) {
+        launch_destroy (l);
+        errno = EEXIST;
+        goto error;
+    }
+    if (idset_test (ids, lr->rank))
+        launch_exec (l, lr->rank);
+    for (int i = 0; i < lr->child_count; i++) {
+        struct launch_child *child = &lr->children[i];
+        if (launch_forward (l, child, ids) < 0) {
+            struct idset *lost;
+            flux_log_error (h,
+                            "%s: error forwarding launch to rank %u",
+                            name,
+                            (unsigned int) child->rank);
+            if ((lost = idset_intersect (ids, child->ranks)))
+                launch_fail (l, lost, EHOSTUNREACH);
+            idset_destroy (lost);
+        }
+    }
+    launch_check_done (l);
+    idset_destroy (outside);
+    idset_destroy (ids);
+    return;
+error:
+    if (flux_respond_error (h, msg, errno, errstr) < 0)
+        flux_log_error (h, "error responding to job-exec.launch");
+    idset_destroy (outside);
+    idset_destroy (ids);
+}
+
+static void write_cb (flux_t *h,
+                      flux_msg_handler_t *mh,
+                      const flux_msg_t *msg,
+                      void *arg)
+{
+    struct launch_relay *lr = arg;
+    const char *payload;
+    const char *name;
+    const char *stream;
+    const char *data = NULL;
+    int eof = 0;
+    struct launch *l;
+    flux_subprocess_t *p;
+    struct sublaunch *sub;
+
+    if (flux_request_decode (msg, NULL, &payload) < 0
+        || flux_request_unpack (msg,
+                                NULL,
+                                "{s:s s:s s?s s?b}",
+                                "name", &name,
+                                "stream", &stream,
+                                "data", &data,
+                                "eof", &eof) < 0) {
+        flux_log_error (h, "error decoding job-exec.launch-write request");
+        return;
+    }
+    if (!(l = zhashx_lookup (lr->launches, name)))
+        return;
+    p = zlistx_first (l->procs);
+    while (p) {
+        if (flux_subprocess_state (p) == FLUX_SUBPROCESS_RUNNING) {
+            if (data) {
+                int len = strlen (data);
+                if (flux_subprocess_write (p, stream, data, len) < len)
+                    flux_log_error (h, "%s: flux_subprocess_write", name);
+            }
+            if (eof && flux_subprocess_close (p, stream) < 0)
+                flux_log_error (h, "%s: flux_subprocess_close", name);
+        }
+        p = zlistx_next (l->procs);
+    }
+    sub = zlistx_first (l->subs);
+    while (sub) {
+        flux_future_t *f;
+        if (!(f = flux_rpc (h,
+                            "job-exec.launch-write",
+                            payload,
+                            sub->child->rank,
+                            FLUX_RPC_NORESPONSE)))
+            flux_log_error (h, "%s: error forwarding launch-write", name);
+        flux_future_destroy (f);
+        sub = zlistx_next (l->subs);
+    }
+}
+
+static void kill_continuation (flux_future_t *f, void *arg)
+{
+    flux_t *h = flux_future_get_flux (f);
+    const flux_msg_t *msg = flux_future_aux_get (f, "msg");
+    const char *name = flux_future_first_child (f);
+    int count = 0;
+    int errnum = ENOENT;
+
+    while (name) {
+        flux_future_t *cf = flux_future_get_child (f, name);
+        if (flux_future_get (cf, NULL) == 0)
+            count++;
+        else if (errno != ENOENT) {
+            flux_log_error (h, "launch-kill: %s", name);
+            errnum = errno;
+        }
+        name = flux_future_next_child (f);
+    }
+    if (count > 0) {
+        if (flux_respond (h, msg, NULL) < 0)
+            flux_log_error (h, "error responding to job-exec.launch-kill");
+    }
+    else if (flux_respond_error (h, msg, errnum, NULL) < 0)
+        flux_log_error (h, "error responding to job-exec.launch-kill");
+    flux_future_destroy (f);
+}
+
+/*  Signal local processes of launch 'l' and forward the request to all
+ *   children that have not finished.  Return a wait_all future for the
+ *   results, or NULL with errno set (ENOENT if there is nothing to signal).
+ */
+static flux_future_t *launch_kill (struct launch *l, int signum)
+{
+    flux_t *h = l->lr->h;
+    flux_future_t *cf;
+    flux_future_t *f;
+    flux_subprocess_t *p;
+    struct sublaunch *sub;
+    char key[64];
+
+    if (!(cf = flux_future_wait_all_create ()))
+        return NULL;
+    flux_future_set_flux (cf, h);
+    p = zlistx_first (l->procs);
+    while (p) {
+        if (flux_subprocess_state (p) == FLUX_SUBPROCESS_RUNNING
+            || flux_subprocess_state (p) == FLUX_SUBPROCESS_INIT) {
+            (void) snprintf (key, sizeof (key), "%d",
+                             flux_subprocess_rank (p));
+            if (!(f = flux_subprocess_kill (p, signum))
+                || flux_future_push (cf, key, f) < 0) {
+                flux_log_error (h, "%s: kill rank %s", l->name, key);
+                flux_future_destroy (f);
+            }
+        }
+        p = zlistx_next (l->procs);
+    }
+    sub = zlistx_first (l->subs);
+    while (sub) {
+        (void) snprintf (key, sizeof (key), "subtree %u",
+                         (unsigned int) sub->child->rank);
+        if (!(f = flux_rpc_pack (h,
+                                 "job-exec.launch-kill",
+                                 sub->child->rank,
+                                 0,
+                                 "{s:s s:i}",
+                                 "name", l->name,
+                                 "signum", signum))
+            || flux_future_push (cf, key, f) < 0) {
+            flux_log_error (h, "%s: kill %s", l->name, key);
+            flux_future_destroy (f);
+        }
+        sub = zlistx_next (l->subs);
+    }
+    if (!flux_future_first_child (cf)) {
+        flux_future_destroy (cf);
+        errno = ENOENT;
+        return NULL;
+    }
+    return cf;
+}
+
+static void kill_cb (flux_t *h,
+                     flux_msg_handler_t *mh,
+                     const flux_msg_t *msg,
+                     void *arg)
+{
+    struct launch_relay *lr = arg;
+    const char *name;
+    int signum;
+    struct launch *l;
+    flux_future_t *f = NULL;
+
+    if (flux_request_unpack (msg,
+                             NULL,
+                             "{s:s s:i}",
+                             "name", &name,
+                             "signum", &signum) < 0)
+        goto error;
+    if (!(l = zhashx_lookup (lr->launches, name))) {
+        errno = ENOENT;
+        goto error;
+    }
+    if (!(f = launch_kill (l, signum)))
+        goto error;
+    if (flux_future_aux_set (f,
+                             "msg",
+                             (void *) flux_msg_incref (msg),
+                             (flux_free_f) flux_msg_decref) < 0) {
+        flux_msg_decref (msg);
+        goto error;
+    }
+    if (flux_future_then (f, -1., kill_continuation, NULL) < 0)
+        goto error;
+    return;
+error:
+    if (flux_respond_error (h, msg, errno, NULL) < 0)
+        flux_log_error (h, "error responding to job-exec.launch-kill");
+    flux_future_destroy (f);
+}
+
+static void kill_ignore_cb (flux_future_t *f, void *arg)
+{
+    flux_future_destroy (f);
+}
+
+/*  If the requester of a launch goes away, kill everything it started.
+ *   The launch is destroyed as usual once all of its processes are done.
+ */
+static void disconnect_cb (flux_t *h,
+                           flux_msg_handler_t *mh,
+                           const flux_msg_t *msg,
+                           void *arg)
+{
+    struct launch_relay *lr = arg;
+    struct launch *l;
+    flux_future_t *f;
+
+    l = zhashx_first (lr->launches);
+    while (l) {
+        if (flux_disconnect_match (msg, l->msg)) {
+            if ((f = launch_kill (l, SIGKILL))
+                && flux_future_then (f, -1., kill_ignore_cb, NULL) < 0)
+                flux_future_destroy (f);
+        }
+        l = zhashx_next (lr->launches);
+    }
+}
+
+/*  Respond with the info of the launch for job 'id'.  The launch remains
+ *   active while any process it started on this rank is running.
+ */
+static void jobinfo_cb (flux_t *h,
+                        flux_msg_handler_t *mh,
+                        const flux_msg_t *msg,
+                        void *arg)
+{
+    struct launch_relay *lr = arg;
+    json_int_t id;
+    json_int_t info_id;
+    struct launch *l;
+
+    if (flux_request_unpack (msg, NULL, "{s:I}", "id", &id) < 0)
+        goto error;
+    l = zhashx_first (lr->launches);
+    while (l) {
+        if (l->info
+            && json_unpack (l->info, "{s:I}", "id", &info_id) == 0
+            && info_id == id)
+            break;
+        l = zhashx_next (lr->launches);
+    }
+    if (!l) {
+        errno = ENOENT;
+        goto error;
+    }
+    if (flux_respond_pack (h, msg, "O", l->info) < 0)
+        flux_log_error (h, "error responding to job-exec.jobinfo");
+    return;
+error:
+    if (flux_respond_error (h, msg, errno, NULL) < 0)
+        flux_log_error (h, "error responding to job-exec.jobinfo");
+}
+
+static const struct flux_msg_handler_spec htab[] = {
+    { FLUX_MSGTYPE_REQUEST, "job-exec.launch", launch_cb, 0 },
+    { FLUX_MSGTYPE_REQUEST, "job-exec.launch-write", write_cb, 0 },
+    { FLUX_MSGTYPE_REQUEST, "job-exec.launch-kill", kill_cb, 0 },
+    { FLUX_MSGTYPE_REQUEST, "job-exec.jobinfo", jobinfo_cb, 0 },
+    { FLUX_MSGTYPE_REQUEST, "job-exec.disconnect", disconnect_cb, 0 },
+    FLUX_MSGHANDLER_TABLE_END
+};
+
+static int topo_add_ranks (json_t *topo, struct idset *ids)
+{
+    int rank;
+    json_t *children = NULL;
+    size_t index;
+    json_t *child;
+
+    if (json_unpack (topo,
+                     "{s:i s?o}",
+                     "rank", &rank,
+                     "children", &children) < 0
+        || idset_set (ids, rank) < 0) {
+        errno = EPROTO;
+        return -1;
+    }
+    json_array_foreach (children, index, child) {
+        if (topo_add_ranks (child, ids) < 0)
+            return -1;
+    }
+    return 0;
+}
+
+/*  Fetch the TBON subtree rooted at this rank, and record the ranks
+ *   reachable through each child.
+ */
+static int launch_relay_topology (struct launch_relay *lr)
+{
+    flux_future_t *f;
+    json_t *children;
+    size_t index;
+    json_t *child;
+    int rc = -1;
+
+    if (!(f = flux_rpc_pack (lr->h,
+                             "overlay.topology",
+                             FLUX_NODEID_ANY,
+                             0,
+                             "{s:i}",
+                             "rank", lr->rank))
+        || flux_rpc_get_unpack (f, "{s:o}", "children", &children) < 0)
+        goto out;
+    if (!(lr->subtree = idset_create (0, IDSET_FLAG_AUTOGROW))
+        || idset_set (lr->subtree, lr->rank) < 0)
+        goto out;
+    if (json_array_size (children) > 0) {
+        lr->children = calloc (json_array_size (children),
+                               sizeof (lr->children[0]));
+        if (!lr->children)
+            goto out;
+    }
+    json_array_foreach (children, index, child) {
+        struct launch_child *c = &lr->children[lr->child_count];
+        int rank;
+
+        if (json_unpack (child, "{s:i}", "rank", &rank) < 0) {
+            errno = EPROTO;
+            goto out;
+        }
+        c->rank = rank;
+        if (!(c->ranks = idset_create (0, IDSET_FLAG_AUTOGROW)))
+            goto out;
+        lr->child_count++;
+        if (topo_add_ranks (child, c->ranks) < 0
+            || idset_add (lr->subtree, c->ranks) < 0)
+            goto out;
+    }
+    rc = 0;
+out:
+    flux_future_destroy (f);
+    return rc;
+}
+
+void launch_relay_destroy (struct launch_relay *lr)
+{
+    if (lr) {
+        int saved_errno = errno;
+        flux_msg_handler_delvec (lr->handlers);
+        zhashx_destroy (&lr->launches);
+        for (int i = 0; i < lr->child_count; i++)
+            idset_destroy (lr->children[i].ranks);
+        free (lr->children);
+        idset_destroy (lr->subtree);
+        free (lr);
+        errno = saved_errno;
+    }
+}
+
+struct launch_relay *launch_relay_create (flux_t *h)
+{
+    struct launch_relay *lr;
+
+    if (!(lr = calloc (1, sizeof (*lr))))
+        return NULL;
+    lr->h = h;
+    if (flux_get_rank (h, &lr->rank) < 0
+        || launch_relay_topology (lr) < 0)
+        goto error;
+    if (!(lr->launches = zhashx_new ())) {
+        errno = ENOMEM;
+        goto error;
+    }
+    zhashx_set_destructor (lr->launches, launch_destructor);
+    if (flux_msg_handler_addvec (h, htab, lr, &lr->handlers) < 0)
+        goto error;
+    return lr;
+error:
+    launch_relay_destroy (lr);
+    return NULL;
+}
+
+/* vi: ts=4 sw=4 expandtab
+ */
@@ -0,0 +1,39 @@
+/************************************************************\
+ * Copyright 2024 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+/* TBON launch relay for job-exec "tree" launch mode */
+
+#ifndef HAVE_JOB_EXEC_LAUNCH_H
+#define HAVE_JOB_EXEC_LAUNCH_H 1
+
+#include <flux/core.h>
+
+struct launch_relay;
+
+/*  Register the job-exec.launch, job-exec.launch-write,
+ *   job-exec.launch-kill and job-exec.jobinfo services on this broker rank.
+ *
+ *  A job-exec.launch request names a command and a set of target ranks,
+ *   which must be this rank and/or its TBON descendants.  The relay
+ *   runs the command on this rank if targeted, and forwards one request
+ *   to each child whose subtree contains targets.  Start and exit
+ *   notifications from the subtree are aggregated into idset-keyed
+ *   responses on the way back.  Optional launch info, such as jobspec
+ *   and R, is relayed along with the request and may be fetched by
+ *   the launched processes.  See launch.c for the protocol.
+ */
+struct launch_relay *launch_relay_create (flux_t *h);
+
+void launch_relay_destroy (struct launch_relay *lr);
+
+#endif /* !HAVE_JOB_EXEC_LAUNCH_H */
+
+/* vi: ts=4 sw=4 expandtab
+ */
@@ -46,24 +46,19 @@ void exited (struct bulk_exec *exec, void *arg, const struct idset *ids)
     free (s);
 }
 
-void on_error (struct bulk_exec *exec, flux_subprocess_t *p, void *arg)
+void on_error (struct bulk_exec *exec, int rank, int errnum, void *arg)
 {
-    if (p) {
-        flux_subprocess_state_t state = flux_subprocess_state (p);
-        log_msg ("%d: pid %ju: %s", flux_subprocess_rank (p),
-                (uintmax_t) flux_subprocess_pid (p),
-                flux_subprocess_state_string (state));
-    }
+    if (rank >= 0)
+        log_msg ("%d: %s", rank, strerror (errnum));
     flux_future_t *f = bulk_exec_kill (exec, 9);
     if (flux_future_get (f, NULL) < 0)
         log_err_exit ("bulk_exec_kill");
 }
 
-void on_output (struct bulk_exec *exec, flux_subprocess_t *p,
+void on_output (struct bulk_exec *exec, int rank,
                 const char *stream, const char *data,
                 int data_len, void *arg)
 {
-    int rank = flux_subprocess_rank (p);
     FILE *fp = strcmp (stream, "stdout") == 0 ? stdout : stderr;
     fprintf (fp, "%d: %s", rank, data);
 }
@@ -190,6 +185,11 @@ int main (int ac, char **av)
           .arginfo = "NCMDS",
           .usage = "Cancel after NCMDS cmds have been launched"
         },
+        { .name = "tree",
+          .key  = 't',
+          .has_arg = 0,
+          .usage = "Launch over the TBON via job-exec.launch"
+        },
         OPTPARSE_TABLE_END
     };
 
@@ -239,6 +239,14 @@ int main (int ac, char **av)
     if (bulk_exec_set_max_per_loop (exec, optparse_get_int (p, "mpl", -1)) < 0)
         log_err_exit ("bulk_exec_set_max_per_loop");
 
+    if (optparse_hasopt (p, "tree")) {
+        char name[64];
+        (void) snprintf (name, sizeof (name), "bulk-exec-%ju",
+                         (uintmax_t) getpid ());
+        if (bulk_exec_set_tree_launch (exec, name) < 0)
+            log_err_exit ("bulk_exec_set_tree_launch");
+    }
+
     ncmds = optparse_get_int (p, "ncmds", 1);
 
     push_commands (exec, idset, ncmds, ac, av);
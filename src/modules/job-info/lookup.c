@@ -91,7 +91,10 @@ static int lookup_key (struct lookup_ctx *l,
         goto error;
     }
 
-    if (!(f = flux_kvs_lookup (l->ctx->h, NULL, 0, path))) {
+    /* Keys of a job are usually read together, so ask the KVS to
+     * prefetch the job directory when it is not cached.
+     */
+    if (!(f = flux_kvs_lookup (l->ctx->h, NULL, FLUX_KVS_PREFETCH, path))) {
         flux_log_error (l->ctx->h, "%s: flux_kvs_lookup", __FUNCTION__);
         goto error;
     }
@@ -96,7 +96,10 @@ static int check_eventlog (struct watch_ctx *w)
         return -1;
     }
 
-    if (!(w->check_f = flux_kvs_lookup (w->ctx->h, NULL, 0, key))) {
+    if (!(w->check_f = flux_kvs_lookup (w->ctx->h,
+                                        NULL,
+                                        FLUX_KVS_PREFETCH,
+                                        key))) {
         flux_log_error (w->ctx->h, "%s: flux_kvs_lookup", __FUNCTION__);
         return -1;
     }
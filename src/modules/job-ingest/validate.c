@@ -10,9 +10,16 @@
 
 /* validate - asynchronous job validation interface
  *
- * Spawn worker(s) to validate job.  Up to 'DEFAULT_WORKER_COUNT'
- * workers may be active at one time.  They are started lazily, on demand,
- * and stop after a period of inactivity (see "tunables" below).
+ * Spawn worker(s) to validate job.  Up to one worker per online core
+ * (at most 'MAX_WORKER_COUNT') may be active at one time.  They are started
+ * lazily, on demand, and stop after a period of inactivity (see "tunables"
+ * below).
+ *
+ * When the validator is configured with only the default "jobspec" plugin,
+ * jobspec is first checked in-process with flux_jobspec1_check(), plus the
+ * few checks the Python plugin makes that it does not.  Jobs that pass are
+ * accepted without a round trip to a worker.  Jobs that fail are passed on
+ * to a worker so the rejection and its error message are unchanged.
  *
  * Jobspec is expected to be in encoded JSON form, with or without
  * whitespace or NULL termination.  The encoding is normalized before
@@ -32,9 +39,11 @@
 #include <jansson.h>
 #include <assert.h>
 #include <signal.h>
+#include <string.h>
 #include <flux/core.h>
 
 #include "src/common/libutil/errno_safe.h"
+#include "src/common/libjob/jobspec1_private.h"
 
 #include "validate.h"
 #include "worker.h"
@@ -42,9 +51,10 @@
 /* Tunables:
  */
 
-/* The maximum number of concurrent workers.
+/* The maximum number of concurrent workers.  The actual limit is the
+ * number of online cores, up to this value.
  */
-#define MAX_WORKER_COUNT 4
+#define MAX_WORKER_COUNT 32
 
 /* Start a new worker if backlog reaches this level for all active workers.
  */
@@ -58,7 +68,9 @@ const double worker_inactivity_timeout = 5.0;
 
 struct validate {
     flux_t *h;
-    struct worker *worker[MAX_WORKER_COUNT];
+    bool fastpath;
+    int worker_count;
+    struct worker **worker;
 };
 
 static void validate_killall (struct validate *v)
@@ -74,7 +86,7 @@ static void validate_killall (struct validate *v)
         return;
     }
     flux_future_set_flux (cf, v->h);
-    for (i = 0; i < MAX_WORKER_COUNT; i++) {
+    for (i = 0; i < v->worker_count; i++) {
         if ((f = worker_kill (v->worker[i], SIGKILL)))
             flux_future_push (cf, NULL, f);
     }
@@ -98,7 +110,7 @@ int validate_stop_notify (struct validate *v, process_exit_f cb, void *arg)
         return 0;
 
     count = 0;
-    for (i = 0; i < MAX_WORKER_COUNT; i++)
+    for (i = 0; i < v->worker_count; i++)
         count += worker_stop_notify (v->worker[i], cb, arg);
     return count;
 }
@@ -109,8 +121,9 @@ void validate_destroy (struct validate *v)
         int saved_errno = errno;
         int i;
         validate_killall (v);
-        for (i = 0; i < MAX_WORKER_COUNT; i++)
+        for (i = 0; i < v->worker_count; i++)
             worker_destroy (v->worker[i]);
+        free (v->worker);
         free (v);
         errno = saved_errno;
     }
@@ -142,6 +155,34 @@ error:
     return -1;
 }
 
+/* The in-process check stands in for the Python "jobspec" plugin only
+ * when it is the sole plugin and its arguments cannot make it stricter.
+ */
+static bool fastpath_allowed (const char *validator_plugins,
+                              const char *validator_args)
+{
+    char *argz = NULL;
+    size_t argz_len = 0;
+    char *arg = NULL;
+    bool allowed = true;
+
+    if (validator_plugins && strcmp (validator_plugins, "jobspec") != 0)
+        return false;
+    if (validator_args) {
+        if (argz_create_sep (validator_args, ',', &argz, &argz_len) != 0)
+            return false;
+        while ((arg = argz_next (argz, argz_len, arg))) {
+            if (strcmp (arg, "--require-version=1") != 0
+                && strcmp (arg, "--require-version=any") != 0) {
+                allowed = false;
+                break;
+            }
+        }
+        free (argz);
+    }
+    return allowed;
+}
+
 int validate_configure (struct validate *v,
                         const char *validator_plugins,
                         const char *validator_args)
@@ -165,7 +206,7 @@ int validate_configure (struct validate *v,
     }
     argz_extract (argz, argz_len, argv);
 
-    for (int i = 0; i < MAX_WORKER_COUNT; i++) {
+    for (int i = 0; i < v->worker_count; i++) {
         if (!v->worker[i]) {
             char name[256];
             (void) snprintf (name, sizeof (name), "validator[%d]", i);
@@ -177,6 +218,7 @@ int validate_configure (struct validate *v,
         if (worker_set_cmdline (v->worker[i], argc, argv) < 0)
             goto error;
     }
+    v->fastpath = fastpath_allowed (validator_plugins, validator_args);
     rc = 0;
 error:
     ERRNO_SAFE_WRAP (free, argv);
@@ -187,9 +229,18 @@ error:
 struct validate *validate_create (flux_t *h)
 {
     struct validate *v;
+    long ncpus;
+
     if (!(v = calloc (1, sizeof (*v))))
         return NULL;
     v->h = h;
+    if ((ncpus = sysconf (_SC_NPROCESSORS_ONLN)) < 1)
+        ncpus = 1;
+    v->worker_count = ncpus < MAX_WORKER_COUNT ? ncpus : MAX_WORKER_COUNT;
+    if (!(v->worker = calloc (v->worker_count, sizeof (v->worker[0])))) {
+        free (v);
+        return NULL;
+    }
     return v;
 }
 
@@ -202,7 +253,7 @@ struct worker *select_best_worker (struct validate *v)
     struct worker *idle = NULL;
     int i;
 
-    for (i = 0; i < MAX_WORKER_COUNT; i++) {
+    for (i = 0; i < v->worker_count; i++) {
         if (worker_is_running (v->worker[i])) {
             if (!best || (worker_queue_depth (v->worker[i])
                         < worker_queue_depth (best)))
@@ -217,15 +268,107 @@ struct worker *select_best_worker (struct validate *v)
     return best;
 }
 
-/* Re-encode job info in compact form to eliminate any white space (esp \n),
- * then pass it to least busy validation worker, returning a future.
+/* Mirror the RFC 31 constraint check of the Python plugin, but only
+ * accept arrays as operator arguments.
+ */
+static bool constraint_check (json_t *constraint)
+{
+    const char *op;
+    json_t *args;
+    size_t index;
+    json_t *entry;
+
+    if (!json_is_object (constraint))
+        return false;
+    json_object_foreach (constraint, op, args) {
+        if (!json_is_array (args))
+            return false;
+        json_array_foreach (args, index, entry) {
+            if (!strcmp (op, "and")
+                || !strcmp (op, "or")
+                || !strcmp (op, "not")) {
+                if (!constraint_check (entry))
+                    return false;
+            }
+            else if (!strcmp (op, "properties")) {
+                if (!json_is_string (entry)
+                    || strpbrk (json_string_value (entry), "&'\"`|()"))
+                    return false;
+            }
+        }
+    }
+    return true;
+}
+
+static bool task_count_check (json_t *count, const char *name)
+{
+    json_t *o = json_object_get (count, name);
+
+    return !o || (json_is_integer (o) && json_integer_value (o) >= 1);
+}
+
+/* Return true if 'jobspec' would pass the Python "jobspec" plugin.
+ * flux_jobspec1_check() accepts a subset of what that plugin accepts,
+ * except that it only looks at the first resource and task entries and
+ * does not check task counts it has no use for, or constraints.
+ */
+static bool fastpath_check (json_t *jobspec)
+{
+    flux_jobspec1_t *js;
+    json_t *resources;
+    json_t *tasks;
+    json_t *count;
+    json_t *constraints = NULL;
+    int rc;
+
+    if (json_unpack (jobspec,
+                     "{s:o s:o s:{s?{s?o}}}",
+                     "resources", &resources,
+                     "tasks", &tasks,
+                     "attributes",
+                       "system",
+                         "constraints", &constraints) < 0
+        || json_unpack (tasks, "[{s:o}]", "count", &count) < 0)
+        return false;
+    if (json_array_size (resources) != 1
+        || json_array_size (tasks) != 1
+        || !task_count_check (count, "per_slot")
+        || !task_count_check (count, "total")
+        || (constraints && !constraint_check (constraints)))
+        return false;
+    if (!(js = jobspec1_from_json (jobspec)))
+        return false;
+    rc = flux_jobspec1_check (js, NULL);
+    flux_jobspec1_destroy (js);
+    return rc == 0;
+}
+
+/* Return an already fulfilled future for a job that passed validation.
+ */
+static flux_future_t *validate_success (struct validate *v)
+{
+    flux_future_t *f;
+
+    if (!(f = flux_future_create (NULL, NULL)))
+        return NULL;
+    flux_future_set_flux (f, v->h);
+    flux_future_fulfill (f, NULL, NULL);
+    return f;
+}
+
+/* Accept job in-process if possible.  Otherwise, re-encode job info in
+ * compact form to eliminate any white space (esp \n), then pass it to
+ * least busy validation worker, returning a future.
  */
 flux_future_t *validate_job (struct validate *v, json_t *job)
 {
     flux_future_t *f;
-    char *s;
+    char *s = NULL;
     struct worker *w;
 
+    if (v->fastpath
+        && fastpath_check (json_object_get (job, "jobspec")))
+        return validate_success (v);
     if (!(s = json_dumps (job, JSON_COMPACT))) {
         errno = ENOMEM;
         goto error;
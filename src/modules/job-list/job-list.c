@@ -99,9 +99,7 @@ static void purge_cb (flux_t *h,
 
         if ((job = zhashx_lookup (ctx->jsctx->index, &id))) {
             job_stats_purge (&ctx->jsctx->stats, job);
-            if (job->list_handle)
-                zlistx_delete (ctx->jsctx->inactive, job->list_handle);
-            zhashx_delete (ctx->jsctx->index, &id);
+            job_state_purge (ctx->jsctx, job);
             count++;
         }
     }
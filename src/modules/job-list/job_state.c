@@ -15,6 +15,7 @@
 #endif
 #include <jansson.h>
 #include <assert.h>
+#include <strings.h>
 #include <flux/core.h>
 
 #include "src/common/libczmqcontainers/czmq_containers.h"
@@ -217,15 +218,227 @@ static void revert_job_state (struct list_ctx *ctx,
     }
 }
 
+/* Hash numerical userid in 'key'.
+ * N.B. zhashx_hash_fn signature
+ */
+static size_t userid_hasher (const void *key)
+{
+    const uint32_t *userid = key;
+    return *userid;
+}
+
+/* Compare hash keys.
+ * N.B. zhashx_comparator_fn signature
+ */
+static int userid_cmp (const void *key1, const void *key2)
+{
+    const uint32_t *u1 = key1;
+    const uint32_t *u2 = key2;
+
+    return NUMCMP (*u1, *u2);
+}
+
+static void user_jobs_destroy (struct user_jobs *uj)
+{
+    if (uj) {
+        int saved_errno = errno;
+        zlistx_destroy (&uj->pending);
+        zlistx_destroy (&uj->running);
+        zlistx_destroy (&uj->inactive);
+        free (uj);
+        errno = saved_errno;
+    }
+}
+
+static void user_jobs_destroy_wrapper (void **data)
+{
+    struct user_jobs **uj = (struct user_jobs **)data;
+    user_jobs_destroy (*uj);
+}
+
+static struct user_jobs *user_jobs_create (uint32_t userid)
+{
+    struct user_jobs *uj;
+
+    if (!(uj = calloc (1, sizeof (*uj))))
+        return NULL;
+    uj->userid = userid;
+    if (!(uj->pending = zlistx_new ())
+        || !(uj->running = zlistx_new ())
+        || !(uj->inactive = zlistx_new ())) {
+        user_jobs_destroy (uj);
+        errno = ENOMEM;
+        return NULL;
+    }
+    zlistx_set_comparator (uj->pending, job_urgency_cmp);
+    return uj;
+}
+
+static struct user_jobs *get_user_jobs (struct job_state_ctx *jsctx,
+                                        uint32_t userid)
+{
+    struct user_jobs *uj;
+
+    if (!(uj = zhashx_lookup (jsctx->user_index, &userid))) {
+        if (!(uj = user_jobs_create (userid)))
+            return NULL;
+        /* key is stored in uj, so no key duplicator is set */
+        if (zhashx_insert (jsctx->user_index, &uj->userid, uj) < 0) {
+            user_jobs_destroy (uj);
+            errno = ENOMEM;
+            return NULL;
+        }
+    }
+    return uj;
+}
+
+/* Return the list in 'uj' that indexes the main list 'list'.
+ */
+static zlistx_t *user_jobs_list (struct job_state_ctx *jsctx,
+                                 struct user_jobs *uj,
+                                 zlistx_t *list)
+{
+    if (list == jsctx->pending)
+        return uj->pending;
+    else if (list == jsctx->running)
+        return uj->running;
+    else if (list == jsctx->inactive)
+        return uj->inactive;
+    return NULL;
+}
+
+static void name_list_destroy_wrapper (void **data)
+{
+    zlistx_t **l = (zlistx_t **)data;
+    zlistx_destroy (l);
+}
+
+static zlistx_t *get_name_list (struct job_state_ctx *jsctx, const char *name)
+{
+    zlistx_t *l;
+
+    if (!(l = zhashx_lookup (jsctx->name_index, name))) {
+        if (!(l = zlistx_new ())) {
+            errno = ENOMEM;
+            return NULL;
+        }
+        if (zhashx_insert (jsctx->name_index, name, l) < 0) {
+            zlistx_destroy (&l);
+            errno = ENOMEM;
+            return NULL;
+        }
+    }
+    return l;
+}
+
+zlistx_t *job_state_result_list (struct job_state_ctx *jsctx,
+                                 flux_job_result_t result)
+{
+    int i = ffs (result) - 1;
+
+    if (i < 0 || i >= JOB_RESULT_COUNT || result != (1 << i))
+        return NULL;
+    return jsctx->result_index[i];
+}
+
+static void *index_add (zlistx_t *l, struct job *job, bool end)
+{
+    if (end)
+        return zlistx_add_end (l, job);
+    return zlistx_add_start (l, job);
+}
+
+/* Add job to the secondary indexes of the main list 'list'.  Pending
+ * jobs are inserted in urgency order.  Otherwise jobs are added at the
+ * start of each index list like on the main list, or at the end if
+ * 'end' is true (see rebuild_job_index()).
+ */
+static void job_index_insert (struct job_state_ctx *jsctx,
+                              struct job *job,
+                              zlistx_t *list,
+                              bool end)
+{
+    struct user_jobs *uj;
+    zlistx_t *l;
+
+    if (!(uj = get_user_jobs (jsctx, job->userid))) {
+        flux_log_error (jsctx->h, "%s: get_user_jobs", __FUNCTION__);
+        return;
+    }
+    if (!(l = user_jobs_list (jsctx, uj, list)))
+        return;
+    if (list == jsctx->pending)
+        job->user_handle = zlistx_insert (l, job, search_direction (job));
+    else
+        job->user_handle = index_add (l, job, end);
+    if (!job->user_handle)
+        flux_log_error (jsctx->h, "%s: user index", __FUNCTION__);
+
+    if (list == jsctx->inactive) {
+        if ((l = job_state_result_list (jsctx, job->result))
+            && !(job->result_handle = index_add (l, job, end)))
+            flux_log_error (jsctx->h, "%s: result index", __FUNCTION__);
+        if (job->name) {
+            if (!(l = get_name_list (jsctx, job->name))
+                || !(job->name_handle = index_add (l, job, end)))
+                flux_log_error (jsctx->h, "%s: name index", __FUNCTION__);
+        }
+    }
+}
+
+/* Remove job from the secondary indexes of the main list 'list'.
+ */
+static void job_index_remove (struct job_state_ctx *jsctx,
+                              struct job *job,
+                              zlistx_t *list)
+{
+    struct user_jobs *uj;
+    zlistx_t *l;
+
+    if (job->user_handle
+        && (uj = zhashx_lookup (jsctx->user_index, &job->userid))
+        && (l = user_jobs_list (jsctx, uj, list)))
+        zlistx_detach (l, job->user_handle);
+    job->user_handle = NULL;
+    if (job->result_handle
+        && (l = job_state_result_list (jsctx, job->result)))
+        zlistx_detach (l, job->result_handle);
+    job->result_handle = NULL;
+    if (job->name_handle
+        && (l = zhashx_lookup (jsctx->name_index, job->name)))
+        zlistx_detach (l, job->name_handle);
+    job->name_handle = NULL;
+}
+
+/* Reorder a pending job after its priority has changed.
+ */
+static void job_reorder_pending (struct job_state_ctx *jsctx,
+                                 struct job *job)
+{
+    struct user_jobs *uj;
+
+    zlistx_reorder (jsctx->pending,
+                    job->list_handle,
+                    search_direction (job));
+    if (job->user_handle
+        && (uj = zhashx_lookup (jsctx->user_index, &job->userid)))
+        zlistx_reorder (uj->pending,
+                        job->user_handle,
+                        search_direction (job));
+}
+
 static void job_insert_list (struct job_state_ctx *jsctx,
                              struct job *job,
                              flux_job_state_t newstate)
 {
+    zlistx_t *list;
+
     /* Note: comparator is set for running & inactive lists, but the
      * sort calls are not called on zlistx_add_start() */
     if (newstate == FLUX_JOB_STATE_DEPEND
         || newstate == FLUX_JOB_STATE_PRIORITY
         || newstate == FLUX_JOB_STATE_SCHED) {
+        list = jsctx->pending;
         if (!(job->list_handle = zlistx_insert (jsctx->pending,
                                                 job,
                                                 search_direction (job))))
@@ -234,17 +447,20 @@ static void job_insert_list (struct job_state_ctx *jsctx,
     }
     else if (newstate == FLUX_JOB_STATE_RUN
              || newstate == FLUX_JOB_STATE_CLEANUP) {
+        list = jsctx->running;
         if (!(job->list_handle = zlistx_add_start (jsctx->running,
                                                    job)))
             flux_log_error (jsctx->h, "%s: zlistx_add_start",
                             __FUNCTION__);
     }
     else { /* newstate == FLUX_JOB_STATE_INACTIVE */
+        list = jsctx->inactive;
         if (!(job->list_handle = zlistx_add_start (jsctx->inactive,
                                                    job)))
             flux_log_error (jsctx->h, "%s: zlistx_add_start",
                             __FUNCTION__);
     }
+    job_index_insert (jsctx, job, list, false);
 }
 
 /* remove job from one list and move it to another based on the
@@ -254,6 +470,7 @@ static void job_change_list (struct job_state_ctx *jsctx,
                              zlistx_t *oldlist,
                              flux_job_state_t newstate)
 {
+    job_index_remove (jsctx, job, oldlist);
     if (zlistx_detach (oldlist, job->list_handle) < 0)
         flux_log_error (jsctx->h, "%s: zlistx_detach",
                         __FUNCTION__);
@@ -301,9 +518,7 @@ static void update_job_state_and_list (struct list_ctx *ctx,
         job_change_list (jsctx, job, oldlist, newstate);
     else if (oldlist == jsctx->pending
              && newstate == FLUX_JOB_STATE_SCHED)
-        zlistx_reorder (jsctx->pending,
-                        job->list_handle,
-                        search_direction (job));
+        job_reorder_pending (jsctx, job);
 }
 
 static void list_id_respond (struct list_ctx *ctx,
@@ -1162,6 +1377,21 @@ static void sort_job_list (zlistx_t *list)
     }
 }
 
+/* Re-add the jobs on 'list' to the secondary indexes in list order,
+ * after the list has been sorted by sort_job_list().
+ */
+static void rebuild_job_index (struct job_state_ctx *jsctx, zlistx_t *list)
+{
+    struct job *job;
+
+    job = zlistx_first (list);
+    while (job) {
+        job_index_remove (jsctx, job, list);
+        job_index_insert (jsctx, job, list, true);
+        job = zlistx_next (list);
+    }
+}
+
 /* Read jobs present in the KVS at startup. */
 int job_state_init_from_kvs (struct list_ctx *ctx)
 {
@@ -1176,6 +1406,8 @@ int job_state_init_from_kvs (struct list_ctx *ctx)
 
     sort_job_list (ctx->jsctx->running);
     sort_job_list (ctx->jsctx->inactive);
+    rebuild_job_index (ctx->jsctx, ctx->jsctx->running);
+    rebuild_job_index (ctx->jsctx, ctx->jsctx->inactive);
     return 0;
 }
 
@@ -1332,9 +1564,7 @@ static int journal_priority_event (struct job_state_ctx *jsctx,
 
     if (job->state & FLUX_JOB_STATE_PENDING
         && job->priority != orig_priority)
-        zlistx_reorder (jsctx->pending,
-                        job->list_handle,
-                        search_direction (job));
+        job_reorder_pending (jsctx, job);
 
     return job_transition_state (jsctx,
                                  job,
@@ -1834,6 +2064,7 @@ struct job_state_ctx *job_state_create (struct list_ctx *ctx)
 {
     struct job_state_ctx *jsctx = NULL;
     int saved_errno;
+    int i;
 
     if (!(jsctx = calloc (1, sizeof (*jsctx)))) {
         flux_log_error (ctx->h, "calloc");
@@ -1866,6 +2097,23 @@ struct job_state_ctx *job_state_create (struct list_ctx *ctx)
     if (!(jsctx->processing = zlistx_new ()))
         goto error;
 
+    if (!(jsctx->user_index = zhashx_new ()))
+        goto error;
+    zhashx_set_key_hasher (jsctx->user_index, userid_hasher);
+    zhashx_set_key_comparator (jsctx->user_index, userid_cmp);
+    zhashx_set_key_duplicator (jsctx->user_index, NULL);
+    zhashx_set_key_destructor (jsctx->user_index, NULL);
+    zhashx_set_destructor (jsctx->user_index, user_jobs_destroy_wrapper);
+
+    for (i = 0; i < JOB_RESULT_COUNT; i++) {
+        if (!(jsctx->result_index[i] = zlistx_new ()))
+            goto error;
+    }
+
+    if (!(jsctx->name_index = zhashx_new ()))
+        goto error;
+    zhashx_set_destructor (jsctx->name_index, name_list_destroy_wrapper);
+
     if (!(jsctx->futures = zlistx_new ()))
         goto error;
 
@@ -1888,6 +2136,7 @@ void job_state_destroy (void *data)
 {
     struct job_state_ctx *jsctx = data;
     if (jsctx) {
+        int i;
         /* Don't destroy processing until futures are complete */
         if (jsctx->futures) {
             flux_future_t *f;
@@ -1903,6 +2152,10 @@ void job_state_destroy (void *data)
         }
         /* Destroy index last, as it is the one that will actually
          * destroy the job objects */
+        zhashx_destroy (&jsctx->name_index);
+        for (i = 0; i < JOB_RESULT_COUNT; i++)
+            zlistx_destroy (&jsctx->result_index[i]);
+        zhashx_destroy (&jsctx->user_index);
         zlistx_destroy (&jsctx->processing);
         zlistx_destroy (&jsctx->inactive);
         zlistx_destroy (&jsctx->running);
@@ -1914,6 +2167,26 @@ void job_state_destroy (void *data)
     }
 }
 
+void job_state_purge (struct job_state_ctx *jsctx, struct job *job)
+{
+    struct user_jobs *uj;
+    zlistx_t *l;
+
+    job_index_remove (jsctx, job, jsctx->inactive);
+    if ((uj = zhashx_lookup (jsctx->user_index, &job->userid))
+        && zlistx_size (uj->pending) == 0
+        && zlistx_size (uj->running) == 0
+        && zlistx_size (uj->inactive) == 0)
+        zhashx_delete (jsctx->user_index, &job->userid);
+    if (job->name
+        && (l = zhashx_lookup (jsctx->name_index, job->name))
+        && zlistx_size (l) == 0)
+        zhashx_delete (jsctx->name_index, job->name);
+    if (job->list_handle)
+        zlistx_delete (jsctx->inactive, job->list_handle);
+    zhashx_delete (jsctx->index, &job->id);
+}
+
 /*
  * vi:tabstop=4 shiftwidth=4 expandtab
  */
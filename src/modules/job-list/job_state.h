@@ -36,8 +36,27 @@
  * cannot yet be stored on one of the lists above.
  *
  * The list `futures` is used to store in process futures.
+ *
+ * Secondary indexes allow queries that filter on userid, result, or
+ * job name to avoid walking every job.  Each index list holds a
+ * subset of the jobs on the pending, running, or inactive list, in
+ * the same order as that list.
+ *
+ * - user_index - hash of userid to struct user_jobs
+ * - result_index - inactive jobs by result, where result_index[i]
+ *   holds the jobs with result (1 << i)
+ * - name_index - hash of job name to list of inactive jobs
  */
 
+#define JOB_RESULT_COUNT 4
+
+struct user_jobs {
+    uint32_t userid;
+    zlistx_t *pending;
+    zlistx_t *running;
+    zlistx_t *inactive;
+};
+
 struct job_state_ctx {
     flux_t *h;
     struct list_ctx *ctx;
@@ -48,6 +67,10 @@ struct job_state_ctx {
     zlistx_t *processing;
     zlistx_t *futures;
 
+    zhashx_t *user_index;
+    zlistx_t *result_index[JOB_RESULT_COUNT];
+    zhashx_t *name_index;
+
     /*  Job statistics: */
     struct job_stats stats;
 
@@ -123,6 +146,11 @@ struct job {
     unsigned int states_events_mask;
     void *list_handle;
 
+    /* handles in secondary indexes, see struct job_state_ctx */
+    void *user_handle;
+    void *result_handle;
+    void *name_handle;
+
     int eventlog_seq;           /* last event seq read */
 };
 
@@ -138,6 +166,16 @@ void job_state_unpause_cb (flux_t *h, flux_msg_handler_t *mh,
 
 int job_state_init_from_kvs (struct list_ctx *ctx);
 
+/* Return the result index list for 'result', or NULL if invalid.
+ */
+zlistx_t *job_state_result_list (struct job_state_ctx *jsctx,
+                                 flux_job_result_t result);
+
+/* Remove an inactive job from the inactive list and secondary
+ * indexes, then destroy it.
+ */
+void job_state_purge (struct job_state_ctx *jsctx, struct job *job);
+
 #endif /* ! _FLUX_JOB_LIST_JOB_STATE_H */
 
 /*
@@ -46,6 +46,42 @@ bool job_filter (struct job *job, uint32_t userid, int states, int results)
     return true;
 }
 
+/* Select the list to walk for jobs on the main list 'list' (pending,
+ * running, or inactive) that may match 'userid' and 'results'.  The
+ * secondary indexes hold the same jobs in the same order, so the
+ * smallest applicable one is chosen.  Returns NULL if no job can match.
+ */
+static zlistx_t *select_list (struct job_state_ctx *jsctx,
+                              zlistx_t *list,
+                              uint32_t userid,
+                              int results)
+{
+    zlistx_t *best = list;
+
+    if (userid != FLUX_USERID_UNKNOWN) {
+        struct user_jobs *uj;
+
+        if (!(uj = zhashx_lookup (jsctx->user_index, &userid)))
+            return NULL;
+        if (list == jsctx->pending)
+            best = uj->pending;
+        else if (list == jsctx->running)
+            best = uj->running;
+        else
+            best = uj->inactive;
+    }
+    /* result index is usable only if a single result is requested */
+    if (list == jsctx->inactive && !(results & (results - 1))) {
+        zlistx_t *l;
+
+        if (!(l = job_state_result_list (jsctx, results)))
+            return NULL;
+        if (zlistx_size (l) < zlistx_size (best))
+            best = l;
+    }
+    return best;
+}
+
 /* Put jobs from list onto jobs array, breaking if max_entries has
  * been reached. Returns 1 if jobs array is full, 0 if continue, -1
  * one error with errno set:
@@ -63,6 +99,9 @@ int get_jobs_from_list (json_t *jobs,
 {
     struct job *job;
 
+    if (!list)
+        return 0;
+
     job = zlistx_first (list);
     while (job) {
         if (job_filter (job, userid, states, results)) {
@@ -111,7 +150,10 @@ json_t *get_jobs (struct list_ctx *ctx,
     if (states & FLUX_JOB_STATE_PENDING) {
         if ((ret = get_jobs_from_list (jobs,
                                        errp,
-                                       ctx->jsctx->pending,
+                                       select_list (ctx->jsctx,
+                                                    ctx->jsctx->pending,
+                                                    userid,
+                                                    results),
                                        max_entries,
                                        attrs,
                                        userid,
@@ -124,7 +166,10 @@ json_t *get_jobs (struct list_ctx *ctx,
         if (!ret) {
             if ((ret = get_jobs_from_list (jobs,
                                            errp,
-                                           ctx->jsctx->running,
+                                           select_list (ctx->jsctx,
+                                                        ctx->jsctx->running,
+                                                        userid,
+                                                        results),
                                            max_entries,
                                            attrs,
                                            userid,
@@ -138,7 +183,10 @@ json_t *get_jobs (struct list_ctx *ctx,
         if (!ret) {
             if ((ret = get_jobs_from_list (jobs,
                                            errp,
-                                           ctx->jsctx->inactive,
+                                           select_list (ctx->jsctx,
+                                                        ctx->jsctx->inactive,
+                                                        userid,
+                                                        results),
                                            max_entries,
                                            attrs,
                                            userid,
@@ -235,13 +283,18 @@ json_t *get_inactive_jobs (struct list_ctx *ctx,
                            const char *name)
 {
     json_t *jobs = NULL;
+    zlistx_t *list = ctx->jsctx->inactive;
     struct job *job;
     int saved_errno;
 
     if (!(jobs = json_array ()))
         goto error_nomem;
 
-    job = zlistx_first (ctx->jsctx->inactive);
+    /* name index holds inactive jobs in the same order */
+    if (name && !(list = zhashx_lookup (ctx->jsctx->name_index, name)))
+        goto out;
+
+    job = zlistx_first (list);
     while (job && (job->t_inactive > since)) {
         json_t *o;
         if (!name || strcmp (job->name, name) == 0) {
@@ -255,7 +308,7 @@ json_t *get_inactive_jobs (struct list_ctx *ctx,
             if (json_array_size (jobs) == max_entries)
                 goto out;
         }
-        job = zlistx_next (ctx->jsctx->inactive);
+        job = zlistx_next (list);
     }
 
 out:
@@ -28,6 +28,7 @@
 #include "ccan/str/str.h"
 
 #include "job.h"
+#include "jobq.h"
 #include "alloc.h"
 #include "event.h"
 #include "drain.h"
@@ -36,8 +37,8 @@
 struct alloc {
     struct job_manager *ctx;
     flux_msg_handler_t **handlers;
-    zlistx_t *queue;
-    zlistx_t *pending_jobs;
+    struct jobq *queue;         // jobs awaiting alloc, highest priority first
+    struct jobq *pending_jobs;  // jobs with alloc pending, lowest priority first
     bool ready;
     bool disable;
     char *disable_reason;
@@ -55,17 +56,12 @@ struct alloc {
 static void requeue_pending (struct alloc *alloc, struct job *job)
 {
     struct job_manager *ctx = alloc->ctx;
-    bool fwd = job->priority > (FLUX_JOB_PRIORITY_MAX / 2);
     bool cleared = false;
 
     assert (job->alloc_pending);
-    if (job->handle) {
-        if (zlistx_delete (alloc->pending_jobs, job->handle) < 0)
-            flux_log (ctx->h, LOG_ERR, "failed to dequeue pending job");
-        job->handle = NULL;
-    }
+    jobq_remove (alloc->pending_jobs, job);
     job->alloc_pending = 0;
-    if (!(job->handle = zlistx_insert (alloc->queue, job, fwd)))
+    if (jobq_insert (alloc->queue, job) < 0)
         flux_log (ctx->h, LOG_ERR, "failed to enqueue job for scheduling");
     job->alloc_queued = 1;
     annotations_sched_clear (job, &cleared);
@@ -225,11 +221,8 @@ static void alloc_response_cb (flux_t *h, flux_msg_handler_t *mh,
     }
     switch (type) {
     case FLUX_SCHED_ALLOC_SUCCESS:
-        if (alloc->alloc_limit) {
-            if (zlistx_delete (alloc->pending_jobs, job->handle) < 0)
-                flux_log (ctx->h, LOG_ERR, "failed to dequeue pending job");
-            job->handle = NULL;
-        }
+        if (alloc->alloc_limit)
+            jobq_remove (alloc->pending_jobs, job);
         if (job->has_resources) {
             flux_log (h,
                       LOG_ERR,
@@ -267,11 +260,8 @@ static void alloc_response_cb (flux_t *h, flux_msg_handler_t *mh,
     case FLUX_SCHED_ALLOC_DENY: // error
         alloc->alloc_pending_count--;
         job->alloc_pending = 0;
-        if (alloc->alloc_limit) {
-            if (zlistx_delete (alloc->pending_jobs, job->handle) < 0)
-                flux_log (ctx->h, LOG_ERR, "failed to dequeue pending job");
-            job->handle = NULL;
-        }
+        if (alloc->alloc_limit)
+            jobq_remove (alloc->pending_jobs, job);
         annotations_clear (job, &cleared);
         if (cleared) {
             if (event_job_post_pack (ctx->event, job, "annotations",
@@ -294,11 +284,8 @@ static void alloc_response_cb (flux_t *h, flux_msg_handler_t *mh,
         if (job->state == FLUX_JOB_STATE_SCHED)
             requeue_pending (alloc, job);
         else {
-            if (alloc->alloc_limit) {
-                if (zlistx_delete (alloc->pending_jobs, job->handle) < 0)
-                    flux_log (ctx->h, LOG_ERR, "failed to dequeue pending job");
-                job->handle = NULL;
-            }
+            if (alloc->alloc_limit)
+                jobq_remove (alloc->pending_jobs, job);
             annotations_clear (job, &cleared);
         }
         job->alloc_pending = 0;
@@ -435,7 +422,7 @@ static void ready_cb (flux_t *h, flux_msg_handler_t *mh,
     }
     ctx->alloc->ready = true;
     flux_log (h, LOG_DEBUG, "scheduler: ready %s", mode);
-    count = zlistx_size (ctx->alloc->queue);
+    count = jobq_size (ctx->alloc->queue);
     if (flux_respond_pack (h, msg, "{s:i}", "count", count) < 0)
         flux_log_error (h, "%s: flux_respond_pack", __FUNCTION__);
     /* Restart any free requests that might have been interrupted
@@ -467,7 +454,7 @@ static bool alloc_work_available (struct job_manager *ctx)
         return false;
     if (!ctx->alloc->ready) // scheduler protocol is not ready for alloc
         return false;
-    if (!(job = zlistx_first (ctx->alloc->queue))) // queue is empty
+    if (!(job = jobq_peek (ctx->alloc->queue))) // queue is empty
         return false;
     if (ctx->alloc->alloc_limit > 0 // alloc limit reached
         && ctx->alloc->alloc_pending_count >= ctx->alloc->alloc_limit)
@@ -510,15 +497,16 @@ static void check_cb (flux_reactor_t *r, flux_watcher_t *w,
     if (!alloc_work_available (ctx))
         return;
 
-    job = zlistx_first (alloc->queue);
+    job = jobq_peek (alloc->queue);
 
     if (alloc_request (alloc, job) < 0) {
         flux_log_error (ctx->h, "alloc_request fatal error");
         flux_reactor_stop_error (flux_get_reactor (ctx->h));
         return;
     }
-    zlistx_delete (alloc->queue, job->handle);
-    job->handle = NULL;
+    /* N.B. the job remains referenced by ctx->active_jobs after removal.
+     */
+    jobq_remove (alloc->queue, job);
     job->alloc_pending = 1;
     job->alloc_queued = 0;
     alloc->alloc_pending_count++;
@@ -527,8 +515,7 @@ static void check_cb (flux_reactor_t *r, flux_watcher_t *w,
      * and higher priority requests need to preempt lower priority ones.
      */
     if (alloc->alloc_limit) {
-        bool fwd = job->priority > (FLUX_JOB_PRIORITY_MAX / 2);
-        if (!(job->handle = zlistx_insert (alloc->pending_jobs, job, fwd)))
+        if (jobq_insert (alloc->pending_jobs, job) < 0)
             flux_log (ctx->h, LOG_ERR, "failed to enqueue pending job");
     }
     /* Post event for debugging if job was submitted FLUX_JOB_DEBUG flag.
@@ -562,9 +549,8 @@ int alloc_enqueue_alloc_request (struct alloc *alloc, struct job *job)
         && !job->alloc_queued
         && !job->alloc_pending
         && job->priority != FLUX_JOB_PRIORITY_MIN) {
-        bool fwd = job->priority > (FLUX_JOB_PRIORITY_MAX / 2);
         assert (job->handle == NULL);
-        if (!(job->handle = zlistx_insert (alloc->queue, job, fwd)))
+        if (jobq_insert (alloc->queue, job) < 0)
             return -1;
         job->alloc_queued = 1;
     }
@@ -577,8 +563,7 @@ int alloc_enqueue_alloc_request (struct alloc *alloc, struct job *job)
 void alloc_dequeue_alloc_request (struct alloc *alloc, struct job *job)
 {
     if (job->alloc_queued) {
-        zlistx_delete (alloc->queue, job->handle);
-        job->handle = NULL;
+        jobq_remove (alloc->queue, job);
         job->alloc_queued = 0;
     }
 }
@@ -598,53 +583,30 @@ int alloc_cancel_alloc_request (struct alloc *alloc, struct job *job)
 /* called from list_handle_request() */
 struct job *alloc_queue_first (struct alloc *alloc)
 {
-    return zlistx_first (alloc->queue);
+    return jobq_first (alloc->queue);
 }
 
 struct job *alloc_queue_next (struct alloc *alloc)
 {
-    return zlistx_next (alloc->queue);
+    return jobq_next (alloc->queue);
 }
 
 /* called from reprioritize_job() */
 void alloc_queue_reorder (struct alloc *alloc, struct job *job)
 {
-    bool fwd = job->priority > (FLUX_JOB_PRIORITY_MAX / 2);
-
-    zlistx_reorder (alloc->queue, job->handle, fwd);
+    jobq_update (alloc->queue, job);
 }
 
 void alloc_pending_reorder (struct alloc *alloc, struct job *job)
 {
-    if (alloc->alloc_limit) {
-        bool fwd = job->priority > (FLUX_JOB_PRIORITY_MAX / 2);
-        zlistx_reorder (alloc->pending_jobs, job->handle, fwd);
-    }
+    if (alloc->alloc_limit)
+        jobq_update (alloc->pending_jobs, job);
 }
 
 int alloc_queue_reprioritize (struct alloc *alloc)
 {
-    struct job *job;
-    zlistx_sort (alloc->queue);
-
-    /*  N.B.: zlistx_sort() invalidates all list handles since
-     *   the sort swaps contents of nodes, not the nodes themselves.
-     *   Therefore, job handles into the list must be re-acquired here:
-     */
-
-    job = zlistx_first (alloc->queue);
-    while (job) {
-        job->handle = zlistx_cursor (alloc->queue);
-        job = zlistx_next (alloc->queue);
-    }
-
-    zlistx_sort (alloc->pending_jobs);
-
-    job = zlistx_first (alloc->pending_jobs);
-    while (job) {
-        job->handle = zlistx_cursor (alloc->pending_jobs);
-        job = zlistx_next (alloc->pending_jobs);
-    }
+    jobq_rebuild (alloc->queue);
+    jobq_rebuild (alloc->pending_jobs);
 
     if (alloc->alloc_limit)
         return alloc_queue_recalc_pending (alloc);
@@ -655,8 +617,8 @@ int alloc_queue_reprioritize (struct alloc *alloc)
 /* called if highest priority job may have changed */
 int alloc_queue_recalc_pending (struct alloc *alloc)
 {
-    struct job *head = zlistx_first (alloc->queue);
-    struct job *tail = zlistx_last (alloc->pending_jobs);
+    struct job *head = jobq_first (alloc->queue);
+    struct job *tail = jobq_first (alloc->pending_jobs); // lowest priority
     while (alloc->alloc_limit
            && head
            && tail) {
@@ -669,8 +631,8 @@ int alloc_queue_recalc_pending (struct alloc *alloc)
         }
         else
             break;
-        head = zlistx_next (alloc->queue);
-        tail = zlistx_prev (alloc->pending_jobs);
+        head = jobq_next (alloc->queue);
+        tail = jobq_next (alloc->pending_jobs);
     }
     return 0;
 }
@@ -769,7 +731,7 @@ static void alloc_admin_cb (flux_t *h,
                            "reason",
                            reason ? reason : "",
                            "queue_length",
-                           zlistx_size (alloc->queue),
+                           jobq_size (alloc->queue),
                            "alloc_pending",
                            alloc->alloc_pending_count,
                            "free_pending",
@@ -807,8 +769,8 @@ void alloc_ctx_destroy (struct alloc *alloc)
         flux_watcher_destroy (alloc->prep);
         flux_watcher_destroy (alloc->check);
         flux_watcher_destroy (alloc->idle);
-        zlistx_destroy (&alloc->queue);
-        zlistx_destroy (&alloc->pending_jobs);
+        jobq_destroy (alloc->queue);
+        jobq_destroy (alloc->pending_jobs);
         free (alloc->disable_reason);
         free (alloc->sched_sender);
         free (alloc);
@@ -816,6 +778,15 @@ void alloc_ctx_destroy (struct alloc *alloc)
     }
 }
 
+/* Order pending_jobs from lowest to highest priority, so that the
+ * first jobs visited by alloc_queue_recalc_pending() are the ones
+ * that would be preempted first.
+ */
+static int pending_comparator (const void *a1, const void *a2)
+{
+    return job_priority_comparator (a2, a1);
+}
+
 static const struct flux_msg_handler_spec htab[] = {
     {   FLUX_MSGTYPE_REQUEST,
         "job-manager.sched-hello",
@@ -853,17 +824,10 @@ struct alloc *alloc_ctx_create (struct job_manager *ctx)
     if (!(alloc = calloc (1, sizeof (*alloc))))
         return NULL;
     alloc->ctx = ctx;
-    if (!(alloc->queue = zlistx_new()))
+    if (!(alloc->queue = jobq_create (job_priority_comparator)))
         goto error;
-    zlistx_set_destructor (alloc->queue, job_destructor);
-    zlistx_set_comparator (alloc->queue, job_priority_comparator);
-    zlistx_set_duplicator (alloc->queue, job_duplicator);
-
-    if (!(alloc->pending_jobs = zlistx_new()))
+    if (!(alloc->pending_jobs = jobq_create (pending_comparator)))
         goto error;
-    zlistx_set_destructor (alloc->pending_jobs, job_destructor);
-    zlistx_set_comparator (alloc->pending_jobs, job_priority_comparator);
-    zlistx_set_duplicator (alloc->pending_jobs, job_duplicator);
 
     if (flux_msg_handler_addvec (ctx->h, htab, ctx, &alloc->handlers) < 0)
         goto error;
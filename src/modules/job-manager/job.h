@@ -56,7 +56,7 @@ struct job {
 
     struct bitmap *events;  // set of events by id posted to this job
 
-    void *handle;           // zlistx_t handle
+    void *handle;           // zlistx_t or jobq handle
     int refcount;           // private to job.c
 
     struct aux_item *aux;
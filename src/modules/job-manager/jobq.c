@@ -0,0 +1,288 @@
+/************************************************************\
+ * Copyright 2024 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+/* jobq.c - indexed binary heap of jobs
+ *
+ * The heap is an array of entries, each of which records its own array
+ * index so that a job (via job->handle) can be located, removed, or
+ * re-sifted in O(log n) without searching.
+ *
+ * Ordered iteration walks the heap best-first: a second, smaller heap
+ * (the cursor) holds the indices of the frontier of unvisited nodes.
+ * Popping a node pushes its two children, so the cursor never holds
+ * more entries than the main heap.
+ */
+
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdlib.h>
+#include <stdbool.h>
+#include <errno.h>
+
+#include "job.h"
+#include "jobq.h"
+
+#define JOBQ_INITIAL_CAPACITY 64
+
+struct jobq_entry {
+    struct jobq *q;
+    struct job *job;
+    size_t index;
+};
+
+struct jobq {
+    jobq_compare_f cmp;
+    struct jobq_entry **heap;
+    size_t size;
+    size_t capacity;
+    size_t *cursor;             // heap of indices into 'heap' for iteration
+    size_t cursor_size;
+};
+
+static inline bool before (struct jobq *q, size_t i, size_t j)
+{
+    return q->cmp (q->heap[i]->job, q->heap[j]->job) < 0;
+}
+
+static inline void swap (struct jobq *q, size_t i, size_t j)
+{
+    struct jobq_entry *tmp = q->heap[i];
+
+    q->heap[i] = q->heap[j];
+    q->heap[i]->index = i;
+    q->heap[j] = tmp;
+    q->heap[j]->index = j;
+}
+
+static size_t sift_up (struct jobq *q, size_t i)
+{
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+        if (!before (q, i, parent))
+            break;
+        swap (q, i, parent);
+        i = parent;
+    }
+    return i;
+}
+
+static void sift_down (struct jobq *q, size_t i)
+{
+    for (;;) {
+        size_t left = 2 * i + 1;
+        size_t right = left + 1;
+        size_t best = i;
+
+        if (left < q->size && before (q, left, best))
+            best = left;
+        if (right < q->size && before (q, right, best))
+            best = right;
+        if (best == i)
+            break;
+        swap (q, i, best);
+        i = best;
+    }
+}
+
+static int grow (struct jobq *q)
+{
+    size_t capacity = q->capacity ? q->capacity * 2 : JOBQ_INITIAL_CAPACITY;
+    struct jobq_entry **heap;
+    size_t *cursor;
+
+    if (!(heap = realloc (q->heap, capacity * sizeof (heap[0]))))
+        return -1;
+    q->heap = heap;
+    if (!(cursor = realloc (q->cursor, capacity * sizeof (cursor[0]))))
+        return -1;
+    q->cursor = cursor;
+    q->capacity = capacity;
+    return 0;
+}
+
+size_t jobq_size (struct jobq *q)
+{
+    return q ? q->size : 0;
+}
+
+int jobq_insert (struct jobq *q, struct job *job)
+{
+    struct jobq_entry *entry;
+
+    if (!q || !job || job->handle) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (q->size == q->capacity && grow (q) < 0)
+        return -1;
+    if (!(entry = calloc (1, sizeof (*entry))))
+        return -1;
+    entry->q = q;
+    entry->job = job_incref (job);
+    entry->index = q->size;
+    q->heap[q->size++] = entry;
+    job->handle = entry;
+    sift_up (q, entry->index);
+    return 0;
+}
+
+void jobq_remove (struct jobq *q, struct job *job)
+{
+    struct jobq_entry *entry;
+    size_t i;
+
+    if (!q || !job || !(entry = job->handle) || entry->q != q)
+        return;
+    i = entry->index;
+    if (i < --q->size) {
+        q->heap[i] = q->heap[q->size];
+        q->heap[i]->index = i;
+        sift_down (q, sift_up (q, i));
+    }
+    job->handle = NULL;
+    free (entry);
+    job_decref (job);
+}
+
+void jobq_update (struct jobq *q, struct job *job)
+{
+    struct jobq_entry *entry;
+
+    if (!q || !job || !(entry = job->handle) || entry->q != q)
+        return;
+    sift_down (q, sift_up (q, entry->index));
+}
+
+void jobq_rebuild (struct jobq *q)
+{
+    size_t i;
+
+    if (!q || q->size < 2)
+        return;
+    i = q->size / 2;
+    while (i-- > 0)
+        sift_down (q, i);
+}
+
+struct job *jobq_peek (struct jobq *q)
+{
+    if (!q || q->size == 0)
+        return NULL;
+    return q->heap[0]->job;
+}
+
+static inline bool cursor_before (struct jobq *q, size_t i, size_t j)
+{
+    return before (q, q->cursor[i], q->cursor[j]);
+}
+
+static void cursor_push (struct jobq *q, size_t index)
+{
+    size_t i = q->cursor_size++;
+
+    q->cursor[i] = index;
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+        size_t tmp;
+        if (!cursor_before (q, i, parent))
+            break;
+        tmp = q->cursor[i];
+        q->cursor[i] = q->cursor[parent];
+        q->cursor[parent] = tmp;
+        i = parent;
+    }
+}
+
+static size_t cursor_pop (struct jobq *q)
+{
+    size_t top = q->cursor[0];
+    size_t i = 0;
+
+    q->cursor[0] = q->cursor[--q->cursor_size];
+    for (;;) {
+        size_t left = 2 * i + 1;
+        size_t right = left + 1;
+        size_t best = i;
+        size_t tmp;
+
+        if (left < q->cursor_size && cursor_before (q, left, best))
+            best = left;
+        if (right < q->cursor_size && cursor_before (q, right, best))
+            best = right;
+        if (best == i)
+            break;
+        tmp = q->cursor[i];
+        q->cursor[i] = q->cursor[best];
+        q->cursor[best] = tmp;
+        i = best;
+    }
+    return top;
+}
+
+struct job *jobq_first (struct jobq *q)
+{
+    if (!q)
+        return NULL;
+    q->cursor_size = 0;
+    if (q->size > 0)
+        cursor_push (q, 0);
+    return jobq_next (q);
+}
+
+struct job *jobq_next (struct jobq *q)
+{
+    size_t index;
+
+    if (!q || q->cursor_size == 0)
+        return NULL;
+    index = cursor_pop (q);
+    if (2 * index + 1 < q->size)
+        cursor_push (q, 2 * index + 1);
+    if (2 * index + 2 < q->size)
+        cursor_push (q, 2 * index + 2);
+    return q->heap[index]->job;
+}
+
+void jobq_destroy (struct jobq *q)
+{
+    if (q) {
+        int saved_errno = errno;
+        size_t i;
+        for (i = 0; i < q->size; i++) {
+            struct jobq_entry *entry = q->heap[i];
+            entry->job->handle = NULL;
+            job_decref (entry->job);
+            free (entry);
+        }
+        free (q->heap);
+        free (q->cursor);
+        free (q);
+        errno = saved_errno;
+    }
+}
+
+struct jobq *jobq_create (jobq_compare_f cmp)
+{
+    struct jobq *q;
+
+    if (!cmp) {
+        errno = EINVAL;
+        return NULL;
+    }
+    if (!(q = calloc (1, sizeof (*q))))
+        return NULL;
+    q->cmp = cmp;
+    return q;
+}
+
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */
@@ -0,0 +1,67 @@
+/************************************************************\
+ * Copyright 2024 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+#ifndef _FLUX_JOB_MANAGER_JOBQ_H
+#define _FLUX_JOB_MANAGER_JOBQ_H
+
+#include <stddef.h>
+
+#include "job.h"
+
+/* jobq - indexed binary heap of jobs
+ *
+ * Jobs are ordered by a comparator with zlistx_comparator_fn signature,
+ * e.g. job_priority_comparator().  The comparator must define a total
+ * order (no two jobs compare equal) so that ordering is deterministic.
+ *
+ * A job may be in at most one jobq at a time: its position is tracked
+ * through job->handle, which is non-NULL while the job is queued.
+ * The queue holds a reference on each job.
+ */
+
+typedef int (*jobq_compare_f)(const void *a1, const void *a2);
+
+struct jobq *jobq_create (jobq_compare_f cmp);
+void jobq_destroy (struct jobq *q);
+
+size_t jobq_size (struct jobq *q);
+
+/* Add job to queue in O(log n).  Returns 0 on success, -1 with errno set.
+ */
+int jobq_insert (struct jobq *q, struct job *job);
+
+/* Remove job from queue in O(log n).  No-op if job is not in this queue.
+ */
+void jobq_remove (struct jobq *q, struct job *job);
+
+/* Restore order after the sort key of 'job' has changed, in O(log n).
+ */
+void jobq_update (struct jobq *q, struct job *job);
+
+/* Restore order after the sort keys of many jobs have changed, in O(n).
+ */
+void jobq_rebuild (struct jobq *q);
+
+/* Return the first job in comparator order without disturbing
+ * any iteration in progress, or NULL if the queue is empty.
+ */
+struct job *jobq_peek (struct jobq *q);
+
+/* Iterate over jobs in comparator order.  Returning the first k jobs
+ * costs O(k log k).  Iteration is invalidated by any queue modification.
+ */
+struct job *jobq_first (struct jobq *q);
+struct job *jobq_next (struct jobq *q);
+
+#endif /* ! _FLUX_JOB_MANAGER_JOBQ_H */
+
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */
@@ -12,6 +12,13 @@
  *
  *  Maintains a list of one or more job manager plugins which
  *   "tap" into job state transitions and/or events.
+ *
+ *  The plugins with a handler matching a given topic are cached in a
+ *   dispatch table keyed by topic, so that each job event does not
+ *   glob match the topic against every plugin.  The table is cleared
+ *   whenever a plugin is loaded or removed.  This assumes plugins
+ *   register their handlers when they are loaded, as all jobtap
+ *   plugins do.
  */
 
 #if HAVE_CONFIG_H
@@ -41,6 +48,11 @@
 
 #define FLUX_JOBTAP_PRIORITY_UNAVAIL INT64_C(-2)
 
+/*  Limit the dispatch table size, since job.dependency.<scheme> topics
+ *   are derived from user input.
+ */
+#define DISPATCH_MAX_TOPICS 1024
+
 extern int priority_default_plugin_init (flux_plugin_t *p);
 extern int jobspec_default_plugin_init (flux_plugin_t *p);
 extern int limit_job_size_plugin_init (flux_plugin_t *p);
@@ -70,6 +82,7 @@ struct jobtap {
     char *searchpath;
     zlistx_t *plugins;
     zhashx_t *plugins_byuuid;
+    zhashx_t *dispatch;         // topic => struct dispatch
     zlistx_t *jobstack;
     char last_error [128];
     bool configured;
@@ -80,6 +93,16 @@ struct dependency {
     char *description;
 };
 
+/*  Plugins with a handler for a topic, in plugin order.  Refcounted
+ *   so that a table entry remains valid while its plugins are being
+ *   called, even if the table is cleared from a callback.
+ */
+struct dispatch {
+    int refcount;
+    int count;
+    flux_plugin_t *plugins[];
+};
+
 static int jobtap_job_raise (struct jobtap *jobtap,
                              struct job *job,
                              const char *type,
@@ -147,7 +170,7 @@ static flux_plugin_arg_t *jobtap_args_create (struct jobtap *jobtap,
      *   args to work without error, even if plugin does not set any
      *   OUT args.
      */
-    if (flux_plugin_arg_set (args, FLUX_PLUGIN_ARG_OUT, "{}") < 0)
+    if (flux_plugin_arg_pack (args, FLUX_PLUGIN_ARG_OUT, "{}") < 0)
         goto error;
 
     return args;
@@ -349,6 +372,7 @@ static int jobtap_remove (struct jobtap *jobtap,
             || (isglob && fnmatch (arg, name, FNM_PERIOD) == 0)
             || streq (arg, name)) {
             jobtap_finalize (jobtap, p);
+            zhashx_purge (jobtap->dispatch);
             zhashx_delete (jobtap->plugins_byuuid, flux_plugin_get_uuid (p));
             zlistx_detach_cur (jobtap->plugins);
             flux_plugin_destroy (p);
@@ -541,6 +565,62 @@ static int load_builtins (struct jobtap *jobtap)
     return 0;
 }
 
+static void dispatch_decref (struct dispatch *d)
+{
+    if (d && --d->refcount == 0)
+        free (d);
+}
+
+static struct dispatch *dispatch_incref (struct dispatch *d)
+{
+    d->refcount++;
+    return d;
+}
+
+// zhashx_destructor_fn footprint
+static void dispatch_destructor (void **item)
+{
+    if (item) {
+        dispatch_decref (*item);
+        *item = NULL;
+    }
+}
+
+/*  Return the dispatch table entry for 'topic', creating it if needed.
+ *  Caller must dispatch_decref() the result.
+ */
+static struct dispatch *dispatch_get (struct jobtap *jobtap,
+                                      const char *topic)
+{
+    struct dispatch *d;
+    flux_plugin_t *p;
+    int count = 0;
+
+    if ((d = zhashx_lookup (jobtap->dispatch, topic)))
+        return dispatch_incref (d);
+
+    p = zlistx_first (jobtap->plugins);
+    while (p) {
+        if (flux_plugin_match_handler (p, topic))
+            count++;
+        p = zlistx_next (jobtap->plugins);
+    }
+    if (!(d = calloc (1, sizeof (*d) + count * sizeof (d->plugins[0]))))
+        return NULL;
+    d->refcount = 1;
+    p = zlistx_first (jobtap->plugins);
+    while (p) {
+        if (flux_plugin_match_handler (p, topic))
+            d->plugins[d->count++] = p;
+        p = zlistx_next (jobtap->plugins);
+    }
+    if (zhashx_size (jobtap->dispatch) >= DISPATCH_MAX_TOPICS)
+        zhashx_purge (jobtap->dispatch);
+    if (zhashx_insert (jobtap->dispatch, topic, d) == 0)
+        dispatch_incref (d);
+    return d;
+}
+
 struct jobtap *jobtap_create (struct job_manager *ctx)
 {
     const char *path;
@@ -554,10 +634,12 @@ struct jobtap *jobtap_create (struct job_manager *ctx)
         goto error;
     if (!(jobtap->plugins = zlistx_new ())
         || !(jobtap->plugins_byuuid = zhashx_new ())
+        || !(jobtap->dispatch = zhashx_new ())
         || !(jobtap->jobstack = zlistx_new ())) {
         errno = ENOMEM;
         goto error;
     }
+    zhashx_set_destructor (jobtap->dispatch, dispatch_destructor);
     zlistx_set_destructor (jobtap->plugins, plugin_destroy);
     zlistx_set_comparator (jobtap->plugins, plugin_byname);
     zhashx_set_key_duplicator (jobtap->plugins_byuuid, NULL);
@@ -591,6 +673,7 @@ void jobtap_destroy (struct jobtap *jobtap)
         conf_unregister_callback (jobtap->ctx->conf, jobtap_parse_config);
         zlistx_destroy (&jobtap->plugins);
         zhashx_destroy (&jobtap->plugins_byuuid);
+        zhashx_destroy (&jobtap->dispatch);
         zlistx_destroy (&jobtap->jobstack);
         jobtap->ctx = NULL;
         free (jobtap->searchpath);
@@ -599,17 +682,20 @@ void jobtap_destroy (struct jobtap *jobtap)
     }
 }
 
-static int jobtap_topic_match_count (struct jobtap *jobtap,
-                                     const char *topic)
+static int jobtap_plugin_call (struct jobtap *jobtap,
+                               flux_plugin_t *p,
+                               const char *topic,
+                               flux_plugin_arg_t *args)
 {
-    int count = 0;
-    flux_plugin_t *p = zlistx_first (jobtap->plugins);
-    while (p) {
-        if (flux_plugin_match_handler (p, topic))
-            count++;
-        p = zlistx_next (jobtap->plugins);
+    int rc = flux_plugin_call (p, topic, args);
+    if (rc < 0)  {
+        flux_log (jobtap->ctx->h, LOG_DEBUG,
+                  "jobtap: %s: %s: rc=%d",
+                  jobtap_plugin_name (p),
+                  topic,
+                  rc);
     }
-    return count;
+    return rc;
 }
 
 static int jobtap_stack_call (struct jobtap *jobtap,
@@ -631,13 +717,8 @@ static int jobtap_stack_call (struct jobtap *jobtap,
         return -1;
     p = zlistx_first (l);
     while (p) {
-        int rc = flux_plugin_call (p, topic, args);
+        int rc = jobtap_plugin_call (jobtap, p, topic, args);
         if (rc < 0)  {
-            flux_log (jobtap->ctx->h, LOG_DEBUG,
-                      "jobtap: %s: %s: rc=%d",
-                      jobtap_plugin_name (p),
-                      topic,
-                      rc);
             retcode = -1;
             break;
         }
@@ -650,11 +731,38 @@ static int jobtap_stack_call (struct jobtap *jobtap,
     return retcode;
 }
 
+/*  Like jobtap_stack_call() on all plugins, but only call the plugins
+ *   that have a handler for 'topic', from the dispatch table.
+ */
+static int jobtap_dispatch_call (struct jobtap *jobtap,
+                                 struct dispatch *d,
+                                 struct job *job,
+                                 const char *topic,
+                                 flux_plugin_arg_t *args)
+{
+    int retcode = 0;
+
+    if (current_job_push (jobtap, job) < 0)
+        return -1;
+    for (int i = 0; i < d->count; i++) {
+        int rc = jobtap_plugin_call (jobtap, d->plugins[i], topic, args);
+        if (rc < 0)  {
+            retcode = -1;
+            break;
+        }
+        retcode += rc;
+    }
+    if (current_job_pop (jobtap) < 0)
+        return -1;
+    return retcode;
+}
+
 int jobtap_get_priority (struct jobtap *jobtap,
                          struct job *job,
                          int64_t *pprio)
 {
     int rc = -1;
+    struct dispatch *d;
     flux_plugin_arg_t *args;
     int64_t priority = FLUX_JOBTAP_PRIORITY_UNAVAIL;
 
@@ -663,14 +771,20 @@ int jobtap_get_priority (struct jobtap *jobtap,
         return -1;
     }
 
-    if (!(args = jobtap_args_create (jobtap, job)))
+    if (!(d = dispatch_get (jobtap, "job.priority.get")))
         return -1;
+    if (d->count == 0) {
+        dispatch_decref (d);
+        *pprio = priority;
+        return 0;
+    }
+    if (!(args = jobtap_args_create (jobtap, job))) {
+        dispatch_decref (d);
+        return -1;
+    }
 
-    rc = jobtap_stack_call (jobtap,
-                            jobtap->plugins,
-                            job,
-                            "job.priority.get",
-                            args);
+    rc = jobtap_dispatch_call (jobtap, d, job, "job.priority.get", args);
+    dispatch_decref (d);
 
     if (rc >= 1) {
         /*
@@ -745,19 +859,23 @@ static int jobtap_call_early (struct jobtap *jobtap,
                               char **errp)
 {
     int rc;
+    struct dispatch *d;
     flux_plugin_arg_t *args;
     const char *errmsg = NULL;
 
-    if (jobtap_topic_match_count (jobtap, topic) == 0)
+    if (!(d = dispatch_get (jobtap, topic)))
+        return -1;
+    if (d->count == 0) {
+        dispatch_decref (d);
         return 0;
-    if (!(args = jobtap_args_create (jobtap, job)))
+    }
+    if (!(args = jobtap_args_create (jobtap, job))) {
+        dispatch_decref (d);
         return -1;
+    }
 
-    rc = jobtap_stack_call (jobtap,
-                            jobtap->plugins,
-                            job,
-                            topic,
-                            args);
+    rc = jobtap_dispatch_call (jobtap, d, job, topic, args);
+    dispatch_decref (d);
 
     if (rc < 0) {
         /*
@@ -829,6 +947,7 @@ static int jobtap_check_dependency (struct jobtap *jobtap,
     int rc = -1;
     char topic [128];
     const char *scheme = NULL;
+    struct dispatch *d = NULL;
 
     if (make_dependency_topic (jobtap,
                                job,
@@ -845,21 +964,29 @@ static int jobtap_check_dependency (struct jobtap *jobtap,
      */
     if (p && !flux_plugin_match_handler (p, topic))
         return 0;
+    if (!p && !(d = dispatch_get (jobtap, topic))) {
+        flux_log_error (jobtap->ctx->h,
+                        "jobtap_check_depedency: failed to get plugins");
+        return -1;
+    }
 
     if (flux_plugin_arg_pack (args,
                               FLUX_PLUGIN_ARG_IN,
                               "{s:O}",
                               "dependency", entry) < 0
-        || flux_plugin_arg_set (args, FLUX_PLUGIN_ARG_OUT, "{}") < 0) {
+        || flux_plugin_arg_pack (args, FLUX_PLUGIN_ARG_OUT, "{}") < 0) {
         flux_log_error (jobtap->ctx->h,
                         "jobtap_check_depedency: failed to prepare args");
+        dispatch_decref (d);
         return -1;
     }
 
     if (p)
         rc = flux_plugin_call (p, topic, args);
-    else
-        rc = jobtap_stack_call (jobtap, jobtap->plugins, job, topic, args);
+    else {
+        rc = jobtap_dispatch_call (jobtap, d, job, topic, args);
+        dispatch_decref (d);
+    }
 
     if (rc == 0) {
         /*  No handler for job.dependency.<scheme>. return an error.
@@ -1018,12 +1145,17 @@ int jobtap_call (struct jobtap *jobtap,
 {
     int rc = -1;
     json_t *note = NULL;
+    struct dispatch *d;
     flux_plugin_arg_t *args;
     int64_t priority = FLUX_JOBTAP_PRIORITY_UNAVAIL;
     va_list ap;
 
-    if (jobtap_topic_match_count (jobtap, topic) == 0)
+    if (!(d = dispatch_get (jobtap, topic)))
+        return -1;
+    if (d->count == 0) {
+        dispatch_decref (d);
         return 0;
+    }
 
     va_start (ap, fmt);
     if (!(args = jobtap_args_vcreate (jobtap, job, fmt, ap))) {
@@ -1034,10 +1166,13 @@ int jobtap_call (struct jobtap *jobtap,
     }
     va_end (ap);
 
-    if (!args)
+    if (!args) {
+        dispatch_decref (d);
         return -1;
+    }
 
-    rc = jobtap_stack_call (jobtap, jobtap->plugins, job, topic, args);
+    rc = jobtap_dispatch_call (jobtap, d, job, topic, args);
+    dispatch_decref (d);
     if (rc < 0) {
         flux_log (jobtap->ctx->h, LOG_ERR,
                   "jobtap: %s: callback returned error",
@@ -1309,6 +1444,7 @@ flux_plugin_t * jobtap_load (struct jobtap *jobtap,
         errno = ENOMEM;
         goto error;
     }
+    zhashx_purge (jobtap->dispatch);
     return p;
 error:
     if (errp && errp->text[0] == '\0')
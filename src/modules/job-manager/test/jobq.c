@@ -0,0 +1,266 @@
+/************************************************************\
+ * Copyright 2024 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+/* Unit tests for jobq, plus a microbenchmark comparing it with the
+ * sorted zlistx it replaced in alloc.c.  The benchmark is not run by
+ * default.  Run it with
+ *   test_jobq.t --bench [count]
+ * using 'count' jobs (default 200000).
+ */
+
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdlib.h>
+#include <string.h>
+#include <flux/core.h>
+
+#include "src/common/libtap/tap.h"
+#include "src/common/libutil/monotime.h"
+#include "src/modules/job-manager/job.h"
+#include "src/modules/job-manager/jobq.h"
+
+static struct job **jobs_create (int count)
+{
+    struct job **jobs;
+    int i;
+
+    if (!(jobs = calloc (count, sizeof (jobs[0]))))
+        BAIL_OUT ("out of memory");
+    for (i = 0; i < count; i++) {
+        if (!(jobs[i] = job_create ()))
+            BAIL_OUT ("job_create failed");
+        jobs[i]->id = i + 1;
+        jobs[i]->priority = random () % 100;
+    }
+    return jobs;
+}
+
+static void jobs_destroy (struct job **jobs, int count)
+{
+    int i;
+
+    for (i = 0; i < count; i++)
+        job_decref (jobs[i]);
+    free (jobs);
+}
+
+/* Return true if iteration visits 'count' jobs in comparator order.
+ */
+static bool check_order (struct jobq *q, jobq_compare_f cmp, size_t count)
+{
+    struct job *prev = NULL;
+    struct job *job;
+    size_t n = 0;
+
+    job = jobq_first (q);
+    while (job) {
+        if (prev && cmp (prev, job) >= 0) {
+            diag ("job %ju out of order", (uintmax_t)job->id);
+            return false;
+        }
+        prev = job;
+        n++;
+        job = jobq_next (q);
+    }
+    if (n != count) {
+        diag ("iterated over %zu of %zu jobs", n, count);
+        return false;
+    }
+    return true;
+}
+
+static int reverse_comparator (const void *a1, const void *a2)
+{
+    return job_priority_comparator (a2, a1);
+}
+
+static void test_basic (void)
+{
+    struct jobq *q;
+    struct job **jobs;
+    const int count = 100;
+    int i;
+
+    ok (jobq_create (NULL) == NULL && errno == EINVAL,
+        "jobq_create cmp=NULL fails with EINVAL");
+    if (!(q = jobq_create (job_priority_comparator)))
+        BAIL_OUT ("jobq_create failed");
+    ok (jobq_size (q) == 0 && jobq_peek (q) == NULL && jobq_first (q) == NULL,
+        "new queue is empty");
+
+    jobs = jobs_create (count);
+    for (i = 0; i < count; i++) {
+        if (jobq_insert (q, jobs[i]) < 0)
+            break;
+    }
+    ok (i == count && jobq_size (q) == count,
+        "jobq_insert added %d jobs", count);
+    ok (jobs[0]->refcount == 2 && jobs[0]->handle != NULL,
+        "queued job has a reference and a handle");
+    ok (jobq_insert (q, jobs[0]) < 0 && errno == EINVAL,
+        "jobq_insert of queued job fails with EINVAL");
+    ok (check_order (q, job_priority_comparator, count),
+        "iteration is in priority order");
+    ok (jobq_peek (q) == jobq_first (q),
+        "jobq_peek returns first job");
+
+    jobs[50]->priority = FLUX_JOB_PRIORITY_MAX;
+    jobq_update (q, jobs[50]);
+    ok (jobq_peek (q) == jobs[50],
+        "jobq_update moved job to front after priority increase");
+    jobs[50]->priority = FLUX_JOB_PRIORITY_MIN;
+    jobq_update (q, jobs[50]);
+    ok (check_order (q, job_priority_comparator, count),
+        "jobq_update preserved order after priority decrease");
+
+    for (i = 0; i < count; i += 3)
+        jobq_remove (q, jobs[i]);
+    ok (jobq_size (q) == count - (count + 2) / 3,
+        "jobq_remove removed every third job");
+    ok (jobs[0]->refcount == 1 && jobs[0]->handle == NULL,
+        "removed job reference and handle were released");
+    ok (check_order (q, job_priority_comparator, jobq_size (q)),
+        "iteration is in priority order after removals");
+    jobq_remove (q, jobs[0]);
+    ok (jobq_size (q) == count - (count + 2) / 3,
+        "jobq_remove of unqueued job is a no-op");
+
+    for (i = 0; i < count; i++)
+        jobs[i]->priority = random () % 100;
+    jobq_rebuild (q);
+    ok (check_order (q, job_priority_comparator, jobq_size (q)),
+        "jobq_rebuild restored order after changing all priorities");
+
+    jobq_destroy (q);
+    ok (jobs[1]->refcount == 1 && jobs[1]->handle == NULL,
+        "jobq_destroy released queued jobs");
+    jobs_destroy (jobs, count);
+}
+
+static void test_multiple (void)
+{
+    struct jobq *q1;
+    struct jobq *q2;
+    struct job **jobs;
+    const int count = 10;
+    int i;
+
+    if (!(q1 = jobq_create (job_priority_comparator))
+        || !(q2 = jobq_create (reverse_comparator)))
+        BAIL_OUT ("jobq_create failed");
+    jobs = jobs_create (count);
+    for (i = 0; i < count; i++) {
+        if (jobq_insert (i % 2 ? q1 : q2, jobs[i]) < 0)
+            BAIL_OUT ("jobq_insert failed");
+    }
+    ok (check_order (q2, reverse_comparator, count / 2),
+        "reverse comparator iterates lowest priority first");
+    jobq_remove (q2, jobs[1]);
+    ok (jobq_size (q1) == count / 2 && jobs[1]->handle != NULL,
+        "jobq_remove of job in another queue is a no-op");
+
+    /* Interleaved iteration over two queues, as in
+     * alloc_queue_recalc_pending().
+     */
+    ok (jobq_first (q1) != NULL && jobq_first (q2) != NULL
+        && jobq_next (q1) != NULL && jobq_next (q2) != NULL,
+        "queues can be iterated concurrently");
+
+    jobq_destroy (q1);
+    jobq_destroy (q2);
+    jobs_destroy (jobs, count);
+}
+
+static double bench_jobq (struct job **jobs, int count)
+{
+    struct jobq *q;
+    struct timespec t;
+    int i;
+
+    monotime (&t);
+    if (!(q = jobq_create (job_priority_comparator)))
+        BAIL_OUT ("jobq_create failed");
+    for (i = 0; i < count; i++) {
+        if (jobq_insert (q, jobs[i]) < 0)
+            BAIL_OUT ("jobq_insert failed");
+    }
+    for (i = 0; i < count; i++) {
+        jobs[i]->priority = (jobs[i]->priority + 7) % 100;
+        jobq_update (q, jobs[i]);
+    }
+    while (jobq_peek (q))
+        jobq_remove (q, jobq_peek (q));
+    jobq_destroy (q);
+    return monotime_since (t);
+}
+
+static double bench_zlistx (struct job **jobs, int count)
+{
+    zlistx_t *l;
+    struct timespec t;
+    struct job *job;
+    int i;
+
+    monotime (&t);
+    if (!(l = zlistx_new ()))
+        BAIL_OUT ("zlistx_new failed");
+    zlistx_set_destructor (l, job_destructor);
+    zlistx_set_comparator (l, job_priority_comparator);
+    zlistx_set_duplicator (l, job_duplicator);
+    for (i = 0; i < count; i++) {
+        bool fwd = jobs[i]->priority > 50;
+        if (!(jobs[i]->handle = zlistx_insert (l, jobs[i], fwd)))
+            BAIL_OUT ("zlistx_insert failed");
+    }
+    for (i = 0; i < count; i++) {
+        jobs[i]->priority = (jobs[i]->priority + 7) % 100;
+        zlistx_reorder (l, jobs[i]->handle, jobs[i]->priority > 50);
+    }
+    while ((job = zlistx_first (l))) {
+        zlistx_delete (l, job->handle);
+        job->handle = NULL;
+    }
+    zlistx_destroy (&l);
+    return monotime_since (t);
+}
+
+static void bench (int count)
+{
+    struct job **jobs;
+    double t;
+
+    jobs = jobs_create (count);
+    t = bench_jobq (jobs, count);
+    diag ("jobq:   %d insert/update/remove: %.3fs", count, t / 1000.);
+    t = bench_zlistx (jobs, count);
+    diag ("zlistx: %d insert/reorder/delete: %.3fs", count, t / 1000.);
+    jobs_destroy (jobs, count);
+}
+
+int main (int argc, char *argv[])
+{
+    plan (NO_PLAN);
+
+    if (argc > 1 && !strcmp (argv[1], "--bench")) {
+        bench (argc > 2 ? strtol (argv[2], NULL, 10) : 200000);
+        ok (true, "benchmark completed");
+        done_testing ();
+    }
+
+    test_basic ();
+    test_multiple ();
+
+    done_testing ();
+}
+
+/*
+ * vi:ts=4 sw=4 expandtab
+ */
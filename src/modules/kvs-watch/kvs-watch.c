@@ -20,6 +20,7 @@
 #include "src/common/libczmqcontainers/czmq_containers.h"
 #include "src/common/libkvs/treeobj.h"
 #include "src/common/libkvs/kvs_util_private.h"
+#include "src/common/libcontent/content.h"
 #include "src/common/libutil/blobref.h"
 
 /* State for one watcher */
@@ -40,7 +41,10 @@ struct watcher {
 
     struct ns_monitor *nsm;     // back pointer for removal
     json_t *prev;               // previous watch value for KVS_WATCH_FULL/UNIQ
-    int append_offset;          // offset for KVS_WATCH_APPEND
+    int append_offset;          // bytes sent for KVS_WATCH_APPEND
+    int append_index;           // blobrefs sent for KVS_WATCH_APPEND
+    flux_future_t *append_f;    // content loads for KVS_WATCH_APPEND
+    int append_nloads;          // number of loads in append_f
 };
 
 /* Current KVS root.
@@ -67,6 +71,17 @@ struct ns_monitor {
     char *topic;                // topic string for subscription
     bool subscribed;            // subscription active
     flux_future_t *getrootf;    // initial getroot future
+    zhash_t *lookups;           // in flight lookups, for coalescing
+};
+
+/* A kvs.lookup-plus RPC shared by watchers making identical lookups
+ * of the same root.
+ */
+struct lookup {
+    char *hashkey;              // hash key for nsm->lookups
+    struct ns_monitor *nsm;     // back pointer for removal
+    flux_future_t *f;           // lookup future, watchers hold a reference
+    zlist_t *watchers;          // watchers waiting on f
 };
 
 /* Module state.
@@ -75,6 +90,8 @@ struct watch_ctx {
     flux_t *h;
     flux_msg_handler_t **handlers;
     zhash_t *namespaces;        // hash of monitored namespaces
+    int64_t lookup_count;       // watcher lookups after initial lookup
+    int64_t lookup_rpc_count;   // lookup RPCs sent for lookup_count
 };
 
 static void watcher_destroy (struct watcher *w)
@@ -89,6 +106,7 @@ static void watcher_destroy (struct watcher *w)
                 flux_future_destroy (f);
             zlist_destroy (&w->lookups);
         }
+        flux_future_destroy (w->append_f);
         json_decref (w->prev);
         free (w);
         errno = saved_errno;
@@ -152,6 +170,7 @@ static void namespace_destroy (struct ns_monitor *nsm)
     if (nsm) {
         int saved_errno = errno;
         commit_destroy (nsm->commit);
+        zhash_destroy (&nsm->lookups);
         if (nsm->watchers) {
             struct watcher *w;
             while ((w = zlist_pop (nsm->watchers)))
@@ -176,6 +195,8 @@ static struct ns_monitor *namespace_create (struct watch_ctx *ctx,
         return NULL;
     if (!(nsm->watchers = zlist_new ()))
         goto error;
+    if (!(nsm->lookups = zhash_new ()))
+        goto error;
     if (!(nsm->ns_name = strdup (ns)))
         goto error;
     /* We are subscribing to the kvs.namespace-<NS> substring.
@@ -221,8 +242,9 @@ static bool key_match (json_t *o, const char *key)
 
 static void watcher_cleanup (struct ns_monitor *nsm, struct watcher *w)
 {
-    /* wait for all in flight lookups to complete before destroying watcher */
-    if (zlist_size (w->lookups) == 0) {
+    /* wait for all in flight lookups and loads to complete before
+     * destroying watcher */
+    if (zlist_size (w->lookups) == 0 && !w->append_f) {
         zlist_remove (nsm->watchers, w);
         watcher_destroy (w);
     }
@@ -232,10 +254,16 @@ static void watcher_cleanup (struct ns_monitor *nsm, struct watcher *w)
         zhash_delete (nsm->ctx->namespaces, nsm->ns_name);
 }
 
+static int handle_append_response (flux_t *h,
+                                   struct watcher *w,
+                                   json_t *val,
+                                   int count);
+
 static int handle_initial_response (flux_t *h,
                                     struct watcher *w,
                                     json_t *val,
-                                    int root_seq)
+                                    int root_seq,
+                                    int count)
 {
     /* this is the first response case, store the first response
      * val */
@@ -244,12 +272,8 @@ static int handle_initial_response (flux_t *h,
         w->prev = json_incref (val);
 
     if ((w->flags & FLUX_KVS_WATCH_APPEND)) {
-        if (treeobj_decode_val (val,
-                                NULL,
-                                &w->append_offset) < 0) {
-            flux_log_error (h, "%s: treeobj_decode_val", __FUNCTION__);
-            return -1;
-        }
+        w->initial_rootseq = root_seq;
+        return handle_append_response (h, w, val, count);
     }
 
     if (flux_respond_pack (h, w->request, "{ s:O }", "val", val) < 0) {
@@ -297,69 +321,174 @@ static int handle_compare_response (flux_t *h,
     return 0;
 }
 
-static int handle_append_response (flux_t *h,
-                                    struct watcher *w,
-                                    json_t *val)
+static void lookup_continuation (flux_future_t *f, void *arg);
+
+static int append_respond (flux_t *h,
+                           struct watcher *w,
+                           const void *data,
+                           int len)
 {
-    if (!w->responded) {
-        /* this is the first response case, store the first response
-         * info.  This is here b/c initial response could have been
-         * ENOENT case */
-        if (treeobj_decode_val (val,
-                                NULL,
-                                &w->append_offset) < 0) {
-            flux_log_error (h, "%s: treeobj_decode_val", __FUNCTION__);
-            return -1;
-        }
+    json_t *val;
 
-        if (flux_respond_pack (h, w->request, "{ s:O }", "val", val) < 0) {
-            flux_log_error (h, "%s: flux_respond_pack", __FUNCTION__);
-            return -1;
-        }
+    if (!(val = treeobj_create_val (data, len)))
+        return -1;
+    if (flux_respond_pack (h, w->request, "{ s:o }", "val", val) < 0) {
+        json_decref (val);
+        flux_log_error (h, "%s: flux_respond_pack", __FUNCTION__);
+        return -1;
+    }
+    w->responded = true;
+    return 0;
+}
 
-        w->responded = true;
+/* Content loads for new blobrefs of a KVS_WATCH_APPEND key have
+ * completed.  Respond with the concatenated blobs, then resume
+ * processing lookup responses, which are held while loads are in
+ * flight to preserve commit order.
+ */
+static void append_load_continuation (flux_future_t *f, void *arg)
+{
+    struct watcher *w = arg;
+    flux_t *h = flux_future_get_flux (f);
+    char *data = NULL;
+    int size = 0;
+    int pass;
+    int i;
+
+    if (w->finished)
+        goto done;
+    /* first pass computes size, second pass copies data */
+    for (pass = 0; pass < 2; pass++) {
+        int offset = 0;
+
+        if (pass == 1 && size > 0 && !(data = malloc (size)))
+            goto error;
+        for (i = 0; i < w->append_nloads; i++) {
+            char name[16];
+            flux_future_t *cf;
+            const void *buf;
+            int len;
+
+            snprintf (name, sizeof (name), "%d", i);
+            if (!(cf = flux_future_get_child (f, name))
+                || content_load_get (cf, &buf, &len) < 0)
+                goto error;
+            if (pass == 0)
+                size += len;
+            else {
+                memcpy (data + offset, buf, len);
+                offset += len;
+            }
+        }
     }
-    else {
-        json_t *new_val = NULL;
-        void *new_data = NULL;
-        int new_offset;
+    if (append_respond (h, w, data, size) < 0)
+        goto error;
+    w->append_offset += size;
+    w->append_index += w->append_nloads;
+    goto done;
+error:
+    if (!w->mute) {
+        if (flux_respond_error (h, w->request, errno, NULL) < 0)
+            flux_log_error (h, "%s: flux_respond_error", __FUNCTION__);
+    }
+    w->finished = true;
+done:
+    free (data);
+    flux_future_destroy (f);
+    w->append_f = NULL;
+    lookup_continuation (NULL, w);
+}
+
+/* Respond to a KVS_WATCH_APPEND watcher with only the data appended
+ * since the last response.  Appended values are stored by the KVS as
+ * a valref with one blobref per append.  For KVS_WATCH_APPEND lookups,
+ * the KVS returns a valref unread, holding only blobrefs from
+ * 'append_index' (the number of blobrefs already sent) on, and 'count'
+ * is the total number of blobrefs (-1 if not trimmed).  Only the new
+ * blobs are loaded, and the response is sent from
+ * append_load_continuation().
+ *
+ * A key that has not yet been appended to is a val.  Compare its
+ * length to determine if it was changed.  Note that this check does
+ * not ensure that the key was not "fake" appended to.  i.e. the key
+ * overwritten with data longer than the original.
+ */
+static int handle_append_response (flux_t *h,
+                                   struct watcher *w,
+                                   json_t *val,
+                                   int count)
+{
+    if (treeobj_is_val (val)) {
+        void *data = NULL;
+        int len;
+        int rc;
 
-        if (treeobj_decode_val (val,
-                                &new_data,
-                                &new_offset) < 0) {
+        if (treeobj_decode_val (val, &data, &len) < 0) {
             flux_log_error (h, "%s: treeobj_decode_val", __FUNCTION__);
             return -1;
         }
-
-        /* check length to determine if append actually happened, note
-         * that zero length append is legal
-         *
-         * Note that this check does not ensure that the key was not
-         * "fake" appended to.  i.e. the key overwritten with data
-         * longer than the original.
-         */
-        if (new_offset < w->append_offset) {
-            free (new_data);
+        if (len < w->append_offset) {
+            free (data);
             errno = EINVAL;
             return -1;
         }
-
-        if (!(new_val = treeobj_create_val (new_data + w->append_offset,
-                                            new_offset - w->append_offset))) {
-            free (new_data);
+        rc = append_respond (h,
+                             w,
+                             (char *)data + w->append_offset,
+                             len - w->append_offset);
+        free (data);
+        if (rc < 0)
+            return -1;
+        w->append_offset = len;
+        w->append_index = 1;
+    }
+    else if (treeobj_is_valref (val)) {
+        flux_future_t *cf = NULL;
+        int n = treeobj_get_count (val);
+        int first;
+        int i;
+
+        if (count < 0)
+            count = n;
+        first = count - n;
+        /* fewer blobrefs than already sent means the key was overwritten */
+        if (count < w->append_index || first > w->append_index) {
+            errno = EINVAL;
             return -1;
         }
-
-        free (new_data);
-        w->append_offset = new_offset;
-
-        if (flux_respond_pack (h, w->request, "{ s:o }", "val", new_val) < 0) {
-            json_decref (new_val);
-            flux_log_error (h, "%s: flux_respond_pack", __FUNCTION__);
+        if (count == w->append_index)
+            return append_respond (h, w, NULL, 0);
+        if (!(cf = flux_future_wait_all_create ()))
             return -1;
+        flux_future_set_flux (cf, h);
+        w->append_nloads = 0;
+        for (i = w->append_index - first; i < n; i++) {
+            const char *ref;
+            char name[16];
+            flux_future_t *f;
+
+            if (!(ref = treeobj_get_blobref (val, i))
+                || !(f = content_load_byblobref (h, ref, 0)))
+                goto error;
+            snprintf (name, sizeof (name), "%d", w->append_nloads++);
+            if (flux_future_push (cf, name, f) < 0) {
+                flux_future_destroy (f);
+                goto error;
+            }
         }
+        if (flux_future_then (cf, -1, append_load_continuation, w) < 0)
+            goto error;
+        w->append_f = cf;
+        return 0;
+error:
+        flux_log_error (h, "%s: content load", __FUNCTION__);
+        flux_future_destroy (cf);
+        return -1;
+    }
+    else {
+        errno = EINVAL;
+        return -1;
     }
-
     return 0;
 }
 
@@ -389,6 +518,7 @@ static void handle_lookup_response (flux_future_t *f,
     flux_t *h = flux_future_get_flux (f);
     int errnum;
     int root_seq;
+    int count = -1;
     json_t *val;
 
     if (flux_future_aux_get (f, "initial")) {
@@ -409,9 +539,10 @@ static void handle_lookup_response (flux_future_t *f,
             goto error;
         }
 
-        if (flux_rpc_get_unpack (f, "{ s:o s:i }",
+        if (flux_rpc_get_unpack (f, "{ s:o s:i s?:i }",
                                  "val", &val,
-                                 "rootseq", &root_seq) < 0) {
+                                 "rootseq", &root_seq,
+                                 "count", &count) < 0) {
             /* It is worth mentioning ENOTSUP error conditions here.
              *
              * Recall that in namespace_monitor(), an initial getroot
@@ -432,7 +563,7 @@ static void handle_lookup_response (flux_future_t *f,
             goto error;
         }
 
-        if (handle_initial_response (h, w, val, root_seq) < 0)
+        if (handle_initial_response (h, w, val, root_seq, count) < 0)
             goto error;
     }
     else {
@@ -445,9 +576,10 @@ static void handle_lookup_response (flux_future_t *f,
             goto error;
         }
 
-        if (flux_rpc_get_unpack (f, "{ s:o s:i }",
+        if (flux_rpc_get_unpack (f, "{ s:o s:i s?:i }",
                                  "val", &val,
-                                 "rootseq", &root_seq) < 0)
+                                 "rootseq", &root_seq,
+                                 "count", &count) < 0)
             goto error;
 
         /* if we got some setroots before the initial rpc returned,
@@ -462,7 +594,7 @@ static void handle_lookup_response (flux_future_t *f,
                     goto error;
             }
             else if (w->flags & FLUX_KVS_WATCH_APPEND) {
-                if (handle_append_response (h, w, val) < 0)
+                if (handle_append_response (h, w, val, count) < 0)
                     goto error;
             }
             else {
@@ -482,14 +614,17 @@ error:
 
 /* One lookup has completed.
  * Pop ready futures off w->lookups and send responses, until
- * the list is empty, or a non-ready future is encountered.
+ * the list is empty, a non-ready future is encountered, or content
+ * loads for a KVS_WATCH_APPEND response are in flight.
  */
 static void lookup_continuation (flux_future_t *f, void *arg)
 {
     struct watcher *w = arg;
     struct ns_monitor *nsm = w->nsm;
 
-    while ((f = zlist_first (w->lookups)) && flux_future_is_ready (f)) {
+    while (!w->append_f
+           && (f = zlist_first (w->lookups))
+           && flux_future_is_ready (f)) {
         f = zlist_pop (w->lookups);
         if (!w->finished)
             handle_lookup_response (f, w);
@@ -512,6 +647,8 @@ static void lookup_continuation (flux_future_t *f, void *arg)
  *   response
  * - blobref param replaces treeobj
  * - namespace param (ignores namespace associated with flux_t handle)
+ * - KVS_WATCH_APPEND lookups of a valref return the treeobj, trimmed
+ *   to blobrefs not yet sent (see handle_append_response())
  * - cred params (see N.B. below)
  * Use flux_rpc_get() not flux_kvs_lookup_get() to access the response.
  */
@@ -526,23 +663,26 @@ static flux_future_t *lookupat (flux_t *h,
     flux_future_t *f;
     int saved_errno;
 
+    /* append_index is only non-zero for KVS_WATCH_APPEND watchers */
     if (!(msg = flux_request_encode ("kvs.lookup-plus", NULL)))
         return NULL;
     if (!w->initial_rpc_sent) {
-        if (flux_msg_pack (msg, "{s:s s:s s:i}",
+        if (flux_msg_pack (msg, "{s:s s:s s:i s:i}",
                            "key", w->key,
                            "namespace", ns,
-                           "flags", w->flags) < 0)
+                           "flags", w->flags,
+                           "append_index", w->append_index) < 0)
             goto error;
     }
     else {
         if (!(o = treeobj_create_dirref (blobref)))
             goto error;
-        if (flux_msg_pack (msg, "{s:s s:i s:i s:O}",
+        if (flux_msg_pack (msg, "{s:s s:i s:i s:O s:i}",
                            "key", w->key,
                            "flags", w->flags,
                            "rootseq", root_seq,
-                           "rootdir", o) < 0)
+                           "rootdir", o,
+                           "append_index", w->append_index) < 0)
             goto error;
     }
     /* N.B. Since this module is authenticated to the shmem:// connector
@@ -574,9 +714,114 @@ error:
     return NULL;
 }
 
+static void lookup_destroy (struct lookup *l)
+{
+    if (l) {
+        int saved_errno = errno;
+        flux_future_destroy (l->f);
+        zlist_destroy (&l->watchers);
+        free (l->hashkey);
+        free (l);
+        errno = saved_errno;
+    }
+}
+
+/* A shared lookup has completed.  Remove it from nsm->lookups, so later
+ * lookups are not coalesced with it, then let each waiting watcher
+ * process its ready lookups.  N.B. the last watcher may destroy nsm,
+ * and the last reference on 'f' is dropped by the watchers.
+ */
+static void shared_lookup_continuation (flux_future_t *f, void *arg)
+{
+    struct lookup *l = arg;
+    zlist_t *watchers = l->watchers;
+    struct watcher *w;
+
+    l->watchers = NULL;
+    zhash_delete (l->nsm->lookups, l->hashkey);
+    while ((w = zlist_pop (watchers)))
+        lookup_continuation (f, w);
+    zlist_destroy (&watchers);
+}
+
+/* Find an in flight lookup of nsm->commit identical to the one watcher
+ * 'w' would make, or send a new one.  The lookup response depends on
+ * the request credentials, so they are part of the hash key.
+ */
+static struct lookup *lookup_get (struct ns_monitor *nsm, struct watcher *w)
+{
+    struct lookup *l;
+    char *hashkey;
+
+    if (asprintf (&hashkey,
+                  "%d:%ju:%ju:%d:%d:%s",
+                  nsm->commit->rootseq,
+                  (uintmax_t)w->cred.userid,
+                  (uintmax_t)w->cred.rolemask,
+                  w->flags,
+                  w->append_index,
+                  w->key) < 0)
+        return NULL;
+    if ((l = zhash_lookup (nsm->lookups, hashkey))) {
+        free (hashkey);
+        return l;
+    }
+    if (!(l = calloc (1, sizeof (*l)))) {
+        free (hashkey);
+        return NULL;
+    }
+    l->hashkey = hashkey;
+    l->nsm = nsm;
+    if (!(l->watchers = zlist_new ()))
+        goto error_nomem;
+    if (!(l->f = lookupat (nsm->ctx->h,
+                           w,
+                           nsm->commit->rootref,
+                           nsm->commit->rootseq,
+                           nsm->ns_name))) {
+        flux_log_error (nsm->ctx->h, "%s: lookupat", __FUNCTION__);
+        goto error;
+    }
+    if (flux_future_then (l->f, -1., shared_lookup_continuation, l) < 0)
+        goto error;
+    if (zhash_insert (nsm->lookups, l->hashkey, l) < 0)
+        goto error_nomem;
+    zhash_freefn (nsm->lookups, l->hashkey, (zhash_free_fn *)lookup_destroy);
+    nsm->ctx->lookup_rpc_count++;
+    return l;
+error_nomem:
+    errno = ENOMEM;
+error:
+    lookup_destroy (l);
+    return NULL;
+}
+
 static int process_lookup_response (struct ns_monitor *nsm, struct watcher *w)
 {
     flux_future_t *f;
+
+    /* After the initial lookup, identical lookups of the same root
+     * by different watchers share one RPC.
+     */
+    if (w->initial_rpc_sent) {
+        struct lookup *l;
+
+        if (!(l = lookup_get (nsm, w)))
+            return -1;
+        if (zlist_append (l->watchers, w) < 0) {
+            errno = ENOMEM;
+            return -1;
+        }
+        if (zlist_append (w->lookups, l->f) < 0) {
+            zlist_remove (l->watchers, w);
+            errno = ENOMEM;
+            return -1;
+        }
+        flux_future_incref (l->f);
+        nsm->ctx->lookup_count++;
+        w->rootseq = nsm->commit->rootseq;
+        return 0;
+    }
     if (!(f = lookupat (nsm->ctx->h,
                         w,
                         nsm->commit->rootref,
@@ -1023,18 +1268,20 @@ static void stats_cb (flux_t *h, flux_msg_handler_t *mh,
     struct ns_monitor *nsm;
     json_t *stats;
     int watchers = 0;
+    double coalesce_ratio = 0.;
 
     if (!(stats = json_object()))
         goto nomem;
     nsm = zhash_first (ctx->namespaces);
     while (nsm) {
-        json_t *o = json_pack ("{s:i s:i s:s s:i}",
+        json_t *o = json_pack ("{s:i s:i s:s s:i s:i}",
                                "owner", (int)nsm->owner,
                                "rootseq", nsm->commit ? nsm->commit->rootseq
                                                       : -1,
                                "rootref", nsm->commit ? nsm->commit->rootref
                                                       : "(null)",
-                               "watchers", (int)zlist_size (nsm->watchers));
+                               "watchers", (int)zlist_size (nsm->watchers),
+                               "lookups", (int)zhash_size (nsm->lookups));
         if (!o)
             goto nomem;
         if (json_object_set_new (stats, nsm->ns_name, o) < 0) {
@@ -1044,10 +1291,18 @@ static void stats_cb (flux_t *h, flux_msg_handler_t *mh,
         watchers += zlist_size (nsm->watchers);
         nsm = zhash_next (ctx->namespaces);
     }
-    if (flux_respond_pack (h, msg, "{s:i s:i s:O}",
+    /* Average number of watcher lookups satisfied by each lookup RPC.
+     */
+    if (ctx->lookup_rpc_count > 0)
+        coalesce_ratio = (double)ctx->lookup_count / ctx->lookup_rpc_count;
+    if (flux_respond_pack (h, msg, "{s:i s:i s:O s:I s:I s:f}",
                            "watchers", watchers,
                            "namespace-count", (int)zhash_size (ctx->namespaces),
-                           "namespaces", stats) < 0)
+                           "namespaces", stats,
+                           "lookup-count", (json_int_t)ctx->lookup_count,
+                           "lookup-rpc-count",
+                           (json_int_t)ctx->lookup_rpc_count,
+                           "lookup-coalesce-ratio", coalesce_ratio) < 0)
         flux_log_error (h, "%s: flux_respond_pack", __FUNCTION__);
     json_decref (stats);
     return;
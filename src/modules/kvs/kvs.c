@@ -19,6 +19,7 @@
 #include <libgen.h>
 #include <unistd.h>
 #include <stdbool.h>
+#include <pthread.h>
 #include <sys/time.h>
 #include <flux/core.h>
 #include <jansson.h>
@@ -30,11 +31,13 @@
 #include "src/common/libutil/tstat.h"
 #include "src/common/libutil/timestamp.h"
 #include "src/common/libutil/errprintf.h"
+#include "src/common/libutil/errno_safe.h"
 #include "src/common/libkvs/treeobj.h"
 #include "src/common/libkvs/kvs_checkpoint.h"
 #include "src/common/libkvs/kvs_txn_private.h"
 #include "src/common/libkvs/kvs_util_private.h"
 #include "src/common/libcontent/content.h"
+#include "src/common/libcontent/content-batch.h"
 #include "src/common/libutil/fsd.h"
 
 #include "waitqueue.h"
@@ -46,6 +49,7 @@
 #include "kvsroot.h"
 #include "kvs_wait_version.h"
 #include "kvs_checkpoint.h"
+#include "workpool.h"
 
 /* heartbeat_sync_cb() is called periodically to manage cached content
  * and namespaces.  Synchronize with the system heartbeat if possible,
@@ -63,16 +67,30 @@ const double max_lastuse_age = 10.;
  */
 const double max_namespace_age = 3600.;
 
+/* FLUX_KVS_PREFETCH lookups do not prefetch the children of
+ * directories with more than 'prefetch_max_entries' entries, and
+ * request at most 'prefetch_max_refs' blobs per directory.
+ */
+const int prefetch_max_entries = 64;
+const int prefetch_max_refs = 128;
+
 struct kvs_ctx {
     struct cache *cache;    /* blobref => cache_entry */
     kvsroot_mgr_t *krm;
     int faults;                 /* for kvs.stats.get, etc. */
+    int prefetches;             /* for kvs.stats.get, etc. */
     flux_t *h;
     uint32_t rank;
     flux_watcher_t *prep_w;
     flux_watcher_t *idle_w;
     flux_watcher_t *check_w;
     int transaction_merge;
+    int dir_shard_threshold;
+    int prefetch_depth;
+    bool binary_treeobj;
+    int commit_threads;
+    struct workpool *workpool;  /* NULL unless commit_threads > 1 */
+    pthread_mutex_t commit_lock; /* held by reactor thread, see below */
     bool events_init;            /* flag */
     const char *hash_name;
     unsigned int seq;           /* for commit transactions */
@@ -93,6 +111,7 @@ static void transaction_prep_cb (flux_reactor_t *r, flux_watcher_t *w,
 static void transaction_check_cb (flux_reactor_t *r, flux_watcher_t *w,
                                   int revents, void *arg);
 static void start_root_remove (struct kvs_ctx *ctx, const char *ns);
+static int namespace_remove (struct kvs_ctx *ctx, const char *ns);
 static void work_queue_check_append (struct kvs_ctx *ctx,
                                      struct kvsroot *root);
 static void kvstxn_apply (kvstxn_t *kt);
@@ -110,6 +129,9 @@ static void kvs_ctx_destroy (struct kvs_ctx *ctx)
         flux_watcher_destroy (ctx->check_w);
         flux_watcher_destroy (ctx->idle_w);
         kvs_checkpoint_destroy (ctx->kcp);
+        workpool_destroy (ctx->workpool);
+        pthread_mutex_unlock (&ctx->commit_lock);
+        pthread_mutex_destroy (&ctx->commit_lock);
         free (ctx);
         errno = saved_errno;
     }
@@ -129,6 +151,11 @@ static struct kvs_ctx *kvs_ctx_create (flux_t *h)
 
     if (!(ctx = calloc (1, sizeof (*ctx))))
         return NULL;
+    /* The reactor thread always holds commit_lock, releasing it only
+     * while workpool threads are processing transactions.
+     */
+    pthread_mutex_init (&ctx->commit_lock, NULL);
+    pthread_mutex_lock (&ctx->commit_lock);
     ctx->h = h;
     if (!(ctx->hash_name = flux_attr_get (h, "content.hash"))) {
         flux_log_error (h, "getattr content.hash");
@@ -168,6 +195,16 @@ error:
     return NULL;
 }
 
+/* Apply current module configuration to a root's transaction manager.
+ * Called when a root is created and on config reload.
+ */
+static void root_configure (struct kvs_ctx *ctx, struct kvsroot *root)
+{
+    kvstxn_mgr_set_dir_shard_threshold (root->ktm, ctx->dir_shard_threshold);
+    kvstxn_mgr_set_binary_treeobj (root->ktm, ctx->binary_treeobj);
+    kvstxn_mgr_set_lock (root->ktm, ctx->workpool ? &ctx->commit_lock : NULL);
+}
+
 /*
  * event subscribe/unsubscribe
  */
@@ -338,6 +375,7 @@ static void getroot_completion (flux_future_t *f, void *arg)
             flux_log_error (ctx->h, "%s: kvsroot_mgr_create_root", __FUNCTION__);
             goto error;
         }
+        root_configure (ctx, root);
 
         if (event_subscribe (ctx, ns) < 0) {
             save_errno = errno;
@@ -467,15 +505,23 @@ static void content_load_cache_entry_error (struct kvs_ctx *ctx,
         flux_log (ctx->h, LOG_ERR, "%s: cache_remove_entry", __FUNCTION__);
 }
 
+static void prefetch_dir (struct kvs_ctx *ctx, const json_t *dir, int depth);
+static void prefetch_raw (struct kvs_ctx *ctx,
+                          const void *data,
+                          int size,
+                          int depth);
+
 static void content_load_completion (flux_future_t *f, void *arg)
 {
     struct kvs_ctx *ctx = arg;
     const void *data;
     int size;
     const char *blobref;
+    int *prefetch;
     struct cache_entry *entry;
 
     blobref = flux_future_aux_get (f, "ref");
+    prefetch = flux_future_aux_get (f, "prefetch");
 
     /* should be impossible for lookup to fail, cache entry created
      * earlier, and cache_expire_entries() could not have removed it
@@ -493,6 +539,12 @@ static void content_load_completion (flux_future_t *f, void *arg)
         goto done;
     }
 
+    /* Start prefetching before cache_entry_set_raw() restarts waiters,
+     * so that a restarted lookup finds the children already in flight.
+     */
+    if (prefetch)
+        prefetch_raw (ctx, data, size, *prefetch);
+
     /* If cache_entry_set_raw() fails, it's a pretty terrible error
      * case, where we've loaded an object from the content store, but
      * can't put it in the cache.
@@ -508,11 +560,16 @@ done:
 }
 
 /* Send content load request and setup contination to handle response.
+ * If 'prefetch' > 0, 'ref' is expected to be a directory and its
+ * children are prefetched 'prefetch' levels deep once it is loaded.
  */
-static int content_load_request_send (struct kvs_ctx *ctx, const char *ref)
+static int content_load_request_send (struct kvs_ctx *ctx,
+                                      const char *ref,
+                                      int prefetch)
 {
     flux_future_t *f = NULL;
     char *refcpy;
+    int *depth;
     int saved_errno;
 
     if (!(f = content_load_byblobref (ctx->h, ref, 0))) {
@@ -526,6 +583,16 @@ static int content_load_request_send (struct kvs_ctx *ctx, const char *ref)
         free (refcpy);
         goto error;
     }
+    if (prefetch > 0) {
+        if (!(depth = malloc (sizeof (*depth))))
+            goto error;
+        *depth = prefetch;
+        if (flux_future_aux_set (f, "prefetch", depth, free) < 0) {
+            flux_log_error (ctx->h, "%s: flux_future_aux_set", __FUNCTION__);
+            free (depth);
+            goto error;
+        }
+    }
     if (flux_future_then (f, -1., content_load_completion, ctx) < 0) {
         flux_log_error (ctx->h, "%s: flux_future_then", __FUNCTION__);
         goto error;
@@ -538,9 +605,243 @@ error:
     return -1;
 }
 
-/* Return 0 on success, -1 on error.  Set stall variable appropriately
+/*
+ * prefetch
+ *
+ * A lookup made with FLUX_KVS_PREFETCH that faults in a directory also
+ * requests the dirref and valref children of that directory that are
+ * not yet cached, in a single content.load-batch request issued as soon
+ * as the directory arrives.  Prefetched subdirectories are descended
+ * into until ctx->prefetch_depth levels have been fetched.  Prefetched
+ * cache entries are created without waiters, so a lookup that needs one
+ * before it arrives simply waits on it like any other in-flight load.
+ */
+
+struct prefetch_slot {
+    char *ref;
+    bool dir;
+};
+
+struct prefetch {
+    int depth;                  /* levels left below fetched directories */
+    int count;
+    struct prefetch_slot slots[];
+};
+
+static void prefetch_destroy (struct prefetch *pf)
+{
+    if (pf) {
+        int saved_errno = errno;
+        for (int i = 0; i < pf->count; i++)
+            free (pf->slots[i].ref);
+        free (pf);
+        errno = saved_errno;
+    }
+}
+
+/* Abandon a prefetch slot without data.  If the entry has no waiters,
+ * drop it.  Otherwise, a lookup is counting on it so fall back to a
+ * single load, or fail the waiters if that is not possible.
  */
-static int load (struct kvs_ctx *ctx, const char *ref, wait_t *wait, bool *stall)
+static void prefetch_slot_abandon (struct kvs_ctx *ctx,
+                                   struct prefetch_slot *slot,
+                                   int errnum)
+{
+    struct cache_entry *entry;
+
+    if (!(entry = cache_lookup (ctx->cache, slot->ref))
+        || cache_entry_get_valid (entry))
+        return;
+    if (cache_remove_entry (ctx->cache, slot->ref) == 1)
+        return;
+    if (errnum == 0) {
+        if (content_load_request_send (ctx, slot->ref, 0) == 0)
+            return;
+        errnum = errno;
+        flux_log_error (ctx->h, "%s: content_load_request_send", __FUNCTION__);
+    }
+    content_load_cache_entry_error (ctx, entry, errnum, slot->ref);
+}
+
+static void prefetch_completion (flux_future_t *f, void *arg)
+{
+    struct kvs_ctx *ctx = arg;
+    struct prefetch *pf = flux_future_aux_get (f, "prefetch");
+    const void *buf;
+    int len;
+    int cursor = 0;
+    int i = 0;
+
+    if (content_batch_get (f, &buf, &len) < 0) {
+        if (errno != ENOSYS)
+            flux_log_error (ctx->h, "%s: content_batch_get", __FUNCTION__);
+        goto abandon;
+    }
+    for (i = 0; i < pf->count; i++) {
+        struct prefetch_slot *slot = &pf->slots[i];
+        struct cache_entry *entry;
+        const void *data;
+        int size;
+        int errnum;
+
+        if (content_batch_next (buf, len, &cursor, &errnum, &data, &size) < 1) {
+            flux_log (ctx->h, LOG_ERR, "%s: malformed response", __FUNCTION__);
+            goto abandon;
+        }
+        if (!(entry = cache_lookup (ctx->cache, slot->ref))
+            || cache_entry_get_valid (entry))
+            continue;
+        if (errnum != 0) {
+            prefetch_slot_abandon (ctx, slot, errnum);
+            continue;
+        }
+        if (slot->dir && pf->depth > 0)
+            prefetch_raw (ctx, data, size, pf->depth);
+        if (cache_entry_set_raw (entry, data, size) < 0) {
+            flux_log_error (ctx->h, "%s: cache_entry_set_raw", __FUNCTION__);
+            content_load_cache_entry_error (ctx, entry, errno, slot->ref);
+        }
+    }
+    flux_future_destroy (f);
+    return;
+abandon:
+    for (; i < pf->count; i++)
+        prefetch_slot_abandon (ctx, &pf->slots[i], 0);
+    flux_future_destroy (f);
+}
+
+/* Add blobref 'ref' to prefetch batch 'b', creating a cache entry for
+ * it.  References already in the cache are skipped, although cached
+ * directories are descended into if depth remains.
+ * Returns 0 on success, -1 on failure with errno set.
+ */
+static int prefetch_add (struct kvs_ctx *ctx,
+                         struct content_batch *b,
+                         struct prefetch *pf,
+                         const char *ref,
+                         bool dir)
+{
+    struct cache_entry *entry;
+    char hash[BLOBREF_MAX_DIGEST_SIZE];
+    int hash_len;
+    struct prefetch_slot *slot;
+
+    if ((entry = cache_lookup (ctx->cache, ref))) {
+        const json_t *o;
+
+        if (dir
+            && pf->depth > 0
+            && cache_entry_get_valid (entry)
+            && (o = cache_entry_get_treeobj (entry)))
+            prefetch_dir (ctx, o, pf->depth);
+        return 0;
+    }
+    if ((hash_len = blobref_strtohash (ref, hash, sizeof (hash))) < 0)
+        return -1;
+    if (!(entry = cache_entry_create (ref)))
+        return -1;
+    if (cache_insert (ctx->cache, entry) < 0) {
+        cache_entry_destroy (entry);
+        return -1;
+    }
+    slot = &pf->slots[pf->count];
+    if (!(slot->ref = strdup (ref))
+        || content_batch_append (b, 0, hash, hash_len) < 0) {
+        free (slot->ref);
+        (void)cache_remove_entry (ctx->cache, ref);
+        return -1;
+    }
+    slot->dir = dir;
+    pf->count++;
+    return 0;
+}
+
+/* Prefetch the children of directory 'dir', descending 'depth' - 1
+ * more levels into subdirectories.
+ */
+static void prefetch_dir (struct kvs_ctx *ctx, const json_t *dir, int depth)
+{
+    json_t *data;
+    const char *name;
+    json_t *dirent;
+    struct content_batch *b = NULL;
+    struct prefetch *pf = NULL;
+    flux_future_t *f = NULL;
+
+    if (!treeobj_is_dir (dir)
+        || !(data = treeobj_get_data ((json_t *)dir))
+        || json_object_size (data) > prefetch_max_entries)
+        return;
+    if (!(b = content_batch_create ())
+        || !(pf = calloc (1, sizeof (*pf) + prefetch_max_refs
+                                            * sizeof (pf->slots[0]))))
+        goto error;
+    pf->depth = depth - 1;
+    json_object_foreach (data, name, dirent) {
+        bool is_dir = treeobj_is_dirref (dirent);
+        int count;
+
+        if (!is_dir && !treeobj_is_valref (dirent))
+            continue;
+        count = treeobj_get_count (dirent);
+        if (pf->count + count > prefetch_max_refs)
+            continue;
+        for (int i = 0; i < count; i++) {
+            const char *ref;
+
+            if (!(ref = treeobj_get_blobref (dirent, i))
+                || prefetch_add (ctx, b, pf, ref, is_dir) < 0)
+                goto error;
+        }
+    }
+    if (pf->count == 0)
+        goto done;
+    if (!(f = content_load_batch (ctx->h, b, 0))
+        || flux_future_then (f, -1., prefetch_completion, ctx) < 0
+        || flux_future_aux_set (f,
+                                "prefetch",
+                                pf,
+                                (flux_free_f)prefetch_destroy) < 0)
+        goto error;
+    ctx->prefetches += pf->count;
+    content_batch_destroy (b);
+    return;
+error:
+    flux_log_error (ctx->h, "%s: prefetch failed", __FUNCTION__);
+    flux_future_destroy (f);
+    if (pf) {
+        for (int i = 0; i < pf->count; i++)
+            prefetch_slot_abandon (ctx, &pf->slots[i], 0);
+    }
+done:
+    prefetch_destroy (pf);
+    content_batch_destroy (b);
+}
+
+/* Prefetch the children of raw directory object 'data'.
+ */
+static void prefetch_raw (struct kvs_ctx *ctx,
+                          const void *data,
+                          int size,
+                          int depth)
+{
+    json_t *o;
+
+    if ((o = treeobj_decodeb (data, size))) {
+        prefetch_dir (ctx, o, depth);
+        json_decref (o);
+    }
+}
+
+/* Return 0 on success, -1 on error.  Set stall variable appropriately.
+ * If 'prefetch' > 0 and 'ref' must be fetched, prefetch its children
+ * that many levels deep (see above).
+ */
+static int load (struct kvs_ctx *ctx,
+                 const char *ref,
+                 int prefetch,
+                 wait_t *wait,
+                 bool *stall)
 {
     struct cache_entry *entry = cache_lookup (ctx->cache, ref);
     int saved_errno, ret;
@@ -561,7 +862,7 @@ static int load (struct kvs_ctx *ctx, const char *ref, wait_t *wait, bool *stall
             cache_entry_destroy (entry);
             return -1;
         }
-        if (content_load_request_send (ctx, ref) < 0) {
+        if (content_load_request_send (ctx, ref, prefetch) < 0) {
             saved_errno = errno;
             flux_log_error (ctx->h, "%s: content_load_request_send",
                             __FUNCTION__);
@@ -728,7 +1029,7 @@ static int kvstxn_load_cb (kvstxn_t *kt, const char *ref, void *data)
     struct kvs_cb_data *cbd = data;
     bool stall;
 
-    if (load (cbd->ctx, ref, cbd->wait, &stall) < 0) {
+    if (load (cbd->ctx, ref, 0, cbd->wait, &stall) < 0) {
         cbd->errnum = errno;
         flux_log_error (cbd->ctx->h, "%s: load", __FUNCTION__);
         return -1;
@@ -1120,9 +1421,9 @@ static void transaction_prep_cb (flux_reactor_t *r, flux_watcher_t *w,
         flux_watcher_start (ctx->idle_w);
 }
 
-static void kvstxn_check_root_cb (struct kvsroot *root, void *arg)
+static kvstxn_t *get_ready_transaction (struct kvs_ctx *ctx,
+                                        struct kvsroot *root)
 {
-    struct kvs_ctx *ctx = arg;
     kvstxn_t *kt;
 
     if ((kt = kvstxn_mgr_get_ready_transaction (root->ktm))) {
@@ -1139,7 +1440,16 @@ static void kvstxn_check_root_cb (struct kvsroot *root, void *arg)
                 assert (kt);
             }
         }
+    }
+    return kt;
+}
+
+static void kvstxn_check_root_cb (struct kvsroot *root, void *arg)
+{
+    struct kvs_ctx *ctx = arg;
+    kvstxn_t *kt;
 
+    if ((kt = get_ready_transaction (ctx, root))) {
         /* It does not matter if root has been marked for removal,
          * we want to process and clear all lingering ready
          * transactions in this kvstxn manager
@@ -1148,6 +1458,80 @@ static void kvstxn_check_root_cb (struct kvsroot *root, void *arg)
     }
 }
 
+struct commit_job {
+    struct kvs_ctx *ctx;
+    struct kvsroot *root;
+    kvstxn_t *kt;
+};
+
+/* Called from a workpool thread to run the CPU intensive part of a
+ * transaction (applying ops, unrolling, encoding, and hashing objects).
+ * commit_lock serializes access to the shared cache and flux handle,
+ * and is released by kvstxn_process() while objects are encoded and
+ * hashed.  The transaction is completed by kvstxn_apply() on the
+ * reactor thread, which picks up where this left off.
+ */
+static void commit_job_cb (void *arg)
+{
+    struct commit_job *job = arg;
+
+    pthread_mutex_lock (&job->ctx->commit_lock);
+    if (!job->root->remove && !kvstxn_get_aux_errnum (job->kt))
+        (void)kvstxn_process (job->kt, job->root->ref, job->root->seq);
+    pthread_mutex_unlock (&job->ctx->commit_lock);
+}
+
+/* Process ready transactions from different namespaces concurrently
+ * using the workpool.  Return true if the work queue was handled, or
+ * false if there is too little work to bother.
+ */
+static bool transaction_check_parallel (struct kvs_ctx *ctx)
+{
+    struct kvsroot *root;
+    struct commit_job *jobs;
+    void **args;
+    int count = 0;
+    int njobs = 0;
+    int i;
+
+    list_for_each (&ctx->work_queue, root, work_queue_node)
+        count++;
+    if (count < 2)
+        return false;
+    if (!(jobs = calloc (count, sizeof (*jobs)))
+        || !(args = calloc (count, sizeof (*args)))) {
+        free (jobs);
+        return false;
+    }
+    count = 0;
+    list_for_each (&ctx->work_queue, root, work_queue_node) {
+        kvstxn_t *kt;
+
+        if (!(kt = get_ready_transaction (ctx, root)))
+            continue;
+        jobs[count].ctx = ctx;
+        jobs[count].root = root;
+        jobs[count].kt = kt;
+        /* FLUX_KVS_SYNC transactions make RPCs during processing,
+         * leave them to the reactor thread.
+         */
+        if (!(kvstxn_get_flags (kt) & FLUX_KVS_SYNC))
+            args[njobs++] = &jobs[count];
+        count++;
+    }
+    if (njobs > 1) {
+        pthread_mutex_unlock (&ctx->commit_lock);
+        if (workpool_run (ctx->workpool, commit_job_cb, args, njobs) < 0)
+            flux_log_error (ctx->h, "workpool_run");
+        pthread_mutex_lock (&ctx->commit_lock);
+    }
+    for (i = 0; i < count; i++)
+        kvstxn_apply (jobs[i].kt);
+    free (args);
+    free (jobs);
+    return true;
+}
+
 static void transaction_check_cb (flux_reactor_t *r, flux_watcher_t *w,
                                   int revents, void *arg)
 {
@@ -1157,6 +1541,9 @@ static void transaction_check_cb (flux_reactor_t *r, flux_watcher_t *w,
 
     flux_watcher_stop (ctx->idle_w);
 
+    if (ctx->workpool && transaction_check_parallel (ctx))
+        return;
+
     list_for_each_safe (&ctx->work_queue, root, next, work_queue_node)
         kvstxn_check_root_cb (root, ctx);
 }
@@ -1266,9 +1653,12 @@ static void heartbeat_sync_cb (flux_future_t *f, void *arg)
 static int lookup_load_cb (lookup_t *lh, const char *ref, void *data)
 {
     struct kvs_cb_data *cbd = data;
+    int prefetch = 0;
     bool stall;
 
-    if (load (cbd->ctx, ref, cbd->wait, &stall) < 0) {
+    if (lookup_want_prefetch (lh))
+        prefetch = cbd->ctx->prefetch_depth;
+    if (load (cbd->ctx, ref, prefetch, cbd->wait, &stall) < 0) {
         cbd->errnum = errno;
         flux_log_error (cbd->ctx->h, "%s: load", __FUNCTION__);
         return -1;
@@ -1469,12 +1859,38 @@ error:
     lookup_destroy (lh);
 }
 
+/* Return valref 'val' with the blobrefs before 'index' removed.
+ */
+static json_t *valref_trim (json_t *val, int index)
+{
+    json_t *cpy;
+    int count = treeobj_get_count (val);
+    int i;
+
+    if (!(cpy = treeobj_create_valref (NULL)))
+        return NULL;
+    for (i = index; i < count; i++) {
+        const char *ref;
+        if (!(ref = treeobj_get_blobref (val, i))
+            || treeobj_append_blobref (cpy, ref) < 0) {
+            json_decref (cpy);
+            return NULL;
+        }
+    }
+    return cpy;
+}
+
 /* similar to kvs.lookup, but root_ref / root_seq returned to caller.
  * Also, ENOENT handle special case, returned as error number to
  * caller.  This request is a special rpc predominantly used by the
  * kvs-watch module.  The kvs-watch module requires root information
  * on lookups (including ENOENT failed lookups) to determine what
  * lookups can be considered to be read-your-writes consistency safe.
+ *
+ * With FLUX_KVS_WATCH_APPEND, a valref is returned without reading its
+ * blobs.  If the optional 'append_index' is greater than zero and not
+ * beyond the end of the valref, blobrefs before it are removed and the
+ * total number of blobrefs is returned in 'count'.
  */
 static void lookup_plus_request_cb (flux_t *h, flux_msg_handler_t *mh,
                                     const flux_msg_t *msg, void *arg)
@@ -1483,6 +1899,8 @@ static void lookup_plus_request_cb (flux_t *h, flux_msg_handler_t *mh,
     json_t *val = NULL;
     const char *root_ref;
     int root_seq;
+    int append_index = 0;
+    int count;
     bool stall = false;
 
     if (!(lh = lookup_common (h, mh, msg, arg, lookup_plus_request_cb,
@@ -1497,6 +1915,10 @@ static void lookup_plus_request_cb (flux_t *h, flux_msg_handler_t *mh,
     root_seq = lookup_get_root_seq (lh);
     assert (root_seq >= 0);
 
+    /* append_index is optional */
+    (void)flux_request_unpack (msg, NULL, "{ s:i }",
+                               "append_index", &append_index);
+
     if (!(val = lookup_get_value (lh))) {
         if (flux_respond_pack (h, msg, "{ s:i s:i s:s }",
                                "errno", ENOENT,
@@ -1504,6 +1926,23 @@ static void lookup_plus_request_cb (flux_t *h, flux_msg_handler_t *mh,
                                "rootref", root_ref) < 0)
             flux_log_error (h, "%s: flux_respond_pack", __FUNCTION__);
     }
+    else if (append_index > 0
+             && treeobj_is_valref (val)
+             && (count = treeobj_get_count (val)) >= append_index) {
+        json_t *trimmed;
+
+        if (!(trimmed = valref_trim (val, append_index))) {
+            lookup_destroy (lh);
+            json_decref (val);
+            goto error;
+        }
+        if (flux_respond_pack (h, msg, "{ s:o s:i s:s s:i }",
+                               "val", trimmed,
+                               "rootseq", root_seq,
+                               "rootref", root_ref,
+                               "count", count) < 0)
+            flux_log_error (h, "%s: flux_respond_pack", __FUNCTION__);
+    }
     else {
         if (flux_respond_pack (h, msg, "{ s:O s:i s:s }",
                                "val", val,
@@ -2214,12 +2653,13 @@ static void stats_get_cb (flux_t *h, flux_msg_handler_t *mh,
                               "max", tstat_max (&ts)*scale)))
         goto nomem;
 
-    if (!(cstats = json_pack ("{ s:f s:O s:i s:i s:i }",
+    if (!(cstats = json_pack ("{ s:f s:O s:i s:i s:i s:i }",
                               "obj size total (MiB)", (double)size/1048576,
                               "obj size (KiB)", tstats,
                               "#obj dirty", dirty,
                               "#obj incomplete", incomplete,
-                              "#faults", ctx->faults)))
+                              "#faults", ctx->faults,
+                              "#prefetch", ctx->prefetches)))
         goto nomem;
 
     if (!(nsstats = json_object ()))
@@ -2276,6 +2716,7 @@ static int stats_clear_root_cb (struct kvsroot *root, void *arg)
 static void stats_clear (struct kvs_ctx *ctx)
 {
     ctx->faults = 0;
+    ctx->prefetches = 0;
 
     if (kvsroot_mgr_iter_roots (ctx->krm, stats_clear_root_cb, NULL) < 0)
         flux_log_error (ctx->h, "%s: kvsroot_mgr_iter_roots", __FUNCTION__);
@@ -2329,6 +2770,7 @@ static int namespace_create (struct kvs_ctx *ctx, const char *ns,
         flux_log_error (ctx->h, "%s: kvsroot_mgr_create_root", __FUNCTION__);
         return -1;
     }
+    root_configure (ctx, root);
 
     setroot (ctx, root, rootref, 0);
 
@@ -2369,6 +2811,71 @@ cleanup:
     return rv;
 }
 
+static void namespace_link_continuation (flux_future_t *f, void *arg)
+{
+    struct kvs_ctx *ctx = arg;
+    const flux_msg_t *msg = flux_future_aux_get (f, "msg");
+    const char *ns = flux_future_aux_get (f, "namespace");
+
+    if (flux_future_get (f, NULL) < 0) {
+        int saved_errno = errno;
+        /* The caller is told creation failed, so don't leave the
+         * namespace behind.
+         */
+        if (namespace_remove (ctx, ns) < 0)
+            flux_log_error (ctx->h, "%s: namespace_remove", __FUNCTION__);
+        if (flux_respond_error (ctx->h,
+                                msg,
+                                saved_errno,
+                                "error linking namespace") < 0)
+            flux_log_error (ctx->h, "%s: flux_respond_error", __FUNCTION__);
+    }
+    else if (flux_respond (ctx->h, msg, NULL) < 0)
+        flux_log_error (ctx->h, "%s: flux_respond", __FUNCTION__);
+    flux_future_destroy (f);
+}
+
+/* Commit a symlink at 'key' in the primary namespace to the root of
+ * newly created namespace 'ns', and respond to 'msg' when it completes.
+ * Concurrent links are merged into one commit by the transaction
+ * manager like any other commits.
+ */
+static int namespace_link (struct kvs_ctx *ctx,
+                           const flux_msg_t *msg,
+                           const char *ns,
+                           const char *key)
+{
+    flux_kvs_txn_t *txn;
+    flux_future_t *f = NULL;
+    char *cpy = NULL;
+
+    if (!(txn = flux_kvs_txn_create ()))
+        return -1;
+    if (flux_kvs_txn_symlink (txn, 0, key, ns, ".") < 0
+        || !(f = flux_kvs_commit (ctx->h, KVS_PRIMARY_NAMESPACE, 0, txn)))
+        goto error;
+    if (flux_future_aux_set (f,
+                             "msg",
+                             (void *)flux_msg_incref (msg),
+                             (flux_free_f)flux_msg_decref) < 0) {
+        flux_msg_decref (msg);
+        goto error;
+    }
+    if (!(cpy = strdup (ns))
+        || flux_future_aux_set (f, "namespace", cpy, free) < 0) {
+        ERRNO_SAFE_WRAP (free, cpy);
+        goto error;
+    }
+    if (flux_future_then (f, -1., namespace_link_continuation, ctx) < 0)
+        goto error;
+    flux_kvs_txn_destroy (txn);
+    return 0;
+error:
+    flux_future_destroy (f);
+    flux_kvs_txn_destroy (txn);
+    return -1;
+}
+
 static void namespace_create_request_cb (flux_t *h, flux_msg_handler_t *mh,
                                          const flux_msg_t *msg, void *arg)
 {
@@ -2376,17 +2883,19 @@ static void namespace_create_request_cb (flux_t *h, flux_msg_handler_t *mh,
     const char *errmsg = NULL;
     const char *ns;
     const char *rootref;
+    const char *link = NULL;
     uint32_t owner;
     int flags;
 
     assert (ctx->rank == 0);
 
     /* N.B. owner read into uint32_t */
-    if (flux_request_unpack (msg, NULL, "{ s:s s:s s:i s:i }",
+    if (flux_request_unpack (msg, NULL, "{ s:s s:s s:i s:i s?s }",
                              "namespace", &ns,
                              "rootref", &rootref,
                              "owner", &owner,
-                             "flags", &flags) < 0) {
+                             "flags", &flags,
+                             "link", &link) < 0) {
         flux_log_error (h, "%s: flux_request_unpack", __FUNCTION__);
         goto error;
     }
@@ -2397,6 +2906,20 @@ static void namespace_create_request_cb (flux_t *h, flux_msg_handler_t *mh,
     if (namespace_create (ctx, ns, rootref, owner, flags, &errmsg) < 0)
         goto error;
 
+    /* Response is sent once the link is committed.
+     */
+    if (link) {
+        if (namespace_link (ctx, msg, ns, link) < 0) {
+            int saved_errno = errno;
+            flux_log_error (h, "%s: namespace_link", __FUNCTION__);
+            if (namespace_remove (ctx, ns) < 0)
+                flux_log_error (h, "%s: namespace_remove", __FUNCTION__);
+            errno = saved_errno;
+            goto error;
+        }
+        return;
+    }
+
     if (flux_respond (h, msg, NULL) < 0)
         flux_log_error (h, "%s: flux_respond", __FUNCTION__);
     return;
@@ -2727,6 +3250,141 @@ error:
         flux_log_error (h, "%s: flux_respond_error", __FUNCTION__);
 }
 
+static int dir_shard_threshold_parse (const flux_conf_t *conf,
+                                      flux_error_t *errp,
+                                      int *threshold)
+{
+    flux_error_t error;
+    int value = 0;
+
+    if (flux_conf_unpack (conf,
+                          &error,
+                          "{s?{s?i}}",
+                          "kvs",
+                          "dir-shard-threshold", &value) < 0) {
+        errprintf (errp, "error reading config for kvs: %s", error.text);
+        return -1;
+    }
+    if (value < 0) {
+        errprintf (errp, "invalid dir-shard-threshold config: %d", value);
+        errno = EINVAL;
+        return -1;
+    }
+    (*threshold) = value;
+    return 0;
+}
+
+static int prefetch_depth_parse (const flux_conf_t *conf,
+                                 flux_error_t *errp,
+                                 int *depth)
+{
+    flux_error_t error;
+    int value = 1;
+
+    if (flux_conf_unpack (conf,
+                          &error,
+                          "{s?{s?i}}",
+                          "kvs",
+                          "prefetch-depth", &value) < 0) {
+        errprintf (errp, "error reading config for kvs: %s", error.text);
+        return -1;
+    }
+    if (value < 0) {
+        errprintf (errp, "invalid prefetch-depth config: %d", value);
+        errno = EINVAL;
+        return -1;
+    }
+    (*depth) = value;
+    return 0;
+}
+
+static int treeobj_format_parse (const flux_conf_t *conf,
+                                 flux_error_t *errp,
+                                 bool *binary)
+{
+    flux_error_t error;
+    const char *format = "json";
+
+    if (flux_conf_unpack (conf,
+                          &error,
+                          "{s?{s?s}}",
+                          "kvs",
+                          "treeobj-format", &format) < 0) {
+        errprintf (errp, "error reading config for kvs: %s", error.text);
+        return -1;
+    }
+    if (!strcmp (format, "json"))
+        (*binary) = false;
+    else if (!strcmp (format, "binary"))
+        (*binary) = true;
+    else {
+        errprintf (errp, "invalid treeobj-format config: %s", format);
+        errno = EINVAL;
+        return -1;
+    }
+    return 0;
+}
+
+static int commit_threads_parse (const flux_conf_t *conf,
+                                 flux_error_t *errp,
+                                 int *nthreads)
+{
+    flux_error_t error;
+    int value = 0;
+
+    if (flux_conf_unpack (conf,
+                          &error,
+                          "{s?{s?i}}",
+                          "kvs",
+                          "commit-threads", &value) < 0) {
+        errprintf (errp, "error reading config for kvs: %s", error.text);
+        return -1;
+    }
+    if (value < 0) {
+        errprintf (errp, "invalid commit-threads config: %d", value);
+        errno = EINVAL;
+        return -1;
+    }
+    /* Concurrent commits share cached json objects between threads,
+     * which requires atomic refcounts and a json_dumps() that does
+     * not modify its argument.
+     */
+#if JANSSON_VERSION_HEX < 0x020e00
+    if (value > 1) {
+        errprintf (errp, "commit-threads requires jansson >= 2.14");
+        errno = EINVAL;
+        return -1;
+    }
+#endif
+    (*nthreads) = value;
+    return 0;
+}
+
+/* (Re-)create the workpool if the number of commit threads has changed.
+ * Only rank 0 processes transactions.
+ */
+static int commit_threads_configure (struct kvs_ctx *ctx, int nthreads)
+{
+    struct workpool *wp = NULL;
+
+    if (ctx->rank != 0 || nthreads == ctx->commit_threads)
+        return 0;
+    if (nthreads > 1 && !(wp = workpool_create (nthreads)))
+        return -1;
+    workpool_destroy (ctx->workpool);
+    ctx->workpool = wp;
+    ctx->commit_threads = nthreads;
+    return 0;
+}
+
+static int root_configure_cb (struct kvsroot *root, void *arg)
+{
+    struct kvs_ctx *ctx = arg;
+
+    root_configure (ctx, root);
+    return 0;
+}
+
 static void config_reload_cb (flux_t *h,
                               flux_msg_handler_t *mh,
                               const flux_msg_t *msg,
@@ -2736,13 +3394,36 @@ static void config_reload_cb (flux_t *h,
     const flux_conf_t *conf;
     const char *errstr = NULL;
     flux_error_t error;
+    int dir_shard_threshold;
+    int prefetch_depth;
+    bool binary_treeobj;
+    int commit_threads;
 
     if (flux_conf_reload_decode (msg, &conf) < 0)
         goto error;
+    /* Parse all settings before applying any of them, so that an
+     * invalid config leaves the current one entirely in place.
+     */
+    if (dir_shard_threshold_parse (conf, &error, &dir_shard_threshold) < 0
+        || prefetch_depth_parse (conf, &error, &prefetch_depth) < 0
+        || treeobj_format_parse (conf, &error, &binary_treeobj) < 0
+        || commit_threads_parse (conf, &error, &commit_threads) < 0) {
+        errstr = error.text;
+        goto error;
+    }
     if (kvs_checkpoint_reload (ctx->kcp, conf, &error) < 0) {
         errstr = error.text;
         goto error;
     }
+    if (commit_threads_configure (ctx, commit_threads) < 0) {
+        errstr = "error creating commit threads";
+        goto error;
+    }
+    ctx->dir_shard_threshold = dir_shard_threshold;
+    ctx->prefetch_depth = prefetch_depth;
+    ctx->binary_treeobj = binary_treeobj;
+    if (kvsroot_mgr_iter_roots (ctx->krm, root_configure_cb, ctx) < 0)
+        goto error;
     if (flux_respond (h, msg, NULL) < 0)
         flux_log_error (h, "error responding to config-reload request");
     return;
@@ -2795,12 +3476,33 @@ static const struct flux_msg_handler_spec htab[] = {
 static int process_config (struct kvs_ctx *ctx)
 {
     flux_error_t error;
+    int commit_threads;
+
     if (kvs_checkpoint_config_parse (ctx->kcp,
                                      flux_get_conf (ctx->h),
                                      &error) < 0) {
         flux_log (ctx->h, LOG_ERR, "%s", error.text);
         return -1;
     }
+    if (dir_shard_threshold_parse (flux_get_conf (ctx->h),
+                                   &error,
+                                   &ctx->dir_shard_threshold) < 0
+        || prefetch_depth_parse (flux_get_conf (ctx->h),
+                                 &error,
+                                 &ctx->prefetch_depth) < 0
+        || treeobj_format_parse (flux_get_conf (ctx->h),
+                                 &error,
+                                 &ctx->binary_treeobj) < 0
+        || commit_threads_parse (flux_get_conf (ctx->h),
+                                 &error,
+                                 &commit_threads) < 0) {
+        flux_log (ctx->h, LOG_ERR, "%s", error.text);
+        return -1;
+    }
+    if (commit_threads_configure (ctx, commit_threads) < 0) {
+        flux_log_error (ctx->h, "error creating commit threads");
+        return -1;
+    }
     return 0;
 }
 
@@ -2998,6 +3700,7 @@ int mod_main (flux_t *h, int argc, char **argv)
                 flux_log_error (h, "kvsroot_mgr_create_root");
                 goto done;
             }
+            root_configure (ctx, root);
         }
 
         setroot (ctx, root, rootref, seq);
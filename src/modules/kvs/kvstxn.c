@@ -21,6 +21,7 @@
 #include <flux/core.h>
 #include <jansson.h>
 #include <assert.h>
+#include <pthread.h>
 
 #include "src/common/libczmqcontainers/czmq_containers.h"
 #include "src/common/libccan/ccan/base64/base64.h"
@@ -39,6 +40,9 @@ struct kvstxn_mgr {
     const char *ns_name;
     const char *hash_name;
     int noop_stores;            /* for kvs.stats.get, etc.*/
+    int dir_shard_threshold;    /* split dirs larger than this, 0=never */
+    bool binary_treeobj;        /* store treeobjs in binary encoding */
+    pthread_mutex_t *lock;      /* held by caller of kvstxn_process() */
     zlist_t *ready;
     flux_t *h;
     void *aux;
@@ -297,24 +301,22 @@ static int kvstxn_add_dirty_cache_entry (kvstxn_t *kt, struct cache_entry *entry
     return 0;
 }
 
-/* Store object 'o' under key 'ref' in local cache.
- * Object reference is still owned by the caller.
- * 'is_raw' indicates this data is a json string w/ base64 value and
- * should be flushed to the content store as raw data after it is
- * decoded.  Otherwise, the json object should be a treeobj.
- * Returns -1 on error, 0 on success entry already there, 1 on success
- * entry needs to be flushed to content store
+/* Encode object 'o' for storage and compute its blobref.
+ * This touches no shared state other than reading 'o', so it may be
+ * called with the kvstxn_mgr lock released.  It must not log.
+ * On error, return -1 with errno set and 'errstr' set to the name of
+ * the failing operation.
  */
-static int store_cache (kvstxn_t *kt, json_t *o,
-                        bool is_raw, char *ref, int ref_len,
-                        struct cache_entry **entryp)
+static int encode_object (kvstxn_mgr_t *ktm, json_t *o, bool is_raw,
+                          char *ref, int ref_len,
+                          char **datap, ssize_t *datalenp,
+                          const char **errstr)
 {
-    struct cache_entry *entry;
-    int saved_errno, rc;
     const char *xdata;
     char *data = NULL;
     size_t xlen, databuflen;
     ssize_t datalen = 0;
+    int saved_errno;
 
     if (is_raw) {
         xdata = json_string_value (o);
@@ -322,7 +324,7 @@ static int store_cache (kvstxn_t *kt, json_t *o,
         databuflen = base64_decoded_length (xlen);
         if (databuflen > 0) {
             if (!(data = malloc (databuflen))) {
-                flux_log_error (kt->ktm->h, "malloc");
+                *errstr = "malloc";
                 goto error;
             }
             if ((datalen = base64_decode (data, databuflen, xdata, xlen)) < 0) {
@@ -332,14 +334,72 @@ static int store_cache (kvstxn_t *kt, json_t *o,
         }
     }
     else {
-        if (treeobj_validate (o) < 0 || !(data = treeobj_encode (o))) {
-            flux_log_error (kt->ktm->h, "%s: treeobj_encode", __FUNCTION__);
+        if (treeobj_validate (o) < 0) {
+            *errstr = "treeobj_validate";
             goto error;
         }
-        datalen = strlen (data);
+        if (ktm->binary_treeobj) {
+            size_t len;
+            if (!(data = treeobj_encode_binary (o, &len))) {
+                *errstr = "treeobj_encode_binary";
+                goto error;
+            }
+            datalen = len;
+        }
+        else {
+            if (!(data = treeobj_encode (o))) {
+                *errstr = "treeobj_encode";
+                goto error;
+            }
+            datalen = strlen (data);
+        }
     }
-    if (blobref_hash (kt->ktm->hash_name, data, datalen, ref, ref_len) < 0) {
-        flux_log_error (kt->ktm->h, "%s: blobref_hash", __FUNCTION__);
+    if (blobref_hash (ktm->hash_name, data, datalen, ref, ref_len) < 0) {
+        *errstr = "blobref_hash";
+        goto error;
+    }
+    *datap = data;
+    *datalenp = datalen;
+    return 0;
+error:
+    saved_errno = errno;
+    free (data);
+    errno = saved_errno;
+    return -1;
+}
+
+/* Store object 'o' under key 'ref' in local cache.
+ * Object reference is still owned by the caller.
+ * 'is_raw' indicates this data is a json string w/ base64 value and
+ * should be flushed to the content store as raw data after it is
+ * decoded.  Otherwise, the json object should be a treeobj.
+ * Returns -1 on error, 0 on success entry already there, 1 on success
+ * entry needs to be flushed to content store
+ */
+static int store_cache (kvstxn_t *kt, json_t *o,
+                        bool is_raw, char *ref, int ref_len,
+                        struct cache_entry **entryp)
+{
+    struct cache_entry *entry;
+    int saved_errno, rc, encode_rc;
+    char *data = NULL;
+    ssize_t datalen = 0;
+    const char *errstr = NULL;
+
+    /* Encoding and hashing dominate the cost of a commit, allow other
+     * threads to make progress while it is done.
+     */
+    if (kt->ktm->lock)
+        pthread_mutex_unlock (kt->ktm->lock);
+    encode_rc = encode_object (kt->ktm, o, is_raw, ref, ref_len,
+                               &data, &datalen, &errstr);
+    saved_errno = errno;
+    if (kt->ktm->lock)
+        pthread_mutex_lock (kt->ktm->lock);
+    errno = saved_errno;
+    if (encode_rc < 0) {
+        if (errstr)
+            flux_log_error (kt->ktm->h, "%s: %s", __FUNCTION__, errstr);
         goto error;
     }
     if (!(entry = cache_lookup (kt->ktm->cache, ref))) {
@@ -384,6 +444,89 @@ static int store_cache (kvstxn_t *kt, json_t *o,
     return -1;
 }
 
+static int kvstxn_unroll (kvstxn_t *kt, json_t *dir);
+static int kvstxn_unroll_hdir (kvstxn_t *kt, json_t *hdir);
+
+/* Unroll and store dir or hdir object 'dir', returning a new dirref
+ * that refers to it.  If sharding is enabled and a dir has grown past
+ * the shard threshold, it is split into an hdir at 'level' first.
+ * Return dirref on success, NULL on error.
+ */
+static json_t *kvstxn_store_dir (kvstxn_t *kt, json_t *dir, int level)
+{
+    json_t *split = NULL;
+    json_t *dirref = NULL;
+    char ref[BLOBREF_MAX_STRING_SIZE];
+    struct cache_entry *entry;
+    int saved_errno;
+    int ret;
+
+    if (treeobj_is_dir (dir)
+        && kt->ktm->dir_shard_threshold > 0
+        && level <= TREEOBJ_HDIR_MAX_LEVEL
+        && treeobj_get_count (dir) > kt->ktm->dir_shard_threshold) {
+        if (!(split = treeobj_split_dir (dir, level)))
+            goto error;
+        dir = split;
+    }
+    if (treeobj_is_hdir (dir))
+        ret = kvstxn_unroll_hdir (kt, dir); /* depth first */
+    else
+        ret = kvstxn_unroll (kt, dir);
+    if (ret < 0)
+        goto error;
+    if ((ret = store_cache (kt, dir, false, ref, sizeof (ref), &entry)) < 0)
+        goto error;
+    if (ret) {
+        if (kvstxn_add_dirty_cache_entry (kt, entry) < 0)
+            goto error;
+    }
+    if (!(dirref = treeobj_create_dirref (ref)))
+        goto error;
+error:
+    saved_errno = errno;
+    json_decref (split);
+    errno = saved_errno;
+    return dirref;
+}
+
+/* Store shards of an hdir, converting them to DIRREFs.  Shards that
+ * were emptied by the transaction are removed.
+ * Return 0 on success, -1 on error
+ */
+static int kvstxn_unroll_hdir (kvstxn_t *kt, json_t *hdir)
+{
+    json_t *shard;
+    json_t *ktmp;
+    int level;
+    int i;
+
+    if ((level = treeobj_get_hdir_level (hdir)) < 0)
+        return -1;
+
+    for (i = 0; i < TREEOBJ_HDIR_FANOUT; i++) {
+        if (!(shard = treeobj_get_shard (hdir, i))) {
+            if (errno != ENOENT)
+                return -1;
+            continue;
+        }
+        if (treeobj_is_dir (shard) && treeobj_get_count (shard) == 0) {
+            if (treeobj_set_shard (hdir, i, NULL) < 0)
+                return -1;
+        }
+        else if (treeobj_is_dir (shard) || treeobj_is_hdir (shard)) {
+            if (!(ktmp = kvstxn_store_dir (kt, shard, level + 1)))
+                return -1;
+            if (treeobj_set_shard (hdir, i, ktmp) < 0) {
+                json_decref (ktmp);
+                return -1;
+            }
+            json_decref (ktmp);
+        }
+    }
+    return 0;
+}
+
 /* Store DIRVAL objects, converting them to DIRREFs.
  * Store (large) FILEVAL objects, converting them to FILEREFs.
  * Return 0 on success, -1 on error
@@ -410,17 +553,8 @@ static int kvstxn_unroll (kvstxn_t *kt, json_t *dir)
      */
     while (iter) {
         dir_entry = json_object_iter_value (iter);
-        if (treeobj_is_dir (dir_entry)) {
-            if (kvstxn_unroll (kt, dir_entry) < 0) /* depth first */
-                return -1;
-            if ((ret = store_cache (kt, dir_entry,
-                                    false, ref, sizeof (ref), &entry)) < 0)
-                return -1;
-            if (ret) {
-                if (kvstxn_add_dirty_cache_entry (kt, entry) < 0)
-                    return -1;
-            }
-            if (!(ktmp = treeobj_create_dirref (ref)))
+        if (treeobj_is_dir (dir_entry) || treeobj_is_hdir (dir_entry)) {
+            if (!(ktmp = kvstxn_store_dir (kt, dir_entry, 0)))
                 return -1;
             if (json_object_iter_set_new (dir, iter, ktmp) < 0) {
                 json_decref (ktmp);
@@ -594,6 +728,115 @@ static int kvstxn_append (kvstxn_t *kt, json_t *dirent,
     return 0;
 }
 
+/* Get a copy of the dir or hdir referenced by 'dirref' from the cache,
+ * so that it can be modified without corrupting the cached original.
+ * If the object is not in the cache, set 'missing_ref' and return
+ * success with *dirp set to NULL.
+ * Return 0 on success, -1 on error with errno set.
+ */
+static int kvstxn_copy_dirref (kvstxn_t *kt,
+                               const json_t *dirref,
+                               json_t **dirp,
+                               const char **missing_ref)
+{
+    struct cache_entry *entry;
+    const char *ref;
+    const json_t *dirtmp;
+    int refcount;
+
+    if ((refcount = treeobj_get_count (dirref)) < 0)
+        return -1;
+
+    if (refcount != 1) {
+        flux_log (kt->ktm->h, LOG_ERR, "invalid dirref count: %d",
+                  refcount);
+        errno = ENOTRECOVERABLE;
+        return -1;
+    }
+
+    if (!(ref = treeobj_get_blobref (dirref, 0)))
+        return -1;
+
+    if (!(entry = cache_lookup (kt->ktm->cache, ref))
+        || !cache_entry_get_valid (entry)) {
+        *missing_ref = ref;
+        *dirp = NULL;
+        return 0; /* stall */
+    }
+
+    if (!(dirtmp = cache_entry_get_treeobj (entry))) {
+        errno = ENOTRECOVERABLE;
+        return -1;
+    }
+
+    /* do not corrupt store by modifying orig. */
+    if (!(*dirp = treeobj_deep_copy (dirtmp)))
+        return -1;
+    return 0;
+}
+
+/* If 'dir' is an hdir, descend through its shards to the dir that
+ * holds (or would hold) 'name', copying dirref shards into the working
+ * copy along the way.  Empty shards are created if 'create' is true.
+ * On success, *dirp is set to the dir, or to NULL if the shard is empty
+ * and 'create' is false, or if a shard must be loaded (stall), in which
+ * case 'missing_ref' is also set.
+ * Return 0 on success, -1 on error with errno set.
+ */
+static int kvstxn_resolve_shard (kvstxn_t *kt,
+                                 json_t *dir,
+                                 const char *name,
+                                 bool create,
+                                 json_t **dirp,
+                                 const char **missing_ref)
+{
+    while (treeobj_is_hdir (dir)) {
+        json_t *shard;
+        int index;
+
+        if ((index = treeobj_hdir_index (dir, name)) < 0)
+            return -1;
+        if (!(shard = treeobj_get_shard (dir, index))) {
+            if (errno != ENOENT)
+                return -1;
+            if (!create) {
+                *dirp = NULL;
+                return 0;
+            }
+            if (!(shard = treeobj_create_dir ()))
+                return -1;
+            if (treeobj_set_shard (dir, index, shard) < 0) {
+                json_decref (shard);
+                return -1;
+            }
+            json_decref (shard);
+        }
+        else if (treeobj_is_dirref (shard)) {
+            json_t *cpy;
+
+            if (kvstxn_copy_dirref (kt, shard, &cpy, missing_ref) < 0)
+                return -1;
+            if (!cpy) {
+                *dirp = NULL;
+                return 0; /* stall */
+            }
+            if (treeobj_set_shard (dir, index, cpy) < 0) {
+                json_decref (cpy);
+                return -1;
+            }
+            json_decref (cpy);
+            shard = cpy;
+        }
+        else if (!treeobj_is_dir (shard) && !treeobj_is_hdir (shard)) {
+            errno = ENOTRECOVERABLE;
+            return -1;
+        }
+        dir = shard;
+    }
+    *dirp = dir;
+    return 0;
+}
+
 /* link (key, dirent) into directory 'dir'.
  */
 static int kvstxn_link_dirent (kvstxn_t *kt,
@@ -629,11 +872,23 @@ static int kvstxn_link_dirent (kvstxn_t *kt,
     while ((next = strchr (name, '.'))) {
         *next++ = '\0';
 
-        if (!treeobj_is_dir (dir)) {
+        if (!treeobj_is_dir (dir) && !treeobj_is_hdir (dir)) {
             saved_errno = ENOTRECOVERABLE;
             goto done;
         }
 
+        if (kvstxn_resolve_shard (kt,
+                                  dir,
+                                  name,
+                                  !json_is_null (dirent),
+                                  &dir,
+                                  missing_ref) < 0) {
+            saved_errno = errno;
+            goto done;
+        }
+        if (!dir) /* stall, or key deletion in empty shard */
+            goto success;
+
         if (!(dir_entry = treeobj_get_entry (dir, name))) {
             if (json_is_null (dirent)) /* key deletion - it doesn't exist so return */
                 goto success;
@@ -648,47 +903,16 @@ static int kvstxn_link_dirent (kvstxn_t *kt,
                 goto done;
             }
             json_decref (subdir);
-        } else if (treeobj_is_dir (dir_entry)) {
+        } else if (treeobj_is_dir (dir_entry)
+                   || treeobj_is_hdir (dir_entry)) {
             subdir = dir_entry;
         } else if (treeobj_is_dirref (dir_entry)) {
-            struct cache_entry *entry;
-            const char *ref;
-            const json_t *subdirktmp;
-            int refcount;
-
-            if ((refcount = treeobj_get_count (dir_entry)) < 0) {
+            if (kvstxn_copy_dirref (kt, dir_entry, &subdir, missing_ref) < 0) {
                 saved_errno = errno;
                 goto done;
             }
-
-            if (refcount != 1) {
-                flux_log (kt->ktm->h, LOG_ERR, "invalid dirref count: %d",
-                          refcount);
-                saved_errno = ENOTRECOVERABLE;
-                goto done;
-            }
-
-            if (!(ref = treeobj_get_blobref (dir_entry, 0))) {
-                saved_errno = errno;
-                goto done;
-            }
-
-            if (!(entry = cache_lookup (kt->ktm->cache, ref))
-                || !cache_entry_get_valid (entry)) {
-                *missing_ref = ref;
+            if (!subdir)
                 goto success; /* stall */
-            }
-
-            if (!(subdirktmp = cache_entry_get_treeobj (entry))) {
-                saved_errno = ENOTRECOVERABLE;
-                goto done;
-            }
-
-            /* do not corrupt store by modifying orig. */
-            if (!(subdir = treeobj_deep_copy (subdirktmp))) {
-                saved_errno = errno;
-                goto done;
-            }
 
             /* copy from entry already in cache, assume novalidate ok */
             if (treeobj_insert_entry_novalidate (dir, name, subdir) < 0) {
@@ -752,6 +976,17 @@ static int kvstxn_link_dirent (kvstxn_t *kt,
     /* This is the final path component of the key.  Add/modify/delete
      * it in the directory.
      */
+    if (kvstxn_resolve_shard (kt,
+                              dir,
+                              name,
+                              !json_is_null (dirent),
+                              &dir,
+                              missing_ref) < 0) {
+        saved_errno = errno;
+        goto done;
+    }
+    if (!dir) /* stall, or key deletion in empty shard */
+        goto success;
     if (!json_is_null (dirent)) {
         if (flags & FLUX_KVS_APPEND) {
             if (kvstxn_append (kt, dirent, dir, name, append) < 0) {
@@ -1249,6 +1484,21 @@ kvstxn_mgr_t *kvstxn_mgr_create (struct cache *cache,
     return NULL;
 }
 
+void kvstxn_mgr_set_dir_shard_threshold (kvstxn_mgr_t *ktm, int threshold)
+{
+    ktm->dir_shard_threshold = threshold > 0 ? threshold : 0;
+}
+
+void kvstxn_mgr_set_binary_treeobj (kvstxn_mgr_t *ktm, bool enable)
+{
+    ktm->binary_treeobj = enable;
+}
+
+void kvstxn_mgr_set_lock (kvstxn_mgr_t *ktm, pthread_mutex_t *lock)
+{
+    ktm->lock = lock;
+}
+
 void kvstxn_mgr_destroy (kvstxn_mgr_t *ktm)
 {
     if (ktm) {
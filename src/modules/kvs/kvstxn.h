@@ -11,6 +11,7 @@
 #ifndef _FLUX_KVS_KVSTXN_H
 #define _FLUX_KVS_KVSTXN_H
 
+#include <pthread.h>
 #include <flux/core.h>
 
 #include "cache.h"
@@ -159,6 +160,27 @@ kvstxn_mgr_t *kvstxn_mgr_create (struct cache *cache,
 
 void kvstxn_mgr_destroy (kvstxn_mgr_t *ktm);
 
+/* Directories with more than 'threshold' entries are converted to
+ * sharded hdir objects when stored, so that updating a single key
+ * only stores the affected shards.  A threshold of 0 (the default)
+ * disables sharding of new directories.  Existing hdir objects are
+ * always handled.
+ */
+void kvstxn_mgr_set_dir_shard_threshold (kvstxn_mgr_t *ktm, int threshold);
+
+/* If 'enable' is true, treeobjs are stored in the compact binary
+ * encoding rather than JSON.  Either encoding may be read back
+ * regardless of this setting.
+ */
+void kvstxn_mgr_set_binary_treeobj (kvstxn_mgr_t *ktm, bool enable);
+
+/* If 'lock' is set, kvstxn_process() must be called with it held.
+ * The lock is temporarily released while objects are encoded and
+ * hashed, so that transactions of other kvstxn managers sharing the
+ * same lock may be processed concurrently by other threads.
+ */
+void kvstxn_mgr_set_lock (kvstxn_mgr_t *ktm, pthread_mutex_t *lock);
+
 /* kvstxn_mgr_add_transaction() will internally create a kvstxn_t and
  * store it in the queue of ready to process transactions.
  *
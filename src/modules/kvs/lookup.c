@@ -81,6 +81,9 @@ struct lookup {
     const json_t *valref_missing_refs;
     const char *missing_ref;
 
+    /* if non-NULL, array of refs needed to read a sharded directory */
+    json_t *hdir_missing_refs;
+
     /* for namespace callback */
 
     char *missing_namespace;
@@ -350,6 +353,185 @@ cleanup:
     return ret;
 }
 
+/* Load the dir or hdir referenced by hdir shard 'shard'.  Return NULL
+ * with *stall set if the shard is not in the cache.
+ */
+static const json_t *get_shard_dir (lookup_t *lh,
+                                    const json_t *shard,
+                                    struct cache_entry **entryp,
+                                    bool *stall)
+{
+    struct cache_entry *entry;
+    const json_t *dir;
+    const char *refstr;
+
+    (*stall) = false;
+    if (!treeobj_is_dirref (shard))
+        return shard;
+    if (treeobj_get_count (shard) != 1
+        || !(refstr = treeobj_get_blobref (shard, 0))) {
+        lh->errnum = ENOTRECOVERABLE;
+        return NULL;
+    }
+    if (!(entry = cache_lookup (lh->cache, refstr))
+        || !cache_entry_get_valid (entry)) {
+        lh->missing_ref = refstr;
+        (*stall) = true;
+        return NULL;
+    }
+    if (!(dir = cache_entry_get_treeobj (entry))
+        || (!treeobj_is_dir (dir) && !treeobj_is_hdir (dir))) {
+        flux_log (lh->h, LOG_ERR, "hdir shard points to non-directory");
+        lh->errnum = ENOTRECOVERABLE;
+        return NULL;
+    }
+    if (entryp)
+        (*entryp) = entry;
+    return dir;
+}
+
+/* If 'dir' is an hdir, follow shards to the dir that would contain
+ * 'name'.  On success, *dirp is set to that dir, or to NULL if the
+ * shard is empty, and *entryp is updated to the cache entry holding it.
+ */
+static lookup_process_t walk_shards (lookup_t *lh,
+                                     const json_t *dir,
+                                     const char *name,
+                                     const json_t **dirp,
+                                     struct cache_entry **entryp)
+{
+    while (treeobj_is_hdir (dir)) {
+        const json_t *shard;
+        bool stall;
+        int index;
+
+        if ((index = treeobj_hdir_index (dir, name)) < 0) {
+            lh->errnum = errno;
+            return LOOKUP_PROCESS_ERROR;
+        }
+        if (!(shard = treeobj_peek_shard (dir, index))) {
+            if (errno != ENOENT) {
+                lh->errnum = errno;
+                return LOOKUP_PROCESS_ERROR;
+            }
+            (*dirp) = NULL;
+            return LOOKUP_PROCESS_FINISHED;
+        }
+        if (!(dir = get_shard_dir (lh, shard, entryp, &stall))) {
+            if (stall)
+                return LOOKUP_PROCESS_LOAD_MISSING_REFS;
+            return LOOKUP_PROCESS_ERROR;
+        }
+    }
+    (*dirp) = dir;
+    return LOOKUP_PROCESS_FINISHED;
+}
+
+/* Copy entries of all shards of 'hdir' into dir object 'dir', so that
+ * sharding is invisible to readers of the directory.  All missing
+ * shards are gathered in lh->hdir_missing_refs so they can be loaded
+ * in parallel.  Return 0 on success, -1 on failure.  On success, stall
+ * should be checked.
+ */
+static int flatten_hdir (lookup_t *lh,
+                         const json_t *hdir,
+                         json_t *dir,
+                         bool *stall)
+{
+    int i;
+
+    for (i = 0; i < TREEOBJ_HDIR_FANOUT; i++) {
+        const json_t *shard;
+        const json_t *shard_dir;
+        bool shard_stall;
+
+        if (!(shard = treeobj_peek_shard (hdir, i))) {
+            if (errno != ENOENT) {
+                lh->errnum = errno;
+                return -1;
+            }
+            continue;
+        }
+        if (!(shard_dir = get_shard_dir (lh, shard, NULL, &shard_stall))) {
+            json_t *o;
+
+            if (!shard_stall)
+                return -1;
+            if (!lh->hdir_missing_refs
+                && !(lh->hdir_missing_refs = json_array ())) {
+                lh->errnum = ENOMEM;
+                return -1;
+            }
+            if (!(o = json_string (lh->missing_ref))
+                || json_array_append_new (lh->hdir_missing_refs, o) < 0) {
+                json_decref (o);
+                lh->errnum = ENOMEM;
+                return -1;
+            }
+            (*stall) = true;
+            continue;
+        }
+        if (treeobj_is_hdir (shard_dir)) {
+            if (flatten_hdir (lh, shard_dir, dir, stall) < 0)
+                return -1;
+        }
+        else {
+            const char *name;
+            json_t *entry;
+
+            /* N.B. safe to cast away const, 'entry' is only copied */
+            json_object_foreach (treeobj_get_data ((json_t *)shard_dir),
+                                 name,
+                                 entry) {
+                json_t *cpy;
+
+                if (!(cpy = treeobj_deep_copy (entry))
+                    || treeobj_insert_entry_novalidate (dir, name, cpy) < 0) {
+                    json_decref (cpy);
+                    lh->errnum = ENOMEM;
+                    return -1;
+                }
+                json_decref (cpy);
+            }
+        }
+    }
+    return 0;
+}
+
+/* Set lh->val to a copy of 'dir', flattening it if it is an hdir.
+ * Return 0 on success, -1 on failure.  On success, stall should be
+ * checked.
+ */
+static int get_dir_value (lookup_t *lh, const json_t *dir, bool *stall)
+{
+    json_t *val;
+
+    (*stall) = false;
+    if (!treeobj_is_hdir (dir)) {
+        if (!(lh->val = treeobj_deep_copy (dir))) {
+            lh->errnum = errno;
+            return -1;
+        }
+        return 0;
+    }
+    json_decref (lh->hdir_missing_refs);
+    lh->hdir_missing_refs = NULL;
+    if (!(val = treeobj_create_dir ())) {
+        lh->errnum = errno;
+        return -1;
+    }
+    if (flatten_hdir (lh, dir, val, stall) < 0) {
+        json_decref (val);
+        return -1;
+    }
+    if ((*stall)) {
+        json_decref (val);
+        return 0;
+    }
+    lh->val = val;
+    return 0;
+}
+
 /* Get dirent of the requested path starting at the given root.
  *
  * Return true on success or error, error code is returned in ep and
@@ -410,7 +592,7 @@ static lookup_process_t walk (lookup_t *lh)
                     lh->errnum = ENOTRECOVERABLE;
                 goto error;
             }
-            if (!treeobj_is_dir (dir)) {
+            if (!treeobj_is_dir (dir) && !treeobj_is_hdir (dir)) {
                 /* dirref pointed to non-dir error, special case when
                  * root_dirent is bad, is EINVAL from user.
                  */
@@ -441,6 +623,20 @@ static lookup_process_t walk (lookup_t *lh)
             }
         }
 
+        /* Descend into shards if directory is sharded */
+
+        if (treeobj_is_hdir (dir)) {
+            lookup_process_t lret;
+
+            lret = walk_shards (lh, dir, pathcomp, &dir, &entry);
+            if (lret == LOOKUP_PROCESS_ERROR)
+                goto error;
+            else if (lret == LOOKUP_PROCESS_LOAD_MISSING_REFS)
+                return LOOKUP_PROCESS_LOAD_MISSING_REFS;
+            if (!dir)
+                goto done;
+        }
+
         /* Get directory reference of path component from directory */
 
         if (!(dirent_tmp = treeobj_peek_entry (dir, pathcomp))) {
@@ -598,6 +794,7 @@ void lookup_destroy (lookup_t *lh)
         free (lh->root_ref);
         free (lh->path);
         json_decref (lh->val);
+        json_decref (lh->hdir_missing_refs);
         free (lh->missing_namespace);
         zlist_destroy (&lh->levels);
         free (lh);
@@ -677,6 +874,15 @@ int lookup_iter_missing_refs (lookup_t *lh, lookup_ref_f cb, void *data)
                 }
             }
         }
+        else if (lh->hdir_missing_refs) {
+            size_t index;
+            json_t *o;
+
+            json_array_foreach (lh->hdir_missing_refs, index, o) {
+                if (cb (lh, json_string_value (o), data) < 0)
+                    return -1;
+            }
+        }
         else {
             if (cb (lh, lh->missing_ref, data) < 0)
                 return -1;
@@ -687,6 +893,18 @@ int lookup_iter_missing_refs (lookup_t *lh, lookup_ref_f cb, void *data)
     return -1;
 }
 
+bool lookup_want_prefetch (lookup_t *lh)
+{
+    if (lh
+        && (lh->flags & FLUX_KVS_PREFETCH)
+        && (lh->state == LOOKUP_STATE_CHECK_ROOT
+            || lh->state == LOOKUP_STATE_WALK
+            || lh->state == LOOKUP_STATE_VALUE)
+        && !lh->valref_missing_refs)
+        return true;
+    return false;
+}
+
 const char *lookup_missing_namespace (lookup_t *lh)
 {
    if (lh
@@ -893,6 +1111,7 @@ lookup_process_t lookup (lookup_t *lh)
     const char *reftmp;
     struct cache_entry *entry;
     bool is_replay = false;
+    bool stall;
     int refcount;
 
     if (!lh) {
@@ -903,6 +1122,12 @@ lookup_process_t lookup (lookup_t *lh)
     if (lh->errnum)
         return LOOKUP_PROCESS_ERROR;
 
+    /* hdir shard refs from a previous stall are stale if the replayed
+     * walk now stalls elsewhere (on lh->missing_ref).
+     */
+    json_decref (lh->hdir_missing_refs);
+    lh->hdir_missing_refs = NULL;
+
     if (lh->state != LOOKUP_STATE_INIT
         && lh->state != LOOKUP_STATE_FINISHED)
         is_replay = true;
@@ -976,15 +1201,15 @@ lookup_process_t lookup (lookup_t *lh)
                         lh->errnum = EINVAL;
                         goto error;
                     }
-                    if (!treeobj_is_dir (valtmp)) {
+                    if (!treeobj_is_dir (valtmp) && !treeobj_is_hdir (valtmp)) {
                         /* root_ref points to not dir */
                         lh->errnum = ENOTRECOVERABLE;
                         goto error;
                     }
-                    if (!(lh->val = treeobj_deep_copy (valtmp))) {
-                        lh->errnum = errno;
+                    if (get_dir_value (lh, valtmp, &stall) < 0)
                         goto error;
-                    }
+                    if (stall)
+                        return LOOKUP_PROCESS_LOAD_MISSING_REFS;
                 }
                 goto done;
             }
@@ -1073,18 +1298,16 @@ lookup_process_t lookup (lookup_t *lh)
                     lh->errnum = ENOTRECOVERABLE;
                     goto error;
                 }
-                if (!treeobj_is_dir (valtmp)) {
+                if (!treeobj_is_dir (valtmp) && !treeobj_is_hdir (valtmp)) {
                     /* dirref points to not dir */
                     lh->errnum = ENOTRECOVERABLE;
                     goto error;
                 }
-                if (!(lh->val = treeobj_deep_copy (valtmp))) {
-                    lh->errnum = errno;
+                if (get_dir_value (lh, valtmp, &stall) < 0)
                     goto error;
-                }
+                if (stall)
+                    return LOOKUP_PROCESS_LOAD_MISSING_REFS;
             } else if (treeobj_is_valref (lh->wdirent)) {
-                bool stall;
-
                 if ((lh->flags & FLUX_KVS_READLINK)) {
                     lh->errnum = EINVAL;
                     goto error;
@@ -1103,6 +1326,14 @@ lookup_process_t lookup (lookup_t *lh)
                     lh->errnum = ENOTRECOVERABLE;
                     goto error;
                 }
+                /* kvs-watch loads only newly appended blobs itself */
+                if ((lh->flags & FLUX_KVS_WATCH_APPEND)) {
+                    if (!(lh->val = treeobj_deep_copy (lh->wdirent))) {
+                        lh->errnum = errno;
+                        goto error;
+                    }
+                    goto done;
+                }
                 if (refcount == 1) {
                     if (get_single_blobref_valref_value (lh, &stall) < 0)
                         goto error;
@@ -74,6 +74,12 @@ json_t *lookup_get_value (lookup_t *lh);
  */
 int lookup_iter_missing_refs (lookup_t *lh, lookup_ref_f cb, void *data);
 
+/* On lookup stall b/c of missing reference(s), returns true if the
+ * lookup was made with FLUX_KVS_PREFETCH and the missing references
+ * are directories, whose children the caller may load ahead of need.
+ */
+bool lookup_want_prefetch (lookup_t *lh);
+
 /* On lookup stall b/c of missing namespace, get missing namespace
  * returned by this function.
  *
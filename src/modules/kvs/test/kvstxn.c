@@ -12,6 +12,7 @@
 #include "config.h"
 #endif
 #include <stdbool.h>
+#include <pthread.h>
 #include <jansson.h>
 #include <assert.h>
 
@@ -3004,6 +3005,382 @@ void kvstxn_process_giant_dir (void)
     json_decref (root);
 }
 
+/* lookup 'key' in 'root_ref' with FLUX_KVS_TREEOBJ and return the
+ * treeobj it references in the cache.
+ */
+const json_t *get_dirref_treeobj (struct cache *cache,
+                                  kvsroot_mgr_t *krm,
+                                  const char *root_ref,
+                                  const char *key)
+{
+    lookup_t *lh;
+    json_t *dirref;
+    struct cache_entry *entry;
+    const json_t *o = NULL;
+    struct flux_msg_cred cred = { .rolemask = FLUX_ROLE_OWNER, .userid = 0 };
+
+    if (!(lh = lookup_create (cache,
+                              krm,
+                              KVS_PRIMARY_NAMESPACE,
+                              root_ref,
+                              0,
+                              key,
+                              cred,
+                              FLUX_KVS_TREEOBJ,
+                              NULL))
+        || lookup (lh) != LOOKUP_PROCESS_FINISHED
+        || !(dirref = lookup_get_value (lh)))
+        BAIL_OUT ("could not lookup treeobj of %s", key);
+    if (treeobj_is_dirref (dirref)
+        && (entry = cache_lookup (cache, treeobj_get_blobref (dirref, 0))))
+        o = cache_entry_get_treeobj (entry);
+    json_decref (dirref);
+    lookup_destroy (lh);
+    return o;
+}
+
+void kvstxn_process_sharded_dir (void)
+{
+    struct cache *cache;
+    kvsroot_mgr_t *krm;
+    kvstxn_mgr_t *ktm;
+    kvstxn_t *kt;
+    char rootref[BLOBREF_MAX_STRING_SIZE];
+    char newroot[BLOBREF_MAX_STRING_SIZE];
+    char key[64];
+    char val[64];
+    const json_t *o;
+    json_t *ops;
+    lookup_t *lh;
+    struct flux_msg_cred cred = { .rolemask = FLUX_ROLE_OWNER, .userid = 0 };
+    int count = 0;
+    int i;
+
+    cache = create_cache_with_empty_rootdir (rootref, sizeof (rootref));
+
+    ok ((krm = kvsroot_mgr_create (NULL, NULL)) != NULL,
+        "kvsroot_mgr_create works");
+
+    setup_kvsroot (krm, KVS_PRIMARY_NAMESPACE, cache, rootref);
+
+    ok ((ktm = kvstxn_mgr_create (cache,
+                                  KVS_PRIMARY_NAMESPACE,
+                                  "sha1",
+                                  NULL,
+                                  &test_global)) != NULL,
+        "kvstxn_mgr_create works");
+
+    kvstxn_mgr_set_dir_shard_threshold (ktm, 16);
+
+    /* create a directory with 500 entries, which exceeds the threshold
+     * and should be stored as an hdir
+     */
+    ops = json_array ();
+    for (i = 0; i < 500; i++) {
+        snprintf (key, sizeof (key), "dir.key%d", i);
+        snprintf (val, sizeof (val), "%d", i);
+        ops_append (ops, key, val, 0);
+    }
+    ok (kvstxn_mgr_add_transaction (ktm, "transaction1", ops, 0, 0) == 0,
+        "kvstxn_mgr_add_transaction works");
+    json_decref (ops);
+
+    ok ((kt = kvstxn_mgr_get_ready_transaction (ktm)) != NULL,
+        "kvstxn_mgr_get_ready_transaction returns ready kvstxn");
+
+    ok (kvstxn_process (kt, rootref, 0) == KVSTXN_PROCESS_DIRTY_CACHE_ENTRIES,
+        "kvstxn_process returns KVSTXN_PROCESS_DIRTY_CACHE_ENTRIES");
+
+    ok (kvstxn_iter_dirty_cache_entries (kt, cache_noop_cb, NULL) == 0,
+        "kvstxn_iter_dirty_cache_entries works for dirty cache entries");
+
+    ok (kvstxn_process (kt, rootref, 0) == KVSTXN_PROCESS_FINISHED,
+        "kvstxn_process returns KVSTXN_PROCESS_FINISHED");
+
+    strcpy (newroot, kvstxn_get_newroot_ref (kt));
+    kvstxn_mgr_remove_transaction (ktm, kt, false);
+
+    o = get_dirref_treeobj (cache, krm, newroot, "dir");
+    ok (treeobj_is_hdir (o) && treeobj_get_hdir_level (o) == 0,
+        "large directory was stored as level 0 hdir");
+
+    verify_value (cache, krm, KVS_PRIMARY_NAMESPACE, newroot, "dir.key0", "0");
+    verify_value (cache, krm, KVS_PRIMARY_NAMESPACE, newroot, "dir.key42", "42");
+    verify_value (cache, krm, KVS_PRIMARY_NAMESPACE, newroot, "dir.key499", "499");
+    verify_value (cache, krm, KVS_PRIMARY_NAMESPACE, newroot, "dir.nokey", NULL);
+
+    /* readdir returns a plain directory with all entries
+     */
+    ok ((lh = lookup_create (cache,
+                             krm,
+                             KVS_PRIMARY_NAMESPACE,
+                             newroot,
+                             0,
+                             "dir",
+                             cred,
+                             FLUX_KVS_READDIR,
+                             NULL)) != NULL,
+        "lookup_create dir works");
+    ok (lookup (lh) == LOOKUP_PROCESS_FINISHED,
+        "lookup dir found result");
+    o = lookup_get_value (lh);
+    ok (treeobj_is_dir (o) && treeobj_get_count (o) == 500,
+        "lookup of hdir returns dir with all 500 entries");
+    json_decref ((json_t *)o);
+    lookup_destroy (lh);
+
+    /* update and delete single keys, only the root, the hdir, and
+     * the affected shard need to be stored
+     */
+    create_ready_kvstxn (ktm, "transaction2", "dir.key42", "foo", 0, 0);
+
+    ok ((kt = kvstxn_mgr_get_ready_transaction (ktm)) != NULL,
+        "kvstxn_mgr_get_ready_transaction returns ready kvstxn");
+
+    ok (kvstxn_process (kt, newroot, 0) == KVSTXN_PROCESS_DIRTY_CACHE_ENTRIES,
+        "kvstxn_process returns KVSTXN_PROCESS_DIRTY_CACHE_ENTRIES");
+
+    ok (kvstxn_iter_dirty_cache_entries (kt, cache_count_dirty_cb, &count) == 0,
+        "kvstxn_iter_dirty_cache_entries works for dirty cache entries");
+
+    ok (count == 3,
+        "single key update stored 3 objects");
+
+    ok (kvstxn_process (kt, newroot, 0) == KVSTXN_PROCESS_FINISHED,
+        "kvstxn_process returns KVSTXN_PROCESS_FINISHED");
+
+    strcpy (newroot, kvstxn_get_newroot_ref (kt));
+    kvstxn_mgr_remove_transaction (ktm, kt, false);
+
+    verify_value (cache, krm, KVS_PRIMARY_NAMESPACE, newroot, "dir.key42", "foo");
+    verify_value (cache, krm, KVS_PRIMARY_NAMESPACE, newroot, "dir.key43", "43");
+
+    create_ready_kvstxn (ktm, "transaction3", "dir.key43", NULL, 0, 0);
+
+    ok ((kt = kvstxn_mgr_get_ready_transaction (ktm)) != NULL,
+        "kvstxn_mgr_get_ready_transaction returns ready kvstxn");
+
+    ok (kvstxn_process (kt, newroot, 0) == KVSTXN_PROCESS_DIRTY_CACHE_ENTRIES,
+        "kvstxn_process returns KVSTXN_PROCESS_DIRTY_CACHE_ENTRIES");
+
+    ok (kvstxn_iter_dirty_cache_entries (kt, cache_noop_cb, NULL) == 0,
+        "kvstxn_iter_dirty_cache_entries works for dirty cache entries");
+
+    ok (kvstxn_process (kt, newroot, 0) == KVSTXN_PROCESS_FINISHED,
+        "kvstxn_process returns KVSTXN_PROCESS_FINISHED");
+
+    strcpy (newroot, kvstxn_get_newroot_ref (kt));
+    kvstxn_mgr_remove_transaction (ktm, kt, false);
+
+    verify_value (cache, krm, KVS_PRIMARY_NAMESPACE, newroot, "dir.key43", NULL);
+    verify_value (cache, krm, KVS_PRIMARY_NAMESPACE, newroot, "dir.key44", "44");
+
+    kvstxn_mgr_destroy (ktm);
+    kvsroot_mgr_destroy (krm);
+    cache_destroy (cache);
+}
+
+void kvstxn_process_binary_treeobj (void)
+{
+    struct cache *cache;
+    struct cache_entry *entry;
+    kvsroot_mgr_t *krm;
+    kvstxn_mgr_t *ktm;
+    kvstxn_t *kt;
+    char rootref[BLOBREF_MAX_STRING_SIZE];
+    char newroot[BLOBREF_MAX_STRING_SIZE];
+    const void *data;
+    int len;
+
+    cache = create_cache_with_empty_rootdir (rootref, sizeof (rootref));
+
+    ok ((krm = kvsroot_mgr_create (NULL, NULL)) != NULL,
+        "kvsroot_mgr_create works");
+
+    setup_kvsroot (krm, KVS_PRIMARY_NAMESPACE, cache, rootref);
+
+    ok ((ktm = kvstxn_mgr_create (cache,
+                                  KVS_PRIMARY_NAMESPACE,
+                                  "sha1",
+                                  NULL,
+                                  &test_global)) != NULL,
+        "kvstxn_mgr_create works");
+
+    kvstxn_mgr_set_binary_treeobj (ktm, true);
+
+    create_ready_kvstxn (ktm, "transaction1", "a.b.c", "42", 0, 0);
+
+    ok ((kt = kvstxn_mgr_get_ready_transaction (ktm)) != NULL,
+        "kvstxn_mgr_get_ready_transaction returns ready kvstxn");
+
+    ok (kvstxn_process (kt, rootref, 0) == KVSTXN_PROCESS_DIRTY_CACHE_ENTRIES,
+        "kvstxn_process returns KVSTXN_PROCESS_DIRTY_CACHE_ENTRIES");
+
+    ok (kvstxn_iter_dirty_cache_entries (kt, cache_noop_cb, NULL) == 0,
+        "kvstxn_iter_dirty_cache_entries works for dirty cache entries");
+
+    ok (kvstxn_process (kt, rootref, 0) == KVSTXN_PROCESS_FINISHED,
+        "kvstxn_process returns KVSTXN_PROCESS_FINISHED");
+
+    strcpy (newroot, kvstxn_get_newroot_ref (kt));
+    kvstxn_mgr_remove_transaction (ktm, kt, false);
+
+    ok ((entry = cache_lookup (cache, newroot)) != NULL
+        && cache_entry_get_raw (entry, &data, &len) == 0
+        && treeobj_is_binary (data, len),
+        "new root directory was stored in binary encoding");
+
+    verify_value (cache, krm, KVS_PRIMARY_NAMESPACE, newroot, "a.b.c", "42");
+
+    /* binary and json encodings can be mixed in the same tree
+     */
+    kvstxn_mgr_set_binary_treeobj (ktm, false);
+
+    create_ready_kvstxn (ktm, "transaction2", "a.b.d", "43", 0, 0);
+
+    ok ((kt = kvstxn_mgr_get_ready_transaction (ktm)) != NULL,
+        "kvstxn_mgr_get_ready_transaction returns ready kvstxn");
+
+    ok (kvstxn_process (kt, newroot, 0) == KVSTXN_PROCESS_DIRTY_CACHE_ENTRIES,
+        "kvstxn_process returns KVSTXN_PROCESS_DIRTY_CACHE_ENTRIES");
+
+    ok (kvstxn_iter_dirty_cache_entries (kt, cache_noop_cb, NULL) == 0,
+        "kvstxn_iter_dirty_cache_entries works for dirty cache entries");
+
+    ok (kvstxn_process (kt, newroot, 0) == KVSTXN_PROCESS_FINISHED,
+        "kvstxn_process returns KVSTXN_PROCESS_FINISHED");
+
+    strcpy (newroot, kvstxn_get_newroot_ref (kt));
+    kvstxn_mgr_remove_transaction (ktm, kt, false);
+
+    ok ((entry = cache_lookup (cache, newroot)) != NULL
+        && cache_entry_get_raw (entry, &data, &len) == 0
+        && !treeobj_is_binary (data, len),
+        "new root directory was stored in json encoding");
+
+    verify_value (cache, krm, KVS_PRIMARY_NAMESPACE, newroot, "a.b.c", "42");
+    verify_value (cache, krm, KVS_PRIMARY_NAMESPACE, newroot, "a.b.d", "43");
+
+    kvstxn_mgr_destroy (ktm);
+    kvsroot_mgr_destroy (krm);
+    cache_destroy (cache);
+}
+
+struct process_thread {
+    pthread_t t;
+    pthread_mutex_t *lock;
+    kvstxn_t *kt;
+    const char *rootref;
+    kvstxn_process_t ret;
+};
+
+static void *process_thread (void *arg)
+{
+    struct process_thread *pt = arg;
+
+    pthread_mutex_lock (pt->lock);
+    pt->ret = kvstxn_process (pt->kt, pt->rootref, 0);
+    pthread_mutex_unlock (pt->lock);
+    return NULL;
+}
+
+void kvstxn_process_concurrent (void)
+{
+    struct cache *cache;
+    kvsroot_mgr_t *krm;
+    kvstxn_mgr_t *ktm[4];
+    struct process_thread pt[4];
+    pthread_mutex_t lock;
+    char rootref[BLOBREF_MAX_STRING_SIZE];
+    char newroot[4][BLOBREF_MAX_STRING_SIZE];
+    char ns[64];
+    char key[64];
+    char val[64];
+    json_t *ops;
+    int errors;
+    int i, j;
+
+    cache = create_cache_with_empty_rootdir (rootref, sizeof (rootref));
+
+    ok ((krm = kvsroot_mgr_create (NULL, NULL)) != NULL,
+        "kvsroot_mgr_create works");
+
+    pthread_mutex_init (&lock, NULL);
+
+    /* Identical transactions in four namespaces share the cache and
+     * generate identical objects, so concurrent stores race to
+     * create the same cache entries.
+     */
+    for (i = 0; i < 4; i++) {
+        snprintf (ns, sizeof (ns), "ns%d", i);
+        setup_kvsroot (krm, ns, cache, rootref);
+        if (!(ktm[i] = kvstxn_mgr_create (cache, ns, "sha1", NULL,
+                                          &test_global)))
+            BAIL_OUT ("kvstxn_mgr_create failed");
+        kvstxn_mgr_set_lock (ktm[i], &lock);
+        ops = json_array ();
+        for (j = 0; j < 200; j++) {
+            snprintf (key, sizeof (key), "dir%d.key%d", j % 4, j);
+            snprintf (val, sizeof (val), "%d", j);
+            ops_append (ops, key, val, 0);
+        }
+        if (kvstxn_mgr_add_transaction (ktm[i], "transaction", ops, 0, 0) < 0)
+            BAIL_OUT ("kvstxn_mgr_add_transaction failed");
+        json_decref (ops);
+        if (!(pt[i].kt = kvstxn_mgr_get_ready_transaction (ktm[i])))
+            BAIL_OUT ("kvstxn_mgr_get_ready_transaction failed");
+        pt[i].lock = &lock;
+        pt[i].rootref = rootref;
+    }
+
+    errors = 0;
+    for (i = 0; i < 4; i++) {
+        if (pthread_create (&pt[i].t, NULL, process_thread, &pt[i]) != 0)
+            BAIL_OUT ("pthread_create failed");
+    }
+    for (i = 0; i < 4; i++) {
+        pthread_join (pt[i].t, NULL);
+        /* objects may have been stored by another thread already */
+        if (pt[i].ret != KVSTXN_PROCESS_DIRTY_CACHE_ENTRIES
+            && pt[i].ret != KVSTXN_PROCESS_FINISHED)
+            errors++;
+    }
+    ok (errors == 0,
+        "concurrent kvstxn_process works");
+
+    pthread_mutex_lock (&lock);
+    for (i = 0; i < 4; i++) {
+        if (pt[i].ret == KVSTXN_PROCESS_DIRTY_CACHE_ENTRIES) {
+            if (kvstxn_iter_dirty_cache_entries (pt[i].kt,
+                                                 cache_noop_cb,
+                                                 NULL) < 0)
+                BAIL_OUT ("kvstxn_iter_dirty_cache_entries failed");
+        }
+        ok (kvstxn_process (pt[i].kt, rootref, 0) == KVSTXN_PROCESS_FINISHED,
+            "kvstxn_process returns KVSTXN_PROCESS_FINISHED");
+        strcpy (newroot[i], kvstxn_get_newroot_ref (pt[i].kt));
+        kvstxn_mgr_remove_transaction (ktm[i], pt[i].kt, false);
+    }
+    pthread_mutex_unlock (&lock);
+
+    errors = 0;
+    for (i = 1; i < 4; i++) {
+        if (strcmp (newroot[0], newroot[i]) != 0)
+            errors++;
+    }
+    ok (errors == 0,
+        "identical transactions produced identical root references");
+
+    verify_value (cache, krm, "ns0", newroot[0], "dir0.key0", "0");
+    verify_value (cache, krm, "ns3", newroot[3], "dir3.key199", "199");
+
+    for (i = 0; i < 4; i++)
+        kvstxn_mgr_destroy (ktm[i]);
+    pthread_mutex_destroy (&lock);
+    kvsroot_mgr_destroy (krm);
+    cache_destroy (cache);
+}
+
 void kvstxn_process_append (void)
 {
     struct cache *cache;
@@ -3566,6 +3943,9 @@ int main (int argc, char *argv[])
     kvstxn_process_bad_dirrefs ();
     kvstxn_process_big_fileval ();
     kvstxn_process_giant_dir ();
+    kvstxn_process_sharded_dir ();
+    kvstxn_process_binary_treeobj ();
+    kvstxn_process_concurrent ();
     kvstxn_process_append ();
     kvstxn_process_append_errors ();
     kvstxn_process_append_no_duplicate ();
@@ -310,6 +310,8 @@ void basic_api_errors (void)
         "lookup_get_value fails b/c lookup not yet started");
     ok (lookup_iter_missing_refs (lh, lookup_ref, NULL) < 0,
         "lookup_iter_missing_refs fails b/c lookup not yet started");
+    ok (lookup_want_prefetch (lh) == false,
+        "lookup_want_prefetch returns false b/c lookup not yet started");
 
     ok (lookup (NULL) == LOOKUP_PROCESS_ERROR,
         "lookup does not segfault on NULL pointer");
@@ -319,6 +321,8 @@ void basic_api_errors (void)
         "lookup_get_value fails on NULL pointer");
     ok (lookup_iter_missing_refs (NULL, lookup_ref, NULL) < 0,
         "lookup_iter_missing_refs fails on NULL pointer");
+    ok (lookup_want_prefetch (NULL) == false,
+        "lookup_want_prefetch returns false on NULL pointer");
     ok (lookup_missing_namespace (NULL) == NULL,
         "lookup_missing_namespace fails on NULL pointer");
     ok (lookup_get_namespace (NULL) == NULL,
@@ -2824,6 +2828,100 @@ void lookup_stall_ref (void) {
     json_decref (root);
 }
 
+/* lookup_want_prefetch() is true only for FLUX_KVS_PREFETCH lookups
+ * stalled on directories.
+ */
+void lookup_stall_prefetch (void) {
+    json_t *root;
+    json_t *dirref;
+    json_t *test;
+    struct cache *cache;
+    kvsroot_mgr_t *krm;
+    lookup_t *lh;
+    char valref_ref[BLOBREF_MAX_STRING_SIZE];
+    char dirref_ref[BLOBREF_MAX_STRING_SIZE];
+    char root_ref[BLOBREF_MAX_STRING_SIZE];
+
+    ltest_init (&cache, &krm);
+
+    /* This cache is
+     *
+     * valref_ref
+     * "abcd"
+     *
+     * dirref_ref
+     * "valref" : valref to valref_ref
+     *
+     * root_ref
+     * "dirref" : dirref to dirref_ref
+     */
+
+    blobref_hash ("sha1", "abcd", 4, valref_ref, sizeof (valref_ref));
+
+    dirref = treeobj_create_dir ();
+    _treeobj_insert_entry_valref (dirref, "valref", valref_ref);
+    treeobj_hash ("sha1", dirref, dirref_ref, sizeof (dirref_ref));
+
+    root = treeobj_create_dir ();
+    _treeobj_insert_entry_dirref (root, "dirref", dirref_ref);
+    treeobj_hash ("sha1", root, root_ref, sizeof (root_ref));
+
+    setup_kvsroot (krm, KVS_PRIMARY_NAMESPACE, cache, root_ref, 0);
+
+    /* lookup dirref.valref without prefetch */
+    ok ((lh = lookup_create (cache,
+                             krm,
+                             KVS_PRIMARY_NAMESPACE,
+                             NULL,
+                             0,
+                             "dirref.valref",
+                             owner_cred,
+                             0,
+                             NULL)) != NULL,
+        "lookup_create dirref.valref");
+    check_stall (lh, EAGAIN, 1, root_ref, "dirref.valref stall");
+    ok (lookup_want_prefetch (lh) == false,
+        "lookup_want_prefetch returns false without FLUX_KVS_PREFETCH");
+    lookup_destroy (lh);
+
+    /* lookup dirref.valref with prefetch, stalls on root, dirref, valref */
+    ok ((lh = lookup_create (cache,
+                             krm,
+                             KVS_PRIMARY_NAMESPACE,
+                             NULL,
+                             0,
+                             "dirref.valref",
+                             owner_cred,
+                             FLUX_KVS_PREFETCH,
+                             NULL)) != NULL,
+        "lookup_create prefetch dirref.valref");
+    check_stall (lh, EAGAIN, 1, root_ref, "prefetch dirref.valref stall #1");
+    ok (lookup_want_prefetch (lh) == true,
+        "lookup_want_prefetch returns true on root stall");
+
+    (void)cache_insert (cache, create_cache_entry_treeobj (root_ref, root));
+
+    check_stall (lh, EAGAIN, 1, dirref_ref, "prefetch dirref.valref stall #2");
+    ok (lookup_want_prefetch (lh) == true,
+        "lookup_want_prefetch returns true on dirref stall");
+
+    (void)cache_insert (cache, create_cache_entry_treeobj (dirref_ref, dirref));
+
+    check_stall (lh, EAGAIN, 1, valref_ref, "prefetch dirref.valref stall #3");
+    ok (lookup_want_prefetch (lh) == false,
+        "lookup_want_prefetch returns false on valref stall");
+
+    (void)cache_insert (cache, create_cache_entry_raw (valref_ref, "abcd", 4));
+
+    test = treeobj_create_val ("abcd", 4);
+    check_value (lh, test, "prefetch dirref.valref");
+    json_decref (test);
+
+    ltest_finalize (cache, krm);
+    json_decref (dirref);
+    json_decref (root);
+}
+
 void lookup_stall_namespace_removed (void) {
     json_t *root;
     json_t *valref;
@@ -3341,6 +3439,7 @@ int main (int argc, char *argv[])
     lookup_stall_namespace ();
     lookup_stall_ref_root ();
     lookup_stall_ref ();
+    lookup_stall_prefetch ();
     lookup_stall_namespace_removed ();
     lookup_stall_ref_expire_cache_entries ();
 
@@ -0,0 +1,123 @@
+/************************************************************\
+ * Copyright 2024 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdbool.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "src/common/libtap/tap.h"
+#include "src/modules/kvs/workpool.h"
+
+#define NJOBS 1000
+
+struct job {
+    int calls;
+    pthread_t thread;
+};
+
+static void job_cb (void *arg)
+{
+    struct job *job = arg;
+    job->calls++;
+    job->thread = pthread_self ();
+}
+
+void basic_corner_case_tests (void)
+{
+    struct workpool *wp;
+    void *args[1] = { NULL };
+
+    errno = 0;
+    ok (workpool_create (0) == NULL && errno == EINVAL,
+        "workpool_create nthreads=0 fails with EINVAL");
+    ok (workpool_get_nthreads (NULL) == 0,
+        "workpool_get_nthreads returns 0 on NULL pool");
+
+    if (!(wp = workpool_create (1)))
+        BAIL_OUT ("workpool_create failed");
+    errno = 0;
+    ok (workpool_run (NULL, job_cb, args, 1) < 0 && errno == EINVAL,
+        "workpool_run fails with EINVAL on NULL pool");
+    errno = 0;
+    ok (workpool_run (wp, NULL, args, 1) < 0 && errno == EINVAL,
+        "workpool_run fails with EINVAL on NULL fn");
+    errno = 0;
+    ok (workpool_run (wp, job_cb, NULL, 1) < 0 && errno == EINVAL,
+        "workpool_run fails with EINVAL on NULL args");
+    ok (workpool_run (wp, job_cb, NULL, 0) == 0,
+        "workpool_run works with empty batch");
+    workpool_destroy (wp);
+
+    workpool_destroy (NULL);
+}
+
+void run_batches (int nthreads)
+{
+    struct workpool *wp;
+    struct job jobs[NJOBS];
+    void *args[NJOBS];
+    int batch;
+    int i;
+
+    ok ((wp = workpool_create (nthreads)) != NULL,
+        "workpool_create nthreads=%d works", nthreads);
+    if (!wp)
+        BAIL_OUT ("workpool_create failed");
+    ok (workpool_get_nthreads (wp) == nthreads,
+        "workpool_get_nthreads returns %d", nthreads);
+
+    for (batch = 0; batch < 3; batch++) {
+        int errors = 0;
+
+        for (i = 0; i < NJOBS; i++) {
+            jobs[i].calls = 0;
+            args[i] = &jobs[i];
+        }
+        ok (workpool_run (wp, job_cb, args, NJOBS) == 0,
+            "workpool_run batch %d of %d jobs works", batch, NJOBS);
+        for (i = 0; i < NJOBS; i++) {
+            if (jobs[i].calls != 1)
+                errors++;
+        }
+        ok (errors == 0,
+            "each job was called exactly once");
+    }
+    if (nthreads == 1) {
+        int errors = 0;
+        for (i = 0; i < NJOBS; i++) {
+            if (!pthread_equal (jobs[i].thread, pthread_self ()))
+                errors++;
+        }
+        ok (errors == 0,
+            "nthreads=1 runs all jobs in the calling thread");
+    }
+    workpool_destroy (wp);
+}
+
+int main (int argc, char *argv[])
+{
+    plan (NO_PLAN);
+
+    basic_corner_case_tests ();
+    run_batches (1);
+    run_batches (2);
+    run_batches (8);
+
+    done_testing ();
+    return (0);
+}
+
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */
@@ -0,0 +1,169 @@
+/************************************************************\
+ * Copyright 2024 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdlib.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <signal.h>
+
+#include "workpool.h"
+
+struct workpool {
+    pthread_mutex_t lock;
+    pthread_cond_t cond_work;   /* signaled when a batch is posted */
+    pthread_cond_t cond_done;   /* signaled when last job completes */
+    pthread_t *threads;
+    int nthreads;               /* includes calling thread */
+    int started;                /* number of helper threads started */
+    bool shutdown;
+
+    /* current batch, protected by 'lock' */
+    workpool_f fn;
+    void **args;
+    int count;
+    int next;
+    int active;
+};
+
+/* Run jobs from the current batch until none remain.
+ * Called with wp->lock held.
+ */
+static void run_jobs (struct workpool *wp)
+{
+    while (wp->next < wp->count) {
+        int i = wp->next++;
+        wp->active++;
+        pthread_mutex_unlock (&wp->lock);
+        wp->fn (wp->args[i]);
+        pthread_mutex_lock (&wp->lock);
+        wp->active--;
+    }
+    if (wp->active == 0)
+        pthread_cond_signal (&wp->cond_done);
+}
+
+static void *worker (void *arg)
+{
+    struct workpool *wp = arg;
+
+    pthread_mutex_lock (&wp->lock);
+    while (!wp->shutdown) {
+        if (wp->next < wp->count)
+            run_jobs (wp);
+        else
+            pthread_cond_wait (&wp->cond_work, &wp->lock);
+    }
+    pthread_mutex_unlock (&wp->lock);
+    return NULL;
+}
+
+void workpool_destroy (struct workpool *wp)
+{
+    if (wp) {
+        int saved_errno = errno;
+        int i;
+
+        pthread_mutex_lock (&wp->lock);
+        wp->shutdown = true;
+        pthread_cond_broadcast (&wp->cond_work);
+        pthread_mutex_unlock (&wp->lock);
+        for (i = 0; i < wp->started; i++)
+            pthread_join (wp->threads[i], NULL);
+        pthread_cond_destroy (&wp->cond_done);
+        pthread_cond_destroy (&wp->cond_work);
+        pthread_mutex_destroy (&wp->lock);
+        free (wp->threads);
+        free (wp);
+        errno = saved_errno;
+    }
+}
+
+struct workpool *workpool_create (int nthreads)
+{
+    struct workpool *wp;
+    sigset_t sigs, oldsigs;
+    int e;
+
+    if (nthreads < 1) {
+        errno = EINVAL;
+        return NULL;
+    }
+    if (!(wp = calloc (1, sizeof (*wp))))
+        return NULL;
+    wp->nthreads = nthreads;
+    pthread_mutex_init (&wp->lock, NULL);
+    pthread_cond_init (&wp->cond_work, NULL);
+    pthread_cond_init (&wp->cond_done, NULL);
+    if (nthreads > 1) {
+        if (!(wp->threads = calloc (nthreads - 1, sizeof (wp->threads[0]))))
+            goto error;
+        /* helper threads should not receive signals */
+        sigfillset (&sigs);
+        pthread_sigmask (SIG_SETMASK, &sigs, &oldsigs);
+        while (wp->started < nthreads - 1) {
+            if ((e = pthread_create (&wp->threads[wp->started],
+                                     NULL,
+                                     worker,
+                                     wp))) {
+                pthread_sigmask (SIG_SETMASK, &oldsigs, NULL);
+                errno = e;
+                goto error;
+            }
+            wp->started++;
+        }
+        pthread_sigmask (SIG_SETMASK, &oldsigs, NULL);
+    }
+    return wp;
+error:
+    workpool_destroy (wp);
+    return NULL;
+}
+
+int workpool_get_nthreads (struct workpool *wp)
+{
+    return wp ? wp->nthreads : 0;
+}
+
+int workpool_run (struct workpool *wp, workpool_f fn, void **args, int count)
+{
+    if (!wp || !fn || count < 0 || (count > 0 && !args)) {
+        errno = EINVAL;
+        return -1;
+    }
+    pthread_mutex_lock (&wp->lock);
+    if (wp->count > 0) {
+        pthread_mutex_unlock (&wp->lock);
+        errno = EBUSY;
+        return -1;
+    }
+    wp->fn = fn;
+    wp->args = args;
+    wp->count = count;
+    wp->next = 0;
+    if (count > 1)
+        pthread_cond_broadcast (&wp->cond_work);
+    run_jobs (wp);
+    while (wp->active > 0)
+        pthread_cond_wait (&wp->cond_done, &wp->lock);
+    wp->fn = NULL;
+    wp->args = NULL;
+    wp->count = 0;
+    wp->next = 0;
+    pthread_mutex_unlock (&wp->lock);
+    return 0;
+}
+
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */
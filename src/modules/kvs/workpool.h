@@ -0,0 +1,39 @@
+/************************************************************\
+ * Copyright 2024 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+#ifndef _FLUX_KVS_WORKPOOL_H
+#define _FLUX_KVS_WORKPOOL_H
+
+/* A small fixed size pool of threads for running a batch of independent
+ * jobs concurrently.  The calling thread participates in the batch, so
+ * a pool of 'nthreads' runs at most 'nthreads' jobs at once using
+ * nthreads - 1 helper threads.
+ */
+
+struct workpool;
+
+typedef void (*workpool_f)(void *arg);
+
+struct workpool *workpool_create (int nthreads);
+void workpool_destroy (struct workpool *wp);
+
+int workpool_get_nthreads (struct workpool *wp);
+
+/* Call fn (args[i]) for each of 'count' args, and return once all calls
+ * have completed.  Calls may be made from any thread in the pool,
+ * in any order.  workpool_run() may not be called recursively.
+ */
+int workpool_run (struct workpool *wp, workpool_f fn, void **args, int count);
+
+#endif /* !_FLUX_KVS_WORKPOOL_H */
+
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */
@@ -91,6 +91,33 @@ static flux_future_t *lookup_job_info (flux_t *h,
     return f;
 }
 
+/* Fetch jobspec and R from 'service' on the local broker, which may have
+ * received them with the launch request.  Return future on success, or NULL
+ * on failure (and log at debug level) so that the caller may fall back to
+ * the job-info service.
+ */
+static flux_future_t *lookup_job_info_local (flux_t *h,
+                                             const char *service,
+                                             flux_jobid_t jobid)
+{
+    flux_future_t *f;
+
+    if (!(f = flux_rpc_pack (h,
+                             service,
+                             FLUX_NODEID_ANY,
+                             0,
+                             "{s:I}",
+                             "id", jobid))
+        || flux_rpc_get (f, NULL) < 0) {
+        shell_debug ("%s: %s, falling back to job-info",
+                     service,
+                     future_strerror (f, errno));
+        flux_future_destroy (f);
+        return NULL;
+    }
+    return f;
+}
+
 /* Read content of file 'optarg' and return it or NULL on failure (log error).
  * Caller must free returned result.
  */
@@ -142,6 +169,7 @@ static int shell_init_jobinfo (flux_shell_t *shell,
     flux_future_t *f_info = NULL;
     flux_future_t *f_hwloc = NULL;
     const char *xml;
+    const char *service;
     json_error_t error;
 
     /*  If shell is not running standlone, fetch hwloc topology
@@ -158,12 +186,21 @@ static int shell_init_jobinfo (flux_shell_t *shell,
         goto out;
 
     if (!R || !jobspec) {
-        /* Fetch missing jobinfo from broker job-info service */
+        /* Fetch missing jobinfo from the local service given with
+         *  --jobinfo-service, if any, or else the job-info service.
+         */
         if (shell->standalone) {
             shell_log_error ("Invalid arguments: standalone and R/jobspec are unset");
             goto out;
         }
-        if (!(f_info = lookup_job_info (shell->h, shell->jobid, jobspec, R)))
+        service = optparse_get_str (shell->p, "jobinfo-service", NULL);
+        if (service)
+            f_info = lookup_job_info_local (shell->h, service, shell->jobid);
+        if (!f_info
+            && !(f_info = lookup_job_info (shell->h,
+                                           shell->jobid,
+                                           jobspec,
+                                           R)))
             goto out;
     }
 
@@ -70,6 +70,7 @@
 #include "internal.h"
 #include "task.h"
 #include "pmi_exchange.h"
+#include "pmi_sparse.h"
 
 struct shell_pmi {
     flux_shell_t *shell;
@@ -78,6 +79,7 @@ struct shell_pmi {
     json_t *pending;// pending to be exchanged
     json_t *locals;  // never exchanged
     struct pmi_exchange *exchange;
+    struct pmi_sparse *sparse;
 };
 
 /* pmi_simple_ops->abort() signature */
@@ -325,6 +327,75 @@ static int exchange_kvs_put (void *arg,
     return put_dict (pmi->pending, key, val);
 }
 
+/**
+ ** ops for using sparse distributed dict for PMI KVS
+ ** This is used if pmi.kvs=sparse option is provided.
+ **/
+
+static void sparse_fence_cb (struct pmi_sparse *ps, int rc, void *arg)
+{
+    struct shell_pmi *pmi = arg;
+
+    if (rc < 0)
+        shell_warn ("sparse fence failed");
+    else
+        json_object_clear (pmi->pending);
+    pmi_simple_server_barrier_complete (pmi->server, rc);
+}
+
+/* pmi_sparse_lookup_f signature */
+static void sparse_lookup_cb (struct pmi_sparse *ps,
+                              void *cli,
+                              const char *val,
+                              void *arg)
+{
+    struct shell_pmi *pmi = arg;
+
+    pmi_simple_server_kvs_get_complete (pmi->server, cli, val);
+}
+
+/* pmi_simple_ops->kvs_get() signature */
+static int sparse_kvs_get (void *arg,
+                           void *cli,
+                           const char *kvsname,
+                           const char *key)
+{
+    struct shell_pmi *pmi = arg;
+    json_t *o;
+    const char *val = NULL;
+
+    if ((o = json_object_get (pmi->locals, key))
+            || (o = json_object_get (pmi->pending, key))) {
+        val = json_string_value (o);
+        pmi_simple_server_kvs_get_complete (pmi->server, cli, val);
+        return 0;
+    }
+    if (pmi->shell->info->shell_size > 1) {
+        if (pmi_sparse_lookup (pmi->sparse, key, cli) == 0)
+            return 0; // response may be deferred
+    }
+    return -1; // PMI_ERR_INVALID_KEY
+}
+
+/* pmi_simple_ops->barrier_enter() signature */
+static int sparse_barrier_enter (void *arg)
+{
+    struct shell_pmi *pmi = arg;
+
+    if (pmi->shell->info->shell_size == 1) {
+        pmi_simple_server_barrier_complete (pmi->server, 0);
+        return 0;
+    }
+    if (pmi_sparse_fence (pmi->sparse,
+                          pmi->pending,
+                          sparse_fence_cb,
+                          pmi) < 0) {
+        shell_warn ("pmi_sparse_fence %s", flux_strerror (errno));
+        return -1; // PMI_FAIL
+    }
+    return 0;
+}
+
 /**
  ** end of KVS implementations
  **/
@@ -537,6 +608,7 @@ static void pmi_destroy (struct shell_pmi *pmi)
         int saved_errno = errno;
         pmi_simple_server_destroy (pmi->server);
         pmi_exchange_destroy (pmi->exchange);
+        pmi_sparse_destroy (pmi->sparse);
         json_decref (pmi->global);
         json_decref (pmi->pending);
         json_decref (pmi->locals);
@@ -599,6 +671,18 @@ static struct shell_pmi *pmi_create (flux_shell_t *shell)
         if (!(pmi->exchange = pmi_exchange_create (shell, exchange_k)))
             goto error;
     }
+    else if (!strcmp (kvs, "sparse")) {
+        shell_pmi_ops.kvs_put = exchange_kvs_put;
+        shell_pmi_ops.kvs_get = sparse_kvs_get;
+        shell_pmi_ops.barrier_enter = sparse_barrier_enter;
+        if (!(pmi->sparse = pmi_sparse_create (shell,
+                                               exchange_k,
+                                               sparse_lookup_cb,
+                                               pmi)))
+            goto error;
+        if (shell->info->shell_rank == 0)
+            shell_warn ("using sparse kvs implementation");
+    }
     else {
         shell_log_error ("Unknown kvs implementation %s", kvs);
         errno = EINVAL;
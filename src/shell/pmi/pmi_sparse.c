@@ -0,0 +1,416 @@
+/************************************************************\
+ * Copyright 2024 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+/* pmi_sparse.c - distribute key-value dict across shells
+ *
+ * Unlike pmi_exchange.c, no shell holds the full dictionary.  Each key
+ * is owned by the shell rank selected by hashing the key.  At a fence,
+ * each shell sends one pmi-kvs-put request to each owner of keys it
+ * has put since the last fence, then enters a data-free barrier (a
+ * pmi_exchange of an empty dict) once all of its puts are acknowledged.
+ * When the barrier completes, every key published before the fence
+ * is stored at its owner.
+ *
+ * Lookups are resolved locally if the key was put by this shell, is
+ * owned by this shell, or was fetched earlier.  Otherwise a pmi-kvs-get
+ * request is sent to the owner.  Concurrent lookups of the same key
+ * (e.g. by several local tasks) wait on one request.
+ *
+ * Memory per shell is proportional to the keys it puts, owns, and reads,
+ * rather than to the total number of keys in the job.
+ */
+#define FLUX_SHELL_PLUGIN_NAME "pmi"
+
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdlib.h>
+#include <stdint.h>
+#include <jansson.h>
+#include <flux/core.h>
+#include <flux/shell.h>
+
+#include "src/common/libczmqcontainers/czmq_containers.h"
+
+#include "info.h"
+#include "internal.h"
+
+#include "pmi_exchange.h"
+#include "pmi_sparse.h"
+
+struct lookup {
+    struct pmi_sparse *ps;
+    char *key;
+    zlist_t *clients;           // clients waiting on this lookup
+    flux_future_t *f;           // pending request to key owner
+};
+
+struct pmi_sparse {
+    flux_shell_t *shell;
+    int size;
+    int rank;
+
+    json_t *store;              // keys owned by this shell
+    json_t *cache;              // keys put or fetched by this shell
+    zhashx_t *lookups;          // key => struct lookup, for pending lookups
+    pmi_sparse_lookup_f lookup_cb;
+    void *lookup_arg;
+
+    struct pmi_exchange *barrier;
+    json_t *empty;              // empty dict for barrier
+    zlist_t *puts;              // pending pmi-kvs-put requests
+    pmi_sparse_fence_f fence_cb;
+    void *fence_arg;
+    unsigned int fence_active:1;
+    unsigned int fence_error:1;
+};
+
+/* FNV-1a hash of key, used to select owner shell rank.
+ */
+static int key_owner (struct pmi_sparse *ps, const char *key)
+{
+    uint32_t hash = 2166136261U;
+
+    while (*key) {
+        hash ^= (unsigned char)*key++;
+        hash *= 16777619U;
+    }
+    return hash % ps->size;
+}
+
+static void fence_finish (struct pmi_sparse *ps, int rc)
+{
+    ps->fence_active = 0;
+    ps->fence_error = 0;
+    ps->fence_cb (ps, rc, ps->fence_arg);
+}
+
+static void barrier_cb (struct pmi_exchange *pex, void *arg)
+{
+    struct pmi_sparse *ps = arg;
+    int rc = 0;
+
+    if (pmi_exchange_has_error (pex) || ps->fence_error)
+        rc = -1;
+    fence_finish (ps, rc);
+}
+
+/* All puts from this shell are stored at their owners (or failed).
+ * Enter the barrier even on error so that other shells are not left hanging.
+ */
+static void fence_barrier (struct pmi_sparse *ps)
+{
+    if (pmi_exchange (ps->barrier, ps->empty, barrier_cb, ps) < 0) {
+        shell_warn ("pmi-kvs fence barrier: %s", flux_strerror (errno));
+        fence_finish (ps, -1);
+    }
+}
+
+static void put_continuation (flux_future_t *f, void *arg)
+{
+    struct pmi_sparse *ps = arg;
+
+    if (flux_future_get (f, NULL) < 0) {
+        shell_warn ("pmi-kvs-put request: %s", future_strerror (f, errno));
+        ps->fence_error = 1;
+    }
+    zlist_remove (ps->puts, f);
+    flux_future_destroy (f);
+    if (zlist_size (ps->puts) == 0)
+        fence_barrier (ps);
+}
+
+static int put_send (struct pmi_sparse *ps, int owner, json_t *dict)
+{
+    flux_future_t *f;
+
+    if (!(f = flux_shell_rpc_pack (ps->shell, "pmi-kvs-put", owner, 0,
+                                   "O", dict))
+        || flux_future_then (f, -1, put_continuation, ps) < 0
+        || zlist_append (ps->puts, f) < 0) {
+        flux_future_destroy (f);
+        return -1;
+    }
+    return 0;
+}
+
+int pmi_sparse_fence (struct pmi_sparse *ps,
+                      json_t *dict,
+                      pmi_sparse_fence_f cb,
+                      void *arg)
+{
+    json_t *batches;
+    json_t *batch;
+    const char *key;
+    json_t *val;
+    char owner_key[16];
+
+    if (ps->fence_active) {
+        errno = EINPROGRESS;
+        return -1;
+    }
+    if (!(batches = json_object ()))
+        goto nomem;
+
+    /* Sort keys by owner, storing our own keys directly.
+     */
+    json_object_foreach (dict, key, val) {
+        int owner = key_owner (ps, key);
+
+        if (json_object_set (ps->cache, key, val) < 0)
+            goto nomem;
+        if (owner == ps->rank) {
+            if (json_object_set (ps->store, key, val) < 0)
+                goto nomem;
+            continue;
+        }
+        snprintf (owner_key, sizeof (owner_key), "%d", owner);
+        if (!(batch = json_object_get (batches, owner_key))) {
+            if (!(batch = json_object ())
+                || json_object_set_new (batches, owner_key, batch) < 0) {
+                json_decref (batch);
+                goto nomem;
+            }
+        }
+        if (json_object_set (batch, key, val) < 0)
+            goto nomem;
+    }
+
+    ps->fence_cb = cb;
+    ps->fence_arg = arg;
+    ps->fence_active = 1;
+
+    json_object_foreach (batches, key, batch) {
+        if (put_send (ps, strtol (key, NULL, 10), batch) < 0) {
+            shell_warn ("error sending pmi-kvs-put request");
+            ps->fence_error = 1;
+        }
+    }
+    json_decref (batches);
+    if (zlist_size (ps->puts) == 0)
+        fence_barrier (ps);
+    return 0;
+nomem:
+    json_decref (batches);
+    errno = ENOMEM;
+    return -1;
+}
+
+/* PMI implementation on another shell is publishing keys that we own.
+ */
+static void put_request_cb (flux_t *h,
+                            flux_msg_handler_t *mh,
+                            const flux_msg_t *msg,
+                            void *arg)
+{
+    struct pmi_sparse *ps = arg;
+    json_t *dict;
+
+    if (flux_request_unpack (msg, NULL, "o", &dict) < 0)
+        goto error;
+    if (json_object_update (ps->store, dict) < 0) {
+        errno = ENOMEM;
+        goto error;
+    }
+    if (flux_respond (h, msg, NULL) < 0)
+        shell_warn ("error responding to pmi-kvs-put request: %s",
+                    flux_strerror (errno));
+    return;
+error:
+    if (flux_respond_error (h, msg, errno, NULL) < 0)
+        shell_warn ("error responding to pmi-kvs-put request: %s",
+                    flux_strerror (errno));
+}
+
+/* PMI implementation on another shell is looking up a key that we own.
+ */
+static void get_request_cb (flux_t *h,
+                            flux_msg_handler_t *mh,
+                            const flux_msg_t *msg,
+                            void *arg)
+{
+    struct pmi_sparse *ps = arg;
+    const char *key;
+    json_t *o;
+
+    if (flux_request_unpack (msg, NULL, "{s:s}", "key", &key) < 0)
+        goto error;
+    if (!(o = json_object_get (ps->store, key))) {
+        errno = ENOENT;
+        goto error;
+    }
+    if (flux_respond_pack (h, msg, "{s:O}", "value", o) < 0)
+        shell_warn ("error responding to pmi-kvs-get request: %s",
+                    flux_strerror (errno));
+    return;
+error:
+    if (flux_respond_error (h, msg, errno, NULL) < 0)
+        shell_warn ("error responding to pmi-kvs-get request: %s",
+                    flux_strerror (errno));
+}
+
+static void lookup_destroy (struct lookup *l)
+{
+    if (l) {
+        int saved_errno = errno;
+        zlist_destroy (&l->clients);
+        flux_future_destroy (l->f);
+        free (l->key);
+        free (l);
+        errno = saved_errno;
+    }
+}
+
+static void lookup_destructor (void **item)
+{
+    if (item) {
+        lookup_destroy (*item);
+        *item = NULL;
+    }
+}
+
+static void lookup_continuation (flux_future_t *f, void *arg)
+{
+    struct lookup *l = arg;
+    struct pmi_sparse *ps = l->ps;
+    json_t *o;
+    const char *val = NULL;
+    void *cli;
+
+    if (flux_rpc_get_unpack (f, "{s:o}", "value", &o) < 0) {
+        if (errno != ENOENT)
+            shell_warn ("pmi-kvs-get %s: %s",
+                        l->key,
+                        future_strerror (f, errno));
+    }
+    else if (json_object_set (ps->cache, l->key, o) < 0)
+        shell_warn ("pmi-kvs-get %s: error caching value", l->key);
+    else
+        val = json_string_value (o);
+
+    while ((cli = zlist_pop (l->clients)))
+        ps->lookup_cb (ps, cli, val, ps->lookup_arg);
+    zhashx_delete (ps->lookups, l->key);
+}
+
+static struct lookup *lookup_create (struct pmi_sparse *ps, const char *key)
+{
+    struct lookup *l;
+
+    if (!(l = calloc (1, sizeof (*l))))
+        return NULL;
+    l->ps = ps;
+    if (!(l->key = strdup (key))
+        || !(l->clients = zlist_new ()))
+        goto nomem;
+    if (!(l->f = flux_shell_rpc_pack (ps->shell,
+                                      "pmi-kvs-get",
+                                      key_owner (ps, key),
+                                      0,
+                                      "{s:s}",
+                                      "key", key))
+        || flux_future_then (l->f, -1, lookup_continuation, l) < 0)
+        goto error;
+    return l;
+nomem:
+    errno = ENOMEM;
+error:
+    lookup_destroy (l);
+    return NULL;
+}
+
+int pmi_sparse_lookup (struct pmi_sparse *ps, const char *key, void *cli)
+{
+    struct lookup *l;
+    json_t *o;
+
+    if ((o = json_object_get (ps->cache, key))
+        || (o = json_object_get (ps->store, key))) {
+        ps->lookup_cb (ps, cli, json_string_value (o), ps->lookup_arg);
+        return 0;
+    }
+    if (key_owner (ps, key) == ps->rank) {
+        ps->lookup_cb (ps, cli, NULL, ps->lookup_arg);
+        return 0;
+    }
+    if (!(l = zhashx_lookup (ps->lookups, key))) {
+        if (!(l = lookup_create (ps, key)))
+            return -1;
+        (void)zhashx_insert (ps->lookups, key, l);
+    }
+    if (zlist_append (l->clients, cli) < 0) {
+        errno = ENOMEM;
+        return -1;
+    }
+    return 0;
+}
+
+struct pmi_sparse *pmi_sparse_create (flux_shell_t *shell,
+                                      int k,
+                                      pmi_sparse_lookup_f cb,
+                                      void *arg)
+{
+    struct pmi_sparse *ps;
+
+    if (!(ps = calloc (1, sizeof (*ps))))
+        return NULL;
+    ps->shell = shell;
+    ps->size = shell->info->shell_size;
+    ps->rank = shell->info->shell_rank;
+    ps->lookup_cb = cb;
+    ps->lookup_arg = arg;
+    if (!(ps->store = json_object ())
+        || !(ps->cache = json_object ())
+        || !(ps->empty = json_object ())
+        || !(ps->lookups = zhashx_new ())
+        || !(ps->puts = zlist_new ())) {
+        errno = ENOMEM;
+        goto error;
+    }
+    zhashx_set_destructor (ps->lookups, lookup_destructor);
+    if (!(ps->barrier = pmi_exchange_create (shell, k)))
+        goto error;
+    if (flux_shell_service_register (shell,
+                                     "pmi-kvs-put",
+                                     put_request_cb,
+                                     ps) < 0
+        || flux_shell_service_register (shell,
+                                        "pmi-kvs-get",
+                                        get_request_cb,
+                                        ps) < 0)
+        goto error;
+    return ps;
+error:
+    pmi_sparse_destroy (ps);
+    return NULL;
+}
+
+void pmi_sparse_destroy (struct pmi_sparse *ps)
+{
+    if (ps) {
+        int saved_errno = errno;
+        if (ps->puts) {
+            flux_future_t *f;
+            while ((f = zlist_pop (ps->puts)))
+                flux_future_destroy (f);
+            zlist_destroy (&ps->puts);
+        }
+        zhashx_destroy (&ps->lookups);
+        pmi_exchange_destroy (ps->barrier);
+        json_decref (ps->empty);
+        json_decref (ps->cache);
+        json_decref (ps->store);
+        free (ps);
+        errno = saved_errno;
+    }
+}
+
+/* vi: ts=4 sw=4 expandtab
+ */
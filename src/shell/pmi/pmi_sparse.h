@@ -0,0 +1,55 @@
+/************************************************************\
+ * Copyright 2024 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+#ifndef SHELL_PMI_SPARSE_H
+#define SHELL_PMI_SPARSE_H
+
+/* Create handle for a distributed key-value store spread across shells.
+ * Each key is owned by one shell rank, selected by hashing the key.
+ * 'k' is the tree fanout of the fence barrier (k=0 selects internal default).
+ * 'cb' is invoked with 'arg' as each lookup completes (see below).
+ */
+struct pmi_sparse;
+
+typedef void (*pmi_sparse_lookup_f)(struct pmi_sparse *ps,
+                                    void *cli,
+                                    const char *val,
+                                    void *arg);
+
+struct pmi_sparse *pmi_sparse_create (flux_shell_t *shell,
+                                      int k,
+                                      pmi_sparse_lookup_f cb,
+                                      void *arg);
+void pmi_sparse_destroy (struct pmi_sparse *ps);
+
+typedef void (*pmi_sparse_fence_f)(struct pmi_sparse *ps, int rc, void *arg);
+
+/* Publish 'dict' from this shell to the key owners, then wait until
+ * all shells have done the same.  'cb' is invoked with rc=0 on success,
+ * or rc=-1 if any part of the fence failed.
+ */
+int pmi_sparse_fence (struct pmi_sparse *ps,
+                      json_t *dict,
+                      pmi_sparse_fence_f cb,
+                      void *arg);
+
+/* Look up 'key', which was published by a completed fence, on behalf
+ * of client 'cli' (non-NULL).  The lookup callback is invoked with 'cli'
+ * and the value, or val=NULL if the key was not found.  The callback
+ * may be invoked before this function returns if the value is available
+ * locally.  Concurrent lookups of the same remote key share one request
+ * to the owner, and fetched values are cached.
+ */
+int pmi_sparse_lookup (struct pmi_sparse *ps, const char *key, void *cli);
+
+#endif /* !SHELL_PMI_SPARSE_H */
+
+/* vi: ts=4 sw=4 expandtab
+ */
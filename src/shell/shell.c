@@ -48,6 +48,9 @@ static struct optparse_option shell_opts[] =  {
       .usage = "Get jobspec from FILE, not job-info service", },
     { .name = "resources", .key = 'R', .has_arg = 1, .arginfo = "FILE",
       .usage = "Get R from FILE, not job-info service", },
+    { .name = "jobinfo-service", .has_arg = 1, .arginfo = "TOPIC",
+      .usage = "Get jobspec and R from TOPIC on the local broker if "
+               "possible, then job-info service", },
     { .name = "broker-rank", .key = 'r', .has_arg = 1, .arginfo = "RANK",
       .usage = "Set broker rank, rather than asking broker", },
     { .name = "verbose", .key = 'v', .has_arg = 0,
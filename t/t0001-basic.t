@@ -328,6 +328,57 @@ test_expect_success 'hostlist attr is set on size 1 instance' '
 test_expect_success 'hostlist attr is set on all ranks of size 4 instance' '
 	flux start ${ARGS} -s4 flux exec flux getattr hostlist
 '
+test_expect_success 'broker.boot-hostlist defaults to tree' '
+	echo tree >boot_hostlist.exp &&
+	flux start ${ARGS} -s2 \
+		flux getattr broker.boot-hostlist >boot_hostlist.out &&
+	test_cmp boot_hostlist.exp boot_hostlist.out
+'
+test_expect_success 'hostlist is the same with boot-hostlist=all and tree' '
+	flux start ${ARGS} -s7 -o,-Sbroker.boot-hostlist=all \
+		flux exec flux getattr hostlist >hostlist_all.out &&
+	flux start ${ARGS} -s7 -o,-Sbroker.boot-hostlist=tree \
+		flux exec flux getattr hostlist >hostlist_tree.out &&
+	flux start ${ARGS} -s7 -o,-Stbon.fanout=0 \
+		flux exec flux getattr hostlist >hostlist_flat.out &&
+	test $(wc -l <hostlist_all.out) -eq 7 &&
+	test_cmp hostlist_all.out hostlist_tree.out &&
+	test_cmp hostlist_all.out hostlist_flat.out
+'
+# Hostnames (at most 64 characters) end in a letter so the hostlist does
+# not compress, and the total exceeds the PMI value size limit.
+test_expect_success 'create a long list of fake hostnames' '
+	pad=$(printf "%050d" 0) &&
+	for c in a b c d e f g h i j k l m n o p q r s t; do
+		printf "host-$pad-$c,"
+	done | sed -e "s/,\$//" >hostlist_long.exp &&
+	echo >>hostlist_long.exp &&
+	test $(wc -c <hostlist_long.exp) -gt 1000
+'
+test_expect_success 'long hostlist is split across PMI values' '
+	flux start ${ARGS} -s20 --test-hosts=$(cat hostlist_long.exp) \
+		flux exec flux getattr hostlist >hostlist_long_tree.out &&
+	flux start ${ARGS} -s20 --test-hosts=$(cat hostlist_long.exp) \
+		-o,-Sbroker.boot-hostlist=all \
+		flux exec flux getattr hostlist >hostlist_long_all.out &&
+	test $(wc -l <hostlist_long_tree.out) -eq 20 &&
+	sort -u hostlist_long_tree.out >hostlist_long_tree.uniq &&
+	sort -u hostlist_long_all.out >hostlist_long_all.uniq &&
+	test_cmp hostlist_long.exp hostlist_long_tree.uniq &&
+	test_cmp hostlist_long.exp hostlist_long_all.uniq
+'
+test_expect_success 'broker fails with invalid broker.boot-hostlist' '
+	test_must_fail flux start ${ARGS} -s2 \
+		-o,-Sbroker.boot-hostlist=foo /bin/true
+'
+test_expect_success 'broker.boot-time attributes are set on all ranks' '
+	flux start ${ARGS} -s4 flux exec sh -c " \
+		flux getattr broker.boot-time.init && \
+		flux getattr broker.boot-time.exchange && \
+		flux getattr broker.boot-time.hostlist && \
+		flux getattr broker.boot-time.finalize" >boot_time.out &&
+	test $(wc -l <boot_time.out) -eq 16
+'
 test_expect_success 'flux start (singlton) cleans up rundir' '
 	flux start ${ARGS} \
 		flux getattr rundir >rundir_pmi.out &&
@@ -182,6 +182,84 @@ test_expect_success 'store 1K blobs from all ranks using async RPC' '
 	flux exec -n ${SPAMUTIL} 1024 256 >/dev/null
 '
 
+# Batch payloads are a sequence of records:  4 byte errnum, 4 byte length,
+# then data.  See src/common/libcontent/content-batch.h.
+load_batch_encode() {
+	python3 -c "
+import sys, struct
+for line in sys.stdin:
+    h = bytes.fromhex(line.strip().split(\"-\")[1])
+    sys.stdout.buffer.write(struct.pack(\"!II\", 0, len(h)) + h)
+"
+}
+store_batch_encode() {
+	python3 -c "
+import sys, struct
+for path in sys.argv[1:]:
+    data = open(path, \"rb\").read()
+    sys.stdout.buffer.write(struct.pack(\"!II\", 0, len(data)) + data)
+" "$@"
+}
+# Print one line per record: errnum followed by data length
+batch_decode() {
+	python3 -c "
+import sys, struct
+buf = sys.stdin.buffer.read()
+off = 0
+while off < len(buf):
+    errnum, size = struct.unpack_from(\"!II\", buf, off)
+    off += 8 + size
+    print(errnum, size)
+"
+}
+
+test_expect_success 'store-batch of 3 blobs works' '
+	echo batch1 >batch1.store &&
+	echo batch22 >batch2.store &&
+	cat /dev/null >batch3.store &&
+	store_batch_encode batch1.store batch2.store batch3.store \
+		| ${RPC} -r content.store-batch | batch_decode >store-batch.out &&
+	test $(wc -l <store-batch.out) -eq 3 &&
+	test $(grep -c "^0 " store-batch.out) -eq 3
+'
+test_expect_success 'blobs stored with store-batch can be loaded on all ranks' '
+	for i in 1 2 3; do \
+	    ${BLOBREF} $HASHFUN <batch$i.store >batch$i.ref && \
+	    flux exec -n sh -c "flux content load $(cat batch$i.ref)" \
+	        >batch$i.all.out && \
+	    test $(wc -c <batch$i.all.out) -eq $(($(wc -c <batch$i.store)*$SIZE)) \
+	        || return 1; \
+	done
+'
+test_expect_success 'load-batch on rank 3 returns blobs and ENOENT(2) records' '
+	echo notstored | ${BLOBREF} $HASHFUN >missing.ref &&
+	cat batch1.ref missing.ref batch2.ref batch3.ref | load_batch_encode \
+		>load-batch.in &&
+	flux exec -n -r 3 sh -c "${RPC} -r content.load-batch" <load-batch.in \
+		| batch_decode >load-batch.out &&
+	cat >load-batch.exp <<-EOT &&
+	0 7
+	2 0
+	0 8
+	0 0
+	EOT
+	test_cmp load-batch.exp load-batch.out
+'
+test_expect_success 'empty load-batch returns empty response' '
+	${RPC} -r content.load-batch </dev/null >empty-batch.out &&
+	test_must_fail test -s empty-batch.out
+'
+test_expect_success 'load-batch with truncated payload fails with EPROTO(71)' '
+	printf "\000\000\000\000\000\000\000\024abc" \
+		| ${RPC} -r content.load-batch 71
+'
+test_expect_success 'load-batch with wrong hash size gets EPROTO(71) record' '
+	printf "\000\000\000\000\000\000\000\003abc" \
+		| ${RPC} -r content.load-batch | batch_decode >badhash.out &&
+	echo "71 0" >badhash.exp &&
+	test_cmp badhash.exp badhash.out
+'
+
 test_expect_success 'load request with empty payload fails with EPROTO(71)' '
 	${RPC} content.load 71 </dev/null
 '
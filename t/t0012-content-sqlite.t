@@ -78,6 +78,43 @@ test_expect_success 'load 1m blob bypassing cache' '
 	test_cmp 1m.0.store 1m.0.load
 '
 
+# Batch payloads are a sequence of records:  4 byte errnum, 4 byte length,
+# then data.  See src/common/libcontent/content-batch.h.
+store_batch_encode() {
+	python3 -c "
+import sys, struct
+for path in sys.argv[1:]:
+    data = open(path, \"rb\").read()
+    sys.stdout.buffer.write(struct.pack(\"!II\", 0, len(data)) + data)
+" "$@"
+}
+# Write each record of a load-batch response to file PREFIX.N
+batch_split() {
+	python3 -c "
+import sys, struct
+buf = sys.stdin.buffer.read()
+off = 0
+n = 0
+while off < len(buf):
+    errnum, size = struct.unpack_from(\"!II\", buf, off)
+    assert errnum == 0
+    open(sys.argv[1] + \".\" + str(n), \"wb\").write(buf[off+8:off+8+size])
+    off += 8 + size
+    n += 1
+" $1
+}
+
+# N.B. a store-batch response (hash records) is a valid load-batch request
+test_expect_success 'store-batch and load-batch bypassing cache' '
+	store_batch_encode 0.0.store 64.0.store 4k.0.store 1m.0.store \
+		| $RPC -r content-backing.store-batch >hashes.batch &&
+	$RPC -r content-backing.load-batch <hashes.batch | batch_split blob &&
+	test_cmp 0.0.store blob.0 &&
+	test_cmp 64.0.store blob.1 &&
+	test_cmp 4k.0.store blob.2 &&
+	test_cmp 1m.0.store blob.3
+'
+
 # Verify same blobs on all ranks
 # forcing content to fault in from the content backing service
 
@@ -193,6 +230,56 @@ test_expect_success HAVE_JQ 'wait for purge to clear cache entries' '
 	done
 '
 
+getstat() {
+	flux module stats content | jq ".\"$1\""
+}
+
+test_expect_success 'enable compressed cache tier' '
+	flux setattr content.compress-target-size 1048576
+'
+test_expect_success 'store compressible blobs' '
+	for i in $(seq 1 8); do \
+	    seq -f "$i line %g" 1 100 >zblob.$i && \
+	    flux content store <zblob.$i >zblob.$i.ref || return 1; \
+	done &&
+	flux content flush
+'
+test_expect_success HAVE_JQ 'wait for purge to demote entries to compressed tier' '
+	count=0 &&
+	while test $(getstat compressed) -eq 0 -a $count -lt 300; do \
+		sleep 0.1; \
+		count=$(($count+1))
+	done &&
+	test $(getstat compressed) -gt 0 &&
+	test $(getstat compressed-size) -gt 0
+'
+test_expect_success 'compressed blobs can be loaded' '
+	for i in $(seq 1 8); do \
+	    flux content load $(cat zblob.$i.ref) >zblob.$i.out && \
+	    test_cmp zblob.$i zblob.$i.out || return 1; \
+	done
+'
+test_expect_success 'disable compressed cache tier' '
+	flux setattr content.compress-target-size 0
+'
+test_expect_success HAVE_JQ 'wait for purge to empty compressed tier' '
+	count=0 &&
+	while test $(getstat compressed) -gt 0 -a $count -lt 300; do \
+		sleep 0.1; \
+		count=$(($count+1))
+	done &&
+	test $(getstat compressed) -eq 0
+'
+test_expect_success HAVE_JQ 'content.purge-max-size is enforced on load' '
+	flux content dropcache &&
+	flux setattr content.purge-max-size 2048 &&
+	for i in $(seq 1 8); do \
+	    flux content load $(cat zblob.$i.ref) >/dev/null || return 1; \
+	done &&
+	test $(getstat size) -le 2048 &&
+	flux setattr content.purge-max-size 0
+'
+
 test_expect_success 'remove content-sqlite module on rank 0' '
 	flux content flush &&
 	flux module remove content-sqlite
@@ -258,6 +345,42 @@ test_expect_success 'reload module with no options and verify modes' '
 	flux dmesg >logs2 &&
 	grep "journal_mode=OFF synchronous=OFF" logs2
 '
+test_expect_success 'writeback fails without journal_mode=WAL' '
+	flux module remove -f content-sqlite &&
+	test_must_fail flux module load content-sqlite writeback
+'
+test_expect_success 'writeback fails with bad writeback_interval' '
+	test_must_fail flux module load content-sqlite journal_mode=WAL \
+	    writeback writeback_interval=foo
+'
+test_expect_success 'load module with writeback' '
+	flux dmesg --clear &&
+	flux module load content-sqlite journal_mode=WAL \
+	    writeback writeback_interval=0.5s &&
+	flux dmesg >logs.wb &&
+	grep "writeback enabled" logs.wb
+'
+test_expect_success 'blobs can be loaded right after writeback store' '
+	dd if=/dev/urandom count=1 bs=4096 >4k.wb.store 2>/dev/null &&
+	flux content store --bypass-cache <4k.wb.store >4k.wb.hash &&
+	flux content load --bypass-cache $(cat 4k.wb.hash) >4k.wb.load &&
+	test_cmp 4k.wb.store 4k.wb.load
+'
+test_expect_success HAVE_JQ 'checkpoint-put and get work with writeback' '
+	checkpoint_put wbkey wbref &&
+	checkpoint_get wbkey | jq -r .value | jq -r .rootref >wbref.out &&
+	echo wbref >wbref.exp &&
+	test_cmp wbref.exp wbref.out
+'
+test_expect_success 'writeback blobs survive module reload' '
+	flux module reload content-sqlite journal_mode=WAL writeback &&
+	flux content load --bypass-cache $(cat 4k.wb.hash) >4k.wb.load2 &&
+	test_cmp 4k.wb.store 4k.wb.load2
+'
+test_expect_success 'reload module without writeback' '
+	flux module remove content-sqlite &&
+	flux module load content-sqlite
+'
 
 
 test_expect_success 'run flux without statedir and verify modes' '
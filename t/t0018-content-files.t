@@ -55,6 +55,16 @@ recheck_cache_blob() {
 	flux content load $blobref >blob.$1.cachecheck &&
 	test_cmp blob.$1 blob.$1.cachecheck
 }
+# Usage: store_batch_encode file... >batch
+# Batch records are a 4 byte errnum, 4 byte length, then data.
+store_batch_encode() {
+	python3 -c "
+import sys, struct
+for path in sys.argv[1:]:
+    data = open(path, \"rb\").read()
+    sys.stdout.buffer.write(struct.pack(\"!II\", 0, len(data)) + data)
+" "$@"
+}
 # Usage: checkpoint_put key rootref
 checkpoint_put() {
         o="{key:\"$1\",value:{version:1,rootref:\"$2\",timestamp:2.2}}"
@@ -84,6 +94,17 @@ test_expect_success 'load/store/verify key-values stored directly' '
 	test_cmp rawblob.140 rawblob.140.out
 '
 
+# N.B. a store-batch response (hash records) is a valid load-batch request,
+# and identical blobs yield identical responses
+test_expect_success 'store-batch/load-batch/verify blobs' '
+	make_blob 100 >bblob.1 &&
+	make_blob 5000 >bblob.2 &&
+	store_batch_encode bblob.1 bblob.2 >bblob.batch &&
+	$RPC -r content-backing.store-batch <bblob.batch >bhash.batch &&
+	$RPC -r content-backing.load-batch <bhash.batch >bblob.batch.check &&
+	test_cmp bblob.batch bblob.batch.check
+'
+
 test_expect_success 'store/load/verify various size small blobs' '
 	err=0 &&
 	for size in $SIZES; do \
@@ -230,6 +251,49 @@ test_expect_success 'checkpoint-put bad request fails with EPROTO' '
 	grep "Protocol error" badput.err
 '
 
+test_expect_success 'reload content-files module in pack mode' '
+	flux module reload content-files pack
+'
+test_expect_success HAVE_JQ 'checkpoint-get foo falls back to flat layout' '
+        checkpoint_get foo | jq -r .value | jq -r .rootref >rootref6.out &&
+        test_cmp rootref5.exp rootref6.out
+'
+test_expect_success 'store/load/verify various size blobs in pack mode' '
+	err=0 &&
+	for s in $SIZES; do \
+	    if ! check_blob $s; then err=$(($err+1)); fi; \
+	done &&
+	test $err -eq 0
+'
+test_expect_success 'flux module stats reports pack object count' '
+	test $(flux module stats \
+	    --type int --parse object_count content-files) -gt 0 &&
+	test $(flux module stats \
+	    --type int --parse pack_size content-files) -gt 0
+'
+test_expect_success HAVE_JQ 'checkpoint-put foo w/ rootref packed' '
+	checkpoint_put foo packed
+'
+test_expect_success 'reload content-files module in pack mode' '
+	flux module reload content-files pack
+'
+test_expect_success 'reload/verify various size blobs in pack mode' '
+	err=0 &&
+	for s in $SIZES; do \
+	    if ! recheck_blob $s; then err=$(($err+1)); fi; \
+	done &&
+	test $err -eq 0
+'
+test_expect_success HAVE_JQ 'checkpoint-get foo returned rootref packed' '
+        echo packed >rootref7.exp &&
+        checkpoint_get foo | jq -r .value | jq -r .rootref >rootref7.out &&
+        test_cmp rootref7.exp rootref7.out
+'
+test_expect_success 'pack mode stores blobs in one file' '
+	test -f content.files/pack.data &&
+	test -f content.files/pack.index &&
+	test $(ls content.files | grep -c "^sha") -eq 0
+'
 test_expect_success 'remove content-files module' '
 	flux module remove content-files
 '
@@ -508,6 +508,40 @@ test_expect_success 'kvs: test invalid fence arguments on rank 1' '
         grep "flux_future_get: Invalid argument" invalid_output
 '
 
+#
+# test lookup prefetch
+#
+
+test_expect_success 'kvs: lookup without prefetch does not prefetch' '
+        flux kvs put prefetch.a.b.c=1 prefetch.a.d.e=2 prefetch.a.f=3 &&
+        VERS=$(flux kvs version) &&
+        flux exec -n -r 1 sh -c "flux kvs wait ${VERS} && \
+                                 flux kvs dropcache && \
+                                 flux module stats -c kvs" &&
+        flux exec -n -r 1 flux kvs get prefetch.a.b.c &&
+        flux exec -n -r 1 flux module stats --parse "cache.#prefetch" kvs \
+            >prefetch.count &&
+        test $(cat prefetch.count) -eq 0
+'
+
+test_expect_success 'kvs: lookup with prefetch prefetches directories' '
+        flux exec -n -r 1 sh -c "flux kvs dropcache && \
+                                 flux module stats -c kvs" &&
+        flux exec -n -r 1 flux kvs get --prefetch prefetch.a.b.c \
+            >prefetch.out &&
+        echo 1 >prefetch.exp &&
+        test_cmp prefetch.exp prefetch.out &&
+        flux exec -n -r 1 flux module stats --parse "cache.#prefetch" kvs \
+            >prefetch.count &&
+        test $(cat prefetch.count) -gt 0
+'
+
+test_expect_success 'kvs: prefetched siblings may be read' '
+        flux exec -n -r 1 flux kvs get prefetch.a.d.e >prefetch.out &&
+        echo 2 >prefetch.exp &&
+        test_cmp prefetch.exp prefetch.out
+'
+
 #
 # test invalid lookup rpc
 #
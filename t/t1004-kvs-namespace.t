@@ -373,6 +373,39 @@ test_expect_success HAVE_JQ 'kvs: namespace with bad rootref fails otherwise' '
         test_must_fail flux kvs ls --namespace=$NAMESPACEROOTREF-3 .
 '
 
+#
+# Namespace create with link
+#
+
+NAMESPACELINK=namespacelink
+
+test_expect_success 'kvs: namespace create with link works' '
+	flux kvs namespace create --link=$DIR.linktest $NAMESPACELINK-1 &&
+	flux kvs readlink $DIR.linktest > linktest.out &&
+	grep "^$NAMESPACELINK-1::" linktest.out
+'
+
+test_expect_success 'kvs: namespace can be accessed through link' '
+	flux kvs put --namespace=$NAMESPACELINK-1 $DIR.val=44 &&
+	test_kvs_key $DIR.linktest.$DIR.val 44
+'
+
+test_expect_success 'kvs: namespace create with link on existing namespace fails' '
+	test_must_fail flux kvs namespace create \
+		--link=$DIR.linktest2 $NAMESPACETEST &&
+	test_must_fail flux kvs readlink $DIR.linktest2
+'
+
+test_expect_success 'kvs: namespace is removed when link fails' '
+	test_must_fail flux kvs namespace create --link=. $NAMESPACELINK-2 &&
+	test_must_fail flux kvs put --namespace=$NAMESPACELINK-2 $DIR.val=1
+'
+
+test_expect_success 'kvs: namespace create with link rejects multiple names' '
+	test_must_fail flux kvs namespace create --link=$DIR.linktest3 \
+		$NAMESPACELINK-3 $NAMESPACELINK-4
+'
+
 #
 # Namespace corner case tests
 #
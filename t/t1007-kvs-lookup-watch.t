@@ -46,6 +46,32 @@ test_expect_success NO_CHAIN_LINT 'kvs-watch stats reports active watcher' '
        wait $pid
 '
 
+test_expect_success NO_CHAIN_LINT 'kvs-watch coalesces identical lookups' '
+       flux kvs put test.coalesce=0 &&
+       count0=$(flux module stats --parse=lookup-count kvs-watch) &&
+       rpc0=$(flux module stats --parse=lookup-rpc-count kvs-watch) &&
+       flux kvs get --watch --count=2 test.coalesce >coalesce1.out &
+       pid1=$! &&
+       flux kvs get --watch --count=2 test.coalesce >coalesce2.out &
+       pid2=$! &&
+       $waitfile --count=1 --timeout=10 --pattern="[0-9]+" coalesce1.out &&
+       $waitfile --count=1 --timeout=10 --pattern="[0-9]+" coalesce2.out &&
+       flux kvs put --no-merge test.coalesce=1 &&
+       wait $pid1 &&
+       wait $pid2 &&
+       count=$(flux module stats --parse=lookup-count kvs-watch) &&
+       rpc=$(flux module stats --parse=lookup-rpc-count kvs-watch) &&
+       test $((count - count0)) -eq 2 &&
+       test $((rpc - rpc0)) -eq 1
+'
+
+test_expect_success 'kvs-watch stats report lookup coalescing ratio' '
+       flux module stats kvs-watch >coalesce-stats.out &&
+       jq -e ".\"lookup-count\" > .\"lookup-rpc-count\"" \
+           <coalesce-stats.out &&
+       jq -e ".\"lookup-coalesce-ratio\" > 1" <coalesce-stats.out
+'
+
 # Check that stdin contains an integer on each line that
 # is one more than the integer on the previous line.
 test_monotonicity() {
@@ -323,6 +349,21 @@ hi
         test_cmp expected append4.out
 '
 
+test_expect_success NO_CHAIN_LINT 'flux kvs get: --append works with many appends' '
+        flux kvs unlink -Rf test &&
+        flux kvs put test.append.test="0" &&
+        flux kvs get --watch --append --count=100 \
+                     test.append.test > append_many.out 2>&1 &
+        pid=$! &&
+        wait_watcherscount_nonzero primary &&
+        for i in $(seq 1 99); do \
+            flux kvs put --append test.append.test="$i" || return 1; \
+        done &&
+        wait $pid &&
+        seq 0 99 > expected &&
+        test_cmp expected append_many.out
+'
+
 test_expect_success 'flux kvs get: --append fails on non-value' '
         flux kvs unlink -Rf test &&
         flux kvs mkdir test.append &&
@@ -0,0 +1,151 @@
+#!/bin/sh
+#
+
+test_description='Test kvs module treeobj-format config.'
+
+. `dirname $0`/kvs/kvs-helper.sh
+
+. `dirname $0`/sharness.sh
+
+export FLUX_CONF_DIR=$(pwd)
+test_under_flux 1 minimal -o,-Sstatedir=$(pwd)
+
+# Print the first byte of the current kvs root directory object in hex.
+# A JSON treeobj begins with "{" (7b), a binary treeobj with f1.
+root_format() {
+	flux content load $(flux kvs getroot -b) | od -An -tx1 -N1 | tr -d " "
+}
+
+test_expect_success 'load content-sqlite and kvs with default config' '
+	flux module load content-sqlite &&
+	flux module load kvs
+'
+
+test_expect_success 'create some kvs content in JSON format' '
+	printf "%-.*d" 100 0 >json.val &&
+	flux kvs put --no-merge json.a=1 &&
+	flux kvs put --no-merge json.dir.b=foo &&
+	flux kvs put --no-merge json.big=$(cat json.val) &&
+	flux kvs link json.dir json.link &&
+	test $(root_format) = "7b"
+'
+
+test_expect_success 'configure bad treeobj-format fails on reload' '
+	cat >kvs.toml <<-EOF &&
+	[kvs]
+	treeobj-format = "foo"
+	EOF
+	test_must_fail flux config reload
+'
+
+test_expect_success 'configure treeobj-format = binary' '
+	cat >kvs.toml <<-EOF &&
+	[kvs]
+	treeobj-format = "binary"
+	EOF
+	flux config reload
+'
+
+test_expect_success 'kvs: put writes binary treeobjs' '
+	printf "%-.*d" 100 1 >bin.val &&
+	flux kvs put --no-merge bin.a=2 &&
+	flux kvs put --no-merge bin.dir.b=bar &&
+	flux kvs put --no-merge bin.big=$(cat bin.val) &&
+	flux kvs link bin.dir bin.link &&
+	test $(root_format) = "f1"
+'
+
+test_expect_success 'kvs: get works on binary treeobjs' '
+	test_kvs_key bin.a 2 &&
+	test_kvs_key bin.dir.b bar &&
+	test_kvs_key bin.big $(cat bin.val) &&
+	test_kvs_key bin.link.b bar
+'
+
+test_expect_success 'kvs: get works on existing JSON treeobjs' '
+	test_kvs_key json.a 1 &&
+	test_kvs_key json.dir.b foo &&
+	test_kvs_key json.big $(cat json.val) &&
+	test_kvs_key json.link.b foo
+'
+
+test_expect_success 'kvs: update existing JSON directory' '
+	flux kvs put --no-merge json.dir.c=baz &&
+	test_kvs_key json.dir.b foo &&
+	test_kvs_key json.dir.c baz
+'
+
+test_expect_success 'kvs: append works with binary treeobjs' '
+	flux kvs put --no-merge bin.log=x &&
+	flux kvs put --no-merge --append bin.log=y &&
+	test_kvs_key bin.log xy
+'
+
+test_expect_success 'kvs: invalid config on reload leaves format unchanged' '
+	cat >kvs.toml <<-EOF &&
+	[kvs]
+	treeobj-format = "json"
+	prefetch-depth = -1
+	EOF
+	test_must_fail flux config reload &&
+	flux kvs put --no-merge bin.c=3 &&
+	test $(root_format) = "f1"
+'
+
+test_expect_success 'restore treeobj-format = binary' '
+	cat >kvs.toml <<-EOF &&
+	[kvs]
+	treeobj-format = "binary"
+	EOF
+	flux config reload
+'
+
+test_expect_success 'kvs: reload kvs module' '
+	flux kvs dir -R >dir-before.out &&
+	flux module reload kvs &&
+	flux kvs dir -R >dir-after.out &&
+	test_cmp dir-before.out dir-after.out
+'
+
+test_expect_success 'kvs: put after reload writes binary treeobjs' '
+	flux kvs put --no-merge bin.d=4 &&
+	test $(root_format) = "f1" &&
+	test_kvs_key bin.d 4
+'
+
+test_expect_success 'unload kvs and dump checkpoint' '
+	flux kvs dir -R >dir-dump.out &&
+	flux module remove kvs &&
+	flux dump --checkpoint dump.tar
+'
+
+test_expect_success 'remove backing file and restore checkpoint' '
+	flux content flush &&
+	flux content dropcache &&
+	flux module remove content-sqlite &&
+	rm -f content.sqlite &&
+	flux module load content-sqlite &&
+	flux restore --checkpoint dump.tar
+'
+
+test_expect_success 'kvs: restored content is intact' '
+	flux module load kvs &&
+	flux kvs dir -R >dir-restore.out &&
+	test_cmp dir-dump.out dir-restore.out &&
+	test_kvs_key json.dir.c baz &&
+	test_kvs_key bin.big $(cat bin.val) &&
+	test_kvs_key bin.log xy
+'
+
+test_expect_success 'kvs: put after restore writes binary treeobjs' '
+	flux kvs put --no-merge bin.e=5 &&
+	test $(root_format) = "f1" &&
+	test_kvs_key bin.e 5
+'
+
+test_expect_success 'kvs: remove modules' '
+	flux module remove kvs &&
+	flux module remove content-sqlite
+'
+
+test_done
@@ -0,0 +1,126 @@
+#!/bin/sh
+#
+
+test_description='Test kvs module commit-threads config.'
+
+. `dirname $0`/sharness.sh
+
+export FLUX_CONF_DIR=$(pwd)
+SIZE=4
+test_under_flux ${SIZE} kvs
+
+NSCOUNT=8
+THREADS=4
+COUNT=50
+
+# Run the commit test program in each of the test namespaces concurrently.
+# arg1 - key prefix, suffixed with the namespace index
+# remaining args - options passed to the commit test program
+commit_all_namespaces() {
+	local prefix=$1
+	local pids=""
+	local i
+	shift
+	for i in $(seq 1 ${NSCOUNT}); do
+		FLUX_KVS_NAMESPACE=ct-$i ${FLUX_BUILD_DIR}/t/kvs/commit \
+		    "$@" ${THREADS} ${COUNT} ${prefix}-$i &
+		pids="$pids $!"
+	done
+	for pid in $pids; do
+		wait $pid || return 1
+	done
+}
+
+# Check that each test namespace contains THREADS*COUNT keys.
+# arg1 - key prefix, suffixed with the namespace index
+check_all_namespaces() {
+	local i
+	for i in $(seq 1 ${NSCOUNT}); do
+		test $(flux kvs dir -R --namespace=ct-$i $1-$i | wc -l) \
+		    -eq $((${THREADS}*${COUNT})) || return 1
+	done
+}
+
+test_expect_success 'configure commit-threads = 4' '
+	cat >kvs.toml <<-EOF
+	[kvs]
+	commit-threads = 4
+	EOF
+'
+
+if ! flux config reload 2>config-reload.err; then
+	if grep -q "requires jansson" config-reload.err; then
+		skip_all='skipping commit-threads tests, jansson is too old'
+		test_done
+	fi
+fi
+
+test_expect_success 'configure bad commit-threads fails on reload' '
+	cat >kvs.toml <<-EOF &&
+	[kvs]
+	commit-threads = -1
+	EOF
+	test_must_fail flux config reload
+'
+
+test_expect_success 'reload kvs with commit-threads = 4' '
+	cat >kvs.toml <<-EOF &&
+	[kvs]
+	commit-threads = 4
+	EOF
+	flux config reload &&
+	flux module reload kvs
+'
+
+test_expect_success 'kvs: 8 threads/rank each doing 100 put,commits in a loop' '
+	flux exec -n ${FLUX_BUILD_DIR}/t/kvs/commit 8 100 primary &&
+	test $(flux kvs dir -R primary | wc -l) -eq $((${SIZE}*8*100))
+'
+
+test_expect_success 'kvs: 8 threads/rank each doing 100 put,fence in a loop' '
+	flux exec -n ${FLUX_BUILD_DIR}/t/kvs/commit \
+		--fence $((${SIZE}*8)) 8 100 fence
+'
+
+test_expect_success 'kvs: create test namespaces' '
+	for i in $(seq 1 ${NSCOUNT}); do
+		flux kvs namespace create ct-$i || return 1
+	done
+'
+
+test_expect_success NO_CHAIN_LINT 'kvs: concurrent commits to many namespaces' '
+	commit_all_namespaces commit &&
+	check_all_namespaces commit
+'
+
+test_expect_success NO_CHAIN_LINT 'kvs: concurrent unmerged commits to many namespaces' '
+	commit_all_namespaces nomerge --nomerge 1 &&
+	check_all_namespaces nomerge
+'
+
+test_expect_success NO_CHAIN_LINT 'kvs: concurrent fences in many namespaces' '
+	commit_all_namespaces fence --fence ${THREADS} &&
+	check_all_namespaces fence
+'
+
+test_expect_success 'kvs: primary namespace is intact' '
+	test $(flux kvs dir -R primary | wc -l) -eq $((${SIZE}*8*100))
+'
+
+test_expect_success 'kvs: remove test namespaces' '
+	for i in $(seq 1 ${NSCOUNT}); do
+		flux kvs namespace remove ct-$i || return 1
+	done
+'
+
+test_expect_success 'reload kvs with commit-threads = 0' '
+	cat >kvs.toml <<-EOF &&
+	[kvs]
+	commit-threads = 0
+	EOF
+	flux config reload &&
+	flux module reload kvs &&
+	test $(flux kvs dir -R primary | wc -l) -eq $((${SIZE}*8*100))
+'
+
+test_done
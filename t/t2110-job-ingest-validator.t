@@ -96,6 +96,19 @@ test_expect_success HAVE_JQ 'flux job-validator --feasibility-service works ' '
 test_expect_success 'job-ingest: v1 jobspecs accepted by default' '
 	test_valid ${JOBSPEC}/valid_v1/*
 '
+test_expect_success HAVE_JQ 'job-ingest: default validator rejects bad constraint' '
+	flux mini run --dry-run hostname \
+		| jq ".attributes.system.constraints.properties = [\"a|b\"]" \
+		>badprop.json &&
+	test_must_fail flux job submit badprop.json 2>badprop.err &&
+	grep "invalid character" badprop.err
+'
+test_expect_success HAVE_JQ 'job-ingest: default validator checks all task counts' '
+	flux mini run --dry-run hostname \
+		| jq ".tasks[0].count.total = 0" >badcount.json &&
+	test_must_fail flux job submit badcount.json 2>badcount.err &&
+	grep "count total must be > 0" badcount.err
+'
 test_expect_success 'job-ingest: test jobspec validator with any version' '
 	ingest_module reload \
 		validator-plugins=jobspec \
@@ -471,6 +471,34 @@ test_expect_success 'job-manager: job.create can reject a job' '
 	grep nope submit.err
 '
 
+test_expect_success 'job-manager: topic with no handler is dispatched after load' '
+	flux jobtap remove all &&
+	flux mini submit hostname &&
+	flux jobtap load ${PLUGINPATH}/create-reject.so &&
+	test_must_fail flux mini submit hostname 2>dispatch-load.err &&
+	grep nope dispatch-load.err
+'
+test_expect_success 'job-manager: topic is not dispatched to removed plugin' '
+	flux jobtap remove create-reject.so &&
+	flux mini submit hostname
+'
+test_expect_success 'job-manager: removing a plugin keeps others dispatched' '
+	flux mini submit \
+	    --setattr=system.jobtap.validate-test-id=4 hostname &&
+	flux jobtap load ${PLUGINPATH}/validate.so &&
+	flux jobtap load ${PLUGINPATH}/create-reject.so &&
+	test_must_fail flux mini submit hostname 2>dispatch-both.err &&
+	grep nope dispatch-both.err &&
+	flux jobtap remove create-reject.so &&
+	flux mini submit hostname &&
+	test_must_fail flux mini submit \
+	    --setattr=system.jobtap.validate-test-id=4 hostname \
+	    2>dispatch-validate.err &&
+	grep "Job had reject_id" dispatch-validate.err &&
+	flux jobtap remove validate.so &&
+	flux mini submit \
+	    --setattr=system.jobtap.validate-test-id=4 hostname
+'
 test_expect_success 'job-manager: plugin fails to load on config.update error' '
 	flux jobtap remove all &&
 	test_must_fail flux jobtap load ${PLUGINPATH}/config.so 2>config.err
@@ -366,6 +366,21 @@ test_expect_success HAVE_JQ 'job-list: list successfully reconstructed' '
         test_cmp before_reload.out after_reload.out
 '
 
+test_expect_success HAVE_JQ 'flux job list only completed jobs after reload' '
+        id=$(id -u) &&
+        state=`${JOB_CONV} strtostate INACTIVE` &&
+        result=`${JOB_CONV} strtoresult COMPLETED` &&
+        $jq -j -c -n  "{max_entries:1000, userid:${id}, states:${state}, results:${result}, attrs:[]}" \
+          | $RPC job-list.list | $jq .jobs | $jq -c '.[]' | $jq .id > list_result_completed2.out &&
+        test_cmp completed.ids list_result_completed2.out
+'
+
+test_expect_success HAVE_JQ 'flux job list of user with no jobs returns nothing' '
+        id=$(($(id -u) + 1)) &&
+        $jq -j -c -n  "{max_entries:1000, userid:${id}, states:0, results:0, attrs:[]}" \
+          | $RPC job-list.list | $jq -e ".jobs | length == 0"
+'
+
 test_expect_success HAVE_JQ 'job stats lists jobs in correct state (all inactive)' '
         flux job stats | jq -e ".job_states.depend == 0" &&
         flux job stats | jq -e ".job_states.priority == 0" &&
@@ -42,6 +42,19 @@ test_expect_success 'job-exec: exec.eventlog exists with expected states' '
 	head -1 eventlog.1.out | grep "init" &&
 	tail -1 eventlog.1.out | grep "done"
 '
+test_expect_success 'job-exec: guestns of jobs started together are moved' '
+	flux mini submit --cc=1-8 \
+	    --setattr=system.exec.test.run_duration=0.0001s \
+	    hostname > cc.ids &&
+	test $(wc -l < cc.ids) -eq 8 &&
+	for id in $(cat cc.ids); do
+	    flux job wait-event -t 10 $id clean &&
+	    test_must_fail flux kvs readlink $(job_kvsdir $id).guest &&
+	    exec_eventlog $id > eventlog.$id.out &&
+	    head -1 eventlog.$id.out | grep "init" &&
+	    tail -1 eventlog.$id.out | grep "done" || return 1
+	done
+'
 test_expect_success 'job-exec: canceling job during execution works' '
 	jobid=$(flux mini submit \
                 --setattr=system.exec.test.run_duration=10s hostname) &&
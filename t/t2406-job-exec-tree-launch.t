@@ -0,0 +1,78 @@
+#!/bin/sh
+
+test_description='Test flux job execution service with TBON launch'
+
+. $(dirname $0)/sharness.sh
+
+test_under_flux 4 job
+
+RPC=${FLUX_BUILD_DIR}/t/request/rpc
+
+flux setattr log-stderr-level 1
+
+test_expect_success 'job-exec: launch relay is loaded on all ranks' '
+	flux exec -r 1-3 sh -c "flux module list | grep job-exec"
+'
+test_expect_success 'job-exec: reload job-exec with tree-launch' '
+	flux module reload -f job-exec tree-launch
+'
+test_expect_success 'job-exec: multi-node job runs on all ranks' '
+	cat >ranks.expected <<-EOF &&
+	0
+	1
+	2
+	3
+	EOF
+	flux mini run -N4 -n4 flux getattr rank | sort -n >ranks.out &&
+	test_cmp ranks.expected ranks.out
+'
+test_expect_success 'job-exec: single node job on a leaf rank runs' '
+	jobid=$(flux mini submit -N3 sleep 300) &&
+	flux job wait-event -t 30 $jobid start &&
+	flux mini run -N1 flux getattr rank >leaf.out &&
+	flux job cancel $jobid &&
+	flux job wait-event -t 30 $jobid clean &&
+	test "$(cat leaf.out)" = "3"
+'
+test_expect_success 'job-exec: task exit code propagates' '
+	test_expect_code 3 flux mini run -N4 -n4 \
+		sh -c "test \$(flux getattr rank) -ne 2 || exit 3"
+'
+test_expect_success 'job-exec: standard input is delivered to all ranks' '
+	echo hello | flux mini run -N4 -n4 cat >stdin.out &&
+	test $(grep -c hello stdin.out) -eq 4
+'
+test_expect_success 'job-exec: multi-node job can be canceled' '
+	jobid=$(flux mini submit -N4 -n4 sleep 300) &&
+	flux job wait-event -t 30 $jobid start &&
+	flux job cancel $jobid &&
+	flux job wait-event -t 30 $jobid clean
+'
+test_expect_success 'job-exec: jobspec and R are relayed to every rank' '
+	cat >jobinfo.sh <<-EOF &&
+	#!/bin/sh
+	echo "{\"id\":\$1}" | $RPC job-exec.jobinfo \$2
+	EOF
+	chmod +x jobinfo.sh &&
+	jobid=$(flux mini submit -N4 -n4 sleep 300) &&
+	flux job wait-event -t 30 $jobid start &&
+	flux exec -r 0-3 ./jobinfo.sh $(flux job id $jobid) >jobinfo.out &&
+	test $(grep -c environment jobinfo.out) -eq 4 &&
+	test $(grep -c R_lite jobinfo.out) -eq 4 &&
+	flux job cancel $jobid &&
+	flux job wait-event -t 30 $jobid clean
+'
+test_expect_success 'job-exec: jobinfo is not available after job exits' '
+	flux exec -r 0-3 ./jobinfo.sh $(flux job id $jobid) 2
+'
+test_expect_success 'job-exec: remove launch relay from rank 1' '
+	flux exec -r 1 flux module remove job-exec
+'
+test_expect_success 'job-exec: job runs when a relay is missing' '
+	flux mini run -N4 -n4 flux getattr rank | sort -n >ranks2.out &&
+	test_cmp ranks.expected ranks2.out
+'
+test_expect_success 'job-exec: restore launch relay on rank 1' '
+	flux exec -r 1 flux module load job-exec
+'
+test_done
@@ -51,6 +51,16 @@ test_expect_success 'kvstest works with -o pmi.kvs=native' '
 	flux mini run -n${SIZE} -N${SIZE} -o pmi.kvs=native ${kvstest}
 '
 
+test_expect_success 'kvstest works with -o pmi.kvs=sparse' '
+	flux mini run -n${SIZE} -N${SIZE} -o pmi.kvs=sparse ${kvstest} \
+		2>kvstest_sparse.err &&
+	grep "using sparse kvs implementation" kvstest_sparse.err
+'
+
+test_expect_success 'kvstest works with -o pmi.kvs=sparse and 2 tasks/shell' '
+	flux mini run -n$((${SIZE}*2)) -N${SIZE} -o pmi.kvs=sparse ${kvstest}
+'
+
 test_expect_success 'kvstest -N8 works' '
 	flux mini run -n${SIZE} -N${SIZE} ${kvstest} -N8
 '
@@ -59,6 +69,10 @@ test_expect_success 'kvstest -N8 works with -o pmi.kvs=native' '
 	flux mini run -n${SIZE} -N${SIZE} -o pmi.kvs=native ${kvstest} -N8
 '
 
+test_expect_success 'kvstest -N8 works with -o pmi.kvs=sparse' '
+	flux mini run -n${SIZE} -N${SIZE} -o pmi.kvs=sparse ${kvstest} -N8
+'
+
 test_expect_success 'verbose=2 shell option enables PMI server side tracing' '
 	flux mini run -n${SIZE} -N${SIZE} -o verbose=2 ${kvstest} 2>trace.out &&
 	grep "cmd=finalize_ack" trace.out